@@ -0,0 +1,238 @@
+#include "Benchmark.h"
+#include "../Utilities/FrameArena.h"
+#include "../Utilities/IndexPool.h"
+#include <cstdlib>
+#include <thread>
+
+namespace Havana::Benchmarks
+{
+	namespace
+	{
+		constexpr u32 frameBufferCount{ 3 };
+		constexpr u32 heapCapacity{ 4096 };
+
+		// Portable copy of the index management DescriptorHeap had before it moved to
+		// Utils::IndexPool: a stack of free indices behind a mutex, with frees deferred
+		// until the frame that used the index is done on the GPU.
+		class FreeIndexHeap
+		{
+		public:
+			explicit FreeIndexHeap(u32 capacity) : m_freeHandles{ std::make_unique<u32[]>(capacity) }, m_capacity{ capacity }
+			{
+				for (u32 i{ 0 }; i < capacity; i++) m_freeHandles[i] = i;
+			}
+
+			u32 Allocate()
+			{
+				std::lock_guard lock{ m_mutex };
+				assert(m_size < m_capacity);
+				const u32 index{ m_freeHandles[m_size] };
+				m_size++;
+				return index;
+			}
+
+			void Free(u32 index, u32 frameIdx)
+			{
+				std::lock_guard lock{ m_mutex };
+				assert(index < m_capacity && m_size);
+				m_deferredFreeIndices[frameIdx].push_back(index);
+			}
+
+			void ProcessDeferredFree(u32 frameIdx)
+			{
+				std::lock_guard lock{ m_mutex };
+				Utils::vector<u32>& indices{ m_deferredFreeIndices[frameIdx] };
+				for (const u32 index : indices)
+				{
+					m_size--;
+					m_freeHandles[m_size] = index;
+				}
+				indices.clear();
+			}
+
+			void Free(u32 index) { Free(index, 0); ProcessDeferredFree(0); }
+
+			constexpr u32 Size() const { return m_size; }
+
+		private:
+			std::unique_ptr<u32[]>	m_freeHandles{};
+			Utils::vector<u32>		m_deferredFreeIndices[frameBufferCount]{};
+			std::mutex				m_mutex{};
+			u32						m_capacity{ 0 };
+			u32						m_size{ 0 };
+		};
+
+		using IndexPool = Utils::IndexPool<frameBufferCount>;
+
+		// Steady state of a renderer that replaces 64 descriptors per frame out of 1024 live ones
+		template<typename Heap>
+		u64 DescriptorChurn(u32 iterations)
+		{
+			constexpr u32 liveCount{ 1024 };
+			constexpr u32 churnPerFrame{ 64 };
+			Heap heap{ heapCapacity };
+			u32 live[liveCount]{};
+			for (u32& index : live) index = heap.Allocate();
+
+			Random random{};
+			u64 sum{ 0 };
+			u32 frame{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				if (i % churnPerFrame == 0)
+				{
+					frame = (frame + 1) % frameBufferCount;
+					heap.ProcessDeferredFree(frame);
+				}
+
+				u32& index{ live[random.Next() % liveCount] };
+				heap.Free(index, frame);
+				index = heap.Allocate();
+				sum += index;
+			}
+			return sum + heap.Size();
+		}
+
+		// Allocating and freeing a batch of indices without frame latency
+		template<typename Heap>
+		u64 DescriptorBatch(u32 iterations)
+		{
+			constexpr u32 batchSize{ 256 };
+			Heap heap{ heapCapacity };
+			u32 batch[batchSize]{};
+
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i += batchSize)
+			{
+				for (u32& index : batch) index = heap.Allocate();
+				for (const u32 index : batch)
+				{
+					sum += index;
+					heap.Free(index, 0);
+				}
+				heap.ProcessDeferredFree(0);
+			}
+			return sum;
+		}
+
+		// Four threads creating and destroying resources at the same time, with immediate frees
+		template<typename Heap>
+		u64 DescriptorContended(u32 iterations)
+		{
+			constexpr u32 threadCount{ 4 };
+			constexpr u32 liveCount{ 64 };
+			Heap heap{ heapCapacity };
+			u64 sums[threadCount]{};
+
+			auto work = [&heap, iterations](u64& sum)
+			{
+				u32 live[liveCount]{};
+				for (u32& index : live) index = heap.Allocate();
+				for (u32 i{ 0 }; i < iterations / threadCount; i++)
+				{
+					u32& index{ live[i % liveCount] };
+					heap.Free(index);
+					index = heap.Allocate();
+				}
+				for (const u32 index : live) heap.Free(index);
+				sum = iterations / threadCount;
+			};
+
+			std::thread threads[threadCount - 1];
+			for (u32 i{ 0 }; i < threadCount - 1; i++) threads[i] = std::thread{ work, std::ref(sums[i]) };
+			work(sums[threadCount - 1]);
+			for (std::thread& thread : threads) thread.join();
+
+			u64 sum{ heap.Size() };
+			for (const u64 s : sums) sum += s;
+			return sum;
+		}
+
+		//// TRANSIENT ALLOCATIONS ////
+
+		// Frame of small transient allocations (16-256 bytes) that are all freed at the end
+		constexpr u32 allocationsPerFrame{ 4096 };
+
+		u64 MallocFrame(u32 iterations)
+		{
+			void* allocations[allocationsPerFrame];
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i += allocationsPerFrame)
+			{
+				for (u32 j{ 0 }; j < allocationsPerFrame; j++)
+				{
+					allocations[j] = malloc(16 + (j * 37) % 241);
+					DoNotOptimize(allocations[j]);
+					sum += j;
+				}
+				for (void* const allocation : allocations) free(allocation);
+			}
+			return sum;
+		}
+
+		u64 FrameArenaFrame(u32 iterations)
+		{
+			Utils::FrameArena arena{};
+			arena.Initialize(frameBufferCount + 1, 4 * 1024 * 1024);
+			u32 frame{ 0 };
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i += allocationsPerFrame)
+			{
+				for (u32 j{ 0 }; j < allocationsPerFrame; j++)
+				{
+					void* const allocation{ arena.Allocate(16 + (j * 37) % 241) };
+					DoNotOptimize(allocation);
+					sum += j;
+				}
+				frame = (frame + 1) % arena.FrameCount();
+				arena.BeginFrame(frame);
+			}
+			return sum;
+		}
+
+		// A per-frame list that grows to 1024 elements
+		template<bool useArena>
+		u64 TransientVector(u32 iterations)
+		{
+			constexpr u32 listSize{ 1024 };
+			Utils::FrameArena arena{};
+			arena.Initialize(frameBufferCount + 1, 1024 * 1024);
+			u32 frame{ 0 };
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i += listSize)
+			{
+				if constexpr (useArena)
+				{
+					Utils::frame_vector<u32> list{ Utils::FrameAllocator<u32>{ arena } };
+					for (u32 j{ 0 }; j < listSize; j++) list.push_back(j);
+					sum += list.back();
+				}
+				else
+				{
+					Utils::vector<u32> list;
+					for (u32 j{ 0 }; j < listSize; j++) list.push_back(j);
+					sum += list.back();
+				}
+				frame = (frame + 1) % arena.FrameCount();
+				arena.BeginFrame(frame);
+			}
+			return sum;
+		}
+	} // anonymous namespace
+
+	void AddAllocatorBenchmarks()
+	{
+		Add("free_index/churn", DescriptorChurn<FreeIndexHeap>, 1 << 22);
+		Add("free_index/batch", DescriptorBatch<FreeIndexHeap>, 1 << 22);
+		Add("free_index/contended", DescriptorContended<FreeIndexHeap>, 1 << 22);
+
+		Add("index_pool/churn", DescriptorChurn<IndexPool>, 1 << 22);
+		Add("index_pool/batch", DescriptorBatch<IndexPool>, 1 << 22);
+		Add("index_pool/contended", DescriptorContended<IndexPool>, 1 << 22);
+
+		Add("transient/malloc", MallocFrame, 1 << 22);
+		Add("transient/frame_arena", FrameArenaFrame, 1 << 22);
+		Add("transient/vector/heap", TransientVector<false>, 1 << 22);
+		Add("transient/vector/frame_arena", TransientVector<true>, 1 << 22);
+	}
+}
@@ -0,0 +1,128 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace Havana::Benchmarks
+{
+	namespace
+	{
+		constexpr u32 repetitions{ 7 };
+
+		struct BenchmarkInfo
+		{
+			const char*			name{ nullptr };
+			benchmark_function	function{ nullptr };
+			u32					iterations{ 0 };
+		};
+
+		struct BenchmarkResult
+		{
+			f64		minNs{ 0.0 };		// per iteration
+			f64		medianNs{ 0.0 };
+			f64		maxNs{ 0.0 };
+			u64		checksum{ 0 };
+		};
+
+		Utils::vector<BenchmarkInfo> benchmarks;
+
+		BenchmarkResult Run(const BenchmarkInfo& info)
+		{
+			using clock = std::chrono::steady_clock;
+
+			// The first run warms up caches and the branch predictor and isn't measured
+			BenchmarkResult result{};
+			result.checksum = info.function(info.iterations);
+			DoNotOptimize(result.checksum);
+
+			f64 times[repetitions]{};
+			for (f64& time : times)
+			{
+				const clock::time_point begin{ clock::now() };
+				const u64 checksum{ info.function(info.iterations) };
+				const clock::time_point end{ clock::now() };
+				DoNotOptimize(checksum);
+				assert(checksum == result.checksum);
+				time = std::chrono::duration<f64, std::nano>(end - begin).count() / info.iterations;
+			}
+
+			std::sort(std::begin(times), std::end(times));
+			result.minNs = times[0];
+			result.medianNs = times[repetitions / 2];
+			result.maxNs = times[repetitions - 1];
+			return result;
+		}
+
+		const char* Compiler()
+		{
+#if defined (__clang__)
+			return "clang " __clang_version__;
+#elif defined (__GNUC__)
+			return "gcc " __VERSION__;
+#elif defined (_MSC_VER)
+			return "msvc";
+#else
+			return "unknown";
+#endif
+		}
+	} // anonymous namespace
+
+	void Add(const char* name, benchmark_function function, u32 iterations)
+	{
+		assert(name && function && iterations);
+		benchmarks.push_back({ name, function, iterations });
+	}
+}
+
+using namespace Havana;
+
+// Usage: bench.a [--filter <substring>] [--out <file.json>]
+int main(int argc, char** argv)
+{
+	const char* filter{ nullptr };
+	const char* outPath{ nullptr };
+	for (int i{ 1 }; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+		else if (!strcmp(argv[i], "--out") && i + 1 < argc) outPath = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [--filter <substring>] [--out <file.json>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Benchmarks::AddCoreBenchmarks();
+	Benchmarks::AddMathBenchmarks();
+	Benchmarks::AddAllocatorBenchmarks();
+	Benchmarks::AddSpatialBenchmarks();
+
+	FILE* const out{ outPath ? fopen(outPath, "w") : stdout };
+	if (!out)
+	{
+		fprintf(stderr, "Can't open %s\n", outPath);
+		return 1;
+	}
+
+	fprintf(out, "{\n  \"context\": {\"compiler\": \"%s\", \"repetitions\": %u, \"utilsVectorIsStl\": %s, \"utilsDequeIsStl\": %s},\n",
+			Benchmarks::Compiler(), Benchmarks::repetitions, USE_STL_VECTOR ? "true" : "false", USE_STL_DEQUE ? "true" : "false");
+	fprintf(out, "  \"benchmarks\": [");
+
+	bool isFirst{ true };
+	for (const Benchmarks::BenchmarkInfo& info : Benchmarks::benchmarks)
+	{
+		if (filter && !strstr(info.name, filter)) continue;
+
+		const Benchmarks::BenchmarkResult result{ Benchmarks::Run(info) };
+		fprintf(out, "%s\n    {\"name\": \"%s\", \"iterations\": %u, \"nsPerIteration\": {\"min\": %.3f, \"median\": %.3f, \"max\": %.3f}, \"checksum\": %llu}",
+				isFirst ? "" : ",", info.name, info.iterations, result.minNs, result.medianNs, result.maxNs,
+				(unsigned long long)result.checksum);
+		isFirst = false;
+		if (outPath) fprintf(stderr, "%-48s %10.3f ns\n", info.name, result.medianNs);
+	}
+
+	fprintf(out, "\n  ]\n}\n");
+	if (outPath) fclose(out);
+	return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "../Common/CommonHeaders.h"
+
+// Minimal microbenchmark harness. Every benchmark runs a fixed number of iterations,
+// so results from different machines and builds measure the same work and can be
+// compared directly. Results are written as JSON.
+namespace Havana::Benchmarks
+{
+	// Performs "iterations" operations and returns a value that depends on all of
+	// them, which keeps the compiler from optimizing the work away.
+	using benchmark_function = u64(*)(u32 iterations);
+
+	void Add(const char* name, benchmark_function function, u32 iterations);
+
+	// Defined by the benchmark translation units
+	void AddCoreBenchmarks();
+	void AddMathBenchmarks();
+	void AddAllocatorBenchmarks();
+	void AddSpatialBenchmarks();
+
+	// Force a value to be computed, without the cost of a volatile store
+	template<typename T>
+	inline void DoNotOptimize(const T& value)
+	{
+#if defined (__GNUC__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static volatile const T* sink;
+		sink = &value;
+#endif
+	}
+
+	// Deterministic pseudo random numbers, the same sequence on every run
+	class Random
+	{
+	public:
+		constexpr explicit Random(u64 seed = 0x9e3779b97f4a7c15ull) : m_state{ seed } {}
+
+		constexpr u32 Next()
+		{
+			// xorshift64*
+			m_state ^= m_state >> 12;
+			m_state ^= m_state << 25;
+			m_state ^= m_state >> 27;
+			return (u32)((m_state * 0x2545f4914f6cdd1dull) >> 32);
+		}
+
+		constexpr f32 NextUnit() { return (f32)(Next() >> 8) / (f32)(1u << 24); }
+
+	private:
+		u64 m_state;
+	};
+}
@@ -0,0 +1,245 @@
+#include "Benchmark.h"
+#include "../Utilities/ObjectPool.h"
+#include <deque>
+#include <vector>
+
+namespace Havana::Benchmarks
+{
+	namespace
+	{
+		constexpr u32 idCount{ 4096 };
+		constexpr u32 containerSize{ 1024 };
+
+		//// ID ////
+
+		// Ids with random indices and generations, like the ones handed out after a lot of churn
+		struct IdTable
+		{
+			Id::id_type ids[idCount];
+
+			IdTable()
+			{
+				Random random{};
+				for (Id::id_type& id : ids)
+				{
+					const Id::id_type index{ random.Next() % (Id::Detail::INDEX_MASK - 1) };
+					const Id::id_type generation{ random.Next() % (Id::Detail::GENERATION_MASK - 1) };
+					id = index | (generation << Id::Detail::INDEX_BITS);
+				}
+			}
+		};
+
+		const IdTable idTable{};
+
+		u64 IdIndexAndGeneration(u32 iterations)
+		{
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				const Id::id_type id{ idTable.ids[i % idCount] };
+				sum += Id::Index(id) + Id::Generation(id);
+			}
+			return sum;
+		}
+
+		u64 IdNewGeneration(u32 iterations)
+		{
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				const Id::id_type id{ idTable.ids[i % idCount] };
+				sum += Id::NewGeneration(id);
+			}
+			return sum;
+		}
+
+		u64 IdIsValid(u32 iterations)
+		{
+			u64 count{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				const Id::id_type id{ (i & 7) ? idTable.ids[i % idCount] : Id::INVALID_ID };
+				count += Id::IsValid(id);
+			}
+			return count;
+		}
+
+		//// SLOT TRACKING ////
+
+		// The vector and free slot list the window, surface and batch tables used before
+		// ObjectPool. D3D12Core.cpp still tracks render targets this way.
+		struct SlotInfo
+		{
+			u64 handle{ 0 };
+			u32 width{ 0 };
+			u32 height{ 0 };
+		};
+
+		struct SlotTable
+		{
+			Utils::vector<SlotInfo>	slots;
+			Utils::vector<u32>		availableSlots;
+
+			u32 Add(const SlotInfo& info)
+			{
+				u32 id{ U32_INVALID_ID };
+				if (availableSlots.empty())
+				{
+					id = (u32)slots.size();
+					slots.emplace_back(info);
+				}
+				else
+				{
+					id = availableSlots.back();
+					availableSlots.pop_back();
+					slots[id] = info;
+				}
+				return id;
+			}
+
+			void Remove(u32 id)
+			{
+				assert(id < slots.size());
+				slots[id] = {};
+				availableSlots.emplace_back(id);
+			}
+		};
+
+		// An add and a remove per iteration, with up to 256 live slots
+		u64 SlotAddRemove(u32 iterations)
+		{
+			constexpr u32 liveCount{ 256 };
+			SlotTable table{};
+			u32 live[liveCount]{};
+			for (u32 i{ 0 }; i < liveCount; i++) live[i] = table.Add({ i, 0, 0 });
+
+			Random random{};
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				u32& slot{ live[random.Next() % liveCount] };
+				table.Remove(slot);
+				slot = table.Add({ i, i, i });
+				sum += slot;
+			}
+			return sum;
+		}
+
+		// The same with the object pool that replaced the vector and free slot list
+		u64 ObjectPoolAddRemove(u32 iterations)
+		{
+			constexpr u32 liveCount{ 256 };
+			Utils::ObjectPool<SlotInfo> pool{ liveCount };
+			Id::id_type live[liveCount]{};
+			for (u32 i{ 0 }; i < liveCount; i++) live[i] = pool.Add(SlotInfo{ i, 0, 0 });
+
+			Random random{};
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				Id::id_type& id{ live[random.Next() % liveCount] };
+				pool.Remove(id);
+				id = pool.Add(SlotInfo{ i, i, i });
+				sum += Id::Index(id);
+			}
+			return sum;
+		}
+
+		//// CONTAINERS ////
+
+		template<typename V>
+		u64 VectorPushBack(u32 iterations)
+		{
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i += containerSize)
+			{
+				V v;
+				for (u32 j{ 0 }; j < containerSize; j++) v.push_back(j);
+				sum += v.size() + v.back();
+			}
+			return sum;
+		}
+
+		template<typename V>
+		u64 VectorIterate(u32 iterations)
+		{
+			V v;
+			for (u32 j{ 0 }; j < containerSize; j++) v.push_back(j);
+
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i += containerSize)
+			{
+				for (const u32 value : v) sum += value;
+				DoNotOptimize(sum);
+			}
+			return sum;
+		}
+
+		u64 UtilsEraseUnordered(u32 iterations)
+		{
+			Utils::vector<u32> v;
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i += containerSize)
+			{
+				v.clear();
+				for (u32 j{ 0 }; j < containerSize; j++) v.push_back(j);
+				Random random{ i + 1 };
+				while (!v.empty()) Utils::EraseUnordered(v, random.Next() % v.size());
+				sum += v.size();
+			}
+			return sum + iterations;
+		}
+
+		u64 StdEraseOrdered(u32 iterations)
+		{
+			std::vector<u32> v;
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i += containerSize)
+			{
+				v.clear();
+				for (u32 j{ 0 }; j < containerSize; j++) v.push_back(j);
+				Random random{ i + 1 };
+				while (!v.empty()) v.erase(v.begin() + random.Next() % v.size());
+				sum += v.size();
+			}
+			return sum + iterations;
+		}
+
+		// Queue use: push at the back, pop at the front, with 64 elements in flight
+		template<typename D>
+		u64 DequeQueue(u32 iterations)
+		{
+			D d;
+			for (u32 j{ 0 }; j < 64; j++) d.push_back(j);
+
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				sum += d.front();
+				d.pop_front();
+				d.push_back(i);
+			}
+			return sum;
+		}
+	} // anonymous namespace
+
+	void AddCoreBenchmarks()
+	{
+		Add("id/index_and_generation", IdIndexAndGeneration, 1 << 24);
+		Add("id/new_generation", IdNewGeneration, 1 << 24);
+		Add("id/is_valid", IdIsValid, 1 << 24);
+
+		Add("slots/add_remove", SlotAddRemove, 1 << 22);
+		Add("slots/add_remove/object_pool", ObjectPoolAddRemove, 1 << 22);
+
+		Add("vector/push_back/utils", VectorPushBack<Utils::vector<u32>>, 1 << 22);
+		Add("vector/push_back/std", VectorPushBack<std::vector<u32>>, 1 << 22);
+		Add("vector/iterate/utils", VectorIterate<Utils::vector<u32>>, 1 << 24);
+		Add("vector/iterate/std", VectorIterate<std::vector<u32>>, 1 << 24);
+		Add("vector/erase/utils_unordered", UtilsEraseUnordered, 1 << 20);
+		Add("vector/erase/std_ordered", StdEraseOrdered, 1 << 20);
+
+		Add("deque/queue/utils", DequeQueue<Utils::deque<u32>>, 1 << 22);
+		Add("deque/queue/std", DequeQueue<std::deque<u32>>, 1 << 22);
+	}
+}
@@ -0,0 +1,155 @@
+#include "Benchmark.h"
+#include <cmath>
+
+namespace Havana::Benchmarks
+{
+	namespace
+	{
+		constexpr u32 valueCount{ 4096 };
+		constexpr u32 matrixCount{ 256 };
+
+		struct UnitValues
+		{
+			f32 values[valueCount];
+
+			UnitValues()
+			{
+				Random random{};
+				for (f32& value : values) value = random.NextUnit();
+			}
+		};
+
+		const UnitValues unitValues{};
+
+		//// PACKING ////
+
+		template<u32 bits>
+		u64 PackUnitFloat(u32 iterations)
+		{
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+				sum += Math::PackFloat<bits>(unitValues.values[i % valueCount]);
+			return sum;
+		}
+
+		template<u32 bits>
+		u64 PackRangeFloat(u32 iterations)
+		{
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+				sum += Math::PackFloat<bits>(unitValues.values[i % valueCount] * 200.0f - 100.0f, -100.0f, 100.0f);
+			return sum;
+		}
+
+		template<u32 bits>
+		u64 UnpackUnitFloat(u32 iterations)
+		{
+			constexpr u32 mask{ (u32)((1ull << bits) - 1) };
+			f32 sum{ 0.0f };
+			for (u32 i{ 0 }; i < iterations; i++)
+				sum += Math::UnpackToUnitFloat<bits>((i * 2654435761u) & mask);
+			return (u64)sum;
+		}
+
+		//// TRANSFORMS ////
+
+		// Column-major 4x4 matrices, the layout the renderer uploads
+		struct Transforms
+		{
+			f32 matrices[matrixCount][16];
+			f32 points[valueCount][4];
+
+			Transforms()
+			{
+				Random random{};
+				for (auto& m : matrices)
+				{
+					// Rotation about z, uniform scale and translation
+					const f32 angle{ random.NextUnit() * Math::twoPi };
+					const f32 scale{ 0.5f + random.NextUnit() };
+					const f32 c{ std::cos(angle) * scale }, s{ std::sin(angle) * scale };
+					const f32 values[16]{ c, s, 0, 0,  -s, c, 0, 0,  0, 0, scale, 0,
+										  random.NextUnit() * 100.0f, random.NextUnit() * 100.0f, random.NextUnit() * 100.0f, 1 };
+					for (u32 i{ 0 }; i < 16; i++) m[i] = values[i];
+				}
+				for (auto& p : points)
+				{
+					p[0] = random.NextUnit() * 10.0f;
+					p[1] = random.NextUnit() * 10.0f;
+					p[2] = random.NextUnit() * 10.0f;
+					p[3] = 1.0f;
+				}
+			}
+		};
+
+		const Transforms transforms{};
+
+		void Multiply(const f32* const a, const f32* const b, f32* const result)
+		{
+			for (u32 c{ 0 }; c < 4; c++)
+				for (u32 r{ 0 }; r < 4; r++)
+					result[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+		}
+
+		u64 TransformPoint(u32 iterations)
+		{
+			f32 sum{ 0.0f };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				const f32* const m{ transforms.matrices[i % matrixCount] };
+				const f32* const p{ transforms.points[i % valueCount] };
+				for (u32 r{ 0 }; r < 4; r++)
+					sum += m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r] * p[3];
+			}
+			return (u64)sum;
+		}
+
+		u64 MultiplyMatrices(u32 iterations)
+		{
+			f32 result[16]{};
+			f32 sum{ 0.0f };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				Multiply(transforms.matrices[i % matrixCount], transforms.matrices[(i * 7 + 3) % matrixCount], result);
+				sum += result[12] + result[0];
+			}
+			return (u64)sum;
+		}
+
+		// World space bounding sphere of a mesh instance, as computed for static batches
+		u64 TransformBoundingSphere(u32 iterations)
+		{
+			f32 sum{ 0.0f };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				const f32* const world{ transforms.matrices[i % matrixCount] };
+				const f32* const c{ transforms.points[i % valueCount] };
+				f32 center[3]{};
+				f32 maxScale{ 0.0f };
+				for (u32 j{ 0 }; j < 3; j++)
+				{
+					center[j] = world[j] * c[0] + world[4 + j] * c[1] + world[8 + j] * c[2] + world[12 + j];
+					const f32* const axis{ &world[j * 4] };
+					const f32 scale{ axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] };
+					maxScale = scale > maxScale ? scale : maxScale;
+				}
+				sum += center[0] + center[1] + center[2] + std::sqrt(maxScale);
+			}
+			return (u64)sum;
+		}
+	} // anonymous namespace
+
+	void AddMathBenchmarks()
+	{
+		Add("math/pack_float/8", PackUnitFloat<8>, 1 << 24);
+		Add("math/pack_float/16", PackUnitFloat<16>, 1 << 24);
+		Add("math/pack_float/32", PackUnitFloat<32>, 1 << 24);
+		Add("math/pack_float_range/16", PackRangeFloat<16>, 1 << 24);
+		Add("math/unpack_float/8", UnpackUnitFloat<8>, 1 << 24);
+		Add("math/unpack_float/16", UnpackUnitFloat<16>, 1 << 24);
+
+		Add("math/transform_point", TransformPoint, 1 << 24);
+		Add("math/multiply_matrices", MultiplyMatrices, 1 << 22);
+		Add("math/transform_bounding_sphere", TransformBoundingSphere, 1 << 23);
+	}
+}
@@ -0,0 +1,566 @@
+#include "../../Graphics/Renderer.h"
+#include "../../Common/AllocationGuard.h"
+#include "../../Graphics/OpenGL/OpenGLShaders.h"
+#include "../../Graphics/OpenGL/OpenGLStateCache.h"
+#include "../../Graphics/OpenGL/OpenGLTextures.h"
+#include "../../Platforms/PlatformTypes.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+// End-to-end benchmark of the OpenGL backend. Every scenario renders a fixed number
+// of frames through the public renderer interface (command lists, then RenderFrame()
+// on a small window) and reports frames per second and the render thread's CPU time
+// per frame. Results can be checked against a baseline file so renderer changes can
+// be gated on a build machine without a GPU. The numbers only mean something on the
+// machine that measured them, so no baseline is checked in: record one there first,
+// then check against it:
+//
+//   xvfb-run -a env LIBGL_ALWAYS_SOFTWARE=1 ./renderbench.a --update-baseline renderbench.txt
+//   xvfb-run -a env LIBGL_ALWAYS_SOFTWARE=1 ./renderbench.a --baseline renderbench.txt
+//
+// Scenarios missing from the baseline, or with zero values, fail the check (exit code 3).
+//
+// Every frame ends with glFinish(), so frames don't queue up and the numbers measure
+// complete frames.
+//
+// With --zero-alloc the steady-state scenarios also check that their measured frames
+// make no heap allocations, which needs a build with the allocation guard:
+//
+//   make zeroalloc && xvfb-run -a ./zeroalloc.a --zero-alloc
+
+using namespace Havana;
+using namespace Havana::Graphics;
+
+namespace
+{
+	constexpr u32 warmupFrames{ 30 };
+	constexpr u32 measuredFrames{ 300 };
+	constexpr u32 targetSize{ 512 };
+	constexpr u32 windowSize{ 64 };
+	constexpr u32 maxSurfaces{ 8 };
+	constexpr u32 maxScenarios{ 32 };
+	constexpr f32 defaultTolerance{ 0.15f };
+
+	// Small triangles on a grid. gl_VertexID includes the draw's first vertex, so every
+	// draw of 3 vertices lands in its own cell.
+	constexpr const char* vertexSource{ R"(#version 430
+void main()
+{
+	int cell = (gl_VertexID / 3) % 4096;
+	vec2 origin = vec2(cell % 64, cell / 64) / 32.0 - 1.0;
+	vec2 corner = vec2(gl_VertexID % 3 == 1, gl_VertexID % 3 == 2) / 32.0;
+	gl_Position = vec4(origin + corner, 0.0, 1.0);
+}
+)" };
+
+	constexpr const char* fragmentSourceA{ R"(#version 430
+layout(binding = 0) uniform sampler2D image;
+out vec4 color;
+void main() { color = vec4(0.9, 0.4, 0.1, 0.5) + texture(image, gl_FragCoord.xy / 512.0) * 0.1; }
+)" };
+
+	constexpr const char* fragmentSourceB{ R"(#version 430
+layout(binding = 0) uniform sampler2D image;
+out vec4 color;
+void main() { color = vec4(0.1, 0.4, 0.9, 0.5) + texture(image, gl_FragCoord.xy / 512.0) * 0.1; }
+)" };
+
+	struct Resources
+	{
+		GLuint		programs[2]{};
+		GLuint		vertexArray{ 0 };
+		u32			renderTargets[2]{};
+		Surface		surfaces[maxSurfaces]{};
+		Platform::Window windows[maxSurfaces]{};
+		u32			surfaceCount{ 0 };
+	} resources;
+
+	struct Scenario
+	{
+		const char*	name;
+		u32			count;
+		bool		isSteadyState;	// frames shouldn't allocate once warmed up
+		void		(*setup)(u32 count);
+		void		(*frame)(u32 count);
+		void		(*teardown)();
+	};
+
+	struct Result
+	{
+		f64 framesPerSecond{ 0.0 };
+		f64 cpuMsPerFrame{ 0.0 };
+		Memory::AllocationGuardStats allocations{};
+		bool isAllocationChecked{ false };
+	};
+
+	struct BaselineEntry
+	{
+		char	name[64]{};
+		f64		framesPerSecond{ 0.0 };
+		f64		cpuMsPerFrame{ 0.0 };
+		f32		tolerance{ defaultTolerance };
+	};
+
+	//// FRAME HELPERS ////
+
+	// Hands out command lists in submission order and moves on to the next one before a list fills up
+	class Recorder
+	{
+	public:
+		template<typename T>
+		void Record(const T& command)
+		{
+			constexpr u32 reserve{ 256 };
+			if (!m_list || m_list->Size() + reserve > m_list->Capacity())
+			{
+				m_list = AcquireCommandList(m_sortKey++);
+				assert(m_list);
+			}
+			m_list->Record(command);
+		}
+
+	private:
+		CommandList*	m_list{ nullptr };
+		u32				m_sortKey{ 0 };
+	};
+
+	void BeginTarget(Recorder& recorder)
+	{
+		SetRenderTargetsCommand targets{};
+		for (u32 i{ 0 }; i < maxRenderTargets; i++) targets.colors[i] = U32_INVALID_ID;
+		targets.colors[0] = resources.renderTargets[0];
+		targets.depthStencil = U32_INVALID_ID;
+		recorder.Record(targets);
+		recorder.Record(SetViewportCommand{ 0, 0, targetSize, targetSize });
+		recorder.Record(SetRenderStateCommand{ 0 });
+
+		ClearCommand clear{};
+		clear.flags = ClearFlags::Color;
+		recorder.Record(clear);
+		recorder.Record(BindVertexArrayCommand{ resources.vertexArray });
+		recorder.Record(BindTextureCommand{ resources.renderTargets[1], 0 });
+	}
+
+	void EndFrame()
+	{
+		SubmitCommandLists();
+		RenderFrame(&resources.surfaces[0], resources.surfaceCount);
+	}
+
+	//// SCENARIOS ////
+
+	void NoSetup(u32) {}
+	void NoTeardown() {}
+
+	void DrawsFrame(u32 count)
+	{
+		Recorder recorder{};
+		BeginTarget(recorder);
+		recorder.Record(BindProgramCommand{ resources.programs[0] });
+		for (u32 i{ 0 }; i < count; i++)
+			recorder.Record(DrawCommand{ 3, 1, i * 3, 0, PrimitiveTopology::Triangles });
+		EndFrame();
+	}
+
+	// Every draw switches program, blending and texture
+	void StateChangesFrame(u32 count)
+	{
+		Recorder recorder{};
+		BeginTarget(recorder);
+		for (u32 i{ 0 }; i < count; i++)
+		{
+			const u32 odd{ i & 1 };
+			recorder.Record(BindProgramCommand{ resources.programs[odd] });
+			recorder.Record(SetRenderStateCommand{ odd ? (u32)RenderStateFlags::Blend : 0u });
+			recorder.Record(BindTextureCommand{ odd ? resources.renderTargets[1] : 0u, 0 });
+			recorder.Record(DrawCommand{ 3, 1, i * 3, 0, PrimitiveTopology::Triangles });
+		}
+		EndFrame();
+	}
+
+	// Extra windows on top of the one every scenario presents to
+	void SurfacesSetup(u32 count)
+	{
+		assert(count <= maxSurfaces);
+		for (u32 i{ 1 }; i < count; i++)
+		{
+			Platform::WindowInitInfo info{};
+			info.width = windowSize;
+			info.height = windowSize;
+			resources.windows[i] = Platform::MakeWindow(&info);
+			resources.surfaces[i] = CreateSurface(resources.windows[i]);
+			resources.surfaces[i].SetPresentMode(PresentMode::Immediate);
+		}
+		resources.surfaceCount = count;
+	}
+
+	void SurfacesFrame(u32)
+	{
+		EndFrame();
+	}
+
+	void SurfacesTeardown()
+	{
+		for (u32 i{ 1 }; i < resources.surfaceCount; i++)
+		{
+			RemoveSurface(resources.surfaces[i].GetID());
+			Platform::RemoveWindow(resources.windows[i].GetID());
+			resources.surfaces[i] = {};
+			resources.windows[i] = {};
+		}
+		resources.surfaceCount = 1;
+	}
+
+	//// UPLOADS ////
+
+	// A full mip chain is streamed in for a new texture every frame. Uploads are limited
+	// by the streaming budget per frame, so large textures take more than one frame and
+	// the next texture starts with whatever wasn't finished.
+	Utils::vector<u8>						uploadPixels;
+	OpenGL::Textures::texture_id			uploadTexture{ Id::INVALID_ID };
+
+	bool LoadMip(void*, u32, void* destination, u32 size)
+	{
+		memcpy(destination, uploadPixels.data(), std::min((size_t)size, uploadPixels.size()));
+		return true;
+	}
+
+	constexpr u32 MipCount(u32 size)
+	{
+		u32 count{ 1 };
+		while (size > 1) { size >>= 1; count++; }
+		return count;
+	}
+
+	void UploadsSetup(u32 size)
+	{
+		uploadPixels.assign((size_t)size * size * 4, 0x7f);
+	}
+
+	void UploadsFrame(u32 size)
+	{
+		using namespace OpenGL::Textures;
+		if (Id::IsValid(uploadTexture)) RemoveTexture(uploadTexture);
+
+		StreamingTextureDesc desc{};
+		desc.width = size;
+		desc.height = size;
+		desc.mipCount = MipCount(size);
+		desc.loader = LoadMip;
+		uploadTexture = CreateTexture(desc);
+		RequestScreenSize(uploadTexture, (f32)size);
+		EndFrame();
+	}
+
+	void UploadsTeardown()
+	{
+		if (Id::IsValid(uploadTexture)) OpenGL::Textures::RemoveTexture(uploadTexture);
+		uploadTexture = OpenGL::Textures::texture_id{ Id::INVALID_ID };
+		uploadPixels = {};
+	}
+
+	const Scenario scenarios[]{
+		{ "draws/100", 100, true, NoSetup, DrawsFrame, NoTeardown },
+		{ "draws/1000", 1000, true, NoSetup, DrawsFrame, NoTeardown },
+		{ "draws/10000", 10000, true, NoSetup, DrawsFrame, NoTeardown },
+		{ "state_changes/100", 100, true, NoSetup, StateChangesFrame, NoTeardown },
+		{ "state_changes/1000", 1000, true, NoSetup, StateChangesFrame, NoTeardown },
+		{ "state_changes/10000", 10000, true, NoSetup, StateChangesFrame, NoTeardown },
+		{ "surfaces/1", 1, true, SurfacesSetup, SurfacesFrame, SurfacesTeardown },
+		{ "surfaces/2", 2, true, SurfacesSetup, SurfacesFrame, SurfacesTeardown },
+		{ "surfaces/4", 4, true, SurfacesSetup, SurfacesFrame, SurfacesTeardown },
+		{ "uploads/256", 256, false, UploadsSetup, UploadsFrame, UploadsTeardown },
+		{ "uploads/1024", 1024, false, UploadsSetup, UploadsFrame, UploadsTeardown },
+		{ "uploads/2048", 2048, false, UploadsSetup, UploadsFrame, UploadsTeardown },
+	};
+
+	//// RUNNING ////
+
+	// CPU time is taken from the renderer's own frame statistics (time spent in
+	// SubmitCommandLists() and RenderFrame()), frames per second from wall time.
+	// The first measured frame starts before the guard is on, so it isn't checked.
+	Result Run(const Scenario& scenario, bool checkAllocations)
+	{
+		using clock = std::chrono::steady_clock;
+
+		scenario.setup(scenario.count);
+		for (u32 i{ 0 }; i < warmupFrames; i++)
+		{
+			scenario.frame(scenario.count);
+			glFinish();
+		}
+
+		Result result{};
+		result.isAllocationChecked = checkAllocations && scenario.isSteadyState;
+		if (result.isAllocationChecked)
+		{
+			Memory::ResetAllocationGuardStats();
+			Memory::SetAllocationGuard(Memory::AllocationGuardMode::Report, 0);
+		}
+
+		f64 cpuMs{ 0.0 };
+		const clock::time_point begin{ clock::now() };
+		for (u32 i{ 0 }; i < measuredFrames; i++)
+		{
+			scenario.frame(scenario.count);
+			cpuMs += GetFrameStats().last.cpuMs;
+			glFinish();
+		}
+		const f64 seconds{ std::chrono::duration<f64>(clock::now() - begin).count() };
+		if (result.isAllocationChecked)
+		{
+			Memory::SetAllocationGuard(Memory::AllocationGuardMode::Off);
+			result.allocations = Memory::GetAllocationGuardStats();
+		}
+		scenario.teardown();
+
+		result.framesPerSecond = measuredFrames / seconds;
+		result.cpuMsPerFrame = cpuMs / measuredFrames;
+		return result;
+	}
+
+	bool CreateResources()
+	{
+		RenderTargetDesc desc{};
+		desc.width = targetSize;
+		desc.height = targetSize;
+		for (u32& target : resources.renderTargets)
+		{
+			target = CreateRenderTarget(desc);
+			if (!target) return false;
+		}
+
+		const OpenGL::Shaders::ShaderSource stagesA[]{ { GL_VERTEX_SHADER, vertexSource }, { GL_FRAGMENT_SHADER, fragmentSourceA } };
+		const OpenGL::Shaders::ShaderSource stagesB[]{ { GL_VERTEX_SHADER, vertexSource }, { GL_FRAGMENT_SHADER, fragmentSourceB } };
+		resources.programs[0] = OpenGL::Shaders::CreateProgram(&stagesA[0], (u32)std::size(stagesA));
+		resources.programs[1] = OpenGL::Shaders::CreateProgram(&stagesB[0], (u32)std::size(stagesB));
+
+		// Vertices are generated from gl_VertexID, the vertex array only has to exist
+		glGenVertexArrays(1, &resources.vertexArray);
+		return resources.programs[0] && resources.programs[1] && resources.vertexArray;
+	}
+
+	void RemoveResources()
+	{
+		if (resources.vertexArray)
+		{
+			glDeleteVertexArrays(1, &resources.vertexArray);
+			OpenGL::State::OnVertexArrayDeleted(resources.vertexArray);
+		}
+		for (const GLuint program : resources.programs)
+			if (program) OpenGL::Shaders::RemoveProgram(program);
+		for (const u32 target : resources.renderTargets)
+			if (target) RemoveRenderTarget(target);
+		resources = {};
+	}
+
+	//// BASELINE ////
+
+	// One scenario per line: <name> <frames/s> <cpu ms/frame> <tolerance>. Lines starting
+	// with # are comments. A value of 0 means it hasn't been recorded.
+	u32 ReadBaseline(const char* path, BaselineEntry* const entries, u32 maxCount)
+	{
+		FILE* const file{ fopen(path, "r") };
+		if (!file) return U32_INVALID_ID;
+
+		u32 count{ 0 };
+		char line[256];
+		while (count < maxCount && fgets(line, sizeof(line), file))
+		{
+			if (line[0] == '#') continue;
+			BaselineEntry& entry{ entries[count] };
+			if (sscanf(line, "%63s %lf %lf %f", entry.name, &entry.framesPerSecond, &entry.cpuMsPerFrame, &entry.tolerance) >= 3)
+				count++;
+			else entry = {};
+		}
+
+		fclose(file);
+		return count;
+	}
+
+	bool WriteBaseline(const char* path, const BaselineEntry* const entries, u32 count)
+	{
+		FILE* const file{ fopen(path, "w") };
+		if (!file) return false;
+
+		fprintf(file, "# Render benchmark baseline: <scenario> <frames/s> <cpu ms/frame> <tolerance>\n");
+		fprintf(file, "# Regenerate on the build machine with: renderbench.a --update-baseline <this file>\n");
+		fprintf(file, "# A value of 0 hasn't been recorded and fails the check.\n");
+		for (u32 i{ 0 }; i < count; i++)
+			fprintf(file, "%-24s %10.2f %10.4f %5.2f\n", entries[i].name, entries[i].framesPerSecond, entries[i].cpuMsPerFrame, entries[i].tolerance);
+
+		fclose(file);
+		return true;
+	}
+
+	BaselineEntry* FindBaseline(BaselineEntry* const entries, u32 count, const char* name)
+	{
+		for (u32 i{ 0 }; i < count; i++)
+			if (!strcmp(entries[i].name, name)) return &entries[i];
+		return nullptr;
+	}
+
+	// A scenario without an entry, or with values that were never measured, can't be
+	// checked. That's reported as an error rather than passing without a comparison.
+	bool IsRecorded(const BaselineEntry* const baseline)
+	{
+		return baseline && baseline->framesPerSecond > 0.0 && baseline->cpuMsPerFrame > 0.0;
+	}
+
+	// Lower frame rates and higher CPU times than the baseline allows are regressions.
+	// Improvements never fail, but a large one is a hint to update the baseline.
+	bool IsRegression(const BaselineEntry& baseline, const Result& result)
+	{
+		assert(IsRecorded(&baseline));
+		const f64 tolerance{ baseline.tolerance };
+		return result.framesPerSecond < baseline.framesPerSecond * (1.0 - tolerance) ||
+			   result.cpuMsPerFrame > baseline.cpuMsPerFrame * (1.0 + tolerance);
+	}
+} // anonymous namespace
+
+// Usage: renderbench.a [--filter <substring>] [--baseline <file> | --update-baseline <file>] [--zero-alloc]
+// Returns 1 when a scenario regressed against the baseline or allocated in steady state, 2
+// when the renderer couldn't be set up, and 3 when a checked scenario has no recorded baseline.
+int main(int argc, char** argv)
+{
+	const char* filter{ nullptr };
+	const char* baselinePath{ nullptr };
+	bool updateBaseline{ false };
+	bool checkAllocations{ false };
+	for (int i{ 1 }; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+		else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) baselinePath = argv[++i];
+		else if (!strcmp(argv[i], "--update-baseline") && i + 1 < argc)
+		{
+			baselinePath = argv[++i];
+			updateBaseline = true;
+		}
+		else if (!strcmp(argv[i], "--zero-alloc")) checkAllocations = true;
+		else
+		{
+			fprintf(stderr, "usage: %s [--filter <substring>] [--baseline <file> | --update-baseline <file>] [--zero-alloc]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (checkAllocations && !Memory::IsAllocationGuardSupported())
+	{
+		fprintf(stderr, "--zero-alloc needs a build with the allocation guard (make zeroalloc)\n");
+		return 2;
+	}
+
+	BaselineEntry baseline[maxScenarios]{};
+	u32 baselineCount{ 0 };
+	if (baselinePath)
+	{
+		baselineCount = ReadBaseline(baselinePath, &baseline[0], maxScenarios);
+		if (baselineCount == U32_INVALID_ID)
+		{
+			if (!updateBaseline)
+			{
+				fprintf(stderr, "Can't read baseline %s\n", baselinePath);
+				return 2;
+			}
+			baselineCount = 0;
+		}
+	}
+
+	Platform::WindowInitInfo info{};
+	info.width = windowSize;
+	info.height = windowSize;
+	resources.windows[0] = Platform::MakeWindow(&info);
+	if (!Graphics::Initialize(GraphicsPlatform::OpenGL))
+	{
+		fprintf(stderr, "Can't initialize the OpenGL renderer (is DISPLAY set?)\n");
+		return 2;
+	}
+
+	resources.surfaces[0] = CreateSurface(resources.windows[0]);
+	resources.surfaces[0].SetPresentMode(PresentMode::Immediate);
+	resources.surfaceCount = 1;
+	if (!CreateResources())
+	{
+		fprintf(stderr, "Can't create the benchmark resources\n");
+		RemoveResources();
+		Graphics::Shutdown();
+		return 2;
+	}
+
+	printf("{\n  \"context\": {\"vendor\": \"%s\", \"renderer\": \"%s\", \"warmupFrames\": %u, \"measuredFrames\": %u},\n",
+		   (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), warmupFrames, measuredFrames);
+	printf("  \"scenarios\": [");
+
+	u32 regressionCount{ 0 };
+	u32 unrecordedCount{ 0 };
+	bool isFirst{ true };
+	for (const Scenario& scenario : scenarios)
+	{
+		if (filter && !strstr(scenario.name, filter)) continue;
+
+		const Result result{ Run(scenario, checkAllocations) };
+		BaselineEntry* const entry{ FindBaseline(&baseline[0], baselineCount, scenario.name) };
+		const bool isChecked{ baselinePath && !updateBaseline };
+		const bool isRecorded{ IsRecorded(entry) };
+		const bool isRegression{ isChecked && isRecorded && IsRegression(*entry, result) };
+		const bool hasAllocations{ result.isAllocationChecked && result.allocations.allocations };
+		regressionCount += isRegression || hasAllocations;
+		unrecordedCount += isChecked && !isRecorded;
+
+		printf("%s\n    {\"name\": \"%s\", \"framesPerSecond\": %.2f, \"cpuMsPerFrame\": %.4f",
+			   isFirst ? "" : ",", scenario.name, result.framesPerSecond, result.cpuMsPerFrame);
+		if (isChecked && !isRecorded)
+			printf(", \"baseline\": null");
+		else if (isChecked)
+			printf(", \"baseline\": {\"framesPerSecond\": %.2f, \"cpuMsPerFrame\": %.4f, \"tolerance\": %.2f}, \"regression\": %s",
+				   entry->framesPerSecond, entry->cpuMsPerFrame, entry->tolerance, isRegression ? "true" : "false");
+		if (result.isAllocationChecked)
+			printf(", \"heapAllocations\": %llu, \"framesWithAllocations\": %u, \"checkedFrames\": %u",
+				   (unsigned long long)result.allocations.allocations, result.allocations.framesWithAllocations, result.allocations.guardedFrames);
+		printf("}");
+		isFirst = false;
+		fflush(stdout);
+
+		if (isRegression)
+			fprintf(stderr, "REGRESSION %s: %.2f frames/s, %.4f ms (baseline %.2f frames/s, %.4f ms, tolerance %.2f)\n",
+					scenario.name, result.framesPerSecond, result.cpuMsPerFrame, entry->framesPerSecond, entry->cpuMsPerFrame, entry->tolerance);
+		if (isChecked && !isRecorded)
+			fprintf(stderr, "NO BASELINE %s: not recorded in %s, run --update-baseline on the build machine\n",
+					scenario.name, baselinePath);
+		if (hasAllocations)
+			fprintf(stderr, "ALLOCATIONS %s: %llu heap allocations in %u of %u steady-state frames\n",
+					scenario.name, (unsigned long long)result.allocations.allocations, result.allocations.framesWithAllocations, result.allocations.guardedFrames);
+
+		if (updateBaseline)
+		{
+			BaselineEntry* target{ entry };
+			if (!target && baselineCount < maxScenarios)
+			{
+				target = &baseline[baselineCount++];
+				strncpy(target->name, scenario.name, sizeof(target->name) - 1);
+			}
+			if (target)
+			{
+				target->framesPerSecond = result.framesPerSecond;
+				target->cpuMsPerFrame = result.cpuMsPerFrame;
+			}
+		}
+	}
+	printf("\n  ]\n}\n");
+
+	RemoveResources();
+	RemoveSurface(resources.surfaces[0].GetID());
+	Graphics::Shutdown();
+	Platform::RemoveWindow(resources.windows[0].GetID());
+
+	if (updateBaseline && !WriteBaseline(baselinePath, &baseline[0], baselineCount))
+	{
+		fprintf(stderr, "Can't write baseline %s\n", baselinePath);
+		return 2;
+	}
+	if (regressionCount) return 1;
+	return unrecordedCount ? 3 : 0;
+}
@@ -0,0 +1,255 @@
+#include "Benchmark.h"
+#include "../Common/DynamicBvh.h"
+#include <cfloat>
+#include <cmath>
+
+namespace Havana::Benchmarks
+{
+	namespace
+	{
+		using Spatial::Aabb;
+
+		constexpr u32 objectCount{ 100'000 };
+		constexpr f32 worldSize{ 2000.0f };
+
+		// Small objects scattered through a cube around the origin
+		struct Scene
+		{
+			Aabb				bounds[objectCount];
+			Spatial::DynamicBvh	bvh{};
+
+			Scene()
+			{
+				Random random{};
+				for (u32 i{ 0 }; i < objectCount; i++) bounds[i] = RandomBox(random, 0.5f + random.NextUnit() * 3.5f);
+
+				bvh.Initialize();
+				for (u32 i{ 0 }; i < objectCount; i++)
+				{
+					const Spatial::proxy_id id{ bvh.Add(bounds[i], i) };
+					DoNotOptimize(id);
+				}
+				bvh.Rebuild();
+			}
+
+			static Aabb RandomBox(Random& random, f32 size)
+			{
+				Aabb box;
+				for (u32 axis{ 0 }; axis < 3; axis++)
+				{
+					box.min[axis] = (random.NextUnit() - 0.5f) * worldSize;
+					box.max[axis] = box.min[axis] + size;
+				}
+				return box;
+			}
+		};
+
+		Scene& GetScene()
+		{
+			static Scene* const scene{ new Scene{} };
+			return *scene;
+		}
+
+		// 60 degree frustum from a random point, looking down +z, 1000 units deep
+		void RandomFrustum(Random& random, f32* const planes)
+		{
+			const f32 x{ (random.NextUnit() - 0.5f) * worldSize };
+			const f32 y{ (random.NextUnit() - 0.5f) * worldSize };
+			const f32 z{ (random.NextUnit() - 0.5f) * worldSize };
+			const f32 s{ 0.5f }, c{ 0.8660254f };
+			const f32 frustum[6 * 4]{
+				c, 0.0f, s, -(c * x + s * z),
+				-c, 0.0f, s, c * x - s * z,
+				0.0f, c, s, -(c * y + s * z),
+				0.0f, -c, s, c * y - s * z,
+				0.0f, 0.0f, 1.0f, -(z + 0.1f),
+				0.0f, 0.0f, -1.0f, z + 1000.0f,
+			};
+			for (u32 i{ 0 }; i < 6 * 4; i++) planes[i] = frustum[i];
+		}
+
+		bool IsInFrustum(const Aabb& box, const f32* const planes)
+		{
+			for (u32 p{ 0 }; p < 6; p++)
+			{
+				const f32* const plane{ &planes[p * 4] };
+				f32 distance{ plane[3] };
+				for (u32 axis{ 0 }; axis < 3; axis++) distance += plane[axis] * (plane[axis] >= 0.0f ? box.max[axis] : box.min[axis]);
+				if (distance < 0.0f) return false;
+			}
+			return true;
+		}
+
+		bool Overlaps(const Aabb& a, const Aabb& b)
+		{
+			for (u32 axis{ 0 }; axis < 3; axis++)
+				if (a.min[axis] > b.max[axis] || a.max[axis] < b.min[axis]) return false;
+			return true;
+		}
+
+		struct Ray
+		{
+			f32 origin[3];
+			f32 direction[3];
+		};
+
+		Ray RandomRay(Random& random)
+		{
+			Ray ray;
+			f32 length{ 0.0f };
+			for (u32 axis{ 0 }; axis < 3; axis++)
+			{
+				ray.origin[axis] = (random.NextUnit() - 0.5f) * worldSize;
+				ray.direction[axis] = random.NextUnit() - 0.5f;
+				length += ray.direction[axis] * ray.direction[axis];
+			}
+			length = std::sqrt(length);
+			for (f32& d : ray.direction) d /= length;
+			return ray;
+		}
+
+		// Distance to the box, or FLT_MAX if the ray misses it
+		f32 RayDistance(const Ray& ray, const Aabb& box)
+		{
+			f32 enter{ 0.0f }, exit{ FLT_MAX };
+			for (u32 axis{ 0 }; axis < 3; axis++)
+			{
+				const f32 inverse{ 1.0f / ray.direction[axis] };
+				const f32 t0{ (box.min[axis] - ray.origin[axis]) * inverse };
+				const f32 t1{ (box.max[axis] - ray.origin[axis]) * inverse };
+				enter = std::max(enter, std::min(t0, t1));
+				exit = std::min(exit, std::max(t0, t1));
+			}
+			return enter <= exit ? enter : FLT_MAX;
+		}
+
+		//// QUERIES ////
+
+		// Culling: sum of visible object ids
+		template<bool useBvh>
+		u64 FrustumQuery(u32 iterations)
+		{
+			const Scene& scene{ GetScene() };
+			Random random{};
+			u64 sum{ 0 };
+			f32 planes[6 * 4];
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				RandomFrustum(random, &planes[0]);
+				if constexpr (useBvh)
+				{
+					scene.bvh.QueryFrustum(&planes[0], [&](u32 object) {
+						if (IsInFrustum(scene.bounds[object], &planes[0])) sum += object; });
+				}
+				else
+				{
+					for (u32 object{ 0 }; object < objectCount; object++)
+						if (IsInFrustum(scene.bounds[object], &planes[0])) sum += object;
+				}
+			}
+			return sum;
+		}
+
+		// Picking: the nearest object a ray hits
+		template<bool useBvh>
+		u64 RayQuery(u32 iterations)
+		{
+			const Scene& scene{ GetScene() };
+			Random random{};
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				const Ray ray{ RandomRay(random) };
+				f32 nearest{ FLT_MAX };
+				u32 hit{ U32_INVALID_ID };
+				if constexpr (useBvh)
+				{
+					scene.bvh.QueryRay(&ray.origin[0], &ray.direction[0], FLT_MAX, [&](u32 object, f32 maxDistance) {
+						const f32 distance{ RayDistance(ray, scene.bounds[object]) };
+						if (distance >= nearest) return maxDistance;
+						nearest = distance;
+						hit = object;
+						return distance;
+					});
+				}
+				else
+				{
+					for (u32 object{ 0 }; object < objectCount; object++)
+					{
+						const f32 distance{ RayDistance(ray, scene.bounds[object]) };
+						if (distance < nearest)
+						{
+							nearest = distance;
+							hit = object;
+						}
+					}
+				}
+				sum += hit;
+			}
+			return sum;
+		}
+
+		// Proximity: objects in a 50 unit box
+		template<bool useBvh>
+		u64 BoxQuery(u32 iterations)
+		{
+			const Scene& scene{ GetScene() };
+			Random random{};
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				const Aabb box{ Scene::RandomBox(random, 50.0f) };
+				if constexpr (useBvh)
+				{
+					scene.bvh.QueryBox(box, [&](u32 object) {
+						if (Overlaps(scene.bounds[object], box)) sum += object; });
+				}
+				else
+				{
+					for (u32 object{ 0 }; object < objectCount; object++)
+						if (Overlaps(scene.bounds[object], box)) sum += object;
+				}
+			}
+			return sum;
+		}
+
+		//// UPDATES ////
+
+		// Every object moves a little each frame, the tree is refitted and rebuilt as needed.
+		// The checksum doesn't depend on the tree, which changes from run to run.
+		u64 MoveObjects(u32 iterations)
+		{
+			Scene& scene{ GetScene() };
+			Random random{};
+			u64 sum{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				const u32 object{ i % objectCount };
+				const f32 displacement[3]{ random.NextUnit() - 0.5f, random.NextUnit() - 0.5f, random.NextUnit() - 0.5f };
+				Aabb& box{ scene.bounds[object] };
+				for (u32 axis{ 0 }; axis < 3; axis++)
+				{
+					box.min[axis] += displacement[axis];
+					box.max[axis] += displacement[axis];
+				}
+				// Ids and user data are the same, all objects were added in order
+				DoNotOptimize(scene.bvh.Move(Spatial::proxy_id{ object }, box, &displacement[0]));
+				if (object == objectCount - 1) scene.bvh.Update();
+				sum += object;
+			}
+			return sum;
+		}
+	} // anonymous namespace
+
+	void AddSpatialBenchmarks()
+	{
+		Add("spatial/frustum/brute_force", FrustumQuery<false>, 256);
+		Add("spatial/frustum/bvh", FrustumQuery<true>, 256);
+		Add("spatial/ray/brute_force", RayQuery<false>, 256);
+		Add("spatial/ray/bvh", RayQuery<true>, 256);
+		Add("spatial/box/brute_force", BoxQuery<false>, 256);
+		Add("spatial/box/bvh", BoxQuery<true>, 256);
+
+		Add("spatial/move/bvh", MoveObjects, 1 << 20);
+	}
+}
@@ -0,0 +1,262 @@
+#include "CommonHeaders.h"
+#include "AllocationGuard.h"
+
+#if defined (USE_ALLOCATION_GUARD) && (defined (__linux__) || (defined (_WIN64) && defined (_DEBUG)))
+#define ALLOCATION_GUARD_HOOKS 1
+#endif
+
+#ifdef ALLOCATION_GUARD_HOOKS
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined (__linux__)
+#include <cerrno>
+#include <execinfo.h>
+#include <unistd.h>
+#elif defined (_WIN64)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <crtdbg.h>
+#endif
+
+namespace Havana::Memory
+{
+	namespace
+	{
+		constexpr u32 maxRecorded{ 8 };	// backtraces kept per frame
+		constexpr u32 maxStackDepth{ 32 };
+
+		struct RecordedAllocation
+		{
+			std::atomic<bool>	isReady{ false };
+			u64					size{ 0 };
+			u32					depth{ 0 };
+			void*				stack[maxStackDepth]{};
+		};
+
+		// Everything here is constant-initialized: the hooks run before static constructors
+		std::atomic<u32>	guardMode{ (u32)AllocationGuardMode::Off };
+		std::atomic<bool>	isFrameGuarded{ false };
+		std::atomic<u64>	frameAllocations{ 0 };
+		std::atomic<u64>	frameBytes{ 0 };
+		std::atomic<u32>	recordedCount{ 0 };
+		RecordedAllocation	recorded[maxRecorded]{};
+
+		// Only used by the thread that calls EndFrame()
+		AllocationGuardStats	stats{};
+		u32						warmupFramesLeft{ 0 };
+
+		// Nesting of AllowAllocationsScope, also taken while an allocation is recorded
+		// because capturing a backtrace can allocate
+		thread_local u32	allowCount{ 0 };
+
+		u32 CaptureStack(void** const stack, u32 maxDepth)
+		{
+#if defined (__linux__)
+			const s32 depth{ backtrace(stack, (s32)maxDepth) };
+			return depth > 0 ? (u32)depth : 0;
+#elif defined (_WIN64)
+			return CaptureStackBackTrace(0, maxDepth, stack, nullptr);
+#endif
+		}
+
+		void PrintStack(void* const* stack, u32 depth)
+		{
+			fflush(stderr);
+#if defined (__linux__)
+			backtrace_symbols_fd(stack, (s32)depth, STDERR_FILENO);
+#elif defined (_WIN64)
+			for (u32 i{ 0 }; i < depth; i++) fprintf(stderr, "    %p\n", stack[i]);
+#endif
+		}
+
+		void OnAllocation(u64 size)
+		{
+			if (!isFrameGuarded.load(std::memory_order_relaxed) || allowCount) return;
+			allowCount++;
+			frameAllocations.fetch_add(1, std::memory_order_relaxed);
+			frameBytes.fetch_add(size, std::memory_order_relaxed);
+
+			const u32 slot{ recordedCount.fetch_add(1, std::memory_order_relaxed) };
+			if (slot < maxRecorded)
+			{
+				RecordedAllocation& allocation{ recorded[slot] };
+				allocation.size = size;
+				allocation.depth = CaptureStack(&allocation.stack[0], maxStackDepth);
+				allocation.isReady.store(true, std::memory_order_release);
+			}
+			allowCount--;
+		}
+
+		// Allocations that are still being recorded by other threads are left out
+		void ReportFrame(u64 allocations, u64 bytes)
+		{
+			fprintf(stderr, "Memory: %llu heap allocations (%llu bytes) in steady-state frame %u\n",
+				(unsigned long long)allocations, (unsigned long long)bytes, stats.guardedFrames);
+
+			const u32 count{ std::min(recordedCount.load(std::memory_order_relaxed), maxRecorded) };
+			for (u32 i{ 0 }; i < count; i++)
+			{
+				const RecordedAllocation& allocation{ recorded[i] };
+				if (!allocation.isReady.load(std::memory_order_acquire)) continue;
+				fprintf(stderr, "  allocation of %llu bytes:\n", (unsigned long long)allocation.size);
+				PrintStack(&allocation.stack[0], allocation.depth);
+			}
+			if (allocations > count) fprintf(stderr, "  (%llu more)\n", (unsigned long long)(allocations - count));
+			fflush(stderr);
+		}
+
+#if defined (_WIN64)
+		// CRT blocks are the CRT's own bookkeeping, which the hook must not touch
+		int __cdecl AllocationHook(int type, void*, size_t size, int blockType, long, const unsigned char*, int)
+		{
+			if (blockType != _CRT_BLOCK && (type == _HOOK_ALLOC || type == _HOOK_REALLOC)) OnAllocation(size);
+			return TRUE;
+		}
+#endif // _WIN64
+	} // anonymous namespace
+
+	bool IsAllocationGuardSupported()
+	{
+		return true;
+	}
+
+	void SetAllocationGuard(AllocationGuardMode mode, u32 warmupFrames /*= 60*/)
+	{
+#if defined (_WIN64)
+		_CrtSetAllocHook(mode == AllocationGuardMode::Off ? nullptr : AllocationHook);
+#endif
+		isFrameGuarded.store(false, std::memory_order_relaxed);
+		guardMode.store((u32)mode, std::memory_order_relaxed);
+		warmupFramesLeft = warmupFrames;
+	}
+
+	AllocationGuardStats GetAllocationGuardStats()
+	{
+		return stats;
+	}
+
+	void ResetAllocationGuardStats()
+	{
+		stats = {};
+	}
+
+	AllowAllocationsScope::AllowAllocationsScope() { allowCount++; }
+	AllowAllocationsScope::~AllowAllocationsScope() { allowCount--; }
+
+	namespace Detail
+	{
+		void EndGuardedFrame()
+		{
+			if (!isFrameGuarded.exchange(false, std::memory_order_relaxed)) return;
+
+			const u64 allocations{ frameAllocations.exchange(0, std::memory_order_relaxed) };
+			const u64 bytes{ frameBytes.exchange(0, std::memory_order_relaxed) };
+			stats.guardedFrames++;
+			if (allocations)
+			{
+				AllowAllocationsScope allow{};
+				stats.allocations += allocations;
+				stats.bytes += bytes;
+				stats.framesWithAllocations++;
+				ReportFrame(allocations, bytes);
+				if (guardMode.load(std::memory_order_relaxed) == (u32)AllocationGuardMode::Fail)
+				{
+					fprintf(stderr, "Memory: aborting, steady-state frames must not allocate\n");
+					abort();
+				}
+			}
+
+			for (RecordedAllocation& allocation : recorded) allocation.isReady.store(false, std::memory_order_relaxed);
+			recordedCount.store(0, std::memory_order_relaxed);
+		}
+
+		void BeginGuardedFrame()
+		{
+			if (guardMode.load(std::memory_order_relaxed) == (u32)AllocationGuardMode::Off) return;
+			if (warmupFramesLeft)
+			{
+				warmupFramesLeft--;
+				return;
+			}
+			isFrameGuarded.store(true, std::memory_order_relaxed);
+		}
+	}
+}
+
+#if defined (__linux__)
+// Replacements for the malloc family. Shared libraries (libstdc++'s operator new, the GL
+// driver, ...) bind to these as well, so their allocations are seen too.
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* memory, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+
+	void* malloc(size_t size)
+	{
+		Havana::Memory::OnAllocation(size);
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size)
+	{
+		Havana::Memory::OnAllocation((u64)count * size);
+		return __libc_calloc(count, size);
+	}
+
+	// Shrinking or freeing with realloc() still counts, it's a call into the heap
+	void* realloc(void* memory, size_t size)
+	{
+		Havana::Memory::OnAllocation(size);
+		return __libc_realloc(memory, size);
+	}
+
+	void* memalign(size_t alignment, size_t size)
+	{
+		Havana::Memory::OnAllocation(size);
+		return __libc_memalign(alignment, size);
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size)
+	{
+		Havana::Memory::OnAllocation(size);
+		return __libc_memalign(alignment, size);
+	}
+
+	int posix_memalign(void** memory, size_t alignment, size_t size)
+	{
+		if (!alignment || (alignment & (alignment - 1)) || alignment % sizeof(void*)) return EINVAL;
+		Havana::Memory::OnAllocation(size);
+		void* const result{ __libc_memalign(alignment, size) };
+		if (!result) return ENOMEM;
+		*memory = result;
+		return 0;
+	}
+}
+#endif // __linux__
+
+#else
+
+namespace Havana::Memory
+{
+	bool IsAllocationGuardSupported() { return false; }
+	void SetAllocationGuard(AllocationGuardMode, u32) {}
+	AllocationGuardStats GetAllocationGuardStats() { return {}; }
+	void ResetAllocationGuardStats() {}
+	AllowAllocationsScope::AllowAllocationsScope() {}
+	AllowAllocationsScope::~AllowAllocationsScope() {}
+
+	namespace Detail
+	{
+		void EndGuardedFrame() {}
+		void BeginGuardedFrame() {}
+	}
+}
+
+#endif // ALLOCATION_GUARD_HOOKS
@@ -0,0 +1,64 @@
+#pragma once
+#include "PrimitiveTypes.h"
+
+// Zero-allocation frame guard for debug and CI builds. The guard hooks the heap (malloc
+// and everything built on it, including operator new) and, once the warm-up frames are
+// over, counts every heap allocation made by any thread between two calls to
+// Memory::EndFrame(). A steady-state frame is expected to allocate nothing: each frame
+// that does is reported on stderr with the backtraces of its first allocations, and in
+// Fail mode the process is aborted so a CI run can't miss it.
+//
+// The guard is compiled in when _ALLOCATION_GUARD is defined. On Linux it replaces the
+// malloc family and forwards to glibc; on Windows it uses the debug CRT's allocation
+// hook, so it needs a _DEBUG build there. Backtraces have symbol names when the program
+// is linked with -rdynamic.
+#if defined (_ALLOCATION_GUARD)
+#define USE_ALLOCATION_GUARD 1
+#endif
+
+namespace Havana::Memory
+{
+	enum class AllocationGuardMode : u32
+	{
+		Off,
+		Report,
+		Fail,
+	};
+
+	struct AllocationGuardStats
+	{
+		u64		allocations;			// in guarded frames
+		u64		bytes;
+		u32		guardedFrames;
+		u32		framesWithAllocations;
+	};
+
+	// False when the guard isn't compiled in; the other functions then do nothing
+	bool IsAllocationGuardSupported();
+
+	/// <summary>
+	/// Turns the guard on or off. Call from the thread that calls EndFrame().
+	/// </summary>
+	/// <param name="warmupFrames"> - Frames that may still allocate, e.g. while caches fill up.</param>
+	void SetAllocationGuard(AllocationGuardMode mode, u32 warmupFrames = 60);
+	AllocationGuardStats GetAllocationGuardStats();
+	void ResetAllocationGuardStats();
+
+	// Allocations of the calling thread are allowed while the scope is alive, for code that
+	// is known to allocate in steady state (e.g. logging a memory report)
+	class AllowAllocationsScope
+	{
+	public:
+		AllowAllocationsScope();
+		~AllowAllocationsScope();
+		AllowAllocationsScope(const AllowAllocationsScope&) = delete;
+		AllowAllocationsScope& operator=(const AllowAllocationsScope&) = delete;
+	};
+
+	namespace Detail
+	{
+		// Called by EndFrame() around its own work, which may allocate
+		void EndGuardedFrame();
+		void BeginGuardedFrame();
+	}
+}
@@ -39,6 +39,8 @@
 #include "../Utilities/Utilities.h"
 #include "Id.h"
 #include "../Utilities/MathTypes.h"
+#include "Profiler.h"
+#include "Memory.h"
 
 #ifdef _DEBUG
 #define DEBUG_OP(x) x
@@ -0,0 +1,711 @@
+#include "DynamicBvh.h"
+#include <cfloat>
+#include <cstring>
+
+namespace Havana::Spatial
+{
+	namespace
+	{
+		constexpr u32 binCount{ 16 };
+		constexpr u32 minRebuildChanges{ 64 };
+
+		constexpr Aabb emptyBounds{ { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+
+		// Half the surface area, which is all the SAH needs
+		f32 Area(const Aabb& box)
+		{
+			const f32 x{ box.max[0] - box.min[0] };
+			const f32 y{ box.max[1] - box.min[1] };
+			const f32 z{ box.max[2] - box.min[2] };
+			return x * y + y * z + z * x;
+		}
+
+		Aabb Merge(const Aabb& a, const Aabb& b)
+		{
+			Aabb result;
+			for (u32 i{ 0 }; i < 3; i++)
+			{
+				result.min[i] = std::min(a.min[i], b.min[i]);
+				result.max[i] = std::max(a.max[i], b.max[i]);
+			}
+			return result;
+		}
+
+		bool Contains(const Aabb& outer, const Aabb& inner)
+		{
+			for (u32 i{ 0 }; i < 3; i++)
+				if (inner.min[i] < outer.min[i] || inner.max[i] > outer.max[i]) return false;
+			return true;
+		}
+
+		bool Overlaps(const Aabb& a, const Aabb& b)
+		{
+			for (u32 i{ 0 }; i < 3; i++)
+				if (a.min[i] > b.max[i] || a.max[i] < b.min[i]) return false;
+			return true;
+		}
+
+		bool IsEqual(const Aabb& a, const Aabb& b)
+		{
+			for (u32 i{ 0 }; i < 3; i++)
+				if (a.min[i] != b.min[i] || a.max[i] != b.max[i]) return false;
+			return true;
+		}
+
+		Aabb Fatten(const Aabb& box, f32 margin)
+		{
+			Aabb result;
+			for (u32 i{ 0 }; i < 3; i++)
+			{
+				result.min[i] = box.min[i] - margin;
+				result.max[i] = box.max[i] + margin;
+			}
+			return result;
+		}
+
+		// Grows the array to hold at least count elements, keeping the first size ones
+		template<typename T>
+		void Reserve(T*& data, u32& capacity, u32 count, u32 size, Memory::Tag tag, Memory::Callsite callsite)
+		{
+			if (count <= capacity) return;
+			const u32 newCapacity{ std::max({ count, capacity * 2, 64u }) };
+			T* const newData{ (T*)Memory::Allocate(tag, (u64)newCapacity * sizeof(T), alignof(T), callsite) };
+			assert(newData);
+			if (size) memcpy(newData, data, (u64)size * sizeof(T));
+			Memory::Free(data);
+			data = newData;
+			capacity = newCapacity;
+		}
+	} // anonymous namespace
+
+	//// NODES ////
+
+	namespace
+	{
+		template<typename Node>
+		Aabb SlotBounds(const Node& node, u32 slot)
+		{
+			return { { node.minX[slot], node.minY[slot], node.minZ[slot] }, { node.maxX[slot], node.maxY[slot], node.maxZ[slot] } };
+		}
+
+		template<typename Node>
+		void SetSlotBounds(Node& node, u32 slot, const Aabb& bounds)
+		{
+			node.minX[slot] = bounds.min[0]; node.minY[slot] = bounds.min[1]; node.minZ[slot] = bounds.min[2];
+			node.maxX[slot] = bounds.max[0]; node.maxY[slot] = bounds.max[1]; node.maxZ[slot] = bounds.max[2];
+		}
+
+		template<typename Node>
+		Aabb NodeBounds(const Node& node)
+		{
+			Aabb bounds{ emptyBounds };
+			for (u32 i{ 0 }; i < node.count; i++) bounds = Merge(bounds, SlotBounds(node, i));
+			return bounds;
+		}
+	} // anonymous namespace
+
+	// Unused slots get an empty box, so the SIMD tests never report them
+	u32 DynamicBvh::AllocateNode(Tree& tree)
+	{
+		u32 index{ tree.freeNode };
+		if (index != U32_INVALID_ID) tree.freeNode = tree.nodes[index].parent;
+		else
+		{
+			Reserve(tree.nodes, tree.capacity, tree.count + 1, tree.count, m_tag, m_callsite);
+			index = tree.count++;
+		}
+
+		Node& node{ tree.nodes[index] };
+		for (u32 i{ 0 }; i < branching; i++)
+		{
+			SetSlotBounds(node, i, emptyBounds);
+			node.children[i] = U32_INVALID_ID;
+		}
+		node.parent = U32_INVALID_ID;
+		node.parentSlot = 0;
+		node.count = 0;
+		return index;
+	}
+
+	void DynamicBvh::FreeNode(Tree& tree, u32 index)
+	{
+		tree.nodes[index].parent = tree.freeNode;
+		tree.freeNode = index;
+	}
+
+	// Keeps the node memory for the next build
+	void DynamicBvh::ClearTree(Tree& tree)
+	{
+		tree.count = 0;
+		tree.freeNode = U32_INVALID_ID;
+		tree.root = U32_INVALID_ID;
+		tree.height = 0;
+	}
+
+	void DynamicBvh::ReleaseTree(Tree& tree)
+	{
+		Memory::Free(tree.nodes);
+		tree = {};
+	}
+
+	// Also points the child back at its new place
+	void DynamicBvh::SetChild(u32 index, u32 slot, u32 child, const Aabb& bounds)
+	{
+		Node& node{ m_tree.nodes[index] };
+		node.children[slot] = child;
+		SetSlotBounds(node, slot, bounds);
+		if (child & leafBit)
+		{
+			Proxy& proxy{ m_proxies[child & ~leafBit] };
+			proxy.node = index;
+			proxy.slot = slot;
+		}
+		else
+		{
+			m_tree.nodes[child].parent = index;
+			m_tree.nodes[child].parentSlot = slot;
+		}
+	}
+
+	// Updates the boxes of the node's ancestors, up to the first one that doesn't change
+	void DynamicBvh::Refit(u32 index)
+	{
+		while (index != m_tree.root)
+		{
+			const Node& node{ m_tree.nodes[index] };
+			const Aabb bounds{ NodeBounds(node) };
+			Node& parent{ m_tree.nodes[node.parent] };
+			if (IsEqual(SlotBounds(parent, node.parentSlot), bounds)) break;
+			SetSlotBounds(parent, node.parentSlot, bounds);
+			index = node.parent;
+		}
+	}
+
+	void DynamicBvh::InsertLeaf(u32 proxyIndex)
+	{
+		const Aabb box{ m_proxies[proxyIndex].bounds };
+		const u32 leaf{ leafBit | proxyIndex };
+
+		if (m_tree.root == U32_INVALID_ID)
+		{
+			m_tree.root = AllocateNode(m_tree);
+			m_tree.nodes[m_tree.root].count = 1;
+			SetChild(m_tree.root, 0, leaf, box);
+			m_tree.height = 1;
+			return;
+		}
+
+		const f32 boxArea{ Area(box) };
+		u32 index{ m_tree.root };
+		u32 depth{ 1 };
+		while (true)
+		{
+			Node& node{ m_tree.nodes[index] };
+			if (node.count < branching)
+			{
+				SetChild(index, node.count++, leaf, box);
+				break;
+			}
+
+			// The node is full: go down the child that grows least, ties go to the smaller one
+			u32 best{ 0 };
+			f32 bestGrowth{ FLT_MAX };
+			f32 bestArea{ FLT_MAX };
+			for (u32 i{ 0 }; i < branching; i++)
+			{
+				const f32 childArea{ Area(SlotBounds(node, i)) };
+				const f32 mergedArea{ Area(Merge(SlotBounds(node, i), box)) };
+				const f32 growth{ mergedArea - childArea };
+				if (growth < bestGrowth || (growth == bestGrowth && mergedArea < bestArea))
+				{
+					best = i;
+					bestGrowth = growth;
+					bestArea = mergedArea;
+				}
+			}
+
+			const u32 child{ node.children[best] };
+			const Aabb childBounds{ SlotBounds(node, best) };
+			const Aabb merged{ Merge(childBounds, box) };
+
+			// Pair the new leaf with a leaf, or with a subtree that is smaller than it,
+			// instead of pushing the leaf further down
+			if ((child & leafBit) || Area(childBounds) <= boxArea)
+			{
+				const u32 pair{ AllocateNode(m_tree) };
+				m_tree.nodes[pair].count = 2;
+				SetChild(pair, 0, child, childBounds);
+				SetChild(pair, 1, leaf, box);
+				SetChild(index, best, pair, merged);
+				depth++;
+				break;
+			}
+
+			SetSlotBounds(node, best, merged);
+			index = child;
+			depth++;
+		}
+		m_tree.height = std::max(m_tree.height, depth);
+	}
+
+	void DynamicBvh::RemoveLeaf(u32 proxyIndex)
+	{
+		Proxy& proxy{ m_proxies[proxyIndex] };
+		const u32 index{ proxy.node };
+		assert(index != U32_INVALID_ID && m_tree.nodes[index].children[proxy.slot] == (leafBit | proxyIndex));
+		proxy.node = U32_INVALID_ID;
+
+		// Fill the hole with the last child
+		Node& node{ m_tree.nodes[index] };
+		const u32 last{ node.count - 1 };
+		if (proxy.slot != last) SetChild(index, proxy.slot, node.children[last], SlotBounds(node, last));
+		SetSlotBounds(node, last, emptyBounds);
+		node.children[last] = U32_INVALID_ID;
+		node.count--;
+
+		if (index == m_tree.root)
+		{
+			if (!node.count)
+			{
+				FreeNode(m_tree, index);
+				m_tree.root = U32_INVALID_ID;
+				m_tree.height = 0;
+			}
+			else if (node.count == 1 && !(node.children[0] & leafBit))
+			{
+				m_tree.root = node.children[0];
+				m_tree.nodes[m_tree.root].parent = U32_INVALID_ID;
+				FreeNode(m_tree, index);
+			}
+			return;
+		}
+
+		if (node.count == 1)
+		{
+			// A node with one child is replaced by the child
+			const u32 parent{ node.parent };
+			const u32 parentSlot{ node.parentSlot };
+			const u32 child{ node.children[0] };
+			const Aabb bounds{ SlotBounds(node, 0) };
+			FreeNode(m_tree, index);
+			SetChild(parent, parentSlot, child, bounds);
+			Refit(parent);
+		}
+		else Refit(index);
+	}
+
+	//// PROXIES ////
+
+	void DynamicBvh::Initialize(f32 margin /*= defaultMargin*/, Memory::Tag tag /*= Memory::Tag::General*/, Memory::Callsite callsite /*= MEMORY_CALLSITE*/)
+	{
+		assert(margin >= 0.0f);
+		Release();
+		m_margin = margin;
+		m_tag = tag;
+		m_callsite = callsite;
+	}
+
+	void DynamicBvh::Release()
+	{
+		if (m_isRebuilding)
+		{
+			Jobs::Wait(m_rebuildCounter);
+			m_isRebuilding = false;
+		}
+
+		ReleaseTree(m_tree);
+		ReleaseTree(m_rebuildTree);
+		Memory::Free(m_proxies);
+		Memory::Free(m_primitives);
+		m_proxies = nullptr;
+		m_primitives = nullptr;
+		m_proxyCapacity = m_proxyCount = m_aliveCount = 0;
+		m_primitiveCapacity = m_primitiveCount = 0;
+		m_freeProxy = m_firstChanged = U32_INVALID_ID;
+		m_changesSinceBuild = 0;
+	}
+
+	proxy_id DynamicBvh::Add(const Aabb& bounds, u32 userData)
+	{
+		u32 index{ m_freeProxy };
+		if (index != U32_INVALID_ID) m_freeProxy = m_proxies[index].node;
+		else
+		{
+			assert(m_proxyCount < Id::Detail::INDEX_MASK);
+			Reserve(m_proxies, m_proxyCapacity, m_proxyCount + 1, m_proxyCount, m_tag, m_callsite);
+			index = m_proxyCount++;
+			m_proxies[index].generation = 0;
+			m_proxies[index].isChanged = false;
+		}
+
+		Proxy& proxy{ m_proxies[index] };
+		proxy.bounds = Fatten(bounds, m_margin);
+		proxy.userData = userData;
+		proxy.node = U32_INVALID_ID;
+		proxy.isAlive = true;
+		m_aliveCount++;
+
+		InsertLeaf(index);
+		MarkChanged(index);
+		if (m_tree.height > maxHeight) Rebuild();
+		return proxy_id{ index | ((Id::id_type)proxy.generation << Id::Detail::INDEX_BITS) };
+	}
+
+	void DynamicBvh::Remove(proxy_id id)
+	{
+		GetProxy(id);
+		const u32 index{ Id::Index(id) };
+		Proxy& proxy{ m_proxies[index] };
+		RemoveLeaf(index);
+		proxy.isAlive = false;
+		// The largest generation with the largest index would be INVALID_ID
+		proxy.generation = (Id::generation_type)((proxy.generation + 1u) % Id::Detail::GENERATION_MASK);
+		m_aliveCount--;
+		MarkChanged(index);
+
+		// A running rebuild still has the proxy, it's freed once the rebuild is swapped in
+		if (!m_isRebuilding)
+		{
+			proxy.node = m_freeProxy;
+			m_freeProxy = index;
+		}
+	}
+
+	bool DynamicBvh::Move(proxy_id id, const Aabb& bounds, const f32* const displacement /*= nullptr*/)
+	{
+		GetProxy(id);
+		const u32 index{ Id::Index(id) };
+		Proxy& proxy{ m_proxies[index] };
+		if (Contains(proxy.bounds, bounds)) return false;
+
+		Aabb fat{ Fatten(bounds, m_margin) };
+		if (displacement)
+		{
+			for (u32 i{ 0 }; i < 3; i++)
+			{
+				if (displacement[i] < 0.0f) fat.min[i] += displacement[i] * 2.0f;
+				else fat.max[i] += displacement[i] * 2.0f;
+			}
+		}
+
+		if (Overlaps(proxy.bounds, fat))
+		{
+			// Still in the same part of the tree: refit in place
+			proxy.bounds = fat;
+			SetSlotBounds(m_tree.nodes[proxy.node], proxy.slot, fat);
+			Refit(proxy.node);
+		}
+		else
+		{
+			// Teleported: find a better place
+			RemoveLeaf(index);
+			proxy.bounds = fat;
+			InsertLeaf(index);
+		}
+
+		MarkChanged(index);
+		if (m_tree.height > maxHeight) Rebuild();
+		return true;
+	}
+
+	// Changes made while a rebuild is running are replayed on the new tree
+	void DynamicBvh::MarkChanged(u32 proxyIndex)
+	{
+		m_changesSinceBuild++;
+		Proxy& proxy{ m_proxies[proxyIndex] };
+		if (m_isRebuilding && !proxy.isChanged)
+		{
+			proxy.isChanged = true;
+			proxy.nextChanged = m_firstChanged;
+			m_firstChanged = proxyIndex;
+		}
+	}
+
+	//// REBUILD ////
+
+	void DynamicBvh::Update()
+	{
+		if (m_isRebuilding)
+		{
+			if (!m_rebuildCounter.IsDone()) return;
+			FinishRebuild();
+		}
+
+		if (m_tree.height > maxHeight) Rebuild();
+		else if (m_changesSinceBuild > std::max(minRebuildChanges, (u32)(m_aliveCount * m_rebuildFraction))) StartRebuild(true);
+	}
+
+	void DynamicBvh::Rebuild()
+	{
+		if (m_isRebuilding)
+		{
+			Jobs::Wait(m_rebuildCounter);
+			FinishRebuild();
+		}
+		StartRebuild(false);
+	}
+
+	void DynamicBvh::StartRebuild(bool inBackground)
+	{
+		assert(!m_isRebuilding);
+		m_changesSinceBuild = 0;
+
+		// The build works on a copy of the boxes, so the tree can change meanwhile
+		Reserve(m_primitives, m_primitiveCapacity, m_aliveCount, 0, m_tag, m_callsite);
+		m_primitiveCount = 0;
+		for (u32 i{ 0 }; i < m_proxyCount; i++)
+		{
+			const Proxy& proxy{ m_proxies[i] };
+			if (!proxy.isAlive) continue;
+			BuildPrimitive& primitive{ m_primitives[m_primitiveCount++] };
+			primitive.bounds = proxy.bounds;
+			for (u32 axis{ 0 }; axis < 3; axis++) primitive.centroid[axis] = (proxy.bounds.min[axis] + proxy.bounds.max[axis]) * 0.5f;
+			primitive.proxy = i;
+			primitive.node = U32_INVALID_ID;
+			primitive.slot = 0;
+		}
+		assert(m_primitiveCount == m_aliveCount);
+
+		ClearTree(m_rebuildTree);
+		m_isRebuilding = true;
+		// Worker 0 is the calling thread, a job would only run when someone waits for it
+		if (inBackground && Jobs::WorkerCount() > 1) Jobs::Run(BuildJob, this, &m_rebuildCounter);
+		else
+		{
+			Build();
+			FinishRebuild();
+		}
+	}
+
+	void DynamicBvh::BuildJob(void* data)
+	{
+		static_cast<DynamicBvh*>(data)->Build();
+	}
+
+	void DynamicBvh::FinishRebuild()
+	{
+		assert(m_isRebuilding && m_rebuildCounter.IsDone());
+		m_isRebuilding = false;
+
+		// Proxies added during the build aren't in the new tree
+		for (u32 i{ m_firstChanged }; i != U32_INVALID_ID; i = m_proxies[i].nextChanged)
+			m_proxies[i].node = U32_INVALID_ID;
+
+		std::swap(m_tree, m_rebuildTree);
+		ClearTree(m_rebuildTree);
+		for (u32 i{ 0 }; i < m_primitiveCount; i++)
+		{
+			const BuildPrimitive& primitive{ m_primitives[i] };
+			m_proxies[primitive.proxy].node = primitive.node;
+			m_proxies[primitive.proxy].slot = primitive.slot;
+		}
+
+		// Replay the changes made during the build
+		u32 index{ m_firstChanged };
+		m_firstChanged = U32_INVALID_ID;
+		while (index != U32_INVALID_ID)
+		{
+			Proxy& proxy{ m_proxies[index] };
+			const u32 next{ proxy.nextChanged };
+			proxy.isChanged = false;
+			if (proxy.node != U32_INVALID_ID) RemoveLeaf(index);
+			if (proxy.isAlive) InsertLeaf(index);
+			else
+			{
+				proxy.node = m_freeProxy;
+				m_freeProxy = index;
+			}
+			index = next;
+		}
+		m_rebuildCount++;
+	}
+
+	// Runs on a worker when the rebuild is in the background. Only touches the rebuild tree
+	// and the primitives.
+	void DynamicBvh::Build()
+	{
+		if (!m_primitiveCount) return;
+		m_rebuildTree.root = AllocateNode(m_rebuildTree);
+		if (m_primitiveCount == 1)
+		{
+			// A root with a single leaf, like InsertLeaf() makes for the first object
+			BuildPrimitive& primitive{ m_primitives[0] };
+			Node& root{ m_rebuildTree.nodes[m_rebuildTree.root] };
+			root.children[0] = leafBit | primitive.proxy;
+			SetSlotBounds(root, 0, primitive.bounds);
+			root.count = 1;
+			primitive.node = m_rebuildTree.root;
+			primitive.slot = 0;
+			m_rebuildTree.height = 1;
+			return;
+		}
+		m_rebuildTree.height = BuildNode(m_rebuildTree.root, 0, m_primitiveCount, 1);
+	}
+
+	// Returns the height of the subtree. Needs at least two primitives.
+	u32 DynamicBvh::BuildNode(u32 index, u32 begin, u32 end, u32 depth)
+	{
+		assert(end - begin > 1);
+
+		// Split the largest range until there are enough for all slots. Splits close to
+		// the height limit are made at the median to keep the tree from getting deeper.
+		u32 ranges[branching + 1]{ begin, end };
+		u32 rangeCount{ 1 };
+		while (rangeCount < branching)
+		{
+			u32 largest{ 0 };
+			for (u32 i{ 1 }; i < rangeCount; i++)
+				if (ranges[i + 1] - ranges[i] > ranges[largest + 1] - ranges[largest]) largest = i;
+			if (ranges[largest + 1] - ranges[largest] < 2) break;
+
+			const u32 split{ Split(ranges[largest], ranges[largest + 1], depth + 8 > maxHeight) };
+			for (u32 i{ rangeCount + 1 }; i > largest + 1; i--) ranges[i] = ranges[i - 1];
+			ranges[largest + 1] = split;
+			rangeCount++;
+		}
+
+		u32 height{ 1 };
+		for (u32 i{ 0 }; i < rangeCount; i++)
+		{
+			u32 child;
+			Aabb bounds;
+			if (ranges[i + 1] - ranges[i] == 1)
+			{
+				BuildPrimitive& primitive{ m_primitives[ranges[i]] };
+				child = leafBit | primitive.proxy;
+				bounds = primitive.bounds;
+				primitive.node = index;
+				primitive.slot = i;
+			}
+			else
+			{
+				child = AllocateNode(m_rebuildTree);
+				height = std::max(height, BuildNode(child, ranges[i], ranges[i + 1], depth + 1) + 1);
+				Node& childNode{ m_rebuildTree.nodes[child] };
+				childNode.parent = index;
+				childNode.parentSlot = i;
+				bounds = NodeBounds(childNode);
+			}
+
+			Node& node{ m_rebuildTree.nodes[index] };
+			node.children[i] = child;
+			SetSlotBounds(node, i, bounds);
+		}
+		m_rebuildTree.nodes[index].count = rangeCount;
+		return height;
+	}
+
+	// Partitions the primitives with a binned SAH split along the axis where their centroids
+	// are spread the most, and returns where the second half starts. Both halves are never empty.
+	u32 DynamicBvh::Split(u32 begin, u32 end, bool atMedian)
+	{
+		BuildPrimitive* const primitives{ m_primitives };
+		Aabb centroids{ emptyBounds };
+		for (u32 i{ begin }; i < end; i++)
+		{
+			for (u32 axis{ 0 }; axis < 3; axis++)
+			{
+				centroids.min[axis] = std::min(centroids.min[axis], primitives[i].centroid[axis]);
+				centroids.max[axis] = std::max(centroids.max[axis], primitives[i].centroid[axis]);
+			}
+		}
+
+		u32 axis{ 0 };
+		for (u32 i{ 1 }; i < 3; i++)
+			if (centroids.max[i] - centroids.min[i] > centroids.max[axis] - centroids.min[axis]) axis = i;
+		const f32 minimum{ centroids.min[axis] };
+		const f32 extent{ centroids.max[axis] - minimum };
+
+		if (!atMedian && extent > 0.0f)
+		{
+			const f32 scale{ binCount / extent };
+			auto binOf = [=](const BuildPrimitive& primitive) { return std::min((u32)((primitive.centroid[axis] - minimum) * scale), binCount - 1); };
+
+			Aabb bins[binCount];
+			u32 counts[binCount]{};
+			for (Aabb& bin : bins) bin = emptyBounds;
+			for (u32 i{ begin }; i < end; i++)
+			{
+				const u32 bin{ binOf(primitives[i]) };
+				bins[bin] = Merge(bins[bin], primitives[i].bounds);
+				counts[bin]++;
+			}
+
+			// Cost of splitting after bin i is area(left) * count(left) + area(right) * count(right)
+			f32 leftCosts[binCount - 1];
+			Aabb bounds{ emptyBounds };
+			u32 count{ 0 };
+			for (u32 i{ 0 }; i < binCount - 1; i++)
+			{
+				bounds = Merge(bounds, bins[i]);
+				count += counts[i];
+				leftCosts[i] = count ? Area(bounds) * count : 0.0f;
+			}
+
+			u32 bestBin{ U32_INVALID_ID };
+			f32 bestCost{ FLT_MAX };
+			bounds = emptyBounds;
+			count = 0;
+			for (u32 i{ binCount - 1 }; i > 0; i--)
+			{
+				bounds = Merge(bounds, bins[i]);
+				count += counts[i];
+				const f32 cost{ leftCosts[i - 1] + (count ? Area(bounds) * count : 0.0f) };
+				if (count && count < end - begin && cost < bestCost)
+				{
+					bestCost = cost;
+					bestBin = i - 1;
+				}
+			}
+
+			if (bestBin != U32_INVALID_ID)
+			{
+				const BuildPrimitive* const split{ std::partition(primitives + begin, primitives + end,
+					[=](const BuildPrimitive& primitive) { return binOf(primitive) <= bestBin; }) };
+				return (u32)(split - primitives);
+			}
+		}
+
+		// All centroids in one place, or the tree is getting too deep: split at the median
+		const u32 middle{ begin + (end - begin) / 2 };
+		std::nth_element(primitives + begin, primitives + middle, primitives + end, [axis](const BuildPrimitive& a, const BuildPrimitive& b) {
+			return a.centroid[axis] < b.centroid[axis]; });
+		return middle;
+	}
+
+	//// STATS ////
+
+	BvhStats DynamicBvh::GetStats() const
+	{
+		BvhStats stats{};
+		stats.proxyCount = m_aliveCount;
+		stats.rebuildCount = m_rebuildCount;
+		stats.isRebuilding = m_isRebuilding;
+		if (m_tree.root == U32_INVALID_ID) return stats;
+
+		struct Entry
+		{
+			u32 node;
+			u32 depth;
+		};
+		Entry stack[stackSize];
+		u32 size{ 0 };
+		stack[size++] = { m_tree.root, 1 };
+		const f32 rootArea{ std::max(Area(NodeBounds(m_tree.nodes[m_tree.root])), FLT_MIN) };
+		while (size)
+		{
+			const Entry entry{ stack[--size] };
+			const Node& node{ m_tree.nodes[entry.node] };
+			stats.nodeCount++;
+			stats.height = std::max(stats.height, entry.depth);
+			stats.sahCost += Area(NodeBounds(node)) / rootArea;
+			for (u32 i{ 0 }; i < node.count; i++)
+			{
+				if (node.children[i] & leafBit) continue;
+				assert(size < stackSize);
+				stack[size++] = { node.children[i], entry.depth + 1 };
+			}
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,392 @@
+#pragma once
+#include "CommonHeaders.h"
+#include "JobSystem.h"
+
+#if defined (__SSE2__) || defined (_M_X64)
+#include <emmintrin.h>
+#define USE_BVH_SIMD 1
+#endif
+
+// Dynamic bounding volume hierarchy for culling, picking and proximity queries over
+// objects that are added, removed and moved all the time.
+//
+// Nodes have up to 4 children whose boxes are stored as structure of arrays, so a query
+// tests all children of a node with one set of SIMD instructions. Objects are inserted
+// into the child that grows least in surface area (a greedy SAH). Each object is stored
+// with a fat box (its box plus a margin) and moving it only changes the tree when it
+// leaves its fat box; the box is then updated in place and the ancestors are refitted.
+// Objects that jump to a box that doesn't touch the old one are reinserted instead.
+//
+// Refitting and inserting make the tree worse over time. Update() rebuilds the whole
+// tree with a binned SAH build once enough objects changed. The build runs on a job
+// worker while the old tree keeps serving queries and taking changes; changes made
+// during the build are replayed on the new tree when it is swapped in.
+//
+// Not thread-safe: changes and queries must come from one thread, or be synchronized
+// by the caller. Queries can run on several threads at once when nothing changes.
+namespace Havana::Spatial
+{
+	DEFINE_TYPED_ID(proxy_id);
+
+	struct Aabb
+	{
+		f32 min[3];
+		f32 max[3];
+	};
+
+	struct BvhStats
+	{
+		u32		proxyCount;
+		u32		nodeCount;
+		u32		height;
+		f32		sahCost;		// sum of node areas relative to the root's, lower is better
+		u32		rebuildCount;
+		bool	isRebuilding;
+	};
+
+	class DynamicBvh
+	{
+	public:
+		constexpr static u32 branching{ 4 };
+		constexpr static u32 maxHeight{ 64 };	// an insert that goes deeper rebuilds the tree right away
+		constexpr static f32 defaultMargin{ 0.1f };
+		constexpr static f32 defaultRebuildFraction{ 0.25f };
+
+		DynamicBvh() = default;
+		DISABLE_COPY_AND_MOVE(DynamicBvh);
+		~DynamicBvh() { Release(); }
+
+		/// <summary>
+		/// Prepares an empty tree.
+		/// </summary>
+		/// <param name="margin"> - Added to every side of an object's box, so small moves don't change the tree.</param>
+		/// <param name="tag"> - Subsystem the tree's memory is tracked under.</param>
+		void Initialize(f32 margin = defaultMargin, Memory::Tag tag = Memory::Tag::General, Memory::Callsite callsite = MEMORY_CALLSITE);
+		// Waits for a rebuild that is still running
+		void Release();
+
+		[[nodiscard]] proxy_id Add(const Aabb& bounds, u32 userData);
+		void Remove(proxy_id id);
+		// Returns true if the tree had to change. The displacement (the object's expected
+		// move in the next frame, optional) stretches the fat box in that direction.
+		bool Move(proxy_id id, const Aabb& bounds, const f32* const displacement = nullptr);
+
+		// Call once per frame. Swaps in a finished rebuild and starts a new one when more
+		// than the rebuild fraction of the objects changed since the last one.
+		void Update();
+		// Rebuilds the tree before returning
+		void Rebuild();
+		void SetRebuildFraction(f32 fraction) { assert(fraction > 0.0f); m_rebuildFraction = fraction; }
+
+		u32 GetUserData(proxy_id id) const { return GetProxy(id).userData; }
+		const Aabb& GetFatBounds(proxy_id id) const { return GetProxy(id).bounds; }
+		BvhStats GetStats() const;
+
+		// Calls callback(userData) for every object whose fat box overlaps the box
+		template<typename F>
+		void QueryBox(const Aabb& box, F&& callback) const
+		{
+			if (m_tree.root == U32_INVALID_ID) return;
+			u32 stack[stackSize];
+			u32 size{ 0 };
+			stack[size++] = m_tree.root;
+			while (size)
+			{
+				const Node& node{ m_tree.nodes[stack[--size]] };
+				const u32 mask{ OverlapMask(node, box) };
+				for (u32 i{ 0 }; i < node.count; i++)
+				{
+					if (!(mask & (1u << i))) continue;
+					const u32 child{ node.children[i] };
+					if (child & leafBit) callback(m_proxies[child & ~leafBit].userData);
+					else
+					{
+						assert(size < stackSize);
+						stack[size++] = child;
+					}
+				}
+			}
+		}
+
+		// Calls callback(userData) for every object whose fat box is at least partly in the
+		// frustum. Planes are (a, b, c, d) with normals pointing in, like the ones from
+		// Graphics::OpenGL::Culling::ExtractFrustumPlanes(). Subtrees that are completely
+		// inside are reported without testing them.
+		template<typename F>
+		void QueryFrustum(const f32* const planes /* [6 * 4] */, F&& callback) const
+		{
+			if (m_tree.root == U32_INVALID_ID) return;
+			// Nodes that are known to be inside are pushed with insideBit set
+			constexpr u32 insideBit{ leafBit };
+			u32 stack[stackSize];
+			u32 size{ 0 };
+			stack[size++] = m_tree.root;
+			while (size)
+			{
+				const u32 entry{ stack[--size] };
+				const Node& node{ m_tree.nodes[entry & ~insideBit] };
+				u32 visible{ (1u << node.count) - 1 };
+				u32 inside{ visible };
+				if (!(entry & insideBit)) FrustumMasks(node, planes, visible, inside);
+
+				for (u32 i{ 0 }; i < node.count; i++)
+				{
+					if (!(visible & (1u << i))) continue;
+					const u32 child{ node.children[i] };
+					if (child & leafBit) callback(m_proxies[child & ~leafBit].userData);
+					else
+					{
+						assert(size < stackSize);
+						stack[size++] = child | ((inside & (1u << i)) ? insideBit : 0);
+					}
+				}
+			}
+		}
+
+		// Visits the objects whose fat boxes the ray hits, roughly nearest first, as
+		// maxDistance = callback(userData, maxDistance). The callback returns the distance
+		// of its own hit to stop looking further than that (picking), or maxDistance to go on.
+		template<typename F>
+		void QueryRay(const f32* const origin, const f32* const direction, f32 maxDistance, F&& callback) const
+		{
+			if (m_tree.root == U32_INVALID_ID) return;
+			f32 inverse[3];
+			for (u32 i{ 0 }; i < 3; i++)
+			{
+				// Keeps 0 * infinity out of the slab test
+				const f32 d{ direction[i] };
+				inverse[i] = 1.0f / (d > 1e-20f || d < -1e-20f ? d : 1e-20f);
+			}
+
+			struct Entry
+			{
+				u32 child;
+				f32 distance;
+			};
+			Entry stack[stackSize];
+			u32 size{ 0 };
+			stack[size++] = { m_tree.root, 0.0f };
+			while (size)
+			{
+				const Entry entry{ stack[--size] };
+				if (entry.distance > maxDistance) continue;
+				if (entry.child & leafBit)
+				{
+					maxDistance = callback(m_proxies[entry.child & ~leafBit].userData, maxDistance);
+					continue;
+				}
+
+				const Node& node{ m_tree.nodes[entry.child] };
+				alignas(16) f32 distances[branching];
+				const u32 mask{ RayMask(node, origin, &inverse[0], maxDistance, &distances[0]) };
+
+				// Farther children are pushed first, so the nearest one is visited next
+				Entry hits[branching];
+				u32 hitCount{ 0 };
+				for (u32 i{ 0 }; i < node.count; i++)
+				{
+					if (!(mask & (1u << i))) continue;
+					u32 j{ hitCount++ };
+					for (; j && hits[j - 1].distance < distances[i]; j--) hits[j] = hits[j - 1];
+					hits[j] = { node.children[i], distances[i] };
+				}
+				assert(size + hitCount <= stackSize);
+				for (u32 i{ 0 }; i < hitCount; i++) stack[size++] = hits[i];
+			}
+		}
+
+	private:
+		constexpr static u32 leafBit{ 0x8000'0000u };
+		constexpr static u32 stackSize{ maxHeight * (branching - 1) + branching + 1 };
+
+		struct alignas(64) Node
+		{
+			f32		minX[branching];
+			f32		minY[branching];
+			f32		minZ[branching];
+			f32		maxX[branching];
+			f32		maxY[branching];
+			f32		maxZ[branching];
+			u32		children[branching];	// node index, or leafBit | proxy index
+			u32		parent;					// next free node while the node is unused
+			u32		parentSlot;
+			u32		count;
+		};
+
+		struct Proxy
+		{
+			Aabb				bounds;		// fat box
+			u32					userData;
+			u32					node;		// next free proxy while the proxy is unused
+			u32					slot;
+			u32					nextChanged;
+			Id::generation_type	generation;
+			bool				isAlive;
+			bool				isChanged;	// changed while a rebuild was running
+		};
+
+		struct BuildPrimitive
+		{
+			Aabb	bounds;
+			f32		centroid[3];
+			u32		proxy;
+			u32		node;
+			u32		slot;
+		};
+
+		// Node memory of one tree. The rebuild writes a second tree and the two are swapped.
+		struct Tree
+		{
+			Node*	nodes{ nullptr };
+			u32		capacity{ 0 };
+			u32		count{ 0 };
+			u32		freeNode{ U32_INVALID_ID };
+			u32		root{ U32_INVALID_ID };
+			u32		height{ 0 };	// upper bound, exact right after a rebuild
+		};
+
+		// Bit i is set when child i overlaps the box
+		static u32 OverlapMask(const Node& node, const Aabb& box)
+		{
+#ifdef USE_BVH_SIMD
+			const __m128 x{ _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minX), _mm_set1_ps(box.max[0])), _mm_cmpge_ps(_mm_load_ps(node.maxX), _mm_set1_ps(box.min[0]))) };
+			const __m128 y{ _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minY), _mm_set1_ps(box.max[1])), _mm_cmpge_ps(_mm_load_ps(node.maxY), _mm_set1_ps(box.min[1]))) };
+			const __m128 z{ _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minZ), _mm_set1_ps(box.max[2])), _mm_cmpge_ps(_mm_load_ps(node.maxZ), _mm_set1_ps(box.min[2]))) };
+			return (u32)_mm_movemask_ps(_mm_and_ps(x, _mm_and_ps(y, z)));
+#else
+			u32 mask{ 0 };
+			for (u32 i{ 0 }; i < branching; i++)
+			{
+				if (node.minX[i] <= box.max[0] && node.maxX[i] >= box.min[0] &&
+					node.minY[i] <= box.max[1] && node.maxY[i] >= box.min[1] &&
+					node.minZ[i] <= box.max[2] && node.maxZ[i] >= box.min[2])
+					mask |= 1u << i;
+			}
+			return mask;
+#endif
+		}
+
+		// Clears the bits of children that are outside a plane in visible, and of children
+		// that aren't inside all planes in inside. The corner farthest along a plane's
+		// normal decides whether a box is outside it, the nearest whether it's inside.
+		static void FrustumMasks(const Node& node, const f32* const planes, u32& visible, u32& inside)
+		{
+#ifdef USE_BVH_SIMD
+			__m128 isOutside{ _mm_setzero_ps() };
+			__m128 isInside{ _mm_cmpeq_ps(isOutside, isOutside) };
+			for (u32 p{ 0 }; p < 6; p++)
+			{
+				const f32* const plane{ &planes[p * 4] };
+				const __m128 a{ _mm_set1_ps(plane[0]) }, b{ _mm_set1_ps(plane[1]) }, c{ _mm_set1_ps(plane[2]) }, d{ _mm_set1_ps(plane[3]) };
+				const __m128 far{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_load_ps(plane[0] >= 0.0f ? node.maxX : node.minX)),
+					_mm_mul_ps(b, _mm_load_ps(plane[1] >= 0.0f ? node.maxY : node.minY))),
+					_mm_add_ps(_mm_mul_ps(c, _mm_load_ps(plane[2] >= 0.0f ? node.maxZ : node.minZ)), d)) };
+				const __m128 near{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_load_ps(plane[0] >= 0.0f ? node.minX : node.maxX)),
+					_mm_mul_ps(b, _mm_load_ps(plane[1] >= 0.0f ? node.minY : node.maxY))),
+					_mm_add_ps(_mm_mul_ps(c, _mm_load_ps(plane[2] >= 0.0f ? node.minZ : node.maxZ)), d)) };
+				isOutside = _mm_or_ps(isOutside, _mm_cmplt_ps(far, _mm_setzero_ps()));
+				isInside = _mm_and_ps(isInside, _mm_cmpge_ps(near, _mm_setzero_ps()));
+			}
+			visible &= ~(u32)_mm_movemask_ps(isOutside);
+			inside &= visible & (u32)_mm_movemask_ps(isInside);
+#else
+			for (u32 i{ 0 }; i < branching; i++)
+			{
+				for (u32 p{ 0 }; p < 6; p++)
+				{
+					const f32* const plane{ &planes[p * 4] };
+					const f32 far{ plane[0] * (plane[0] >= 0.0f ? node.maxX[i] : node.minX[i]) +
+								   plane[1] * (plane[1] >= 0.0f ? node.maxY[i] : node.minY[i]) +
+								   plane[2] * (plane[2] >= 0.0f ? node.maxZ[i] : node.minZ[i]) + plane[3] };
+					const f32 near{ plane[0] * (plane[0] >= 0.0f ? node.minX[i] : node.maxX[i]) +
+									plane[1] * (plane[1] >= 0.0f ? node.minY[i] : node.maxY[i]) +
+									plane[2] * (plane[2] >= 0.0f ? node.minZ[i] : node.maxZ[i]) + plane[3] };
+					if (far < 0.0f) visible &= ~(1u << i);
+					if (near < 0.0f) inside &= ~(1u << i);
+				}
+			}
+			inside &= visible;
+#endif
+		}
+
+		// Slab test. Bit i is set when the ray enters child i before maxDistance; the entry
+		// distances (clamped to 0) are written to distances.
+		static u32 RayMask(const Node& node, const f32* const origin, const f32* const inverse, f32 maxDistance, f32* const distances)
+		{
+#ifdef USE_BVH_SIMD
+			const __m128 ox{ _mm_set1_ps(origin[0]) }, oy{ _mm_set1_ps(origin[1]) }, oz{ _mm_set1_ps(origin[2]) };
+			const __m128 ix{ _mm_set1_ps(inverse[0]) }, iy{ _mm_set1_ps(inverse[1]) }, iz{ _mm_set1_ps(inverse[2]) };
+			const __m128 x0{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix) }, x1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix) };
+			const __m128 y0{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy) }, y1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy) };
+			const __m128 z0{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz) }, z1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz) };
+			const __m128 enter{ _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps())) };
+			const __m128 exit{ _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(maxDistance))) };
+			_mm_store_ps(distances, enter);
+			return (u32)_mm_movemask_ps(_mm_cmple_ps(enter, exit));
+#else
+			u32 mask{ 0 };
+			for (u32 i{ 0 }; i < branching; i++)
+			{
+				const f32 mins[3]{ node.minX[i], node.minY[i], node.minZ[i] };
+				const f32 maxs[3]{ node.maxX[i], node.maxY[i], node.maxZ[i] };
+				f32 enter{ 0.0f }, exit{ maxDistance };
+				for (u32 axis{ 0 }; axis < 3; axis++)
+				{
+					const f32 t0{ (mins[axis] - origin[axis]) * inverse[axis] };
+					const f32 t1{ (maxs[axis] - origin[axis]) * inverse[axis] };
+					enter = std::max(enter, std::min(t0, t1));
+					exit = std::min(exit, std::max(t0, t1));
+				}
+				distances[i] = enter;
+				if (enter <= exit) mask |= 1u << i;
+			}
+			return mask;
+#endif
+		}
+
+		const Proxy& GetProxy(proxy_id id) const
+		{
+			assert(Id::IsValid(id) && Id::Index(id) < m_proxyCount);
+			const Proxy& proxy{ m_proxies[Id::Index(id)] };
+			assert(proxy.isAlive && proxy.generation == Id::Generation(id));
+			return proxy;
+		}
+
+		u32 AllocateNode(Tree& tree);
+		void FreeNode(Tree& tree, u32 index);
+		void ClearTree(Tree& tree);
+		void ReleaseTree(Tree& tree);
+		void SetChild(u32 index, u32 slot, u32 child, const Aabb& bounds);
+		void Refit(u32 index);
+		void InsertLeaf(u32 proxyIndex);
+		void RemoveLeaf(u32 proxyIndex);
+		void MarkChanged(u32 proxyIndex);
+
+		void StartRebuild(bool inBackground);
+		void FinishRebuild();
+		void Build();
+		u32 BuildNode(u32 index, u32 begin, u32 end, u32 depth);
+		u32 Split(u32 begin, u32 end, bool atMedian);
+		static void BuildJob(void* data);
+
+		Tree					m_tree{};
+		Tree					m_rebuildTree{};
+		Proxy*					m_proxies{ nullptr };
+		BuildPrimitive*			m_primitives{ nullptr };
+		u32						m_proxyCapacity{ 0 };
+		u32						m_proxyCount{ 0 };		// proxies that were ever used
+		u32						m_freeProxy{ U32_INVALID_ID };
+		u32						m_aliveCount{ 0 };
+		u32						m_primitiveCapacity{ 0 };
+		u32						m_primitiveCount{ 0 };
+		u32						m_firstChanged{ U32_INVALID_ID };
+		u32						m_changesSinceBuild{ 0 };
+		u32						m_rebuildCount{ 0 };
+		f32						m_margin{ defaultMargin };
+		f32						m_rebuildFraction{ defaultRebuildFraction };
+		Memory::Tag				m_tag{ Memory::Tag::General };
+		Memory::Callsite		m_callsite{};
+		Jobs::JobCounter		m_rebuildCounter{};
+		bool					m_isRebuilding{ false };
+	};
+}
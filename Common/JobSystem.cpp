@@ -0,0 +1,445 @@
+#include "JobSystem.h"
+#include <thread>
+#include <condition_variable>
+
+#if defined (__linux__)
+#include <pthread.h>
+#elif defined (_WIN64)
+#ifndef WIN_32_LEAN_AND_MEAN
+#define WIN_32_LEAN_AND_MEAN
+#endif // WIN_32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+namespace Havana::Jobs
+{
+	namespace
+	{
+		// Chase-Lev work-stealing deque. The owning worker pushes and pops at the bottom,
+		// other workers steal from the top. The capacity is fixed; when a deque is full
+		// the job is executed immediately by the caller instead.
+		class WorkStealingDeque
+		{
+		public:
+			constexpr static u32 capacity{ 4096 };
+			static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of 2");
+
+			WorkStealingDeque() = default;
+			DISABLE_COPY_AND_MOVE(WorkStealingDeque);
+
+			// Owner thread only
+			bool Push(const Job& job)
+			{
+				const s64 bottom{ m_bottom.load(std::memory_order_relaxed) };
+				const s64 top{ m_top.load(std::memory_order_acquire) };
+				if (bottom - top >= (s64)capacity) return false;
+
+				Slot& slot{ m_slots[bottom & (capacity - 1)] };
+				slot.function.store(job.function, std::memory_order_relaxed);
+				slot.data.store(job.data, std::memory_order_relaxed);
+				slot.counter.store(job.counter, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			// Owner thread only
+			bool Pop(Job& job)
+			{
+				const s64 bottom{ m_bottom.load(std::memory_order_relaxed) - 1 };
+				m_bottom.store(bottom, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				s64 top{ m_top.load(std::memory_order_relaxed) };
+
+				if (top > bottom)
+				{
+					// Deque was empty
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+					return false;
+				}
+
+				Read(bottom, job);
+				if (top == bottom)
+				{
+					// Last item, race against thieves for it
+					const bool won{ m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed) };
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+					return won;
+				}
+
+				return true;
+			}
+
+			// Any thread
+			bool Steal(Job& job)
+			{
+				s64 top{ m_top.load(std::memory_order_acquire) };
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const s64 bottom{ m_bottom.load(std::memory_order_acquire) };
+				if (top >= bottom) return false;
+
+				Read(top, job);
+				return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			}
+
+		private:
+			// Slots are made of relaxed atomics so a thief reading a slot that the owner is
+			// writing isn't a data race. The CAS on m_top decides whether the read was valid.
+			struct Slot
+			{
+				std::atomic<job_function>	function{ nullptr };
+				std::atomic<void*>			data{ nullptr };
+				std::atomic<JobCounter*>	counter{ nullptr };
+			};
+
+			void Read(s64 index, Job& job) const
+			{
+				const Slot& slot{ m_slots[index & (capacity - 1)] };
+				job.function = slot.function.load(std::memory_order_relaxed);
+				job.data = slot.data.load(std::memory_order_relaxed);
+				job.counter = slot.counter.load(std::memory_order_relaxed);
+			}
+
+			alignas(64) std::atomic<s64>	m_top{ 0 };
+			alignas(64) std::atomic<s64>	m_bottom{ 0 };
+			Slot							m_slots[capacity]{};
+		};
+
+		struct Worker
+		{
+			WorkStealingDeque	deque{};
+			std::thread			thread{};
+			u32					randomState{ 0 };
+		};
+
+		constexpr u32 invalidWorker{ U32_INVALID_ID };
+
+		std::unique_ptr<Worker[]>	workers{};
+		Memory::Allocation			workersMemory{};
+		u32							workerCount{ 0 };
+		std::atomic<bool>			isRunning{ false };
+
+		// Jobs submitted from threads that aren't workers go here
+		Utils::deque<Job>			injectedJobs{};
+		std::mutex					injectedJobsMutex{};
+		std::atomic<u32>			injectedJobCount{ 0 };
+
+		std::mutex					sleepMutex{};
+		std::condition_variable		sleepCondition{};
+		std::atomic<u32>			sleepingWorkers{ 0 };
+
+		thread_local u32			currentWorker{ invalidWorker };
+
+		u32 NextRandom(u32& state)
+		{
+			// xorshift32
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		void PinThread(std::thread& thread, u32 core)
+		{
+#if defined (__linux__)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(core, &set);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &set);
+#elif defined (_WIN64)
+			SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{ 1 } << core);
+#endif
+		}
+
+		void PinCurrentThread(u32 core)
+		{
+#if defined (__linux__)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(core, &set);
+			pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+#elif defined (_WIN64)
+			SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << core);
+#endif
+		}
+
+		void WakeWorkers(u32 jobCount)
+		{
+			if (sleepingWorkers.load(std::memory_order_acquire) == 0) return;
+			if (jobCount == 1) sleepCondition.notify_one();
+			else sleepCondition.notify_all();
+		}
+
+		void Submit(const Job& job)
+		{
+			if (currentWorker != invalidWorker && workers[currentWorker].deque.Push(job)) return;
+
+			if (currentWorker != invalidWorker)
+			{
+				// Our deque is full. Run the job now rather than queuing without bound.
+				job.function(job.data);
+				if (job.counter) Detail::Decrement(*job.counter);
+				return;
+			}
+
+			std::lock_guard lock{ injectedJobsMutex };
+			injectedJobs.push_back(job);
+			injectedJobCount.fetch_add(1, std::memory_order_release);
+		}
+
+		bool FindJob(Job& job)
+		{
+			const u32 self{ currentWorker };
+			if (self != invalidWorker && workers[self].deque.Pop(job)) return true;
+
+			if (injectedJobCount.load(std::memory_order_acquire))
+			{
+				std::lock_guard lock{ injectedJobsMutex };
+				if (!injectedJobs.empty())
+				{
+					job = injectedJobs.front();
+					injectedJobs.pop_front();
+					injectedJobCount.fetch_sub(1, std::memory_order_release);
+					return true;
+				}
+			}
+
+			// Start stealing at a random victim so thieves don't all hit the same deque
+			u32 random{ self != invalidWorker ? NextRandom(workers[self].randomState) : 0 };
+			for (u32 i{ 0 }; i < workerCount; i++)
+			{
+				const u32 victim{ (random + i) % workerCount };
+				if (victim != self && workers[victim].deque.Steal(job)) return true;
+			}
+
+			return false;
+		}
+
+		void Execute(const Job& job)
+		{
+			assert(job.function);
+			job.function(job.data);
+			if (job.counter) Detail::Decrement(*job.counter);
+		}
+
+		void WorkerLoop(u32 index)
+		{
+			PROFILE_THREAD("Job worker");
+			currentWorker = index;
+
+			while (isRunning.load(std::memory_order_acquire))
+			{
+				Job job;
+				if (FindJob(job))
+				{
+					Execute(job);
+					continue;
+				}
+
+				// Nothing to do. Sleep until new work is submitted. The timeout covers the
+				// (rare) case where a job was pushed right before we registered as sleeping.
+				std::unique_lock lock{ sleepMutex };
+				sleepingWorkers.fetch_add(1, std::memory_order_acq_rel);
+				sleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+				sleepingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+			}
+
+			currentWorker = invalidWorker;
+		}
+	} // anonymous namespace
+
+	u32 JobCounter::Lock()
+	{
+		u32 state{ m_state.load(std::memory_order_relaxed) };
+		while (true)
+		{
+			if (state & lockBit)
+			{
+				std::this_thread::yield();
+				state = m_state.load(std::memory_order_relaxed);
+			}
+			else if (m_state.compare_exchange_weak(state, state | lockBit, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				return state | lockBit;
+			}
+		}
+	}
+
+	void JobCounter::Unlock()
+	{
+		m_state.fetch_and(countMask, std::memory_order_release);
+	}
+
+	namespace Detail
+	{
+		void Increment(JobCounter& counter, u32 count)
+		{
+			[[maybe_unused]] const u32 previous{ counter.m_state.fetch_add(count, std::memory_order_acq_rel) };
+			assert(((previous & JobCounter::countMask) + count) <= JobCounter::countMask);
+		}
+
+		void Decrement(JobCounter& counter)
+		{
+			// Not the last job, the continuations can stay where they are
+			u32 state{ counter.m_state.load(std::memory_order_relaxed) };
+			while ((state & JobCounter::countMask) > 1)
+			{
+				if (counter.m_state.compare_exchange_weak(state, state - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) return;
+			}
+
+			// Probably the last job. Take the continuations out while holding the lock and
+			// publish zero together with the unlock, unless jobs were added in the meantime.
+			Job continuations[JobCounter::maxContinuations];
+			u32 count{ 0 };
+			state = counter.Lock();
+			while (true)
+			{
+				assert(state & JobCounter::countMask);
+				if ((state & JobCounter::countMask) > 1)
+				{
+					if (counter.m_state.compare_exchange_weak(state, (state - 1) & JobCounter::countMask,
+															  std::memory_order_acq_rel, std::memory_order_relaxed)) return;
+					continue;
+				}
+
+				count = counter.m_continuationCount;
+				for (u32 i{ 0 }; i < count; i++)
+					continuations[i] = counter.m_continuations[i];
+				counter.m_continuationCount = 0;
+				if (counter.m_state.compare_exchange_strong(state, 0, std::memory_order_acq_rel, std::memory_order_relaxed)) break;
+				counter.m_continuationCount = count;
+			}
+
+			// Counter reached zero and may be gone already, release the jobs that were waiting on it
+			for (u32 i{ 0 }; i < count; i++)
+				Submit(continuations[i]);
+			if (count) WakeWorkers(count);
+		}
+
+		void AddContinuation(JobCounter& counter, const Job& job)
+		{
+			if (counter.Lock() & JobCounter::countMask)
+			{
+				assert(counter.m_continuationCount < JobCounter::maxContinuations);
+				counter.m_continuations[counter.m_continuationCount++] = job;
+				counter.Unlock();
+				return;
+			}
+			counter.Unlock();
+
+			// Dependency is already satisfied
+			Submit(job);
+			WakeWorkers(1);
+		}
+	} // Detail namespace
+
+	/// <summary>
+	/// Start the worker threads. The calling thread becomes worker 0 and helps
+	/// execute jobs while it waits on a counter.
+	/// </summary>
+	/// <param name="initInfo"> - Worker count and affinity options. Defaults to one worker per core.</param>
+	/// <returns>True if the job system is running.</returns>
+	bool Initialize(const JobSystemInitInfo* const initInfo /*= nullptr*/)
+	{
+		if (isRunning) Shutdown();
+
+		const u32 hardwareThreads{ std::max(std::thread::hardware_concurrency(), 1u) };
+		workerCount = (initInfo && initInfo->workerCount) ? initInfo->workerCount : hardwareThreads;
+		const bool pinThreads{ initInfo && initInfo->pinThreads };
+
+		workers = std::make_unique<Worker[]>(workerCount);
+		workersMemory = Memory::Track(Memory::Tag::Jobs, sizeof(Worker) * workerCount);
+		isRunning.store(true, std::memory_order_release);
+
+		currentWorker = 0;
+		workers[0].randomState = 0x9e3779b9u;
+		if (pinThreads) PinCurrentThread(0);
+
+		for (u32 i{ 1 }; i < workerCount; i++)
+		{
+			Worker& worker{ workers[i] };
+			worker.randomState = 0x9e3779b9u * (i + 1);
+			worker.thread = std::thread{ WorkerLoop, i };
+			if (pinThreads) PinThread(worker.thread, i % hardwareThreads);
+		}
+
+		return true;
+	}
+
+	void Shutdown()
+	{
+		if (!isRunning) return;
+		assert(currentWorker == 0);
+
+		isRunning.store(false, std::memory_order_release);
+		sleepCondition.notify_all();
+
+		for (u32 i{ 1 }; i < workerCount; i++)
+			workers[i].thread.join();
+
+		Memory::Untrack(workersMemory);
+		workers.reset();
+		workerCount = 0;
+		currentWorker = invalidWorker;
+
+		std::lock_guard lock{ injectedJobsMutex };
+		assert(injectedJobs.empty());
+		injectedJobs.clear();
+		injectedJobCount = 0;
+	}
+
+	void Run(job_function function, void* data, JobCounter* counter /*= nullptr*/)
+	{
+		assert(isRunning && function);
+		if (counter) Detail::Increment(*counter, 1);
+		Submit(Job{ function, data, counter });
+		WakeWorkers(1);
+	}
+
+	void Run(const Job* const jobs, u32 count, JobCounter* counter /*= nullptr*/)
+	{
+		assert(isRunning && jobs);
+		if (!count) return;
+		if (counter) Detail::Increment(*counter, count);
+
+		for (u32 i{ 0 }; i < count; i++)
+		{
+			assert(jobs[i].function);
+			Submit(Job{ jobs[i].function, jobs[i].data, counter });
+		}
+
+		WakeWorkers(count);
+	}
+
+	// Run a job once "dependency" reaches zero. "counter" is incremented right away,
+	// so waiting on it also waits for the dependency.
+	void RunAfter(JobCounter& dependency, job_function function, void* data, JobCounter* counter /*= nullptr*/)
+	{
+		assert(isRunning && function);
+		if (counter) Detail::Increment(*counter, 1);
+		Detail::AddContinuation(dependency, Job{ function, data, counter });
+	}
+
+	// Block until the counter reaches zero. Workers (and the main thread) execute
+	// other jobs while waiting instead of idling.
+	void Wait(JobCounter& counter)
+	{
+		while (!counter.IsDone())
+		{
+			Job job;
+			if (FindJob(job)) Execute(job);
+			else std::this_thread::yield();
+		}
+	}
+
+	u32 WorkerCount()
+	{
+		return workerCount;
+	}
+
+	// Index of the calling worker, or U32_INVALID_ID for threads that aren't part of the job system.
+	u32 CurrentWorkerIndex()
+	{
+		return currentWorker;
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "CommonHeaders.h"
+#include <atomic>
+#include <algorithm>
+
+namespace Havana::Jobs
+{
+	using job_function = void(*)(void*);
+
+	class JobCounter;
+
+	struct Job
+	{
+		job_function	function{ nullptr };
+		void*			data{ nullptr };
+		JobCounter*		counter{ nullptr };
+	};
+
+	namespace Detail
+	{
+		void Increment(JobCounter& counter, u32 count);
+		void Decrement(JobCounter& counter);
+		void AddContinuation(JobCounter& counter, const Job& job);
+	}
+
+	// Tracks the number of unfinished jobs in a group. Jobs can be scheduled to run
+	// once a counter reaches zero (see RunAfter), which is how dependencies between
+	// job groups are expressed.
+	class JobCounter
+	{
+	public:
+		constexpr static u32 maxContinuations{ 16 };
+
+		JobCounter() = default;
+		DISABLE_COPY_AND_MOVE(JobCounter);
+		~JobCounter() { assert(IsDone()); }
+
+		bool IsDone() const { return Count() == 0; }
+		u32 Count() const { return m_state.load(std::memory_order_acquire) & countMask; }
+
+	private:
+		friend void Detail::Increment(JobCounter&, u32);
+		friend void Detail::Decrement(JobCounter&);
+		friend void Detail::AddContinuation(JobCounter&, const Job&);
+
+		// The lock of the continuations is the top bit of the count, so the last Decrement
+		// releases it and publishes zero in one atomic operation. The owner may destroy the
+		// counter as soon as it reads zero, nothing touches the counter after that.
+		constexpr static u32 lockBit{ 1u << 31 };
+		constexpr static u32 countMask{ lockBit - 1 };
+
+		u32 Lock();		// returns the state, with lockBit set
+		void Unlock();
+
+		std::atomic<u32>	m_state{ 0 };
+		u32					m_continuationCount{ 0 };
+		Job					m_continuations[maxContinuations]{};
+	};
+
+	struct JobSystemInitInfo
+	{
+		u32		workerCount{ 0 };	// 0 means one worker per hardware thread
+		bool	pinThreads{ false };	// pin worker i to core i
+	};
+
+	// Implemented in JobSystem.cpp
+	bool Initialize(const JobSystemInitInfo* const initInfo = nullptr);
+	void Shutdown();
+
+	void Run(job_function function, void* data, JobCounter* counter = nullptr);
+	void Run(const Job* const jobs, u32 count, JobCounter* counter = nullptr);
+	void RunAfter(JobCounter& dependency, job_function function, void* data, JobCounter* counter = nullptr);
+	void Wait(JobCounter& counter);
+
+	u32 WorkerCount();
+	u32 CurrentWorkerIndex();
+
+	namespace Detail
+	{
+		template<typename F>
+		struct ParallelForData
+		{
+			F*	function;
+			u32	count;
+			u32	batchSize;
+		};
+
+		template<typename F>
+		struct ParallelForBatch
+		{
+			ParallelForData<F>*	data;
+			u32					begin;
+		};
+	}
+
+	/// <summary>
+	/// Split [0, count) into batches and process them on all workers. Returns when every batch is done.
+	/// </summary>
+	/// <param name="count"> - Number of items.</param>
+	/// <param name="batchSize"> - Number of items per job.</param>
+	/// <param name="function"> - Called as function(begin, end) for each batch.</param>
+	template<typename F>
+	void ParallelFor(u32 count, u32 batchSize, F&& function)
+	{
+		if (!count) return;
+		assert(batchSize);
+
+		// Everything lives on this stack frame, which is safe because we wait for all batches below.
+		constexpr u32 maxBatchesPerRound{ 256 };
+		Detail::ParallelForData<std::remove_reference_t<F>> data{ &function, count, batchSize };
+		Detail::ParallelForBatch<std::remove_reference_t<F>> batches[maxBatchesPerRound];
+		Job jobs[maxBatchesPerRound];
+
+		const u32 batchCount{ (count + batchSize - 1) / batchSize };
+		for (u32 first{ 0 }; first < batchCount; first += maxBatchesPerRound)
+		{
+			const u32 roundCount{ std::min(batchCount - first, maxBatchesPerRound) };
+			JobCounter counter;
+			for (u32 i{ 0 }; i < roundCount; i++)
+			{
+				batches[i] = { &data, (first + i) * batchSize };
+				jobs[i].function = [](void* p)
+				{
+					const auto* const batch{ (const Detail::ParallelForBatch<std::remove_reference_t<F>>*)p };
+					const u32 end{ std::min(batch->begin + batch->data->batchSize, batch->data->count) };
+					(*batch->data->function)(batch->begin, end);
+				};
+				jobs[i].data = &batches[i];
+			}
+
+			Run(&jobs[0], roundCount, &counter);
+			Wait(counter);
+		}
+	}
+}
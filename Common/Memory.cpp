@@ -0,0 +1,324 @@
+#include "CommonHeaders.h"
+#include "AllocationGuard.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Havana::Memory
+{
+	namespace
+	{
+		constexpr u32 tagCount{ (u32)Tag::count };
+		constexpr const char* tagNames[tagCount]{ "General", "Platform", "Graphics", "Content", "Jobs", "Profiler" };
+		constexpr f32 rateInterval{ 1.0f };	// seconds
+		constexpr f64 megabyte{ 1024.0 * 1024.0 };
+
+		using clock = std::chrono::steady_clock;
+
+		// Updated by any thread that allocates
+		struct alignas(64) TagCounters
+		{
+			std::atomic<u64>	liveBytes{ 0 };
+			std::atomic<u64>	peakBytes{ 0 };
+			std::atomic<u64>	budgetBytes{ 0 };
+			std::atomic<u64>	totalAllocations{ 0 };
+			std::atomic<u64>	totalBytes{ 0 };
+			std::atomic<u64>	frameAllocations{ 0 };
+			std::atomic<u64>	frameBytes{ 0 };
+		};
+
+		// Written by EndFrame(), the atomics are read by GetStats()
+		struct FrameCounters
+		{
+			std::atomic<u64>	frameBytes{ 0 };
+			std::atomic<u32>	frameAllocations{ 0 };
+			std::atomic<u32>	peakFrameAllocations{ 0 };
+			std::atomic<f32>	allocationsPerSecond{ 0.0f };
+			std::atomic<f32>	bytesPerSecond{ 0.0f };
+			u64					rateAllocations{ 0 };	// totals when the rate was last computed
+			u64					rateBytes{ 0 };
+			bool				isOverBudget{ false };
+		};
+
+		// Placed right before the memory returned by Allocate()
+		struct alignas(16) Header
+		{
+			void*		memory;	// as returned by malloc()
+			Allocation	allocation;
+		};
+
+		TagCounters			counters[tagCount]{};
+		FrameCounters		frames[tagCount]{};
+		clock::time_point	rateStart{};
+		clock::time_point	lastReport{};
+		f32					reportInterval{ 0.0f };
+
+#ifdef _DEBUG
+		constexpr u32 maxCallsites{ 1024 };	// must be a power of 2
+		constexpr u32 reportedCallsites{ 10 };
+
+		struct CallsiteInfo
+		{
+			const char*	file;
+			u32			line;
+			Tag			tag;
+			u64			liveBytes;
+			u64			allocations;	// live ones
+		};
+
+		// Open addressing on line and tag. The same __FILE__ can have different addresses
+		// in different translation units, so file names are compared as strings.
+		CallsiteInfo	callsites[maxCallsites]{};
+		std::mutex		callsiteMutex{};
+
+		u32 AddCallsite(Tag tag, Callsite callsite, u64 size)
+		{
+			if (!callsite.file) return U32_INVALID_ID;
+			u32 index{ (callsite.line * 0x9e37'79b9u) ^ ((u32)tag << 24) };
+			std::lock_guard lock{ callsiteMutex };
+			for (u32 i{ 0 }; i < maxCallsites; i++, index++)
+			{
+				CallsiteInfo& info{ callsites[index & (maxCallsites - 1)] };
+				if (!info.file)
+				{
+					info.file = callsite.file;
+					info.line = callsite.line;
+					info.tag = tag;
+				}
+				else if (info.line != callsite.line || info.tag != tag || strcmp(info.file, callsite.file))
+				{
+					continue;
+				}
+
+				info.liveBytes += size;
+				info.allocations++;
+				return index & (maxCallsites - 1);
+			}
+			return U32_INVALID_ID;	// table is full, only the tag is tracked
+		}
+
+		void RemoveCallsite(const Allocation& allocation)
+		{
+			if (allocation.callsite == U32_INVALID_ID) return;
+			std::lock_guard lock{ callsiteMutex };
+			CallsiteInfo& info{ callsites[allocation.callsite] };
+			assert(info.liveBytes >= allocation.size && info.allocations);
+			info.liveBytes -= allocation.size;
+			info.allocations--;
+		}
+#endif // _DEBUG
+
+		// Appends to the report; length keeps counting when the buffer is full, like snprintf
+		void Append(char* const buffer, u32 size, u32& length, const char* format, ...)
+		{
+			va_list args;
+			va_start(args, format);
+			const u32 offset{ std::min(length, size) };
+			const s32 written{ vsnprintf(buffer ? buffer + offset : nullptr, size - offset, format, args) };
+			va_end(args);
+			if (written > 0) length += (u32)written;
+		}
+	} // anonymous namespace
+
+	const char* TagName(Tag tag)
+	{
+		assert(tag < Tag::count);
+		return tagNames[(u32)tag];
+	}
+
+	Allocation Track(Tag tag, u64 size, [[maybe_unused]] Callsite callsite)
+	{
+		assert(tag < Tag::count);
+		TagCounters& tagCounters{ counters[(u32)tag] };
+		const u64 live{ tagCounters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size };
+		u64 peak{ tagCounters.peakBytes.load(std::memory_order_relaxed) };
+		while (live > peak && !tagCounters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+		tagCounters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+		tagCounters.totalBytes.fetch_add(size, std::memory_order_relaxed);
+		tagCounters.frameAllocations.fetch_add(1, std::memory_order_relaxed);
+		tagCounters.frameBytes.fetch_add(size, std::memory_order_relaxed);
+
+		Allocation allocation{ size, tag };
+		DEBUG_OP(allocation.callsite = AddCallsite(tag, callsite, size));
+		return allocation;
+	}
+
+	void Untrack(const Allocation& allocation)
+	{
+		assert(allocation.tag < Tag::count);
+		[[maybe_unused]] const u64 live{ counters[(u32)allocation.tag].liveBytes.fetch_sub(allocation.size, std::memory_order_relaxed) };
+		assert(live >= allocation.size);
+		DEBUG_OP(RemoveCallsite(allocation));
+	}
+
+	void* Allocate(Tag tag, u64 size, u32 alignment, Callsite callsite)
+	{
+		assert(alignment && !(alignment & (alignment - 1)));
+		alignment = std::max(alignment, (u32)alignof(Header));
+		void* const memory{ malloc(size + sizeof(Header) + alignment - 1) };
+		if (!memory) return nullptr;
+
+		const uintptr_t address{ (reinterpret_cast<uintptr_t>(memory) + sizeof(Header) + alignment - 1) & ~(uintptr_t)(alignment - 1) };
+		Header* const header{ reinterpret_cast<Header*>(address) - 1 };
+		header->memory = memory;
+		header->allocation = Track(tag, size, callsite);
+		return reinterpret_cast<void*>(address);
+	}
+
+	void Free(void* memory)
+	{
+		if (!memory) return;
+		Header* const header{ static_cast<Header*>(memory) - 1 };
+		Untrack(header->allocation);
+		free(header->memory);
+	}
+
+	void EndFrame()
+	{
+		Detail::EndGuardedFrame();
+		const clock::time_point now{ clock::now() };
+		if (rateStart == clock::time_point{}) rateStart = now;
+		const f32 rateSeconds{ std::chrono::duration<f32>(now - rateStart).count() };
+		const bool isRateDue{ rateSeconds >= rateInterval };
+
+		for (u32 i{ 0 }; i < tagCount; i++)
+		{
+			TagCounters& tagCounters{ counters[i] };
+			FrameCounters& frame{ frames[i] };
+
+			const u64 allocations{ tagCounters.frameAllocations.exchange(0, std::memory_order_relaxed) };
+			const u32 frameAllocations{ (u32)std::min(allocations, (u64)U32_INVALID_ID) };
+			frame.frameAllocations.store(frameAllocations, std::memory_order_relaxed);
+			frame.frameBytes.store(tagCounters.frameBytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+			if (frameAllocations > frame.peakFrameAllocations.load(std::memory_order_relaxed))
+				frame.peakFrameAllocations.store(frameAllocations, std::memory_order_relaxed);
+
+			if (isRateDue)
+			{
+				const u64 totalAllocations{ tagCounters.totalAllocations.load(std::memory_order_relaxed) };
+				const u64 totalBytes{ tagCounters.totalBytes.load(std::memory_order_relaxed) };
+				frame.allocationsPerSecond.store((f32)(totalAllocations - frame.rateAllocations) / rateSeconds, std::memory_order_relaxed);
+				frame.bytesPerSecond.store((f32)(totalBytes - frame.rateBytes) / rateSeconds, std::memory_order_relaxed);
+				frame.rateAllocations = totalAllocations;
+				frame.rateBytes = totalBytes;
+			}
+
+			// Warn once each time the tag goes over its budget
+			const u64 budget{ tagCounters.budgetBytes.load(std::memory_order_relaxed) };
+			const u64 live{ tagCounters.liveBytes.load(std::memory_order_relaxed) };
+			const bool isOverBudget{ budget && live > budget };
+			if (isOverBudget && !frame.isOverBudget)
+				printf("Memory: %s is over its budget (%.2f MB of %.2f MB)\n", tagNames[i], live / megabyte, budget / megabyte);
+			frame.isOverBudget = isOverBudget;
+		}
+
+		if (isRateDue) rateStart = now;
+		if (reportInterval > 0.0f && std::chrono::duration<f32>(now - lastReport).count() >= reportInterval)
+		{
+			LogReport();
+			lastReport = now;
+		}
+		Detail::BeginGuardedFrame();
+	}
+
+	TagStats GetStats(Tag tag)
+	{
+		assert(tag < Tag::count);
+		const TagCounters& tagCounters{ counters[(u32)tag] };
+		const FrameCounters& frame{ frames[(u32)tag] };
+		TagStats stats{};
+		stats.liveBytes = tagCounters.liveBytes.load(std::memory_order_relaxed);
+		stats.peakBytes = tagCounters.peakBytes.load(std::memory_order_relaxed);
+		stats.budgetBytes = tagCounters.budgetBytes.load(std::memory_order_relaxed);
+		stats.totalAllocations = tagCounters.totalAllocations.load(std::memory_order_relaxed);
+		stats.totalBytes = tagCounters.totalBytes.load(std::memory_order_relaxed);
+		stats.frameBytes = frame.frameBytes.load(std::memory_order_relaxed);
+		stats.frameAllocations = frame.frameAllocations.load(std::memory_order_relaxed);
+		stats.peakFrameAllocations = frame.peakFrameAllocations.load(std::memory_order_relaxed);
+		stats.allocationsPerSecond = frame.allocationsPerSecond.load(std::memory_order_relaxed);
+		stats.bytesPerSecond = frame.bytesPerSecond.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	void SetBudget(Tag tag, u64 bytes)
+	{
+		assert(tag < Tag::count);
+		counters[(u32)tag].budgetBytes.store(bytes, std::memory_order_relaxed);
+	}
+
+	u32 WriteReport(char* const buffer, u32 size)
+	{
+		assert(buffer || !size);
+		TagStats stats[tagCount];
+		u64 liveBytes{ 0 };
+		for (u32 i{ 0 }; i < tagCount; i++)
+		{
+			stats[i] = GetStats((Tag)i);
+			liveBytes += stats[i].liveBytes;
+		}
+
+		u32 length{ 0 };
+		Append(buffer, size, length, "Memory: %.2f MB live\n", liveBytes / megabyte);
+		Append(buffer, size, length, "%-10s %10s %10s %10s %8s %8s %10s %10s %10s\n",
+			"tag", "live MB", "peak MB", "budget MB", "% live", "allocs", "KB/frame", "allocs/s", "MB/s");
+		for (u32 i{ 0 }; i < tagCount; i++)
+		{
+			const TagStats& tag{ stats[i] };
+			char budget[32]{ "-" };
+			if (tag.budgetBytes) snprintf(budget, sizeof(budget), "%.2f%s", tag.budgetBytes / megabyte, tag.liveBytes > tag.budgetBytes ? "!" : "");
+			Append(buffer, size, length, "%-10s %10.2f %10.2f %10s %7.1f%% %8u %10.1f %10.1f %10.2f\n",
+				tagNames[i], tag.liveBytes / megabyte, tag.peakBytes / megabyte, budget,
+				liveBytes ? 100.0 * tag.liveBytes / liveBytes : 0.0, tag.frameAllocations, tag.frameBytes / 1024.0,
+				tag.allocationsPerSecond, tag.bytesPerSecond / megabyte);
+		}
+
+#ifdef _DEBUG
+		CallsiteInfo largest[reportedCallsites]{};
+		u32 count{ 0 };
+		{
+			std::lock_guard lock{ callsiteMutex };
+			for (const CallsiteInfo& info : callsites)
+			{
+				if (!info.liveBytes) continue;
+				if (count < reportedCallsites) largest[count++] = info;
+				else if (info.liveBytes > largest[count - 1].liveBytes) largest[count - 1] = info;
+				else continue;
+
+				// Keep largest sorted, the new entry is the last one
+				for (u32 j{ count - 1 }; j && largest[j].liveBytes > largest[j - 1].liveBytes; j--)
+					std::swap(largest[j], largest[j - 1]);
+			}
+		}
+
+		if (count) Append(buffer, size, length, "Callsites with the most live memory:\n");
+		for (u32 i{ 0 }; i < count; i++)
+		{
+			const CallsiteInfo& info{ largest[i] };
+			Append(buffer, size, length, "  %-10s %10.2f MB in %llu allocations  %s:%u\n",
+				tagNames[(u32)info.tag], info.liveBytes / megabyte, (unsigned long long)info.allocations, info.file, info.line);
+		}
+#endif // _DEBUG
+
+		return length;
+	}
+
+	void LogReport()
+	{
+		char report[4096];
+		const u32 length{ WriteReport(&report[0], sizeof(report)) };
+		fputs(report, stdout);
+		if (length >= sizeof(report)) fputs("...\n", stdout);
+	}
+
+	void SetReportInterval(f32 seconds)
+	{
+		assert(seconds >= 0.0f);
+		reportInterval = seconds;
+		lastReport = clock::now();
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "PrimitiveTypes.h"
+#include <new>
+
+// Memory tracking by subsystem. Engine allocators (ObjectPool, IndexPool, FrameArena,
+// command lists, ...) take a tag and report the memory they hold to it, so the totals of
+// a tag are what that subsystem costs. Each tag counts live and peak bytes, allocation
+// rate and allocations per frame; a tag can have a budget, and a warning is logged when
+// it goes over. GetStats() and WriteReport() can be used at any time, and a report can be
+// logged periodically with SetReportInterval().
+//
+// _DEBUG builds also record the callsite of each allocation (the code that created the
+// pool or called Allocate()), and reports list the callsites that hold the most memory.
+//
+// Counters are updated with relaxed atomics, so tracking is compiled into every build.
+// Frames are counted by EndFrame(), which Graphics::RenderFrame() calls.
+
+// As a default argument this is the callsite of the caller, not of the declaration
+#define MEMORY_CALLSITE Havana::Memory::Callsite::Current()
+
+namespace Havana::Memory
+{
+	enum class Tag : u32
+	{
+		General,
+		Platform,
+		Graphics,
+		Content,
+		Jobs,
+		Profiler,
+
+		count
+	};
+
+	struct Callsite
+	{
+		const char*	file{ nullptr };
+		u32			line{ 0 };
+
+		// The builtins only give the caller's location when they are default arguments themselves
+		constexpr static Callsite Current(const char* file = __builtin_FILE(), u32 line = __builtin_LINE())
+		{
+			return { file, line };
+		}
+	};
+
+	// Handed out by Track() and kept by the owner of the memory until it calls Untrack()
+	struct Allocation
+	{
+		u64		size{ 0 };
+		Tag		tag{ Tag::General };
+		u32		callsite{ U32_INVALID_ID };
+	};
+
+	struct TagStats
+	{
+		u64		liveBytes;
+		u64		peakBytes;
+		u64		budgetBytes;			// 0 if the tag has no budget
+		u64		totalAllocations;
+		u64		totalBytes;
+		u64		frameBytes;				// allocated in the last frame
+		u32		frameAllocations;		// in the last frame
+		u32		peakFrameAllocations;
+		f32		allocationsPerSecond;	// averaged over the last second or so
+		f32		bytesPerSecond;
+	};
+
+	const char* TagName(Tag tag);
+
+	// For memory the caller allocates itself. Frees must pass the Allocation that was returned.
+	[[nodiscard]] Allocation Track(Tag tag, u64 size, Callsite callsite = MEMORY_CALLSITE);
+	void Untrack(const Allocation& allocation);
+
+	/// <summary>
+	/// Allocates tracked heap memory.
+	/// </summary>
+	/// <param name="alignment"> - Power of 2.</param>
+	/// <returns>The memory, or nullptr if the allocation failed.</returns>
+	[[nodiscard]] void* Allocate(Tag tag, u64 size, u32 alignment = 16, Callsite callsite = MEMORY_CALLSITE);
+	// Frees memory from Allocate(). Nullptr is ignored.
+	void Free(void* memory);
+
+	// Closes the per-frame counters and logs a report if one is due. Call once per frame.
+	void EndFrame();
+
+	TagStats GetStats(Tag tag);
+	void SetBudget(Tag tag, u64 bytes);
+
+	// Writes a human-readable report (like snprintf) and returns the length it needs
+	u32 WriteReport(char* const buffer, u32 size);
+	void LogReport();
+	// Logs a report every interval from EndFrame(), call it from the same thread. 0 turns
+	// periodic reports off.
+	void SetReportInterval(f32 seconds);
+
+	// STL allocator for containers that belong to a subsystem,
+	// e.g. std::vector<u32, TaggedAllocator<u32, Tag::Content>>
+	template<typename T, Tag tag>
+	class TaggedAllocator
+	{
+	public:
+		using value_type = T;
+		template<typename U>
+		struct rebind { using other = TaggedAllocator<U, tag>; };
+
+		constexpr TaggedAllocator() = default;
+		template<typename U>
+		constexpr TaggedAllocator(const TaggedAllocator<U, tag>&) {}
+
+		[[nodiscard]] T* allocate(size_t count)
+		{
+			void* const memory{ Allocate(tag, sizeof(T) * count, alignof(T) > 16 ? alignof(T) : 16) };
+			if (!memory) throw std::bad_alloc{};
+			return static_cast<T*>(memory);
+		}
+		void deallocate(T* memory, size_t) { Free(memory); }
+
+		template<typename U>
+		constexpr bool operator==(const TaggedAllocator<U, tag>&) const { return true; }
+		template<typename U>
+		constexpr bool operator!=(const TaggedAllocator<U, tag>&) const { return false; }
+	};
+}
@@ -15,9 +15,10 @@ using s8 = int8_t;
 
 // FLOATS
 using f32 = float;
+using f64 = double;
 
 // CONSTANTS
-constexpr u64 U64_INVALID_ID{ 0xffff'ffff'ffff'ffffui64 };
-constexpr u32 U32_INVALID_ID{ 0xffff'ffffui32 };
-constexpr u16 U16_INVALID_ID{ 0xffffui16 };
-constexpr u8 U8_INVALID_ID{ 0xffui8 };
\ No newline at end of file
+constexpr u64 U64_INVALID_ID{ 0xffff'ffff'ffff'ffffull };
+constexpr u32 U32_INVALID_ID{ 0xffff'ffffu };
+constexpr u16 U16_INVALID_ID{ (u16)0xffff };
+constexpr u8 U8_INVALID_ID{ (u8)0xff };
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "CommonHeaders.h"
+
+#ifdef USE_PROFILER
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+#if defined (__x86_64__) || defined (_M_X64)
+#if defined (_WIN64)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILER_USE_TSC 1
+#endif
+
+namespace Havana::Profiler
+{
+	namespace
+	{
+		static_assert((eventsPerThread & (eventsPerThread - 1)) == 0);
+
+		// Written only by the owning thread. The write index is the number of events
+		// recorded so far, the ring holds the last eventsPerThread of them.
+		struct ThreadBuffer
+		{
+			ProfileEvent				events[eventsPerThread]{};
+			std::atomic<u64>			writeIndex{ 0 };
+			std::atomic<const char*>	name{ nullptr };
+		};
+
+		// Buffers are never freed, so the events of threads that exited can still be exported
+		std::atomic<ThreadBuffer*>	threads[maxThreads]{};
+		std::atomic<u32>			threadCount{ 0 };
+		thread_local ThreadBuffer*	threadBuffer{ nullptr };
+		thread_local bool			isThreadRegistered{ false };
+
+		struct TimePoint
+		{
+			u64										ticks;
+			std::chrono::steady_clock::time_point	time;
+		};
+
+		TimePoint CurrentTime()
+		{
+			return { Now(), std::chrono::steady_clock::now() };
+		}
+
+		// Ticks are converted to microseconds by comparing against the steady clock over
+		// the whole run, which assumes an invariant TSC (any x86-64 CPU of the last decade)
+		const TimePoint startTime{ CurrentTime() };
+
+		ThreadBuffer* GetThreadBuffer()
+		{
+			if (isThreadRegistered) return threadBuffer;
+			isThreadRegistered = true;
+
+			const u32 index{ threadCount.fetch_add(1, std::memory_order_relaxed) };
+			if (index >= maxThreads) return nullptr;
+
+			threadBuffer = new ThreadBuffer{};
+			static_cast<void>(Memory::Track(Memory::Tag::Profiler, sizeof(ThreadBuffer)));	// never freed
+			threads[index].store(threadBuffer, std::memory_order_release);
+			return threadBuffer;
+		}
+
+		void WriteString(FILE* file, const char* text)
+		{
+			fputc('"', file);
+			for (const char* c{ text }; c && *c; c++)
+			{
+				if (*c == '"' || *c == '\\') fprintf(file, "\\%c", *c);
+				else if ((u8)*c < 0x20) fprintf(file, "\\u%04x", (u32)(u8)*c);
+				else fputc(*c, file);
+			}
+			fputc('"', file);
+		}
+
+		// Copy the events that are still in the ring. Events the owner overwrote (or may be
+		// overwriting) while we were copying are dropped, so the result is consistent.
+		u32 SnapshotEvents(const ThreadBuffer& buffer, Utils::vector<ProfileEvent>& events)
+		{
+			const u64 end{ buffer.writeIndex.load(std::memory_order_acquire) };
+			const u64 begin{ end > eventsPerThread ? end - eventsPerThread : 0 };
+			events.resize((size_t)(end - begin));
+			for (u64 i{ begin }; i < end; i++)
+				events[(size_t)(i - begin)] = buffer.events[i & (eventsPerThread - 1)];
+
+			const u64 written{ buffer.writeIndex.load(std::memory_order_acquire) };
+			const u64 firstValid{ written + 1 > eventsPerThread ? written + 1 - eventsPerThread : 0 };
+			if (firstValid > begin)
+			{
+				const size_t dropped{ (size_t)std::min(firstValid - begin, end - begin) };
+				events.erase(events.begin(), events.begin() + dropped);
+			}
+
+			return (u32)events.size();
+		}
+	} // anonymous namespace
+
+	u64 Now()
+	{
+#ifdef PROFILER_USE_TSC
+		return __rdtsc();
+#else
+		return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	void Record(const char* name, u64 begin, u64 end)
+	{
+		ThreadBuffer* const buffer{ GetThreadBuffer() };
+		if (!buffer) return;
+
+		const u64 index{ buffer->writeIndex.load(std::memory_order_relaxed) };
+		buffer->events[index & (eventsPerThread - 1)] = { name, begin, end };
+		buffer->writeIndex.store(index + 1, std::memory_order_release);
+	}
+
+	void SetThreadName(const char* name)
+	{
+		ThreadBuffer* const buffer{ GetThreadBuffer() };
+		if (buffer) buffer->name.store(name, std::memory_order_release);
+	}
+
+	bool ExportChromeTrace(const char* path)
+	{
+		assert(path);
+		FILE* const file{ fopen(path, "wb") };
+		if (!file) return false;
+
+		const TimePoint now{ CurrentTime() };
+		const double elapsedMicroseconds{ std::chrono::duration<double, std::micro>(now.time - startTime.time).count() };
+		const double ticksPerMicrosecond{ elapsedMicroseconds > 0.0 && now.ticks > startTime.ticks
+									   ? (double)(now.ticks - startTime.ticks) / elapsedMicroseconds : 1000.0 };
+
+		fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		bool isFirst{ true };
+		Utils::vector<ProfileEvent> events;
+
+		const u32 count{ std::min(threadCount.load(std::memory_order_acquire), maxThreads) };
+		for (u32 t{ 0 }; t < count; t++)
+		{
+			const ThreadBuffer* const buffer{ threads[t].load(std::memory_order_acquire) };
+			if (!buffer) continue;
+
+			const u32 tid{ t + 1 };
+			if (const char* const name{ buffer->name.load(std::memory_order_acquire) })
+			{
+				fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", isFirst ? "" : ",\n", tid);
+				WriteString(file, name);
+				fprintf(file, "}}");
+				isFirst = false;
+			}
+
+			SnapshotEvents(*buffer, events);
+			for (const ProfileEvent& event : events)
+			{
+				const double begin{ (double)(s64)(event.begin - startTime.ticks) / ticksPerMicrosecond };
+				const double duration{ (double)(event.end - event.begin) / ticksPerMicrosecond };
+				fprintf(file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":", isFirst ? "" : ",\n", tid, begin, duration);
+				WriteString(file, event.name);
+				fputc('}', file);
+				isFirst = false;
+			}
+		}
+
+		fprintf(file, "\n]}\n");
+		return fclose(file) == 0;
+	}
+}
+
+#endif // USE_PROFILER
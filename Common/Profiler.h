@@ -0,0 +1,68 @@
+#pragma once
+#include "PrimitiveTypes.h"
+
+// CPU scope profiler. A scope records one fixed-size event (name, begin and end time)
+// into a ring buffer owned by the calling thread, so recording takes no locks and never
+// allocates after the thread's first event. Rings keep the most recent events of each
+// thread; ExportChromeTrace() writes them as Chrome trace JSON, which chrome://tracing
+// and Perfetto can open.
+//
+// Profiling is compiled in for _DEBUG and _PROFILE builds. Otherwise the macros expand
+// to nothing, like DEBUG_OP.
+#if defined (_DEBUG) || defined (_PROFILE)
+#define USE_PROFILER 1
+#endif
+
+#ifdef USE_PROFILER
+
+namespace Havana::Profiler
+{
+	constexpr u32 eventsPerThread{ 32 * 1024 };	// must be a power of 2
+	constexpr u32 maxThreads{ 64 };
+
+	struct ProfileEvent
+	{
+		const char*	name;
+		u64			begin;
+		u64			end;
+	};
+
+	// Timestamps are in ticks, which are TSC cycles on x86-64 and nanoseconds elsewhere
+	u64 Now();
+
+	// Names must be string literals or otherwise stay valid until the trace is exported
+	void Record(const char* name, u64 begin, u64 end);
+	void SetThreadName(const char* name);
+
+	// Write the events in all threads' rings to a file. Can be called from any thread
+	// while the others keep recording; events that are overwritten during the export
+	// are left out.
+	bool ExportChromeTrace(const char* path);
+
+	class ProfileScope
+	{
+	public:
+		explicit ProfileScope(const char* name) : m_name{ name }, m_begin{ Now() } {}
+		~ProfileScope() { Record(m_name, m_begin, Now()); }
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		const char*	m_name;
+		u64			m_begin;
+	};
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) Havana::Profiler::ProfileScope PROFILE_CONCAT(profileScope, __LINE__){ name }
+#define PROFILE_THREAD(name) Havana::Profiler::SetThreadName(name)
+#define PROFILE_OP(x) x
+
+#else
+
+#define PROFILE_SCOPE(name) (void(0))
+#define PROFILE_THREAD(name) (void(0))
+#define PROFILE_OP(x) (void(0))
+
+#endif // USE_PROFILER
@@ -0,0 +1,268 @@
+#include "AssetPack.h"
+#include "../Utilities/ObjectPool.h"
+#include <string.h>
+
+#if defined (__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined (_WIN64)
+#ifndef WIN_32_LEAN_AND_MEAN
+#define WIN_32_LEAN_AND_MEAN
+#endif // WIN_32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+namespace Havana::Content
+{
+	namespace
+	{
+		struct PackInfo
+		{
+			const u8*				data{ nullptr };
+			u64						size{ 0 };
+			const Pack::AssetEntry*	entries{ nullptr };
+			u32						assetCount{ 0 };
+#if defined (_WIN64)
+			HANDLE					file{ INVALID_HANDLE_VALUE };
+			HANDLE					mapping{ nullptr };
+#endif
+		};
+
+		constexpr u32 maxPacks{ 64 };
+		Utils::ObjectPool<PackInfo, pack_id> packs{ maxPacks, Memory::Tag::Content };
+
+		const PackInfo& GetPack(pack_id id)
+		{
+			const PackInfo& pack{ packs.Get(id) };
+			assert(pack.data);
+			return pack;
+		}
+
+		// Ranges are checked as offset <= size && count <= (size - offset) / stride so corrupt
+		// values can't overflow into something that looks valid
+		constexpr bool FitsIn(u64 offset, u64 count, u64 stride, u64 size)
+		{
+			return offset <= size && count <= (size - offset) / stride;
+		}
+
+		bool IsValidMesh(const u8* const data, u64 size)
+		{
+			if (size < sizeof(Pack::MeshHeader)) return false;
+			const Pack::MeshHeader& header{ *(const Pack::MeshHeader*)data };
+			if (!FitsIn(header.vertexOffset, header.vertexCount, sizeof(Pack::MeshVertex), size) ||
+				!FitsIn(header.indexOffset, header.indexCount, sizeof(u32), size) ||
+				!header.lodCount || header.lodCount > Pack::maxLods) return false;
+
+			for (u32 i{ 0 }; i < header.lodCount; i++)
+			{
+				if (!FitsIn(header.lods[i].firstIndex, header.lods[i].indexCount, 1, header.indexCount)) return false;
+			}
+			return true;
+		}
+
+		bool IsValidTexture(const u8* const data, u64 size)
+		{
+			if (size < sizeof(Pack::TextureHeader)) return false;
+			const Pack::TextureHeader& header{ *(const Pack::TextureHeader*)data };
+			if (!header.mipCount || header.mipCount > Pack::maxMips) return false;
+
+			for (u32 i{ 0 }; i < header.mipCount; i++)
+			{
+				if (!FitsIn(header.mipOffsets[i], header.mipSizes[i], 1, size)) return false;
+			}
+			return true;
+		}
+
+		// Every entry is checked once when the pack is opened, so lookups and the views
+		// handed out later never read past the mapping, even for truncated or corrupt packs.
+		bool IsValidIndex(const PackInfo& info, u64 indexEnd)
+		{
+			for (u32 i{ 0 }; i < info.assetCount; i++)
+			{
+				const Pack::AssetEntry& entry{ info.entries[i] };
+				if (entry.offset < indexEnd || !FitsIn(entry.offset, entry.size, 1, info.size)) return false;
+				if (i > 0 && info.entries[i - 1].nameHash > entry.nameHash) return false;
+
+				const u8* const data{ info.data + entry.offset };
+				switch (entry.type)
+				{
+				case Pack::AssetType::Mesh: if (!IsValidMesh(data, entry.size)) return false; break;
+				case Pack::AssetType::Texture: if (!IsValidTexture(data, entry.size)) return false; break;
+				default: return false;
+				}
+			}
+			return true;
+		}
+
+		bool MapFile(const char* path, PackInfo& info)
+		{
+#if defined (__linux__)
+			const int file{ open(path, O_RDONLY | O_CLOEXEC) };
+			if (file < 0) return false;
+
+			struct stat status{};
+			if (fstat(file, &status) || status.st_size < (off_t)sizeof(Pack::PackHeader))
+			{
+				close(file);
+				return false;
+			}
+
+			// The mapping keeps its own reference to the file
+			void* const data{ mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0) };
+			close(file);
+			if (data == MAP_FAILED) return false;
+
+			info.data = (const u8*)data;
+			info.size = (u64)status.st_size;
+			return true;
+#elif defined (_WIN64)
+			info.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+			if (info.file == INVALID_HANDLE_VALUE) return false;
+
+			LARGE_INTEGER size{};
+			info.mapping = GetFileSizeEx(info.file, &size) ? CreateFileMappingA(info.file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+			info.data = info.mapping ? (const u8*)MapViewOfFile(info.mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			info.size = (u64)size.QuadPart;
+			return info.data != nullptr;
+#endif
+		}
+
+		void UnmapFile(PackInfo& info)
+		{
+#if defined (__linux__)
+			if (info.data) munmap((void*)info.data, (size_t)info.size);
+#elif defined (_WIN64)
+			if (info.data) UnmapViewOfFile(info.data);
+			if (info.mapping) CloseHandle(info.mapping);
+			if (info.file != INVALID_HANDLE_VALUE) CloseHandle(info.file);
+#endif
+			info = {};
+		}
+	} // anonymous namespace
+
+	/// <summary>
+	/// Map a cooked pack file and validate its header, index table and every asset in it.
+	/// </summary>
+	/// <param name="path"> - Path of the pack file.</param>
+	/// <returns>The id of the pack, or an invalid id if it couldn't be opened.</returns>
+	pack_id OpenPack(const char* path)
+	{
+		PROFILE_SCOPE("Content::OpenPack");
+		assert(path);
+		PackInfo info{};
+		if (!MapFile(path, info)) return pack_id{ Id::INVALID_ID };
+
+		const Pack::PackHeader& header{ *(const Pack::PackHeader*)info.data };
+		const u64 indexEnd{ sizeof(Pack::PackHeader) + (u64)header.assetCount * sizeof(Pack::AssetEntry) };
+		if (header.magic != Pack::magic || header.version != Pack::version ||
+			header.fileSize != info.size || indexEnd > info.size)
+		{
+			UnmapFile(info);
+			return pack_id{ Id::INVALID_ID };
+		}
+
+		info.entries = (const Pack::AssetEntry*)(info.data + sizeof(Pack::PackHeader));
+		info.assetCount = header.assetCount;
+		if (!IsValidIndex(info, indexEnd))
+		{
+			UnmapFile(info);
+			return pack_id{ Id::INVALID_ID };
+		}
+
+#if defined (__linux__)
+		// The index is read on every lookup, the data is read wherever the assets are
+		madvise((void*)info.data, (size_t)indexEnd, MADV_WILLNEED);
+		madvise((void*)info.data, (size_t)info.size, MADV_RANDOM);
+#endif
+
+		return packs.Add(info);
+	}
+
+	void ClosePack(pack_id id)
+	{
+		PROFILE_SCOPE("Content::ClosePack");
+		UnmapFile(packs.Get(id));
+		packs.Remove(id);
+	}
+
+	const Pack::AssetEntry* FindAsset(pack_id id, u64 nameHash)
+	{
+		const PackInfo& pack{ GetPack(id) };
+
+		// Entries are sorted by hash
+		u32 first{ 0 };
+		u32 count{ pack.assetCount };
+		while (count > 0)
+		{
+			const u32 step{ count / 2 };
+			if (pack.entries[first + step].nameHash < nameHash)
+			{
+				first += step + 1;
+				count -= step + 1;
+			}
+			else
+			{
+				count = step;
+			}
+		}
+
+		return first < pack.assetCount && pack.entries[first].nameHash == nameHash ? &pack.entries[first] : nullptr;
+	}
+
+	const u8* AssetData(pack_id id, const Pack::AssetEntry& entry)
+	{
+		const PackInfo& pack{ GetPack(id) };
+		assert(entry.offset + entry.size <= pack.size);
+		return pack.data + entry.offset;
+	}
+
+	MeshView GetMesh(pack_id id, const Pack::AssetEntry& entry)
+	{
+		assert(entry.type == Pack::AssetType::Mesh);
+		const u8* const data{ AssetData(id, entry) };
+		const Pack::MeshHeader* const header{ (const Pack::MeshHeader*)data };
+		assert(header->vertexOffset + (u64)header->vertexCount * sizeof(Pack::MeshVertex) <= entry.size);
+		assert(header->indexOffset + (u64)header->indexCount * sizeof(u32) <= entry.size);
+		assert(header->lodCount && header->lodCount <= Pack::maxLods);
+		assert(header->lods[header->lodCount - 1].firstIndex + (u64)header->lods[header->lodCount - 1].indexCount <= header->indexCount);
+
+		return { header, (const Pack::MeshVertex*)(data + header->vertexOffset), (const u32*)(data + header->indexOffset) };
+	}
+
+	TextureView GetTexture(pack_id id, const Pack::AssetEntry& entry)
+	{
+		assert(entry.type == Pack::AssetType::Texture);
+		const u8* const data{ AssetData(id, entry) };
+		assert(((const Pack::TextureHeader*)data)->mipCount <= Pack::maxMips);
+		return { (const Pack::TextureHeader*)data, data };
+	}
+
+	const u8* TextureMip(const TextureView& texture, u32 mip)
+	{
+		assert(texture.header && mip < texture.header->mipCount);
+		return texture.base + texture.header->mipOffsets[mip];
+	}
+
+	void Prefetch(pack_id id, const Pack::AssetEntry& entry)
+	{
+#if defined (__linux__)
+		// Assets are page aligned, so the range can be passed as is
+		madvise((void*)AssetData(id, entry), (size_t)entry.size, MADV_WILLNEED);
+#elif defined (_WIN64)
+		WIN32_MEMORY_RANGE_ENTRY range{ (void*)AssetData(id, entry), (SIZE_T)entry.size };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+	}
+
+	bool LoadTextureMip(void* userData, u32 mip, void* destination, u32 size)
+	{
+		const Pack::TextureHeader* const header{ (const Pack::TextureHeader*)userData };
+		assert(header && mip < header->mipCount);
+		if (header->mipSizes[mip] != size) return false;
+
+		memcpy(destination, (const u8*)header + header->mipOffsets[mip], size);
+		return true;
+	}
+}
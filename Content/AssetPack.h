@@ -0,0 +1,43 @@
+#pragma once
+#include "../Common/CommonHeaders.h"
+#include "AssetPackFormat.h"
+
+// Runtime access to cooked asset packs. A pack is memory-mapped read-only, and all the
+// pointers handed out point into the mapping, so asset data can be passed straight to
+// the graphics API (glBufferData, the texture streamer's mip loader...) without parsing
+// or intermediate copies. Pointers stay valid until the pack is closed.
+namespace Havana::Content
+{
+	DEFINE_TYPED_ID(pack_id);
+
+	struct MeshView
+	{
+		const Pack::MeshHeader*	header{ nullptr };
+		const Pack::MeshVertex*	vertices{ nullptr };
+		const u32*				indices{ nullptr };
+	};
+
+	struct TextureView
+	{
+		const Pack::TextureHeader*	header{ nullptr };
+		const u8*					base{ nullptr };	// start of the asset, mip offsets are relative to this
+	};
+
+	[[nodiscard]] pack_id OpenPack(const char* path);
+	void ClosePack(pack_id id);
+
+	// Returns nullptr if the pack has no asset with that name
+	const Pack::AssetEntry* FindAsset(pack_id id, u64 nameHash);
+	const u8* AssetData(pack_id id, const Pack::AssetEntry& entry);
+
+	MeshView GetMesh(pack_id id, const Pack::AssetEntry& entry);
+	TextureView GetTexture(pack_id id, const Pack::AssetEntry& entry);
+	const u8* TextureMip(const TextureView& texture, u32 mip);
+
+	// Ask the OS to start paging an asset in ahead of use
+	void Prefetch(pack_id id, const Pack::AssetEntry& entry);
+
+	// Matches the streaming texture mip loader, with userData pointing at the mapped
+	// TextureHeader. Copies one mip from the mapped pages into the upload buffer.
+	bool LoadTextureMip(void* userData, u32 mip, void* destination, u32 size);
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "../Common/PrimitiveTypes.h"
+
+// On-disk layout of cooked asset packs. Shared by the cooker and the runtime, so this
+// header must not depend on anything but the primitive types.
+//
+// [PackHeader][AssetEntry * assetCount][asset data...]
+//
+// Every asset starts on a page boundary so the runtime can hand mapped pages straight
+// to the GPU. Entries are sorted by name hash for binary search.
+namespace Havana::Content::Pack
+{
+	constexpr u32 magic{ 0x50415648 };	// "HVAP"
+	constexpr u32 version{ 2 };
+	constexpr u32 assetAlignment{ 4096 };
+	constexpr u32 subresourceAlignment{ 256 };
+	constexpr u32 maxMips{ 16 };
+	constexpr u32 maxLods{ 8 };
+
+	enum class AssetType : u32
+	{
+		Mesh = 0,
+		Texture
+	};
+
+	struct PackHeader
+	{
+		u32 magic;
+		u32 version;
+		u32 assetCount;
+		u32 assetAlignment;
+		u64 fileSize;
+	};
+
+	struct AssetEntry
+	{
+		u64			nameHash;
+		AssetType	type;
+		u32			reserved;
+		u64			offset;		// from the start of the file
+		u64			size;
+	};
+
+	// Vertex layout of cooked meshes. Indices are always u32.
+	struct MeshVertex
+	{
+		f32 position[3];
+		f32 normal[3];
+		f32 uv[2];
+	};
+
+	// Range of the index buffer that draws one level of detail. All levels index the
+	// same vertices.
+	struct MeshLod
+	{
+		u32 firstIndex;
+		u32 indexCount;
+		f32 error;		// largest distance from the full mesh in mesh units, 0 for level 0
+		u32 reserved;
+	};
+
+	struct MeshHeader
+	{
+		u32 vertexCount;
+		u32 indexCount;		// of all levels
+		u32 vertexOffset;	// from the start of the asset
+		u32 indexOffset;	// from the start of the asset
+		f32 boundsMin[3];
+		f32 boundsMax[3];
+		u32 lodCount;		// at least 1
+		u32 reserved;
+		MeshLod lods[maxLods];	// finest first, level 0 is the full mesh
+	};
+
+	// Mips are stored finest first, tightly packed RGBA8 rows
+	struct TextureHeader
+	{
+		u32 width;
+		u32 height;
+		u32 mipCount;
+		u32 isSRGB;
+		u32 mipOffsets[maxMips];	// from the start of the asset
+		u32 mipSizes[maxMips];
+	};
+
+	static_assert(sizeof(PackHeader) == 24);
+	static_assert(sizeof(AssetEntry) == 32);
+	static_assert(sizeof(MeshVertex) == 32);
+	static_assert(sizeof(MeshHeader) <= subresourceAlignment);
+
+	// FNV-1a of the asset name, which is its source path relative to the content root
+	constexpr u64 NameHash(const char* name)
+	{
+		u64 hash{ 0xcbf29ce484222325ull };
+		while (*name)
+		{
+			hash ^= (u8)*name++;
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	constexpr u64 AlignUp(u64 value, u64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
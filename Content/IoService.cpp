@@ -0,0 +1,673 @@
+#include "IoService.h"
+#include "../Utilities/ObjectPool.h"
+#include <thread>
+#include <condition_variable>
+#include <string.h>
+
+#if defined (__linux__)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#if defined (__linux__)
+namespace Havana::Content::Io
+{
+	namespace
+	{
+		constexpr u32 maxRequests{ 4096 };
+		constexpr u32 maxFiles{ 256 };
+		constexpr u32 maxBatchRequests{ 16 };
+		constexpr u32 maxBatchBytes{ 2 * 1024 * 1024 };
+		constexpr u32 directAlignment{ 4096 };
+		constexpr u64 directThreshold{ 64ull * 1024 * 1024 };	// smaller files are better served by the page cache
+		constexpr u64 wakeTag{ U64_INVALID_ID };
+		constexpr u64 cancelTag{ 1ull << 63 };
+
+		enum class RequestState : u32
+		{
+			Free = 0,
+			Queued,
+			InFlight,
+			Completing
+		};
+
+		struct RequestInfo
+		{
+			ReadRequest		request{};
+			u32				bytesRead{ 0 };
+			u32				batch{ U32_INVALID_ID };
+			u32				generation{ 0 };
+			IoStatus		status{ IoStatus::Completed };
+			RequestState	state{ RequestState::Free };
+			bool			isCancelled{ false };
+		};
+
+		struct FileInfo
+		{
+			int		fd{ -1 };
+			int		directFd{ -1 };
+			u64		size{ 0 };
+		};
+
+		// One read operation covering one or more adjacent requests
+		struct Batch
+		{
+			u32		requests[maxBatchRequests];
+			iovec	iovecs[maxBatchRequests];
+			u32		count{ 0 };
+			file_id	file{ Id::INVALID_ID };
+			u64		offset{ 0 };
+			u32		size{ 0 };
+			bool	isDirect{ false };
+			bool	isInUse{ false };
+			bool	isCancelPending{ false };	// in pendingCancels, so there's at most one cancel per batch
+		};
+
+		// Kernel submission/completion rings, set up with raw syscalls so we don't need liburing
+		struct Uring
+		{
+			int				fd{ -1 };
+			void*			sqRing{ nullptr };
+			void*			cqRing{ nullptr };
+			size_t			sqRingSize{ 0 };
+			size_t			cqRingSize{ 0 };
+			io_uring_sqe*	sqes{ nullptr };
+			size_t			sqesSize{ 0 };
+			u32*			sqHead{ nullptr };
+			u32*			sqTail{ nullptr };
+			u32*			sqMask{ nullptr };
+			u32*			sqArray{ nullptr };
+			u32*			cqHead{ nullptr };
+			u32*			cqTail{ nullptr };
+			u32*			cqMask{ nullptr };
+			io_uring_cqe*	cqes{ nullptr };
+		};
+
+		std::mutex						mutex;
+		std::condition_variable			wakeCondition;
+		std::unique_ptr<RequestInfo[]>	requests;
+		Utils::vector<u32>				freeRequests;
+		Utils::deque<u32>				queues[(u32)IoPriority::count];
+		Utils::ObjectPool<FileInfo, file_id>	files{ maxFiles, Memory::Tag::Content };
+		std::unique_ptr<Batch[]>		batches;
+		Memory::Allocation				requestsMemory{};
+		Memory::Allocation				batchesMemory{};
+		Utils::vector<u32>				freeBatches;
+		Utils::vector<u32>				pendingCancels;
+		IoStats							stats{};
+		bool							isRunning{ false };
+
+		Uring							ring{};
+		int								wakeFd{ -1 };
+		std::thread						uringThread;
+		Utils::vector<std::thread>		fallbackThreads;
+
+		//// URING ////
+
+		bool CreateUring(u32 entries)
+		{
+			io_uring_params params{};
+			ring.fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+			if (ring.fd < 0) return false;
+
+			ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+			ring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			const bool isSingleMap{ (params.features & IORING_FEAT_SINGLE_MMAP) != 0 };
+			if (isSingleMap) ring.sqRingSize = ring.cqRingSize = std::max(ring.sqRingSize, ring.cqRingSize);
+
+			ring.sqRing = mmap(nullptr, ring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+			if (ring.sqRing == MAP_FAILED) ring.sqRing = nullptr;
+			ring.cqRing = isSingleMap ? ring.sqRing :
+				mmap(nullptr, ring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+			if (ring.cqRing == MAP_FAILED) ring.cqRing = nullptr;
+			ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+			void* const sqes{ mmap(nullptr, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES) };
+			ring.sqes = sqes == MAP_FAILED ? nullptr : (io_uring_sqe*)sqes;
+			if (!ring.sqRing || !ring.cqRing || !ring.sqes) return false;
+
+			u8* const sq{ (u8*)ring.sqRing };
+			ring.sqHead = (u32*)(sq + params.sq_off.head);
+			ring.sqTail = (u32*)(sq + params.sq_off.tail);
+			ring.sqMask = (u32*)(sq + params.sq_off.ring_mask);
+			ring.sqArray = (u32*)(sq + params.sq_off.array);
+			u8* const cq{ (u8*)ring.cqRing };
+			ring.cqHead = (u32*)(cq + params.cq_off.head);
+			ring.cqTail = (u32*)(cq + params.cq_off.tail);
+			ring.cqMask = (u32*)(cq + params.cq_off.ring_mask);
+			ring.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+			return true;
+		}
+
+		void DestroyUring()
+		{
+			if (ring.sqes) munmap(ring.sqes, ring.sqesSize);
+			if (ring.cqRing && ring.cqRing != ring.sqRing) munmap(ring.cqRing, ring.cqRingSize);
+			if (ring.sqRing) munmap(ring.sqRing, ring.sqRingSize);
+			if (ring.fd >= 0) close(ring.fd);
+			ring = {};
+		}
+
+		// Entries written to the submission queue that the kernel hasn't consumed yet
+		u32 UnsubmittedSqes()
+		{
+			return *ring.sqTail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE);
+		}
+
+		// Only the I/O thread touches the submission queue, so the tail needs no atomics
+		// beyond publishing it to the kernel. When the queue is full the entries in it are
+		// submitted to make room. Returns nullptr if that didn't free anything, callers
+		// then retry on the next round of the I/O thread.
+		io_uring_sqe* NextSqe()
+		{
+			if (UnsubmittedSqes() > *ring.sqMask)
+			{
+				syscall(__NR_io_uring_enter, ring.fd, UnsubmittedSqes(), 0, 0, nullptr, 0);
+				if (UnsubmittedSqes() > *ring.sqMask) return nullptr;
+			}
+
+			const u32 tail{ *ring.sqTail };
+			const u32 index{ tail & *ring.sqMask };
+			io_uring_sqe& sqe{ ring.sqes[index] };
+			memset(&sqe, 0, sizeof(sqe));
+			ring.sqArray[index] = index;
+			__atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+			return &sqe;
+		}
+
+		void PrepareReadv(io_uring_sqe& sqe, int fd, const iovec* iovecs, u32 count, u64 offset, u64 userData)
+		{
+			sqe.opcode = IORING_OP_READV;
+			sqe.fd = fd;
+			sqe.addr = (u64)iovecs;
+			sqe.len = count;
+			sqe.off = offset;
+			sqe.user_data = userData;
+		}
+
+		void PrepareCancel(io_uring_sqe& sqe, u64 targetUserData)
+		{
+			sqe.opcode = IORING_OP_ASYNC_CANCEL;
+			sqe.fd = -1;
+			sqe.addr = targetUserData;
+			sqe.user_data = cancelTag | targetUserData;
+		}
+
+		//// REQUESTS ////
+
+		u32 RequestIndex(const RequestInfo& info)
+		{
+			return (u32)(&info - requests.get());
+		}
+
+		request_id MakeRequestId(u32 index)
+		{
+			return request_id{ index | (requests[index].generation << Id::Detail::INDEX_BITS) };
+		}
+
+		void FreeRequest(u32 index)
+		{
+			RequestInfo& info{ requests[index] };
+			const u32 generation{ (info.generation + 1) & Id::Detail::GENERATION_MASK };
+			info = {};
+			info.generation = generation;
+			freeRequests.emplace_back(index);
+		}
+
+		bool HasQueuedRequests()
+		{
+			for (const Utils::deque<u32>& queue : queues)
+				if (!queue.empty()) return true;
+			return false;
+		}
+
+		void CompletionJob(void* data)
+		{
+			RequestInfo& info{ *(RequestInfo*)data };
+			const ReadRequest& request{ info.request };
+			if (request.completion) request.completion(request.userData, request.destination, info.bytesRead, info.status);
+
+			std::lock_guard lock{ mutex };
+			FreeRequest(RequestIndex(info));
+		}
+
+		// Must be called without holding the mutex, since completion jobs take it
+		void DispatchCompletions(const u32* const indices, u32 count)
+		{
+			for (u32 i{ 0 }; i < count; i++)
+			{
+				RequestInfo& info{ requests[indices[i]] };
+				Jobs::JobCounter* const counter{ info.request.counter };
+				Jobs::Run(CompletionJob, &info, counter);
+				// Balance the increment done when the request was queued
+				if (counter) Jobs::Detail::Decrement(*counter);
+			}
+		}
+
+		bool TryExtendBatch(Batch& batch)
+		{
+			if (batch.count == maxBatchRequests) return false;
+
+			for (Utils::deque<u32>& queue : queues)
+			{
+				for (auto it{ queue.begin() }; it != queue.end(); it++)
+				{
+					const ReadRequest& request{ requests[*it].request };
+					if (request.file != batch.file || batch.size + request.size > maxBatchBytes) continue;
+
+					const bool isAfter{ request.offset == batch.offset + batch.size };
+					const bool isBefore{ request.offset + request.size == batch.offset };
+					if (!isAfter && !isBefore) continue;
+
+					if (isBefore)
+					{
+						memmove(&batch.requests[1], &batch.requests[0], batch.count * sizeof(u32));
+						batch.requests[0] = *it;
+						batch.offset = request.offset;
+					}
+					else
+					{
+						batch.requests[batch.count] = *it;
+					}
+					batch.count++;
+					batch.size += request.size;
+					queue.erase(it);
+					stats.coalescedRequests++;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		// Take the most urgent request and merge any queued requests that are adjacent to it
+		// in the same file. Called with the mutex held.
+		void BuildBatch(Batch& batch)
+		{
+			u32 first{ U32_INVALID_ID };
+			for (Utils::deque<u32>& queue : queues)
+			{
+				if (queue.empty()) continue;
+				first = queue.front();
+				queue.pop_front();
+				break;
+			}
+			assert(first != U32_INVALID_ID);
+
+			const ReadRequest& request{ requests[first].request };
+			const FileInfo& file{ files.Get(request.file) };
+			batch.requests[0] = first;
+			batch.count = 1;
+			batch.file = request.file;
+			batch.offset = request.offset;
+			batch.size = request.size;
+			batch.isInUse = true;
+
+			while (TryExtendBatch(batch)) {}
+
+			// O_DIRECT needs the file offset and every buffer to be block aligned
+			bool isAligned{ file.directFd >= 0 && (batch.offset % directAlignment) == 0 };
+			for (u32 i{ 0 }; i < batch.count; i++)
+			{
+				RequestInfo& info{ requests[batch.requests[i]] };
+				info.state = RequestState::InFlight;
+				info.batch = (u32)(&batch - batches.get());
+				batch.iovecs[i] = { info.request.destination, info.request.size };
+				isAligned = isAligned && ((uintptr_t)info.request.destination % directAlignment) == 0 &&
+							(info.request.size % directAlignment) == 0;
+			}
+			batch.isDirect = isAligned;
+
+			stats.reads++;
+			if (batch.isDirect) stats.directReads++;
+		}
+
+		int BatchFd(const Batch& batch)
+		{
+			const FileInfo& file{ files.Get(batch.file) };
+			return batch.isDirect ? file.directFd : file.fd;
+		}
+
+		// Distribute the result of a read over the requests it covered
+		void FinishBatch(Batch& batch, s64 result)
+		{
+			u32 completed[maxBatchRequests];
+			const u32 count{ batch.count };
+			{
+				std::lock_guard lock{ mutex };
+				u64 offset{ batch.offset };
+				for (u32 i{ 0 }; i < count; i++)
+				{
+					RequestInfo& info{ requests[batch.requests[i]] };
+					const u64 available{ result > 0 && (u64)result > offset - batch.offset ? (u64)result - (offset - batch.offset) : 0 };
+					info.bytesRead = (u32)std::min<u64>(available, info.request.size);
+					info.status = info.isCancelled ? IoStatus::Cancelled : result < 0 ? IoStatus::Failed : IoStatus::Completed;
+					info.state = RequestState::Completing;
+					if (info.isCancelled) stats.cancelledRequests++;
+					offset += info.request.size;
+					completed[i] = batch.requests[i];
+				}
+				if (result > 0) stats.bytesRead += (u64)result;
+
+				batch.count = 0;
+				batch.isInUse = false;
+			}
+
+			DispatchCompletions(&completed[0], count);
+		}
+
+		//// I/O THREADS ////
+
+		void WakeUringThread()
+		{
+			const u64 value{ 1 };
+			[[maybe_unused]] const ssize_t result{ write(wakeFd, &value, sizeof(value)) };
+		}
+
+		void UringThread()
+		{
+			// An eventfd read is kept in the ring so that other threads can wake us
+			// while we're blocked waiting for completions.
+			u64 wakeValue{ 0 };
+			const iovec wakeIovec{ &wakeValue, sizeof(wakeValue) };
+			bool isWakeArmed{ false };
+			u32 inFlight{ 0 };
+
+			for (;;)
+			{
+				{
+					std::lock_guard lock{ mutex };
+					if (!isRunning && !inFlight) break;
+
+					if (!isWakeArmed)
+					{
+						io_uring_sqe* const sqe{ NextSqe() };
+						if (sqe) PrepareReadv(*sqe, wakeFd, &wakeIovec, 1, 0, wakeTag);
+						isWakeArmed = sqe != nullptr;
+					}
+
+					while (!freeBatches.empty() && HasQueuedRequests())
+					{
+						io_uring_sqe* const sqe{ NextSqe() };
+						if (!sqe) break;
+
+						const u32 index{ freeBatches.back() };
+						freeBatches.pop_back();
+						Batch& batch{ batches[index] };
+						BuildBatch(batch);
+						PrepareReadv(*sqe, BatchFd(batch), &batch.iovecs[0], batch.count, batch.offset, index);
+						inFlight++;
+					}
+
+					u32 processed{ 0 };
+					for (; processed < (u32)pendingCancels.size(); processed++)
+					{
+						// The batch may have completed since the cancel was requested
+						Batch& batch{ batches[pendingCancels[processed]] };
+						bool isCancelled{ batch.isInUse };
+						for (u32 i{ 0 }; i < batch.count; i++) isCancelled = isCancelled && requests[batch.requests[i]].isCancelled;
+						if (isCancelled)
+						{
+							io_uring_sqe* const sqe{ NextSqe() };
+							if (!sqe) break;
+							PrepareCancel(*sqe, pendingCancels[processed]);
+						}
+						batch.isCancelPending = false;
+					}
+					pendingCancels.erase(pendingCancels.begin(), pendingCancels.begin() + processed);
+				}
+
+				// Includes entries left over when the kernel couldn't take everything last time
+				const int result{ (int)syscall(__NR_io_uring_enter, ring.fd, UnsubmittedSqes(), 1, IORING_ENTER_GETEVENTS, nullptr, 0) };
+				if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+				{
+					assert(false);
+					break;
+				}
+
+				u32 head{ *ring.cqHead };
+				const u32 tail{ __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE) };
+				for (; head != tail; head++)
+				{
+					const io_uring_cqe cqe{ ring.cqes[head & *ring.cqMask] };
+					if (cqe.user_data == wakeTag)
+					{
+						isWakeArmed = false;
+					}
+					else if (!(cqe.user_data & cancelTag))
+					{
+						const u32 index{ (u32)cqe.user_data };
+						FinishBatch(batches[index], cqe.res);
+
+						std::lock_guard lock{ mutex };
+						freeBatches.emplace_back(index);
+						inFlight--;
+					}
+				}
+				__atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+			}
+		}
+
+		void FallbackThread(u32 threadIndex)
+		{
+			// Each thread has one batch of its own
+			Batch& batch{ batches[threadIndex] };
+			for (;;)
+			{
+				{
+					std::unique_lock lock{ mutex };
+					wakeCondition.wait(lock, [] { return !isRunning || HasQueuedRequests(); });
+					if (!isRunning) break;
+					BuildBatch(batch);
+				}
+
+				ssize_t result{ preadv(BatchFd(batch), &batch.iovecs[0], (int)batch.count, (off_t)batch.offset) };
+				if (result < 0) result = -errno;
+				FinishBatch(batch, result);
+			}
+		}
+	} // anonymous namespace
+
+	/// <summary>
+	/// Start the I/O service, using io_uring if the kernel allows it.
+	/// </summary>
+	/// <param name="initInfo"> - Optional settings, defaults are used when nullptr.</param>
+	/// <returns>True if initialization succeeded.</returns>
+	bool Initialize(const IoServiceInitInfo* const initInfo)
+	{
+		const IoServiceInitInfo info{ initInfo ? *initInfo : IoServiceInitInfo{} };
+		assert(info.queueDepth && info.fallbackThreadCount);
+		assert(!isRunning);
+
+		if (requests) Memory::Untrack(requestsMemory);
+		requests = std::make_unique<RequestInfo[]>(maxRequests);
+		requestsMemory = Memory::Track(Memory::Tag::Content, sizeof(RequestInfo) * maxRequests);
+		freeRequests.clear();
+		for (u32 i{ maxRequests }; i > 0; i--) freeRequests.emplace_back(i - 1);
+		stats = {};
+		isRunning = true;
+
+		// Room for every batch, the wake read and a cancel per batch
+		const u32 ringEntries{ info.queueDepth * 2 + 1 };
+		if (!info.disableUring && CreateUring(ringEntries) && (wakeFd = eventfd(0, EFD_CLOEXEC)) >= 0)
+		{
+			stats.isUring = true;
+			batches = std::make_unique<Batch[]>(info.queueDepth);
+			batchesMemory = Memory::Track(Memory::Tag::Content, sizeof(Batch) * info.queueDepth);
+			freeBatches.clear();
+			for (u32 i{ 0 }; i < info.queueDepth; i++) freeBatches.emplace_back(i);
+			uringThread = std::thread{ UringThread };
+			return true;
+		}
+
+		DestroyUring();
+		batches = std::make_unique<Batch[]>(info.fallbackThreadCount);
+		batchesMemory = Memory::Track(Memory::Tag::Content, sizeof(Batch) * info.fallbackThreadCount);
+		for (u32 i{ 0 }; i < info.fallbackThreadCount; i++)
+			fallbackThreads.emplace_back(FallbackThread, i);
+		return true;
+	}
+
+	void Shutdown()
+	{
+		Utils::vector<u32> cancelled;
+		{
+			std::lock_guard lock{ mutex };
+			if (!isRunning) return;
+			isRunning = false;
+
+			// Queued requests are never started, in-flight reads are allowed to finish
+			for (Utils::deque<u32>& queue : queues)
+			{
+				for (const u32 index : queue)
+				{
+					RequestInfo& info{ requests[index] };
+					info.status = IoStatus::Cancelled;
+					info.state = RequestState::Completing;
+					cancelled.emplace_back(index);
+				}
+				queue.clear();
+			}
+			stats.cancelledRequests += cancelled.size();
+		}
+		DispatchCompletions(cancelled.data(), (u32)cancelled.size());
+
+		if (uringThread.joinable())
+		{
+			WakeUringThread();
+			uringThread.join();
+		}
+		wakeCondition.notify_all();
+		for (std::thread& thread : fallbackThreads) thread.join();
+		fallbackThreads.clear();
+
+		DestroyUring();
+		if (wakeFd >= 0) close(wakeFd);
+		wakeFd = -1;
+		if (batches) Memory::Untrack(batchesMemory);
+		batches.reset();
+		freeBatches.clear();
+		pendingCancels.clear();
+
+		files.ForEach([](file_id, FileInfo& file)
+		{
+			close(file.fd);
+			if (file.directFd >= 0) close(file.directFd);
+		});
+		files.Clear();
+		// Completion jobs still refer to their requests, so they're kept until the next Initialize
+	}
+
+	file_id OpenFile(const char* path, FileHint hint)
+	{
+		assert(path);
+		FileInfo info{};
+		info.fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (info.fd < 0) return file_id{ Id::INVALID_ID };
+
+		struct stat status{};
+		fstat(info.fd, &status);
+		info.size = (u64)status.st_size;
+
+		if (hint == FileHint::Sequential)
+		{
+			posix_fadvise(info.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+			// Not all file systems support O_DIRECT, the buffered descriptor is used then
+			if (info.size >= directThreshold) info.directFd = open(path, O_RDONLY | O_CLOEXEC | O_DIRECT);
+		}
+
+		std::lock_guard lock{ mutex };
+		return files.Add(info);
+	}
+
+	void CloseFile(file_id id)
+	{
+		std::lock_guard lock{ mutex };
+		const FileInfo& file{ files.Get(id) };
+		close(file.fd);
+		if (file.directFd >= 0) close(file.directFd);
+		files.Remove(id);
+	}
+
+	u64 FileSize(file_id id)
+	{
+		return files.Get(id).size;
+	}
+
+	request_id Read(const ReadRequest& request)
+	{
+		assert(request.destination && request.size && request.priority < IoPriority::count);
+		request_id id{ Id::INVALID_ID };
+		{
+			std::lock_guard lock{ mutex };
+			assert(isRunning && files.IsAlive(request.file));
+			if (freeRequests.empty()) return request_id{ Id::INVALID_ID };
+
+			const u32 index{ freeRequests.back() };
+			freeRequests.pop_back();
+			RequestInfo& info{ requests[index] };
+			info.request = request;
+			info.state = RequestState::Queued;
+			queues[(u32)request.priority].emplace_back(index);
+			stats.requests++;
+
+			// Keep the counter from reaching zero before the completion job is scheduled
+			if (request.counter) Jobs::Detail::Increment(*request.counter, 1);
+			id = MakeRequestId(index);
+		}
+
+		if (stats.isUring) WakeUringThread();
+		else wakeCondition.notify_one();
+		return id;
+	}
+
+	void Cancel(request_id id)
+	{
+		const u32 index{ Id::Index(id) };
+		assert(index < maxRequests);
+		{
+			std::lock_guard lock{ mutex };
+			RequestInfo& info{ requests[index] };
+			if (info.generation != Id::Generation(id) || info.isCancelled) return;
+
+			if (info.state == RequestState::InFlight)
+			{
+				// The read can't be recalled from the middle of a coalesced batch, but
+				// a batch that only holds cancelled requests is cancelled in the kernel.
+				info.isCancelled = true;
+				Batch& batch{ batches[info.batch] };
+				if (stats.isUring && !batch.isCancelPending)
+				{
+					batch.isCancelPending = true;
+					pendingCancels.emplace_back(info.batch);
+					WakeUringThread();
+				}
+				return;
+			}
+
+			if (info.state != RequestState::Queued) return;
+
+			Utils::deque<u32>& queue{ queues[(u32)info.request.priority] };
+			queue.erase(std::find(queue.begin(), queue.end(), index));
+			info.isCancelled = true;
+			info.status = IoStatus::Cancelled;
+			info.state = RequestState::Completing;
+			stats.cancelledRequests++;
+		}
+
+		DispatchCompletions(&index, 1);
+	}
+
+	IoStats Stats()
+	{
+		std::lock_guard lock{ mutex };
+		return stats;
+	}
+}
+#endif // __linux__
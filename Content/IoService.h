@@ -0,0 +1,89 @@
+#pragma once
+#include "../Common/CommonHeaders.h"
+#include "../Common/JobSystem.h"
+
+// Asynchronous file reads. Requests are queued by priority, adjacent reads of the same
+// file are coalesced into a single vectored read, and the batches are submitted through
+// io_uring. When io_uring isn't available (old kernel, seccomp...) a small thread pool
+// issues preadv calls instead. Every request ends with its completion function running
+// as a job, which is where decoding happens.
+namespace Havana::Content::Io
+{
+	DEFINE_TYPED_ID(file_id);
+	DEFINE_TYPED_ID(request_id);
+
+	enum class IoPriority : u32
+	{
+		High = 0,
+		Normal,
+		Low,
+
+		count
+	};
+
+	enum class IoStatus : u32
+	{
+		Completed = 0,
+		Failed,
+		Cancelled
+	};
+
+	enum class FileHint : u32
+	{
+		Default = 0,
+		// Large files read in big sequential chunks, such as asset packs. These bypass
+		// the page cache (O_DIRECT) for reads that are suitably aligned.
+		Sequential
+	};
+
+	// Runs as a job once the read is done. "size" is the number of bytes actually read,
+	// which is less than requested when reading past the end of the file.
+	using io_completion = void(*)(void* userData, u8* data, u32 size, IoStatus status);
+
+	struct ReadRequest
+	{
+		file_id				file{ Id::INVALID_ID };
+		u64					offset{ 0 };
+		u32					size{ 0 };
+		u8*					destination{ nullptr };	// must stay valid until the completion has run
+		IoPriority			priority{ IoPriority::Normal };
+		io_completion		completion{ nullptr };
+		void*				userData{ nullptr };
+		Jobs::JobCounter*	counter{ nullptr };		// reaches zero when the completion job is done
+	};
+
+	struct IoServiceInitInfo
+	{
+		u32		queueDepth{ 64 };			// batches in flight at once
+		u32		fallbackThreadCount{ 4 };	// preadv threads when io_uring isn't available
+		bool	disableUring{ false };
+	};
+
+	struct IoStats
+	{
+		u64		requests{ 0 };
+		u64		reads{ 0 };				// read operations issued, after coalescing
+		u64		coalescedRequests{ 0 };	// requests merged into another request's read
+		u64		directReads{ 0 };
+		u64		cancelledRequests{ 0 };
+		u64		bytesRead{ 0 };
+		bool	isUring{ false };
+	};
+
+	// Implemented in IoService.cpp. The job system must outlive the I/O service.
+	bool Initialize(const IoServiceInitInfo* const initInfo = nullptr);
+	void Shutdown();
+
+	[[nodiscard]] file_id OpenFile(const char* path, FileHint hint = FileHint::Default);
+	void CloseFile(file_id id);
+	u64 FileSize(file_id id);
+
+	// Thread-safe. Returns an invalid id if too many requests are pending.
+	[[nodiscard]] request_id Read(const ReadRequest& request);
+
+	// Thread-safe. Queued requests are dropped; requests already being read complete
+	// with IoStatus::Cancelled. The completion is called either way.
+	void Cancel(request_id id);
+
+	IoStats Stats();
+}
@@ -0,0 +1,418 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace Havana::Content::Simplifier
+{
+	namespace
+	{
+		// Extra weight of the planes that keep border vertices on the border
+		constexpr f64 borderWeight{ 10.0 };
+
+		struct Vector3
+		{
+			f32 x, y, z;
+		};
+
+		Vector3 Subtract(const Vector3& a, const Vector3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+		Vector3 Cross(const Vector3& a, const Vector3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+		f32 Dot(const Vector3& a, const Vector3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+		// Sum of weighted squared distances to a set of planes
+		struct Quadric
+		{
+			f64 a00, a11, a22, a01, a02, a12;
+			f64 b0, b1, b2;
+			f64 c;
+			f64 area;	// of the triangles whose planes were added
+		};
+
+		// The normal must be unit length
+		void AddPlane(Quadric& q, f64 x, f64 y, f64 z, f64 d, f64 weight)
+		{
+			q.a00 += weight * x * x; q.a11 += weight * y * y; q.a22 += weight * z * z;
+			q.a01 += weight * x * y; q.a02 += weight * x * z; q.a12 += weight * y * z;
+			q.b0 += weight * x * d; q.b1 += weight * y * d; q.b2 += weight * z * d;
+			q.c += weight * d * d;
+		}
+
+		void Add(Quadric& q, const Quadric& other)
+		{
+			q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+			q.a01 += other.a01; q.a02 += other.a02; q.a12 += other.a12;
+			q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+			q.c += other.c;
+			q.area += other.area;
+		}
+
+		f64 Evaluate(const Quadric& q, const Vector3& p)
+		{
+			const f64 x{ p.x }, y{ p.y }, z{ p.z };
+			const f64 result{ q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+							  2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+							  2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c };
+			return std::max(result, 0.0);
+		}
+
+		enum class VertexKind : u8
+		{
+			Manifold,	// can collapse onto any neighbor
+			Border,		// on one open border, can only collapse along it
+			Locked,		// on a seam or a non-manifold edge
+		};
+
+		struct Collapse
+		{
+			f32 cost;
+			f32 error;		// squared distance in normalized units
+			u32 from;
+			u32 to;
+		};
+
+		// Positions scaled to the unit cube, so errors and attribute weights mean the same
+		// for every mesh
+		struct SimplifyState
+		{
+			std::vector<Vector3>	positions;
+			std::vector<f32>		attributes;
+			std::vector<u32>		wedges;			// first vertex with the same position
+			std::vector<VertexKind>	kinds;
+			std::vector<Quadric>	quadrics;
+			std::vector<u32>		adjacencyOffsets;
+			std::vector<u32>		adjacency;		// triangles around each vertex
+			f32						scale{ 1.0f };	// normalized units per mesh unit
+		};
+
+		void LoadVertices(const MeshInput& mesh, SimplifyState& state)
+		{
+			const u32 vertexCount{ mesh.vertexCount };
+			state.positions.resize(vertexCount);
+			Vector3 minimum{ 1e30f, 1e30f, 1e30f }, maximum{ -1e30f, -1e30f, -1e30f };
+			for (u32 i{ 0 }; i < vertexCount; i++)
+			{
+				const f32* const p{ (const f32*)((const u8*)mesh.positions + (u64)i * mesh.positionStride) };
+				state.positions[i] = { p[0], p[1], p[2] };
+				minimum = { std::min(minimum.x, p[0]), std::min(minimum.y, p[1]), std::min(minimum.z, p[2]) };
+				maximum = { std::max(maximum.x, p[0]), std::max(maximum.y, p[1]), std::max(maximum.z, p[2]) };
+			}
+
+			const f32 extent{ std::max({ maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z }) };
+			state.scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+			for (Vector3& p : state.positions)
+				p = { (p.x - minimum.x) * state.scale, (p.y - minimum.y) * state.scale, (p.z - minimum.z) * state.scale };
+
+			state.attributes.resize((u64)vertexCount * mesh.attributeCount);
+			for (u32 i{ 0 }; i < vertexCount && mesh.attributeCount; i++)
+			{
+				const f32* const a{ (const f32*)((const u8*)mesh.attributes + (u64)i * mesh.attributeStride) };
+				memcpy(&state.attributes[(u64)i * mesh.attributeCount], a, mesh.attributeCount * sizeof(f32));
+			}
+
+			// Vertices that only differ in their attributes are wedges of one position
+			struct PositionHash
+			{
+				size_t operator()(const Vector3& p) const
+				{
+					u32 bits[3];
+					memcpy(bits, &p, sizeof(bits));
+					return ((size_t)bits[0] * 73856093) ^ ((size_t)bits[1] * 19349663) ^ ((size_t)bits[2] * 83492791);
+				}
+			};
+			struct PositionEqual
+			{
+				bool operator()(const Vector3& a, const Vector3& b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+			};
+			std::unordered_map<Vector3, u32, PositionHash, PositionEqual> firstVertex;
+			firstVertex.reserve(vertexCount);
+			state.wedges.resize(vertexCount);
+			for (u32 i{ 0 }; i < vertexCount; i++) state.wedges[i] = firstVertex.try_emplace(state.positions[i], i).first->second;
+		}
+
+		// Open and non-manifold edges are found on positions, not on vertices, so a seam
+		// isn't mistaken for a border
+		void ClassifyVertices(const u32* const indices, u32 indexCount, SimplifyState& state)
+		{
+			const u32 vertexCount{ (u32)state.positions.size() };
+			std::unordered_map<u64, u32> halfEdges;
+			halfEdges.reserve(indexCount);
+			for (u32 i{ 0 }; i < indexCount; i++)
+			{
+				const u32 a{ state.wedges[indices[i]] };
+				const u32 b{ state.wedges[indices[i - i % 3 + (i + 1) % 3]] };
+				halfEdges[(u64)a << 32 | b]++;
+			}
+
+			std::vector<u32> wedgeCounts(vertexCount, 0), openOut(vertexCount, 0), openIn(vertexCount, 0);
+			std::vector<bool> isComplex(vertexCount, false);
+			for (u32 i{ 0 }; i < vertexCount; i++) wedgeCounts[state.wedges[i]]++;
+			for (const auto& [key, count] : halfEdges)
+			{
+				const u32 a{ (u32)(key >> 32) }, b{ (u32)key };
+				if (count > 1) isComplex[a] = isComplex[b] = true;
+				if (!halfEdges.count((u64)b << 32 | a))
+				{
+					openOut[a]++;
+					openIn[b]++;
+				}
+			}
+
+			state.kinds.resize(vertexCount);
+			for (u32 i{ 0 }; i < vertexCount; i++)
+			{
+				const u32 w{ state.wedges[i] };
+				if (wedgeCounts[w] > 1 || isComplex[w]) state.kinds[i] = VertexKind::Locked;
+				else if (!openOut[w] && !openIn[w]) state.kinds[i] = VertexKind::Manifold;
+				else if (openOut[w] == 1 && openIn[w] == 1) state.kinds[i] = VertexKind::Border;
+				else state.kinds[i] = VertexKind::Locked;
+			}
+		}
+
+		void BuildAdjacency(const u32* const indices, u32 indexCount, SimplifyState& state)
+		{
+			const u32 vertexCount{ (u32)state.positions.size() };
+			state.adjacencyOffsets.assign(vertexCount + 1, 0);
+			for (u32 i{ 0 }; i < indexCount; i++) state.adjacencyOffsets[indices[i] + 1]++;
+			for (u32 i{ 0 }; i < vertexCount; i++) state.adjacencyOffsets[i + 1] += state.adjacencyOffsets[i];
+
+			state.adjacency.resize(indexCount);
+			std::vector<u32> fill(state.adjacencyOffsets.begin(), state.adjacencyOffsets.end() - 1);
+			for (u32 i{ 0 }; i < indexCount; i++) state.adjacency[fill[indices[i]]++] = i / 3;
+		}
+
+		// True if the edge from-to belongs to a single triangle. From isn't a seam vertex,
+		// so every triangle at its position contains it.
+		bool IsOpenEdge(const u32* const indices, const SimplifyState& state, u32 from, u32 to)
+		{
+			const u32 position{ state.wedges[to] };
+			bool isOutgoing{ false }, isIncoming{ false };
+			for (u32 i{ state.adjacencyOffsets[from] }; i < state.adjacencyOffsets[from + 1]; i++)
+			{
+				const u32* const triangle{ &indices[state.adjacency[i] * 3] };
+				for (u32 k{ 0 }; k < 3; k++)
+				{
+					if (triangle[k] != from) continue;
+					isOutgoing |= state.wedges[triangle[(k + 1) % 3]] == position;
+					isIncoming |= state.wedges[triangle[(k + 2) % 3]] == position;
+				}
+			}
+			return isOutgoing != isIncoming;
+		}
+
+		// Needs the adjacency
+		void ComputeQuadrics(const u32* const indices, u32 indexCount, SimplifyState& state)
+		{
+			state.quadrics.assign(state.positions.size(), Quadric{});
+			for (u32 t{ 0 }; t < indexCount; t += 3)
+			{
+				const u32 v[3]{ indices[t], indices[t + 1], indices[t + 2] };
+				const Vector3& p0{ state.positions[v[0]] };
+				const Vector3 normal{ Cross(Subtract(state.positions[v[1]], p0), Subtract(state.positions[v[2]], p0)) };
+				const f32 length{ std::sqrt(Dot(normal, normal)) };
+				if (length <= 0.0f) continue;
+
+				const Vector3 n{ normal.x / length, normal.y / length, normal.z / length };
+				const f64 area{ length * 0.5 };
+				for (const u32 vertex : v)
+				{
+					AddPlane(state.quadrics[vertex], n.x, n.y, n.z, -Dot(n, p0), area);
+					state.quadrics[vertex].area += area;
+				}
+
+				// A plane through each border edge, perpendicular to the triangle
+				for (u32 k{ 0 }; k < 3; k++)
+				{
+					const u32 a{ v[k] }, b{ v[(k + 1) % 3] };
+					if (state.kinds[a] == VertexKind::Border ? !IsOpenEdge(indices, state, a, b) :
+						state.kinds[b] != VertexKind::Border || !IsOpenEdge(indices, state, b, a)) continue;
+
+					const Vector3 edge{ Subtract(state.positions[b], state.positions[a]) };
+					const Vector3 m{ Cross(edge, n) };
+					const f32 mLength{ std::sqrt(Dot(m, m)) };
+					if (mLength <= 0.0f) continue;
+					const Vector3 plane{ m.x / mLength, m.y / mLength, m.z / mLength };
+					const f64 weight{ Dot(edge, edge) * borderWeight };
+					AddPlane(state.quadrics[a], plane.x, plane.y, plane.z, -Dot(plane, state.positions[a]), weight);
+					AddPlane(state.quadrics[b], plane.x, plane.y, plane.z, -Dot(plane, state.positions[a]), weight);
+				}
+			}
+		}
+
+		// Moving from onto to must not turn any remaining triangle around by more than
+		// about 75 degrees or squash it to a line, and every triangle that touches to's
+		// position must use to itself so it ends up degenerate in the index buffer, not
+		// just in space
+		bool IsValidCollapse(const u32* const indices, const SimplifyState& state, u32 from, u32 to, u32& removedTriangles)
+		{
+			const Vector3& p0{ state.positions[from] };
+			const Vector3& p1{ state.positions[to] };
+			removedTriangles = 0;
+			for (u32 i{ state.adjacencyOffsets[from] }; i < state.adjacencyOffsets[from + 1]; i++)
+			{
+				const u32* const triangle{ &indices[state.adjacency[i] * 3] };
+				u32 k{ 0 };
+				while (triangle[k] != from) k++;
+				const u32 b{ triangle[(k + 1) % 3] }, c{ triangle[(k + 2) % 3] };
+				if (b == to || c == to)
+				{
+					removedTriangles++;
+					continue;
+				}
+				if (state.wedges[b] == state.wedges[to] || state.wedges[c] == state.wedges[to]) return false;
+
+				const Vector3& pb{ state.positions[b] };
+				const Vector3& pc{ state.positions[c] };
+				const Vector3 before{ Cross(Subtract(pb, p0), Subtract(pc, p0)) };
+				const Vector3 after{ Cross(Subtract(pb, p1), Subtract(pc, p1)) };
+				// A triangle without area has no normal, which is as bad as a flipped one
+				const f32 alignment{ Dot(before, after) };
+				if (alignment <= 0.0f || alignment < 0.25f * std::sqrt(Dot(before, before) * Dot(after, after))) return false;
+			}
+			return removedTriangles > 0;
+		}
+
+		void AddCollapse(const u32* const indices, const MeshInput& mesh, const SimplifyState& state, u32 from, u32 to, std::vector<Collapse>& collapses)
+		{
+			const VertexKind kind{ state.kinds[from] };
+			if (kind == VertexKind::Locked) return;
+			if (kind == VertexKind::Border && !IsOpenEdge(indices, state, from, to)) return;
+
+			const Quadric& q{ state.quadrics[from] };
+			const f64 distance{ Evaluate(q, state.positions[to]) };
+			f64 attributeError{ 0.0 };
+			for (u32 i{ 0 }; i < mesh.attributeCount; i++)
+			{
+				const f64 difference{ state.attributes[(u64)from * mesh.attributeCount + i] - state.attributes[(u64)to * mesh.attributeCount + i] };
+				attributeError += mesh.attributeWeights[i] * difference * difference;
+			}
+
+			const f64 error{ q.area > 0.0 ? distance / q.area : distance };
+			collapses.push_back({ (f32)(distance + attributeError * q.area), (f32)error, from, to });
+		}
+	} // anonymous namespace
+
+	u32 Simplify(const MeshInput& mesh, u32 targetIndexCount, f32 maxError, u32* const destination, f32* const resultError /*= nullptr*/)
+	{
+		assert(mesh.positions && mesh.positionStride >= 3 * sizeof(f32) && mesh.indices && mesh.indexCount % 3 == 0 && destination);
+		assert(mesh.attributeCount <= maxAttributes && (!mesh.attributeCount || mesh.attributes));
+
+		u32 indexCount{ mesh.indexCount };
+		memmove(destination, mesh.indices, indexCount * sizeof(u32));
+		if (resultError) *resultError = 0.0f;
+		if (indexCount <= targetIndexCount) return indexCount;
+
+		SimplifyState state{};
+		LoadVertices(mesh, state);
+		ClassifyVertices(destination, indexCount, state);
+		BuildAdjacency(destination, indexCount, state);
+		ComputeQuadrics(destination, indexCount, state);
+
+		const f32 maxNormalizedError{ maxError * state.scale };
+		const f32 maxSquaredError{ maxNormalizedError * maxNormalizedError };
+		f32 worstError{ 0.0f };
+
+		std::vector<u32> remap(mesh.vertexCount);
+		std::vector<u8> isTouched(mesh.vertexCount);
+		std::vector<Collapse> collapses;
+		for (u32 i{ 0 }; i < mesh.vertexCount; i++) remap[i] = i;
+
+		// Each pass collapses the cheapest edges it can without two collapses touching the
+		// same triangles, then rewrites the index buffer
+		while (indexCount > targetIndexCount)
+		{
+			BuildAdjacency(destination, indexCount, state);
+
+			collapses.clear();
+			for (u32 i{ 0 }; i < indexCount; i++)
+			{
+				const u32 a{ destination[i] };
+				const u32 b{ destination[i - i % 3 + (i + 1) % 3] };
+				AddCollapse(destination, mesh, state, a, b, collapses);
+				AddCollapse(destination, mesh, state, b, a, collapses);
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			std::fill(isTouched.begin(), isTouched.end(), (u8)0);
+			u32 triangleCount{ indexCount / 3 };
+			u32 collapseCount{ 0 };
+			for (const Collapse& collapse : collapses)
+			{
+				if (isTouched[collapse.from] || isTouched[collapse.to] || collapse.error > maxSquaredError) continue;
+				u32 removedTriangles{ 0 };
+				if (!IsValidCollapse(destination, state, collapse.from, collapse.to, removedTriangles)) continue;
+
+				remap[collapse.from] = collapse.to;
+				Add(state.quadrics[collapse.to], state.quadrics[collapse.from]);
+				for (u32 i{ state.adjacencyOffsets[collapse.from] }; i < state.adjacencyOffsets[collapse.from + 1]; i++)
+				{
+					const u32* const triangle{ &destination[state.adjacency[i] * 3] };
+					isTouched[triangle[0]] = isTouched[triangle[1]] = isTouched[triangle[2]] = 1;
+				}
+				worstError = std::max(worstError, collapse.error);
+				collapseCount++;
+
+				triangleCount -= removedTriangles;
+				if (triangleCount * 3 <= targetIndexCount) break;
+			}
+			if (!collapseCount) break;
+
+			u32 count{ 0 };
+			for (u32 t{ 0 }; t < indexCount; t += 3)
+			{
+				const u32 a{ remap[destination[t]] }, b{ remap[destination[t + 1]] }, c{ remap[destination[t + 2]] };
+				if (a == b || b == c || a == c) continue;
+				destination[count++] = a;
+				destination[count++] = b;
+				destination[count++] = c;
+			}
+			indexCount = count;
+		}
+
+		if (resultError) *resultError = std::sqrt(worstError) / state.scale;
+		return indexCount;
+	}
+
+	u32 GenerateLods(const MeshInput& mesh, const LodSettings& settings, std::vector<u32>& indices, LodRange* const lods)
+	{
+		assert(lods && settings.lodCount && settings.ratio > 0.0f && settings.ratio < 1.0f);
+
+		const u32 first{ (u32)indices.size() };
+		indices.insert(indices.end(), mesh.indices, mesh.indices + mesh.indexCount);
+		lods[0] = { first, mesh.indexCount, 0.0f };
+		u32 lodCount{ 1 };
+
+		std::vector<u32> simplified;
+		MeshInput level{ mesh };
+		while (lodCount < std::min(settings.lodCount, maxLods))
+		{
+			const LodRange& previous{ lods[lodCount - 1] };
+			const u32 targetIndexCount{ std::max((u32)(previous.indexCount / 3 * settings.ratio), settings.minTriangleCount) * 3 };
+			if (targetIndexCount >= previous.indexCount || previous.error >= settings.maxError) break;
+
+			// Simplified from the previous level, so the errors add up
+			level.indices = &indices[previous.firstIndex];
+			level.indexCount = previous.indexCount;
+			simplified.resize(previous.indexCount);
+			f32 error{ 0.0f };
+			const u32 indexCount{ Simplify(level, targetIndexCount, settings.maxError - previous.error, simplified.data(), &error) };
+
+			// Not worth a level if it saves less than 10%
+			if ((u64)indexCount * 10 > (u64)previous.indexCount * 9) break;
+
+			const LodRange lod{ (u32)indices.size(), indexCount, previous.error + error };
+			indices.insert(indices.end(), simplified.begin(), simplified.begin() + indexCount);
+			lods[lodCount++] = lod;
+		}
+
+		return lodCount;
+	}
+
+	void GenerateLodsJob(void* data)
+	{
+		LodRequest& request{ *static_cast<LodRequest*>(data) };
+		request.indices.clear();
+		request.lodCount = GenerateLods(request.mesh, request.settings, request.indices, &request.lods[0]);
+	}
+}
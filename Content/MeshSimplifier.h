@@ -0,0 +1,77 @@
+#pragma once
+#include "../Common/PrimitiveTypes.h"
+#include <vector>
+
+// Mesh simplification for levels of detail. Shared by the cooker and the runtime, so
+// like AssetPackFormat.h it only depends on the primitive types and the STL.
+//
+// Triangles are removed by collapsing edges onto one of their vertices, so every level
+// indexes the original vertex buffer and a mesh needs one vertex buffer for all of them.
+// Collapses are ordered by their quadric error (the squared distance to the planes of
+// the triangles merged into a vertex so far) plus how much the vertex attributes
+// change. Vertices on attribute seams (a position shared by vertices with different
+// normals or uvs) and on non-manifold edges are never moved, and vertices on open
+// borders only move along the border, which keeps uv islands, hard edges and outlines.
+//
+// Everything is computed on the caller's thread and there's no global state, so the
+// functions can run on job workers (see GenerateLodsJob).
+namespace Havana::Content::Simplifier
+{
+	constexpr u32 maxAttributes{ 8 };
+	constexpr u32 maxLods{ 8 };
+
+	struct MeshInput
+	{
+		const f32*	positions{ nullptr };		// xyz of vertex i at positions + i * positionStride bytes
+		u32			positionStride{ 0 };
+		u32			vertexCount{ 0 };
+		const f32*	attributes{ nullptr };		// optional, attributeCount floats per vertex
+		u32			attributeStride{ 0 };
+		u32			attributeCount{ 0 };
+		f32			attributeWeights[maxAttributes]{};	// error of a unit change relative to moving by the mesh's size
+		const u32*	indices{ nullptr };			// triangle list
+		u32			indexCount{ 0 };
+	};
+
+	struct LodRange
+	{
+		u32 firstIndex;
+		u32 indexCount;
+		f32 error;		// largest distance from the full mesh in mesh units (estimated), 0 for the full mesh
+	};
+
+	struct LodSettings
+	{
+		u32 lodCount{ 4 };				// including the full mesh, at most maxLods
+		f32 ratio{ 0.5f };				// target triangle count relative to the previous level
+		u32 minTriangleCount{ 32 };		// no level goes below this
+		f32 maxError{ 1e30f };			// in mesh units, levels stop before exceeding it
+	};
+
+	/// <summary>
+	/// Simplifies a triangle list down to about targetIndexCount indices.
+	/// </summary>
+	/// <param name="destination"> - Room for mesh.indexCount indices.</param>
+	/// <param name="maxError"> - In mesh units. No collapse moves the surface further than this.</param>
+	/// <param name="resultError"> - Optional, receives the error of the result in mesh units.</param>
+	/// <returns>The number of indices written, more than the target if the error limit or the
+	/// seams and borders were in the way.</returns>
+	u32 Simplify(const MeshInput& mesh, u32 targetIndexCount, f32 maxError, u32* const destination, f32* const resultError = nullptr);
+
+	// Appends a chain of levels to indices, each simplified from the one before it.
+	// The full mesh is level 0. Returns the number of levels, fewer than requested when
+	// simplifying stops paying off.
+	u32 GenerateLods(const MeshInput& mesh, const LodSettings& settings, std::vector<u32>& indices, LodRange* const lods /* [maxLods] */);
+
+	// For Jobs::Run(GenerateLodsJob, &request, &counter) at runtime, e.g. for procedural meshes
+	struct LodRequest
+	{
+		MeshInput			mesh{};
+		LodSettings			settings{};
+		std::vector<u32>	indices{};		// output
+		LodRange			lods[maxLods]{};
+		u32					lodCount{ 0 };
+	};
+
+	void GenerateLodsJob(void* request);
+}
@@ -0,0 +1,82 @@
+#include "CommandList.h"
+#include <algorithm>
+
+namespace Havana::Graphics
+{
+	//// COMMAND LIST POOL ////////////////////////////////////////////////////////////////////////
+	void CommandListPool::Initialize(u32 listCount, u32 listCapacity)
+	{
+		assert(listCount && listCapacity);
+		Release();
+
+		m_lists = std::make_unique<CommandList[]>(listCount);
+		m_listCount = listCount;
+
+		for (u32 i{ 0 }; i < listCount; i++)
+			m_lists[i].Initialize(listCapacity);
+
+		m_acquired.store(0, std::memory_order_relaxed);
+	}
+
+	void CommandListPool::Release()
+	{
+		m_lists.reset();
+		m_listCount = 0;
+		m_acquired.store(0, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Get a command list to record into. Safe to call from any thread.
+	/// </summary>
+	/// <param name="sortKey"> - Replay position of this list. Keys must be unique per frame.</param>
+	/// <returns>A command list owned by the caller until the pool is reset, or nullptr if the pool is exhausted.</returns>
+	CommandList* CommandListPool::Acquire(u32 sortKey)
+	{
+		assert(sortKey != U32_INVALID_ID);
+		const u32 index{ m_acquired.fetch_add(1, std::memory_order_relaxed) };
+		assert(index < m_listCount);
+		if (index >= m_listCount) return nullptr;
+
+		CommandList& list{ m_lists[index] };
+		assert(list.IsEmpty());
+		list.SetSortKey(sortKey);
+		return &list;
+	}
+
+	// Fill "lists" with the acquired command lists in replay order and return how many were written.
+	// "lists" has to have room for every acquired list, Capacity() is always enough.
+	// NOTE: must only be called once all recording threads are done with their lists.
+	u32 CommandListPool::Sort(const CommandList** const lists, u32 maxLists) const
+	{
+		const u32 acquired{ std::min(m_acquired.load(std::memory_order_acquire), m_listCount) };
+		assert(acquired <= maxLists);
+		const u32 count{ std::min(acquired, maxLists) };
+		for (u32 i{ 0 }; i < count; i++)
+			lists[i] = &m_lists[i];
+
+		// Insertion sort, since there are only a handful of lists and this doesn't allocate.
+		for (u32 i{ 1 }; i < count; i++)
+		{
+			const CommandList* const list{ lists[i] };
+			u32 j{ i };
+			while (j > 0 && lists[j - 1]->SortKey() > list->SortKey())
+			{
+				lists[j] = lists[j - 1];
+				j--;
+			}
+			assert(j == 0 || lists[j - 1]->SortKey() != list->SortKey());
+			lists[j] = list;
+		}
+
+		return count;
+	}
+
+	void CommandListPool::Reset()
+	{
+		const u32 count{ std::min(m_acquired.load(std::memory_order_acquire), m_listCount) };
+		for (u32 i{ 0 }; i < count; i++)
+			m_lists[i].Reset();
+
+		m_acquired.store(0, std::memory_order_release);
+	}
+}
@@ -0,0 +1,330 @@
+#pragma once
+#include "../Common/CommonHeaders.h"
+#include <atomic>
+#include <cstring>
+
+namespace Havana::Graphics
+{
+	// Command encodings are kept API-agnostic so worker threads can record without
+	// touching the graphics context. The render thread hands the recorded lists to
+	// the active backend which translates them into native calls.
+	namespace Command
+	{
+		enum Type : u16
+		{
+			SetRenderTargets = 0,
+			SetViewport,
+			SetScissor,
+			Clear,
+			SetRenderState,
+			BindProgram,
+			BindVertexArray,
+			BindBuffer,
+			BindTexture,
+			Draw,
+			DrawIndexed,
+			DrawIndexedIndirect,
+			BeginGpuScope,
+			EndGpuScope,
+
+			count
+		};
+	}
+
+	enum class PrimitiveTopology : u8
+	{
+		Points = 0,
+		Lines,
+		LineStrip,
+		Triangles,
+		TriangleStrip
+	};
+
+	enum class BufferBinding : u8
+	{
+		Vertex = 0,
+		Index,
+		Uniform,
+		Storage,
+		Indirect
+	};
+
+	namespace ClearFlags
+	{
+		enum Flags : u32
+		{
+			Color = 0x01,
+			Depth = 0x02,
+			Stencil = 0x04
+		};
+	}
+
+	namespace RenderStateFlags
+	{
+		enum Flags : u32
+		{
+			DepthTest = 0x01,
+			DepthWrite = 0x02,
+			Blend = 0x04,
+			CullBackFaces = 0x08,
+			ScissorTest = 0x10
+		};
+	}
+
+	// Every command starts with a header. The size includes the header so the
+	// replay loop can step over commands it doesn't know about.
+	struct CommandHeader
+	{
+		Command::Type	type;
+		u16				size;
+
+		// Commands are only aligned to CommandList::alignment, which is less than the
+		// alignment of some payloads (e.g. the pointer in BeginGpuScopeCommand), so the
+		// payload is copied out instead of being read in place.
+		template<typename T>
+		T As() const
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			assert(type == T::type);
+			T command{};
+			memcpy(&command, this + 1, sizeof(T));
+			return command;
+		}
+
+		const CommandHeader* Next() const
+		{
+			return reinterpret_cast<const CommandHeader*>(reinterpret_cast<const u8*>(this) + size);
+		}
+	};
+	static_assert(sizeof(CommandHeader) == 4);
+
+	// Render target handle that refers to the back buffer of the current surface.
+	// Handles returned by Graphics::CreateRenderTarget() are never 0.
+	constexpr u32 backBufferRenderTarget{ 0 };
+	constexpr u32 maxRenderTargets{ 4 };
+
+	// Unused color slots and a missing depth target are U32_INVALID_ID.
+	struct SetRenderTargetsCommand
+	{
+		static constexpr Command::Type type{ Command::SetRenderTargets };
+		u32 colors[maxRenderTargets];
+		u32 depthStencil;
+	};
+
+	struct SetViewportCommand
+	{
+		static constexpr Command::Type type{ Command::SetViewport };
+		s32 x, y;
+		u32 width, height;
+	};
+
+	struct SetScissorCommand
+	{
+		static constexpr Command::Type type{ Command::SetScissor };
+		s32 x, y;
+		u32 width, height;
+	};
+
+	struct ClearCommand
+	{
+		static constexpr Command::Type type{ Command::Clear };
+		f32 color[4];
+		f32 depth;
+		u32 stencil;
+		u32 flags; // ClearFlags
+	};
+
+	struct SetRenderStateCommand
+	{
+		static constexpr Command::Type type{ Command::SetRenderState };
+		u32 flags; // RenderStateFlags
+	};
+
+	// Resource handles are backend names (e.g. GL object names). The command list
+	// doesn't interpret them.
+	struct BindProgramCommand
+	{
+		static constexpr Command::Type type{ Command::BindProgram };
+		u32 program;
+	};
+
+	struct BindVertexArrayCommand
+	{
+		static constexpr Command::Type type{ Command::BindVertexArray };
+		u32 vertexArray;
+	};
+
+	struct BindBufferCommand
+	{
+		static constexpr Command::Type type{ Command::BindBuffer };
+		u32				buffer;
+		u32				slot;	// only used by indexed bindings (uniform and storage)
+		BufferBinding	binding;
+	};
+
+	struct BindTextureCommand
+	{
+		static constexpr Command::Type type{ Command::BindTexture };
+		u32 texture;
+		u32 unit;
+	};
+
+	struct DrawCommand
+	{
+		static constexpr Command::Type type{ Command::Draw };
+		u32					vertexCount;
+		u32					instanceCount;
+		u32					firstVertex;
+		u32					baseInstance;
+		PrimitiveTopology	topology;
+	};
+
+	// Indices are always 32-bit.
+	struct DrawIndexedCommand
+	{
+		static constexpr Command::Type type{ Command::DrawIndexed };
+		u32					indexCount;
+		u32					instanceCount;
+		u32					firstIndex;
+		s32					baseVertex;
+		u32					baseInstance;
+		PrimitiveTopology	topology;
+	};
+
+	// Arguments of one indirect indexed draw, as stored in the bound indirect buffer.
+	// Matches both DrawElementsIndirectCommand (GL) and D3D12_DRAW_INDEXED_ARGUMENTS.
+	struct DrawIndexedIndirectArgs
+	{
+		u32 indexCount;
+		u32 instanceCount;
+		u32 firstIndex;
+		s32 baseVertex;
+		u32 baseInstance;
+	};
+	static_assert(sizeof(DrawIndexedIndirectArgs) == 20);
+
+	// Issue drawCount draws with arguments read from the bound indirect buffer, starting
+	// at byte offset. A stride of 0 means the arguments are tightly packed.
+	struct DrawIndexedIndirectCommand
+	{
+		static constexpr Command::Type type{ Command::DrawIndexedIndirect };
+		u32					offset;
+		u32					drawCount;
+		u32					stride;
+		PrimitiveTopology	topology;
+	};
+
+	// Brackets commands whose GPU time is measured under the given name. Scopes can be
+	// nested. The name is stored as a pointer, so it has to outlive the frame's results
+	// (string literals, pass names). Backends without a GPU profiler skip these.
+	struct BeginGpuScopeCommand
+	{
+		static constexpr Command::Type type{ Command::BeginGpuScope };
+		const char* name;
+	};
+
+	struct EndGpuScopeCommand
+	{
+		static constexpr Command::Type type{ Command::EndGpuScope };
+	};
+
+	// A linear buffer of packed commands filled by exactly one thread. Memory is
+	// reserved once in Initialize() so recording never allocates.
+	class CommandList
+	{
+	public:
+		constexpr static u32 alignment{ 4 };
+
+		CommandList() = default;
+		DISABLE_COPY_AND_MOVE(CommandList);
+		~CommandList() { Release(); }
+
+		void Initialize(u32 capacity)
+		{
+			Release();
+			m_buffer = std::make_unique<u8[]>(capacity);
+			m_memory = Memory::Track(Memory::Tag::Graphics, capacity);
+			m_capacity = capacity;
+			Reset();
+		}
+
+		void Release()
+		{
+			if (m_buffer) Memory::Untrack(m_memory);
+			m_buffer.reset();
+			m_capacity = 0;
+			Reset();
+		}
+
+		constexpr void Reset()
+		{
+			m_size = 0;
+			m_commandCount = 0;
+			m_sortKey = U32_INVALID_ID;
+		}
+
+		template<typename T>
+		void Record(const T& command)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			constexpr u32 commandSize{ AlignUp((u32)(sizeof(CommandHeader) + sizeof(T))) };
+			static_assert(commandSize <= 0xffff);
+			assert(m_buffer);
+			assert(m_size + commandSize <= m_capacity);
+			if (m_size + commandSize > m_capacity) return;
+
+			u8* const dst{ &m_buffer[m_size] };
+			const CommandHeader header{ T::type, (u16)commandSize };
+			memcpy(dst, &header, sizeof(CommandHeader));
+			memcpy(dst + sizeof(CommandHeader), &command, sizeof(T));
+
+			m_size += commandSize;
+			m_commandCount++;
+		}
+
+		constexpr void SetSortKey(u32 key) { m_sortKey = key; }
+		constexpr u32 SortKey() const { return m_sortKey; }
+		constexpr u32 Size() const { return m_size; }
+		constexpr u32 Capacity() const { return m_capacity; }
+		constexpr u32 CommandCount() const { return m_commandCount; }
+		constexpr bool IsEmpty() const { return m_size == 0; }
+
+		const CommandHeader* Begin() const { return reinterpret_cast<const CommandHeader*>(m_buffer.get()); }
+		const CommandHeader* End() const { return reinterpret_cast<const CommandHeader*>(m_buffer.get() + m_size); }
+
+	private:
+		constexpr static u32 AlignUp(u32 size) { return (size + alignment - 1) & ~(alignment - 1); }
+
+		std::unique_ptr<u8[]>	m_buffer{};
+		Memory::Allocation		m_memory{};
+		u32						m_capacity{ 0 };
+		u32						m_size{ 0 };
+		u32						m_commandCount{ 0 };
+		u32						m_sortKey{ U32_INVALID_ID };
+	};
+
+	// Fixed set of command lists handed out to recording threads. Acquiring a list
+	// is lock-free. Lists are replayed in ascending sort key order, which makes the
+	// submission order independent of which thread recorded what.
+	class CommandListPool
+	{
+	public:
+		CommandListPool() = default;
+		DISABLE_COPY_AND_MOVE(CommandListPool);
+		~CommandListPool() { Release(); }
+
+		// Implemented in the translation unit for this header
+		void Initialize(u32 listCount, u32 listCapacity);
+		void Release();
+		[[nodiscard]] CommandList* Acquire(u32 sortKey);
+		u32 Sort(const CommandList** const lists, u32 maxLists) const;
+		void Reset();
+
+		constexpr u32 Capacity() const { return m_listCount; }
+
+	private:
+		std::unique_ptr<CommandList[]>	m_lists{};
+		std::atomic<u32>				m_acquired{ 0 };
+		u32								m_listCount{ 0 };
+	};
+}
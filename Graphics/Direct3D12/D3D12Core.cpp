@@ -1,6 +1,7 @@
 #include "D3D12Core.h"
 #include "D3D12Resources.h"
 #include "D3D12Surface.h"
+#include "../../Utilities/ObjectPool.h"
 
 using namespace Microsoft::WRL;
 
@@ -138,6 +139,7 @@ namespace Havana::Graphics::D3D12::Core
 			constexpr ID3D12CommandQueue* const CommandQueue() const { return m_commandQueue; }
 			constexpr ID3D12GraphicsCommandList6* const CommandList() const { return m_commandList; }
 			constexpr u32 FrameIndex() const { return m_frameIndex; }
+			u32 FramesInFlight() const { return m_fence ? (u32)(m_fenceValue - m_fence->GetCompletedValue()) : 0; }
 
 		private:
 			struct CommandFrame
@@ -176,10 +178,11 @@ namespace Havana::Graphics::D3D12::Core
 			u32							m_frameIndex{ 0 };
 		};
 
+		constexpr u32				maxSurfaces{ 64 };
 		ID3D12Device8*				mainDevice{ nullptr };
 		IDXGIFactory7*				dxgiFactory{ nullptr };
 		D3D12Command				gfxCommand;
-		Utils::vector<D3D12Surface> surfaces;
+		Utils::ObjectPool<D3D12Surface, surface_id> surfaces{ maxSurfaces, Memory::Tag::Graphics };
 		DescriptorHeap				rtvDescHeap{ D3D12_DESCRIPTOR_HEAP_TYPE_RTV };
 		DescriptorHeap				dsvDescHeap{ D3D12_DESCRIPTOR_HEAP_TYPE_DSV };
 		DescriptorHeap				srvDescHeap{ D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV };
@@ -187,10 +190,39 @@ namespace Havana::Graphics::D3D12::Core
 		Utils::vector<IUnknown*>	deferredReleases[frameBufferCount]{};
 		u32							deferredReleasesFlag[frameBufferCount]{};
 		std::mutex					deferredReleasesMutex{};
+		const CommandList*			overlay{ nullptr };
+		// Back buffer of the surface whose lists are being replayed
+		D3D12_CPU_DESCRIPTOR_HANDLE	backBufferRTV{};
+		// Command lists of the next frame, owned by the renderer until that frame is rendered
+		const CommandList* const*	frameLists{ nullptr };
+		u32							frameListCount{ 0 };
+
+		struct D3D12RenderTarget
+		{
+			ID3D12Resource*		resource{ nullptr };
+			DescriptorHandle	view{};
+			bool				isDepth{ false };
+		};
+
+		// Render target handles are index + 1, since 0 is the back buffer
+		Utils::vector<D3D12RenderTarget>	renderTargets;
+		Utils::vector<u32>					freeRenderTargets;
 
 		constexpr D3D_FEATURE_LEVEL minimumFeatureLevel{ D3D_FEATURE_LEVEL_11_0 };
 		constexpr DXGI_FORMAT renderTargetFormat{ DXGI_FORMAT_R8G8B8A8_UNORM_SRGB };
 
+		constexpr DXGI_FORMAT ToDXGIFormat(RenderTargetFormat format)
+		{
+			switch (format)
+			{
+			case RenderTargetFormat::RGBA16F: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+			case RenderTargetFormat::R11G11B10F: return DXGI_FORMAT_R11G11B10_FLOAT;
+			case RenderTargetFormat::Depth24Stencil8: return DXGI_FORMAT_D24_UNORM_S8_UINT;
+			case RenderTargetFormat::Depth32F: return DXGI_FORMAT_D32_FLOAT;
+			default: return DXGI_FORMAT_R8G8B8A8_UNORM;
+			}
+		}
+
 		bool FailedInit()
 		{
 			Shutdown();
@@ -249,6 +281,7 @@ namespace Havana::Graphics::D3D12::Core
 		// This wont be called often so we shouldn't have this inlined
 		void __declspec(noinline) ProcessDeferredReleases(u32 frameIdx)
 		{
+			PROFILE_SCOPE("D3D12::ProcessDeferredReleases");
 			std::lock_guard lock{ deferredReleasesMutex };
 
 			// This flag is cleared at the beginning becuase otherwise it might
@@ -429,37 +462,53 @@ namespace Havana::Graphics::D3D12::Core
 
 	Surface CreateSurface(Platform::Window window)
 	{
-		surfaces.emplace_back(window);
-		surface_id id{ (u32)surfaces.size() - 1 };
-		surfaces[id].CreateSwapChain(dxgiFactory, gfxCommand.CommandQueue(), renderTargetFormat);
+		const surface_id id{ surfaces.Add(window) };
+		surfaces.Get(id).CreateSwapChain(dxgiFactory, gfxCommand.CommandQueue(), renderTargetFormat);
 		return Surface{ id };
 	}
 
 	void RemoveSurface(surface_id id)
 	{
 		gfxCommand.Flush();
-		// TODO: use proper removal of surfaces.
-		surfaces[id].~D3D12Surface();
+		surfaces.Remove(id);
 	}
 
 	void ResizeSurface(surface_id id, u32, u32)
 	{
 		gfxCommand.Flush();
-		surfaces[id].Resize();
+		surfaces.Get(id).Resize();
 	}
 	
 	u32 SurfaceWidth(surface_id id)
 	{
-		return surfaces[id].Width();
+		return surfaces.Get(id).Width();
 	}
 
 	u32 SurfaceHeight(surface_id id)
 	{
-		return surfaces[id].Height();
+		return surfaces.Get(id).Height();
+	}
+
+	void SetSurfacePresentMode(surface_id id, PresentMode mode)
+	{
+		surfaces.Get(id).SetPresentMode(mode);
 	}
 
-	void RenderSurface(surface_id id)
+	PresentMode SurfacePresentMode(surface_id id)
 	{
+		return surfaces.Get(id).GetPresentMode();
+	}
+
+	/// <summary>
+	/// Render several surfaces in one frame: a single fence wait and command list
+	/// submission for all of them, then every swap chain is presented.
+	/// </summary>
+	/// <param name="ids"> - The surfaces to render.</param>
+	/// <param name="count"> - Number of surfaces.</param>
+	void RenderFrame(const surface_id* const ids, u32 count)
+	{
+		assert(ids && count);
+
 		// Wait for the GPU to finish with the command allocator and
 		// reset the allocator once the GPU is done with it.
 		// This frees the memory that was used to store commands.
@@ -472,18 +521,212 @@ namespace Havana::Graphics::D3D12::Core
 		{
 			(ProcessDeferredReleases(frameIdx));
 		}
-		
-		const D3D12Surface& surface{ surfaces[id] };
-		
-		// Presenting swap chain buffers happens in lockstep with frame buffers.
-		surface.Present();
 
-		// Record commands
-		// ......
-		//
+		for (u32 i{ 0 }; i < count; i++)
+		{
+			const D3D12Surface& surface{ surfaces.Get(ids[i]) };
+			ID3D12Resource* const backBuffer{ surface.BackBuffer() };
+
+			// Back buffers are presentable between frames and render targets while the
+			// lists are replayed.
+			D3D12_RESOURCE_BARRIER barrier{};
+			barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+			barrier.Transition.pResource = backBuffer;
+			barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+			barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
+			barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
+			commandList->ResourceBarrier(1, &barrier);
+
+			backBufferRTV = surface.RTV();
+			commandList->OMSetRenderTargets(1, &backBufferRTV, FALSE, nullptr);
+			commandList->RSSetViewports(1, &surface.Viewport());
+			commandList->RSSetScissorRects(1, &surface.ScissorRect());
+
+			for (u32 j{ 0 }; j < frameListCount; j++)
+				ExecuteCommandList(*frameLists[j]);
+
+			if (overlay) ExecuteCommandList(*overlay);
+
+			barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
+			barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+			commandList->ResourceBarrier(1, &barrier);
+		}
+
+		backBufferRTV = {};
+		frameLists = nullptr;
+		frameListCount = 0;
+
 		// Done recording commands, now execute them,
 		// signal and incriment fence value for next frame.
 		gfxCommand.EndFrame();
+
+		// Presenting swap chain buffers happens in lockstep with frame buffers.
+		for (u32 i{ 0 }; i < count; i++)
+		{
+			surfaces.Get(ids[i]).Present();
+		}
 	}
 
+	u32 CreateRenderTarget(const RenderTargetDesc& desc)
+	{
+		PROFILE_SCOPE("D3D12::CreateRenderTarget");
+		assert(mainDevice);
+		const bool isDepth{ IsDepthFormat(desc.format) };
+
+		D3D12_HEAP_PROPERTIES heapProperties{};
+		heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+		D3D12_RESOURCE_DESC resourceDesc{};
+		resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		resourceDesc.Width = desc.width;
+		resourceDesc.Height = desc.height;
+		resourceDesc.DepthOrArraySize = 1;
+		resourceDesc.MipLevels = 1;
+		resourceDesc.Format = ToDXGIFormat(desc.format);
+		resourceDesc.SampleDesc.Count = 1;
+		resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		resourceDesc.Flags = isDepth ? D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL : D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+		D3D12_CLEAR_VALUE clearValue{};
+		clearValue.Format = resourceDesc.Format;
+		clearValue.DepthStencil.Depth = 1.0f;
+
+		D3D12RenderTarget target{};
+		target.isDepth = isDepth;
+		HRESULT hr{ S_OK };
+		DXCall(hr = mainDevice->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &resourceDesc,
+														isDepth ? D3D12_RESOURCE_STATE_DEPTH_WRITE : D3D12_RESOURCE_STATE_RENDER_TARGET,
+														&clearValue, IID_PPV_ARGS(&target.resource)));
+		if (FAILED(hr)) return U32_INVALID_ID;
+		NAME_D3D12_OBJECT(target.resource, L"Render Graph Render Target");
+
+		if (isDepth)
+		{
+			target.view = dsvDescHeap.Allocate();
+			mainDevice->CreateDepthStencilView(target.resource, nullptr, target.view.cpu);
+		}
+		else
+		{
+			target.view = rtvDescHeap.Allocate();
+			mainDevice->CreateRenderTargetView(target.resource, nullptr, target.view.cpu);
+		}
+
+		u32 index{ U32_INVALID_ID };
+		if (freeRenderTargets.empty())
+		{
+			index = (u32)renderTargets.size();
+			renderTargets.emplace_back(target);
+		}
+		else
+		{
+			index = freeRenderTargets.back();
+			freeRenderTargets.pop_back();
+			renderTargets[index] = target;
+		}
+
+		return index + 1;
+	}
+
+	void RemoveRenderTarget(u32 handle)
+	{
+		PROFILE_SCOPE("D3D12::RemoveRenderTarget");
+		assert(handle != backBufferRenderTarget && handle <= renderTargets.size());
+		D3D12RenderTarget& target{ renderTargets[handle - 1] };
+		(target.isDepth ? dsvDescHeap : rtvDescHeap).Free(target.view);
+		DeferredRelease(target.resource);
+		freeRenderTargets.emplace_back(handle - 1);
+	}
+
+	// The lists have to stay alive until the next RenderFrame() returns.
+	void SubmitCommandLists(const CommandList* const* lists, u32 count)
+	{
+		assert(lists || !count);
+		frameLists = lists;
+		frameListCount = count;
+	}
+
+	void SetOverlay(const CommandList* list)
+	{
+		overlay = list;
+	}
+
+	// NOTE: there are no timestamp queries in this backend yet
+	f32 GpuFrameTime()
+	{
+		return 0.0f;
+	}
+
+	u32 FramesInFlight()
+	{
+		return gfxCommand.FramesInFlight();
+	}
+
+	// Translate a recorded command list into the graphics command list of the current frame.
+	// NOTE: pipeline state and resource bindings are not translated yet, since there are no
+	//       root signatures or PSOs to map them onto.
+	void ExecuteCommandList(const CommandList& list)
+	{
+		ID3D12GraphicsCommandList6* const commandList{ gfxCommand.CommandList() };
+		assert(commandList);
+
+		for (const CommandHeader* cmd{ list.Begin() }; cmd != list.End(); cmd = cmd->Next())
+		{
+			switch (cmd->type)
+			{
+			case Command::SetRenderTargets:
+			{
+				// NOTE: the back buffer is the one of the surface RenderFrame() is rendering.
+				const SetRenderTargetsCommand& c{ cmd->As<SetRenderTargetsCommand>() };
+				D3D12_CPU_DESCRIPTOR_HANDLE rtvs[maxRenderTargets]{};
+				u32 rtvCount{ 0 };
+				for (u32 i{ 0 }; i < maxRenderTargets; i++)
+				{
+					if (c.colors[i] == U32_INVALID_ID) continue;
+					if (c.colors[i] == backBufferRenderTarget)
+					{
+						assert(backBufferRTV.ptr);
+						rtvs[rtvCount++] = backBufferRTV;
+					}
+					else
+					{
+						rtvs[rtvCount++] = renderTargets[c.colors[i] - 1].view.cpu;
+					}
+				}
+				const bool hasDepth{ c.depthStencil != U32_INVALID_ID };
+				D3D12_CPU_DESCRIPTOR_HANDLE dsv{ hasDepth ? renderTargets[c.depthStencil - 1].view.cpu : D3D12_CPU_DESCRIPTOR_HANDLE{} };
+				if (rtvCount || hasDepth)
+					commandList->OMSetRenderTargets(rtvCount, &rtvs[0], FALSE, hasDepth ? &dsv : nullptr);
+			}
+			break;
+			case Command::SetViewport:
+			{
+				const SetViewportCommand& c{ cmd->As<SetViewportCommand>() };
+				const D3D12_VIEWPORT viewport{ (f32)c.x, (f32)c.y, (f32)c.width, (f32)c.height, 0.0f, 1.0f };
+				commandList->RSSetViewports(1, &viewport);
+			}
+			break;
+			case Command::SetScissor:
+			{
+				const SetScissorCommand& c{ cmd->As<SetScissorCommand>() };
+				const D3D12_RECT rect{ c.x, c.y, c.x + (s32)c.width, c.y + (s32)c.height };
+				commandList->RSSetScissorRects(1, &rect);
+			}
+			break;
+			case Command::Draw:
+			{
+				const DrawCommand& c{ cmd->As<DrawCommand>() };
+				commandList->DrawInstanced(c.vertexCount, c.instanceCount, c.firstVertex, c.baseInstance);
+			}
+			break;
+			case Command::DrawIndexed:
+			{
+				const DrawIndexedCommand& c{ cmd->As<DrawIndexedCommand>() };
+				commandList->DrawIndexedInstanced(c.indexCount, c.instanceCount, c.firstIndex, c.baseVertex, c.baseInstance);
+			}
+			break;
+			default:
+				break;
+			}
+		}
+	}
 }
\ No newline at end of file
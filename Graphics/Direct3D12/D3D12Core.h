@@ -50,5 +50,17 @@ namespace Havana::Graphics::D3D12::Core
 	void ResizeSurface(surface_id id, u32, u32);
 	u32 SurfaceWidth(surface_id id);
 	u32 SurfaceHeight(surface_id id);
-	void RenderSurface(surface_id id);
+	void SetSurfacePresentMode(surface_id id, PresentMode mode);
+	PresentMode SurfacePresentMode(surface_id id);
+	void RenderFrame(const surface_id* const ids, u32 count);
+
+	u32 CreateRenderTarget(const RenderTargetDesc& desc);
+	void RemoveRenderTarget(u32 handle);
+
+	void ExecuteCommandList(const CommandList& list);
+	void SubmitCommandLists(const CommandList* const* lists, u32 count);
+	void SetOverlay(const CommandList* list);
+
+	f32 GpuFrameTime();
+	u32 FramesInFlight();
 }
\ No newline at end of file
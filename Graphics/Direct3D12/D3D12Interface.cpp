@@ -11,13 +11,24 @@ namespace Havana::Graphics
 		{
 			platformInterface.Initialize = Core::Initialize;
 			platformInterface.Shutdown = Core::Shutdown;
+			platformInterface.RenderFrame = Core::RenderFrame;
 
 			platformInterface.Surface.Create = Core::CreateSurface;
 			platformInterface.Surface.Remove = Core::RemoveSurface;
 			platformInterface.Surface.Resize = Core::ResizeSurface;
 			platformInterface.Surface.Width = Core::SurfaceWidth;
 			platformInterface.Surface.Height = Core::SurfaceHeight;
-			platformInterface.Surface.Render = Core::RenderSurface;
+			platformInterface.Surface.SetPresentMode = Core::SetSurfacePresentMode;
+			platformInterface.Surface.GetPresentMode = Core::SurfacePresentMode;
+
+			platformInterface.RenderTarget.Create = Core::CreateRenderTarget;
+			platformInterface.RenderTarget.Remove = Core::RemoveRenderTarget;
+
+			platformInterface.Commands.Submit = Core::SubmitCommandLists;
+			platformInterface.Commands.SetOverlay = Core::SetOverlay;
+
+			platformInterface.Stats.GpuFrameTime = Core::GpuFrameTime;
+			platformInterface.Stats.FramesInFlight = Core::FramesInFlight;
 		}
 	} // D3D12 namespace
 }
\ No newline at end of file
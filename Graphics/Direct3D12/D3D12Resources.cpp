@@ -4,9 +4,10 @@
 namespace Havana::Graphics::D3D12
 {
 	//// DESCRIPTOR HEAP //////////////////////////////////////////////////////////////////////////
+	// NOTE: not thread-safe. Heaps are initialized and released on the render thread,
+	//       while no other thread allocates from them.
 	bool DescriptorHeap::Initialize(u32 capacity, bool isShaderVisible)
 	{
-		std::lock_guard lock{ m_mutex };
 		assert(capacity && capacity < D3D12_MAX_SHADER_VISIBLE_DESCRIPTOR_HEAP_SIZE_TIER_2);
 		assert(!(m_type == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER &&
 			capacity > D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE));
@@ -32,14 +33,8 @@ namespace Havana::Graphics::D3D12
 		DXCall(hr = device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_heap)));
 		if (FAILED(hr)) return false;
 
-		m_freeHandles = std::move(std::make_unique<u32[]>(capacity));
+		m_indices.Initialize(capacity, Memory::Tag::Graphics);
 		m_capacity = capacity;
-		m_size = 0;
-
-		for (u32 i{ 0 }; i < capacity; i++)
-			m_freeHandles[i] = i;
-
-		DEBUG_OP(for (u32 i{ 0 }; i < frameBufferCount; i++) assert(m_deferredFreeIndices[i].empty()));
 
 		m_descriptorSize = device->GetDescriptorHandleIncrementSize(m_type);
 		m_cpuStart = m_heap->GetCPUDescriptorHandleForHeapStart();
@@ -50,36 +45,25 @@ namespace Havana::Graphics::D3D12
 	
 	void DescriptorHeap::ProcessDeferredFree(u32 frameIdx)
 	{
-		std::lock_guard lock{ m_mutex };
 		assert(frameIdx < frameBufferCount);
-
-		Utils::vector<u32>& indices{ m_deferredFreeIndices[frameIdx] };
-		if (!indices.empty())
-		{
-			for (auto index : indices)
-			{
-				m_size--;
-				m_freeHandles[m_size] = index;
-			}
-			indices.clear();
-		}
+		m_indices.ProcessDeferredFree(frameIdx);
 	}
 	
 	void DescriptorHeap::Release()
 	{
-		assert(!m_size);
+		assert(!m_indices.Size());
+		m_indices.Release();
 		Core::DeferredRelease(m_heap);
 	}
 
+	// Allocate() and Free() don't lock: the indices come from a lock-free pool with
+	// per-thread caches, so threads creating resources don't contend on the heap.
 	DescriptorHandle DescriptorHeap::Allocate()
 	{
-		std::lock_guard lock{ m_mutex };
 		assert(m_heap);
-		assert(m_size < m_capacity);
-
-		const u32 index{ m_freeHandles[m_size] };
+		const u32 index{ m_indices.Allocate() };
+		assert(index != U32_INVALID_ID);
 		const u32 offset{ index * m_descriptorSize };
-		m_size++;
 
 		DescriptorHandle handle;
 		handle.cpu.ptr = m_cpuStart.ptr + offset;
@@ -98,8 +82,7 @@ namespace Havana::Graphics::D3D12
 	void DescriptorHeap::Free(DescriptorHandle& handle)
 	{
 		if (!handle.IsVaild()) return;
-		std::lock_guard lock{ m_mutex };
-		assert(m_heap && m_size);
+		assert(m_heap && m_indices.Size());
 		assert(handle.container = this);
 		assert(handle.cpu.ptr >= m_cpuStart.ptr);
 		assert((handle.cpu.ptr - m_cpuStart.ptr) % m_descriptorSize == 0);
@@ -108,7 +91,7 @@ namespace Havana::Graphics::D3D12
 		assert(handle.index == index);
 
 		const u32 frameIdx{ Core::CurrentFrameIndex() };
-		m_deferredFreeIndices[frameIdx].push_back(index);
+		m_indices.Free(index, frameIdx);
 		Core::SetDeferredReleasesFlag();
 		handle = {};
 	}
@@ -1,5 +1,6 @@
 #pragma once
 #include "D3D12CommonHeaders.h"
+#include "../../Utilities/IndexPool.h"
 
 namespace Havana::Graphics::D3D12
 {
@@ -40,7 +41,7 @@ namespace Havana::Graphics::D3D12
 		constexpr D3D12_GPU_DESCRIPTOR_HANDLE GpuStart() { return m_gpuStart; }
 		constexpr ID3D12DescriptorHeap* const Heap() { return m_heap; }
 		constexpr u32 Capactity() { return m_capacity; }
-		constexpr u32 Size() { return m_size; }
+		u32 Size() const { return m_indices.Size(); }
 		constexpr u32 DescriptorSize() { return m_descriptorSize; }
 		constexpr bool IsShaderVisible() { return m_gpuStart.ptr != 0; }
 
@@ -48,11 +49,8 @@ namespace Havana::Graphics::D3D12
 		ID3D12DescriptorHeap*				m_heap;
 		D3D12_CPU_DESCRIPTOR_HANDLE			m_cpuStart{};
 		D3D12_GPU_DESCRIPTOR_HANDLE			m_gpuStart{};
-		std::unique_ptr<u32[]>				m_freeHandles{};
-		Utils::vector<u32>					m_deferredFreeIndices[frameBufferCount]{};
-		std::mutex							m_mutex{};
+		Utils::IndexPool<frameBufferCount>	m_indices{};
 		u32									m_capacity{ 0 };
-		u32									m_size{ 0 };
 		u32									m_descriptorSize{ 0 };
 		const D3D12_DESCRIPTOR_HEAP_TYPE	m_type{};
 	};
@@ -20,10 +20,10 @@ namespace Havana::Graphics::D3D12
 		assert(factory && cmdQueue);
 		Release();
 
-		if (SUCCEEDED(factory->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &m_allowTearing, sizeof(u32))) && m_allowTearing)
-		{
-			m_presentFlags = DXGI_PRESENT_ALLOW_TEARING;
-		}
+		if (FAILED(factory->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &m_allowTearing, sizeof(u32))))
+			m_allowTearing = 0;
+		// Surfaces start out presenting immediately, which is mailbox without tearing support
+		SetPresentMode(m_presentMode);
 
 		DXGI_SWAP_CHAIN_DESC1 desc{};
 		desc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
@@ -59,10 +59,23 @@ namespace Havana::Graphics::D3D12
 	void D3D12Surface::Present() const
 	{
 		assert(m_swapChain);
-		DXCall(m_swapChain->Present(0, m_presentFlags));
+		DXCall(m_swapChain->Present(m_syncInterval, m_presentFlags));
 		m_currentBBIndex = m_swapChain->GetCurrentBackBufferIndex();
 	}
 
+	void D3D12Surface::SetPresentMode(PresentMode mode)
+	{
+		// DXGI has no late-swap tearing, so adaptive is plain vsync. With the flip model,
+		// an interval of 0 without ALLOW_TEARING lets the compositor show the newest
+		// frame at each vertical blank, which is mailbox presentation.
+		if (mode == PresentMode::Immediate && !m_allowTearing) mode = PresentMode::Mailbox;
+		if (mode == PresentMode::Adaptive) mode = PresentMode::VSync;
+
+		m_presentMode = mode;
+		m_syncInterval = mode == PresentMode::VSync ? 1 : 0;
+		m_presentFlags = mode == PresentMode::Immediate ? DXGI_PRESENT_ALLOW_TEARING : 0;
+	}
+
 	void D3D12Surface::Resize()
 	{
 		// TODO: implement
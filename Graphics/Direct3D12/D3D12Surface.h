@@ -16,7 +16,7 @@ namespace Havana::Graphics::D3D12
 		constexpr D3D12Surface(D3D12Surface&& o)
 			: m_swapChain{ o.m_swapChain }, m_window{ o.m_window }, m_currentBBIndex{ o.m_currentBBIndex },
 			m_viewport{ o.m_viewport }, m_scissorRect{ o.m_scissorRect }, m_allowTearing{ o.m_allowTearing },
-			m_presentFlags{ o.m_presentFlags }
+			m_presentFlags{ o.m_presentFlags }, m_syncInterval{ o.m_syncInterval }, m_presentMode{ o.m_presentMode }
 		{
 			for (u32 i{ 0 }; i < frameBufferCount; i++)
 			{
@@ -44,6 +44,8 @@ namespace Havana::Graphics::D3D12
 		void CreateSwapChain(IDXGIFactory7* factory, ID3D12CommandQueue* cmdQueue, DXGI_FORMAT format);
 		void Present() const;
 		void Resize();
+		void SetPresentMode(PresentMode mode);
+		constexpr PresentMode GetPresentMode() const { return m_presentMode; }
 		constexpr u32 Width() const { return (u32)m_viewport.Width; }
 		constexpr u32 Height() const { return (u32)m_viewport.Height; }
 		constexpr ID3D12Resource* const BackBuffer() const { return m_renderTargetData[m_currentBBIndex].resource; }
@@ -64,6 +66,8 @@ namespace Havana::Graphics::D3D12
 		mutable u32			m_currentBBIndex{ 0 };
 		u32					m_allowTearing{ 0 };
 		u32					m_presentFlags{ 0 };
+		u32					m_syncInterval{ 0 };
+		PresentMode			m_presentMode{ PresentMode::Immediate };
 		D3D12_VIEWPORT		m_viewport{ 0 };
 		D3D12_RECT			m_scissorRect{ 0 };
 
@@ -82,6 +86,8 @@ namespace Havana::Graphics::D3D12
 			m_currentBBIndex = 0;
 			m_allowTearing = 0;
 			m_presentFlags = 0;
+			m_syncInterval = 0;
+			m_presentMode = PresentMode::Immediate;
 			m_viewport = {};
 			m_scissorRect = {};
 		}
@@ -97,6 +103,8 @@ namespace Havana::Graphics::D3D12
 			m_currentBBIndex = o.m_currentBBIndex;
 			m_allowTearing = o.m_allowTearing;
 			m_presentFlags = o.m_presentFlags;
+			m_syncInterval = o.m_syncInterval;
+			m_presentMode = o.m_presentMode;
 			m_viewport = o.m_viewport;
 			m_scissorRect = o.m_scissorRect;
 
@@ -0,0 +1,149 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace Havana::Graphics::FrameStatistics
+{
+	namespace
+	{
+		// Overlay layout in pixels, anchored at the scissor origin of the surface
+		constexpr u32 overlayFrameCount{ 128 };
+		constexpr u32 overlayBarWidth{ 2 };
+		constexpr u32 overlayMargin{ 8 };
+		constexpr f32 overlayPixelsPerMs{ 4.0f };
+		constexpr u32 overlayHeight{ 200 };		// 50 ms
+		constexpr f32 targetFrameMs{ 1000.0f / 60.0f };
+		constexpr f32 slowFrameMs{ 1000.0f / 30.0f };
+
+		FrameTimes	history[frameStatsHistorySize]{};
+		u32			next{ 0 };
+		u32			count{ 0 };
+		u64			frameCount{ 0 };
+
+		// Nearest rank percentile of sorted values
+		FrameTimePercentiles Percentiles(f32* const values, u32 valueCount)
+		{
+			if (!valueCount) return {};
+			std::sort(values, values + valueCount);
+			auto rank = [values, valueCount](u32 percent)
+			{
+				const u32 index{ (valueCount * percent + 99) / 100 };
+				return values[std::max(index, 1u) - 1];
+			};
+			return { rank(50), rank(95), rank(99), values[valueCount - 1] };
+		}
+
+		template<typename F>
+		FrameTimePercentiles Percentiles(F field)
+		{
+			f32 values[frameStatsHistorySize];
+			for (u32 i{ 0 }; i < count; i++) values[i] = field(history[i]);
+			return Percentiles(&values[0], count);
+		}
+
+		void RecordRect(CommandList& list, u32 x, u32 y, u32 width, u32 height, f32 r, f32 g, f32 b)
+		{
+			if (!width || !height) return;
+			list.Record(SetScissorCommand{ (s32)x, (s32)y, width, height });
+			ClearCommand clear{};
+			clear.color[0] = r;
+			clear.color[1] = g;
+			clear.color[2] = b;
+			clear.color[3] = 1.0f;
+			clear.flags = ClearFlags::Color;
+			list.Record(clear);
+		}
+
+		constexpr u32 MsToPixels(f32 ms)
+		{
+			const f32 pixels{ ms * overlayPixelsPerMs };
+			return pixels < (f32)overlayHeight ? (u32)pixels : overlayHeight;
+		}
+	} // anonymous namespace
+
+	void Record(const FrameTimes& times)
+	{
+		history[next] = times;
+		next = (next + 1) % frameStatsHistorySize;
+		count = std::min(count + 1, frameStatsHistorySize);
+		frameCount++;
+	}
+
+	FrameStats Compute()
+	{
+		FrameStats stats{};
+		stats.frameCount = frameCount;
+		stats.sampleCount = count;
+		if (!count) return stats;
+
+		stats.cpu = Percentiles([](const FrameTimes& t) { return t.cpuMs; });
+		stats.gpu = Percentiles([](const FrameTimes& t) { return t.gpuMs; });
+		stats.presentInterval = Percentiles([](const FrameTimes& t) { return t.presentIntervalMs; });
+		for (u32 i{ 0 }; i < count; i++)
+			stats.maxFramesInFlight = std::max(stats.maxFramesInFlight, history[i].framesInFlight);
+		stats.last = history[(next + frameStatsHistorySize - 1) % frameStatsHistorySize];
+		return stats;
+	}
+
+	void Reset()
+	{
+		next = 0;
+		count = 0;
+		frameCount = 0;
+	}
+
+	u32 WriteJson(const FrameStats& stats, char* const buffer, u32 size)
+	{
+		assert(buffer || !size);
+		const FrameTimePercentiles& cpu{ stats.cpu };
+		const FrameTimePercentiles& gpu{ stats.gpu };
+		const FrameTimePercentiles& present{ stats.presentInterval };
+		const s32 length{ snprintf(buffer, size,
+			"{\"frames\":%llu,\"samples\":%u,"
+			"\"cpuMs\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"worst\":%.3f},"
+			"\"gpuMs\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"worst\":%.3f},"
+			"\"presentIntervalMs\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"worst\":%.3f},"
+			"\"framesInFlight\":{\"last\":%u,\"max\":%u}}",
+			(unsigned long long)stats.frameCount, stats.sampleCount,
+			cpu.p50, cpu.p95, cpu.p99, cpu.worst,
+			gpu.p50, gpu.p95, gpu.p99, gpu.worst,
+			present.p50, present.p95, present.p99, present.worst,
+			stats.last.framesInFlight, stats.maxFramesInFlight) };
+		return length > 0 ? (u32)length : 0;
+	}
+
+	void RecordOverlay(CommandList& list)
+	{
+		SetRenderTargetsCommand targets{};
+		for (u32 i{ 0 }; i < maxRenderTargets; i++) targets.colors[i] = U32_INVALID_ID;
+		targets.colors[0] = backBufferRenderTarget;
+		targets.depthStencil = U32_INVALID_ID;
+		list.Record(targets);
+		list.Record(SetRenderStateCommand{ RenderStateFlags::ScissorTest });
+
+		const u32 width{ overlayFrameCount * overlayBarWidth };
+		RecordRect(list, overlayMargin, overlayMargin, width, overlayHeight, 0.05f, 0.05f, 0.05f);
+
+		// Oldest frame on the left
+		const u32 frames{ std::min(count, overlayFrameCount) };
+		for (u32 i{ 0 }; i < frames; i++)
+		{
+			const FrameTimes& times{ history[(next + frameStatsHistorySize - frames + i) % frameStatsHistorySize] };
+			const f32 ms{ times.presentIntervalMs };
+			const bool isSlow{ ms > slowFrameMs }, isLate{ ms > targetFrameMs };
+			const u32 x{ overlayMargin + (overlayFrameCount - frames + i) * overlayBarWidth };
+			RecordRect(list, x, overlayMargin, overlayBarWidth, MsToPixels(ms),
+					   isLate ? 0.9f : 0.1f, isSlow ? 0.1f : 0.8f, 0.1f);
+
+			// GPU time as a tick on the bar
+			if (times.gpuMs > 0.0f)
+				RecordRect(list, x, overlayMargin + MsToPixels(times.gpuMs), overlayBarWidth, 1, 0.2f, 0.6f, 1.0f);
+		}
+
+		RecordRect(list, overlayMargin, overlayMargin + MsToPixels(targetFrameMs), width, 1, 0.8f, 0.8f, 0.8f);
+		RecordRect(list, overlayMargin, overlayMargin + MsToPixels(slowFrameMs), width, 1, 0.8f, 0.8f, 0.8f);
+
+		// Back to the default state, depth clears need depth writes
+		list.Record(SetRenderStateCommand{ RenderStateFlags::DepthWrite });
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "Renderer.h"
+
+// History of frame timings kept in a fixed ring of the last frameStatsHistorySize
+// frames. Used by the renderer, the public interface is in Renderer.h.
+namespace Havana::Graphics::FrameStatistics
+{
+	void Record(const FrameTimes& times);
+	FrameStats Compute();
+	void Reset();
+	u32 WriteJson(const FrameStats& stats, char* const buffer, u32 size);
+
+	// Draws a bar per frame (present interval) with scissored clears, so it works
+	// without any shaders. Bars turn yellow past 60 Hz and red past 30 Hz.
+	void RecordOverlay(CommandList& list);
+}
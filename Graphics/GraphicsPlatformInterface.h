@@ -9,6 +9,7 @@ namespace Havana::Graphics
 	{
 		bool(*Initialize)(void);
 		void(*Shutdown)(void);
+		void(*RenderFrame)(const surface_id* const, u32);
 
 		struct
 		{
@@ -17,7 +18,28 @@ namespace Havana::Graphics
 			void(*Resize)(surface_id, u32, u32);
 			u32(*Width)(surface_id);
 			u32(*Height)(surface_id);
-			void(*Render)(surface_id);
+			void(*SetPresentMode)(surface_id, PresentMode);
+			PresentMode(*GetPresentMode)(surface_id);
 		} Surface;
+
+		struct
+		{
+			u32(*Create)(const RenderTargetDesc&);
+			void(*Remove)(u32);
+		} RenderTarget;
+
+		struct
+		{
+			// Replayed in this order on every surface of the next RenderFrame
+			void(*Submit)(const CommandList* const*, u32);
+			// Executed on every surface after its frame, nullptr to remove
+			void(*SetOverlay)(const CommandList*);
+		} Commands;
+
+		struct
+		{
+			f32(*GpuFrameTime)(void);
+			u32(*FramesInFlight)(void);
+		} Stats;
 	};
 }
\ No newline at end of file
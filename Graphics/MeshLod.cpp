@@ -0,0 +1,31 @@
+#include "MeshLod.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Havana::Graphics::Lod
+{
+	f32 ProjectionScale(f32 fovY, f32 viewportHeight)
+	{
+		assert(fovY > 0.0f && viewportHeight > 0.0f);
+		return viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+	}
+
+	u32 SelectLod(const LodLevel* const levels, u32 levelCount, const LodView& view,
+				  const f32* const center, f32 radius, f32 worldScale, u32 currentLod)
+	{
+		assert(levels && levelCount && levelCount <= maxLods && center);
+		if (levelCount == 1) return 0;
+
+		// Distance to the nearest point of the bounds, the error can't be closer than that
+		const f32 dx{ center[0] - view.cameraPosition[0] };
+		const f32 dy{ center[1] - view.cameraPosition[1] };
+		const f32 dz{ center[2] - view.cameraPosition[2] };
+		const f32 distance{ std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - radius, 1e-4f) };
+		const f32 pixelsPerUnit{ view.projectionScale * worldScale / distance };
+
+		u32 lod{ std::min(currentLod, levelCount - 1) };
+		while (lod + 1 < levelCount && levels[lod + 1].error * pixelsPerUnit <= view.pixelError * (1.0f - view.hysteresis)) lod++;
+		while (lod > 0 && levels[lod].error * pixelsPerUnit > view.pixelError * (1.0f + view.hysteresis)) lod--;
+		return lod;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "../Common/CommonHeaders.h"
+
+// Runtime choice between the levels of detail of a mesh (see Content/MeshSimplifier.h).
+// A level is good enough while its error, projected onto the screen, stays under
+// pixelError pixels. To keep instances near a threshold from flipping every frame, a
+// coarser level is only taken once it's comfortably under the threshold and a finer
+// one only once the current level is clearly over it.
+//
+// GPU culling runs the same selection per instance (see OpenGLGpuCulling.cpp), keep
+// the two in line.
+namespace Havana::Graphics::Lod
+{
+	constexpr u32 maxLods{ 8 };
+
+	struct LodLevel
+	{
+		u32 firstIndex{ 0 };
+		u32 indexCount{ 0 };
+		f32 error{ 0.0f };		// in mesh units, 0 for the full mesh
+	};
+
+	struct LodView
+	{
+		f32 cameraPosition[3]{};
+		f32 projectionScale{ 0.0f };	// pixels per world unit at distance 1, see ProjectionScale()
+		f32 pixelError{ 1.0f };			// largest error on screen
+		f32 hysteresis{ 0.25f };		// fraction of pixelError
+	};
+
+	// For a perspective projection with a vertical field of view in radians
+	f32 ProjectionScale(f32 fovY, f32 viewportHeight);
+
+	/// <summary>
+	/// Picks the level of detail for one instance of a mesh.
+	/// </summary>
+	/// <param name="levels"> - Finest first, with increasing errors.</param>
+	/// <param name="center"> - World space bounding sphere center.</param>
+	/// <param name="worldScale"> - Largest scale of the instance's world matrix, to bring errors into world units.</param>
+	/// <param name="currentLod"> - The level picked last frame, 0 if there is none.</param>
+	/// <returns>Index of the level to draw.</returns>
+	u32 SelectLod(const LodLevel* const levels, u32 levelCount, const LodView& view,
+				  const f32* const center, f32 radius, f32 worldScale, u32 currentLod = 0);
+}
@@ -1,6 +1,16 @@
 #pragma once
 
+// Core profile entry points beyond GL 1.1 are exported by libGL on Linux
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif // !GL_GLEXT_PROTOTYPES
 #include <GL/glx.h>
+#include <GL/glext.h>
 
 #include "../Renderer.h"
-#include "../../Common/CommonHeaders.h"
\ No newline at end of file
+#include "../../Common/CommonHeaders.h"
+
+namespace Havana::Graphics::OpenGL
+{
+	constexpr u32 frameBufferCount{ 3 };
+}
@@ -1,16 +1,279 @@
 #include "OpenGLCore.h"
 #include "OpenGLSurface.h"
+#include "OpenGLStateCache.h"
+#include "OpenGLShaders.h"
+#include "OpenGLTextures.h"
+#include "OpenGLGpuCulling.h"
+#include "OpenGLGpuProfiler.h"
+#include "../../Utilities/ObjectPool.h"
+#include <string.h>
 
 namespace Havana::Graphics::OpenGL::Core
 {
+	namespace
+	{
+		// Compiled program binaries are stored here, relative to the working directory
+		constexpr const char* programCacheDirectory{ "ShaderCache" };
+
+		// Streaming textures: resident mip budget and size of each per-frame upload segment
+		constexpr u64 textureMemoryBudget{ 512ull * 1024 * 1024 };
+		constexpr u32 textureUploadBytesPerFrame{ 16 * 1024 * 1024 };
+
+		constexpr GLenum ToGLTopology(PrimitiveTopology topology)
+		{
+			switch (topology)
+			{
+			case PrimitiveTopology::Points: return GL_POINTS;
+			case PrimitiveTopology::Lines: return GL_LINES;
+			case PrimitiveTopology::LineStrip: return GL_LINE_STRIP;
+			case PrimitiveTopology::TriangleStrip: return GL_TRIANGLE_STRIP;
+			default: return GL_TRIANGLES;
+			}
+		}
+
+		constexpr GLenum ToGLBufferTarget(BufferBinding binding)
+		{
+			switch (binding)
+			{
+			case BufferBinding::Index: return GL_ELEMENT_ARRAY_BUFFER;
+			case BufferBinding::Uniform: return GL_UNIFORM_BUFFER;
+			case BufferBinding::Storage: return GL_SHADER_STORAGE_BUFFER;
+			case BufferBinding::Indirect: return GL_DRAW_INDIRECT_BUFFER;
+			default: return GL_ARRAY_BUFFER;
+			}
+		}
+
+		constexpr GLenum ToGLFormat(RenderTargetFormat format)
+		{
+			switch (format)
+			{
+			case RenderTargetFormat::RGBA16F: return GL_RGBA16F;
+			case RenderTargetFormat::R11G11B10F: return GL_R11F_G11F_B10F;
+			case RenderTargetFormat::Depth24Stencil8: return GL_DEPTH24_STENCIL8;
+			case RenderTargetFormat::Depth32F: return GL_DEPTH_COMPONENT32F;
+			default: return GL_RGBA8;
+			}
+		}
+
+		// Render targets are plain textures. Framebuffer objects are created lazily for
+		// each combination of attachments that is bound and reused after that.
+		struct RenderTargetInfo
+		{
+			GLuint				texture{ 0 };
+			RenderTargetFormat	format{};
+		};
+
+		// One context for the whole backend. It's made current on each surface in turn,
+		// and on a small pbuffer when there is no surface (e.g. during Initialize).
+		Display*		display{ nullptr };
+		GLXContext		context{ nullptr };
+		GLXPbuffer		pbuffer{ 0 };
+
+		constexpr u32 maxSurfaces{ 64 };
+		Utils::ObjectPool<OpenGLSurface, surface_id> surfaces{ maxSurfaces, Memory::Tag::Graphics };
+
+		OpenGLSurface& GetSurface(surface_id id)
+		{
+			OpenGLSurface& surface{ surfaces.Get(id) };
+			assert(surface.IsValid());
+			return surface;
+		}
+
+		// Use a frame buffer config that matches the default visual, which is what
+		// Platform creates windows with.
+		GLXFBConfig ChooseConfig()
+		{
+			static const int configAttribs[]{
+				GLX_RENDER_TYPE, GLX_RGBA_BIT,
+				GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT | GLX_PBUFFER_BIT,
+				GLX_DOUBLEBUFFER, True,
+				GLX_RED_SIZE, 8,
+				GLX_GREEN_SIZE, 8,
+				GLX_BLUE_SIZE, 8,
+				GLX_DEPTH_SIZE, 24,
+				None
+			};
+
+			int configCount{ 0 };
+			GLXFBConfig* const configs{ glXChooseFBConfig(display, DefaultScreen(display), configAttribs, &configCount) };
+			if (!configs) return nullptr;
+
+			const VisualID defaultVisual{ XVisualIDFromVisual(DefaultVisual(display, DefaultScreen(display))) };
+			GLXFBConfig config{ configs[0] };
+			for (int i{ 0 }; i < configCount; i++)
+			{
+				int visual{ 0 };
+				glXGetFBConfigAttrib(display, configs[i], GLX_VISUAL_ID, &visual);
+				if ((VisualID)visual == defaultVisual)
+				{
+					config = configs[i];
+					break;
+				}
+			}
+
+			XFree(configs);
+			return config;
+		}
+
+		bool CreateContext()
+		{
+			// Shader compilation uses GLX from worker threads. Platform::MakeWindow() does the
+			// same, so this holds whether the renderer or the first window opens the display first.
+			static const Status threadsInitialized{ XInitThreads() };
+			(void)threadsInitialized;
+
+			display = XOpenDisplay(nullptr);
+			if (!display) return false;
+
+			const GLXFBConfig config{ ChooseConfig() };
+			const auto glXCreateContextAttribsARB{ (Platform::glXCreateContextAttribsARBProc)
+				glXGetProcAddress((const GLubyte*)"glXCreateContextAttribsARB") };
+			if (!config || !glXCreateContextAttribsARB) return false;
+
+			// 4.3 for storage buffers, compute and multi-draw indirect
+			const int contextAttribs[]{
+				GLX_CONTEXT_MAJOR_VERSION_ARB, 4,
+				GLX_CONTEXT_MINOR_VERSION_ARB, 3,
+				GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+				None
+			};
+			context = glXCreateContextAttribsARB(display, config, nullptr, True, contextAttribs);
+
+			const int pbufferAttribs[]{ GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None };
+			pbuffer = context ? glXCreatePbuffer(display, config, pbufferAttribs) : 0;
+			return pbuffer && glXMakeContextCurrent(display, pbuffer, pbuffer, context);
+		}
+
+		void DestroyContext()
+		{
+			if (display)
+			{
+				glXMakeContextCurrent(display, None, None, nullptr);
+				if (pbuffer) glXDestroyPbuffer(display, pbuffer);
+				if (context) glXDestroyContext(display, context);
+				XCloseDisplay(display);
+			}
+			display = nullptr;
+			context = nullptr;
+			pbuffer = 0;
+		}
+
+		// Fence at the end of each of the last frames, to count the frames the GPU is still working on
+		GLsync											frameFences[frameBufferCount]{};
+		u32												frameFenceIndex{ 0 };
+		const CommandList*								overlay{ nullptr };
+		// Command lists of the next frame, owned by the renderer until that frame is rendered
+		const CommandList* const*						frameLists{ nullptr };
+		u32												frameListCount{ 0 };
+
+		std::unordered_map<GLuint, RenderTargetInfo>	renderTargets;
+		std::unordered_map<u64, GLuint>					framebuffers;
+
+		u64 HashAttachments(const SetRenderTargetsCommand& c)
+		{
+			// FNV-1a
+			u64 hash{ 0xcbf29ce484222325ull };
+			auto add = [&hash](u32 value) { hash = (hash ^ value) * 0x100000001b3ull; };
+			for (u32 i{ 0 }; i < maxRenderTargets; i++) add(c.colors[i]);
+			add(c.depthStencil);
+			return hash;
+		}
+
+		GLuint GetFramebuffer(const SetRenderTargetsCommand& c)
+		{
+			if (c.colors[0] == backBufferRenderTarget) return 0;
+
+			const u64 key{ HashAttachments(c) };
+			auto it{ framebuffers.find(key) };
+			if (it != framebuffers.end()) return it->second;
+
+			GLuint fbo{ 0 };
+			glGenFramebuffers(1, &fbo);
+			State::BindFramebuffer(fbo);
+
+			GLenum drawBuffers[maxRenderTargets]{};
+			u32 drawBufferCount{ 0 };
+			for (u32 i{ 0 }; i < maxRenderTargets; i++)
+			{
+				if (c.colors[i] == U32_INVALID_ID) continue;
+				glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, c.colors[i], 0);
+				drawBuffers[drawBufferCount++] = GL_COLOR_ATTACHMENT0 + i;
+			}
+			glDrawBuffers((GLsizei)drawBufferCount, &drawBuffers[0]);
+
+			if (c.depthStencil != U32_INVALID_ID)
+			{
+				assert(renderTargets.count(c.depthStencil));
+				const GLenum attachment{ (GLenum)(renderTargets[c.depthStencil].format == RenderTargetFormat::Depth24Stencil8
+												  ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT) };
+				glFramebufferTexture(GL_FRAMEBUFFER, attachment, c.depthStencil, 0);
+			}
+
+			assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+			framebuffers[key] = fbo;
+			return fbo;
+		}
+
+		// Block until the GPU is done with the frame that used this fence, frameBufferCount
+		// frames ago. This keeps the CPU at most that many frames ahead.
+		void WaitForFence(GLsync& fence)
+		{
+			if (!fence) return;
+			constexpr GLuint64 timeout{ 100'000'000 }; // 100ms
+			GLenum result{ glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout) };
+			while (result == GL_TIMEOUT_EXPIRED)
+				result = glClientWaitSync(fence, 0, timeout);
+			assert(result != GL_WAIT_FAILED);
+
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	} // anonymous namespace
+
     bool Initialize()
     {
+		if (!CreateContext())
+		{
+			DestroyContext();
+			return false;
+		}
 
+		State::Invalidate();
+
+		// GPU timings are optional, scopes are ignored when timestamps aren't supported
+		GpuProfiler::Initialize();
+		return Shaders::Initialize(programCacheDirectory) &&
+			   Textures::Initialize(textureMemoryBudget, textureUploadBytesPerFrame) &&
+			   Culling::Initialize();
     }
 
     void Shutdown()
     {
+		for (GLsync& fence : frameFences)
+		{
+			if (fence) glDeleteSync(fence);
+			fence = nullptr;
+		}
+		overlay = nullptr;
+		frameLists = nullptr;
+		frameListCount = 0;
+
+		GpuProfiler::Shutdown();
+		Culling::Shutdown();
+		Textures::Shutdown();
+		Shaders::Shutdown();
+
+		for (auto& [key, fbo] : framebuffers)
+			glDeleteFramebuffers(1, &fbo);
+		framebuffers.clear();
+
+		for (auto& [handle, info] : renderTargets)
+			glDeleteTextures(1, &info.texture);
+		renderTargets.clear();
 
+		surfaces.Clear();
+		State::Invalidate();
+		DestroyContext();
     }
 
 	void Render()
@@ -18,33 +281,288 @@ namespace Havana::Graphics::OpenGL::Core
 
     }
 
-    Surface CreateSurface(Platform::Window window)
-    {
+	// Check the context for an extension string such as "GL_KHR_parallel_shader_compile"
+	bool HasExtension(const char* name)
+	{
+		GLint count{ 0 };
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i{ 0 }; i < count; i++)
+		{
+			const char* extension{ (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i) };
+			if (extension && !strcmp(extension, name)) return true;
+		}
+		return false;
+	}
 
-    }
+	Surface CreateSurface(Platform::Window window)
+	{
+		assert(display && window.IsValid());
+		OpenGLSurface surface{ window };
+		surface.Resize(display);
+		surface.SetPresentMode(display, context, PresentMode::VSync);
+		return Surface{ surfaces.Add(surface) };
+	}
 
 	void RemoveSurface(surface_id id)
-    {
-
-    }
+	{
+		// Don't leave the context current on a window that may be destroyed next
+		if (glXGetCurrentDrawable() == GetSurface(id).Drawable())
+			glXMakeContextCurrent(display, pbuffer, pbuffer, context);
+		surfaces.Remove(id);
+	}
 
 	void ResizeSurface(surface_id id, u32, u32)
-    {
-
-    }
+	{
+		// The window owns the size of its drawable, so just read it back
+		GetSurface(id).Resize(display);
+	}
 
 	u32 SurfaceWidth(surface_id id)
-    {
-
-    }
+	{
+		return GetSurface(id).Width();
+	}
 
 	u32 SurfaceHeight(surface_id id)
-    {
+	{
+		return GetSurface(id).Height();
+	}
 
-    }
+	void SetSurfacePresentMode(surface_id id, PresentMode mode)
+	{
+		GetSurface(id).SetPresentMode(display, context, mode);
+	}
 
-	void RenderSurface(surface_id id)
-    {
-        
-    }
-}
\ No newline at end of file
+	PresentMode SurfacePresentMode(surface_id id)
+	{
+		return GetSurface(id).GetPresentMode();
+	}
+
+	/// <summary>
+	/// Render all surfaces as one frame. Per-frame work (state cache statistics, shader
+	/// compilation, texture streaming) runs once. Then the context is made current on each
+	/// surface in turn and the submitted command lists are replayed into its back buffer.
+	/// The work is flushed once, and then all surfaces are presented.
+	/// </summary>
+	/// <param name="ids"> - The surfaces to render.</param>
+	/// <param name="count"> - Number of surfaces.</param>
+	void RenderFrame(const surface_id* const ids, u32 count)
+	{
+		assert(ids && count);
+		GLsync& fence{ frameFences[frameFenceIndex] };
+		WaitForFence(fence);
+
+		State::BeginFrame();
+		Shaders::Update();
+		Textures::Update();
+		GpuProfiler::BeginFrame();
+
+		for (u32 i{ 0 }; i < count; i++)
+		{
+			const OpenGLSurface& surface{ GetSurface(ids[i]) };
+			surface.MakeCurrent(display, context);
+			State::BindFramebuffer(0);
+			State::Viewport(0, 0, surface.Width(), surface.Height());
+
+			for (u32 j{ 0 }; j < frameListCount; j++)
+				ExecuteCommandList(*frameLists[j]);
+
+			// The lists may have left an offscreen target bound
+			State::BindFramebuffer(0);
+			State::Viewport(0, 0, surface.Width(), surface.Height());
+			if (overlay) ExecuteCommandList(*overlay);
+		}
+
+		frameLists = nullptr;
+		frameListCount = 0;
+		GpuProfiler::EndFrame();
+
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frameFenceIndex = (frameFenceIndex + 1) % frameBufferCount;
+		glFlush();
+
+		// Swapping doesn't need the drawable to be current
+		for (u32 i{ 0 }; i < count; i++)
+			GetSurface(ids[i]).Present(display);
+	}
+
+	u32 CreateRenderTarget(const RenderTargetDesc& desc)
+	{
+		PROFILE_SCOPE("OpenGL::CreateRenderTarget");
+		GLuint texture{ 0 };
+		glGenTextures(1, &texture);
+		State::BindTexture(0, GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, ToGLFormat(desc.format), (GLsizei)desc.width, (GLsizei)desc.height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		assert(texture != backBufferRenderTarget);
+		renderTargets[texture] = { texture, desc.format };
+		return texture;
+	}
+
+	void RemoveRenderTarget(u32 handle)
+	{
+		PROFILE_SCOPE("OpenGL::RemoveRenderTarget");
+		assert(renderTargets.count(handle));
+
+		// We don't track which framebuffers use which texture, so drop them all.
+		// Render targets only get removed when a render graph is recompiled.
+		for (auto& [key, fbo] : framebuffers)
+		{
+			glDeleteFramebuffers(1, &fbo);
+			State::OnFramebufferDeleted(fbo);
+		}
+		framebuffers.clear();
+
+		GLuint texture{ handle };
+		glDeleteTextures(1, &texture);
+		State::OnTextureDeleted(texture);
+		renderTargets.erase(handle);
+	}
+
+	// The lists have to stay alive until the next RenderFrame() returns.
+	void SubmitCommandLists(const CommandList* const* lists, u32 count)
+	{
+		assert(lists || !count);
+		frameLists = lists;
+		frameListCount = count;
+	}
+
+	void SetOverlay(const CommandList* list)
+	{
+		overlay = list;
+	}
+
+	f32 GpuFrameTime()
+	{
+		return GpuProfiler::FrameTiming().lastMs;
+	}
+
+	u32 FramesInFlight()
+	{
+		u32 count{ 0 };
+		for (const GLsync fence : frameFences)
+		{
+			if (!fence) continue;
+			GLint status{ GL_SIGNALED };
+			glGetSynciv(fence, GL_SYNC_STATUS, 1, nullptr, &status);
+			if (status != GL_SIGNALED) count++;
+		}
+		return count;
+	}
+
+	// Replay a recorded command list. Must be called on the thread that has the context current.
+	void ExecuteCommandList(const CommandList& list)
+	{
+		PROFILE_SCOPE("OpenGL::ExecuteCommandList");
+		for (const CommandHeader* cmd{ list.Begin() }; cmd != list.End(); cmd = cmd->Next())
+		{
+			switch (cmd->type)
+			{
+			case Command::SetRenderTargets:
+				State::BindFramebuffer(GetFramebuffer(cmd->As<SetRenderTargetsCommand>()));
+				break;
+			case Command::SetViewport:
+			{
+				const SetViewportCommand& c{ cmd->As<SetViewportCommand>() };
+				State::Viewport(c.x, c.y, c.width, c.height);
+			}
+			break;
+			case Command::SetScissor:
+			{
+				const SetScissorCommand& c{ cmd->As<SetScissorCommand>() };
+				State::Scissor(c.x, c.y, c.width, c.height);
+			}
+			break;
+			case Command::Clear:
+			{
+				const ClearCommand& c{ cmd->As<ClearCommand>() };
+				GLbitfield mask{ 0 };
+				if (c.flags & ClearFlags::Color)
+				{
+					State::ClearColor(c.color[0], c.color[1], c.color[2], c.color[3]);
+					mask |= GL_COLOR_BUFFER_BIT;
+				}
+				if (c.flags & ClearFlags::Depth)
+				{
+					State::ClearDepth(c.depth);
+					mask |= GL_DEPTH_BUFFER_BIT;
+				}
+				if (c.flags & ClearFlags::Stencil)
+				{
+					State::ClearStencil(c.stencil);
+					mask |= GL_STENCIL_BUFFER_BIT;
+				}
+				if (mask) glClear(mask);
+			}
+			break;
+			case Command::SetRenderState:
+			{
+				const SetRenderStateCommand& c{ cmd->As<SetRenderStateCommand>() };
+				State::SetCapability(GL_DEPTH_TEST, c.flags & RenderStateFlags::DepthTest);
+				State::DepthMask(c.flags & RenderStateFlags::DepthWrite);
+				State::SetCapability(GL_BLEND, c.flags & RenderStateFlags::Blend);
+				State::SetCapability(GL_CULL_FACE, c.flags & RenderStateFlags::CullBackFaces);
+				State::SetCapability(GL_SCISSOR_TEST, c.flags & RenderStateFlags::ScissorTest);
+			}
+			break;
+			case Command::BindProgram:
+				State::UseProgram(cmd->As<BindProgramCommand>().program);
+				break;
+			case Command::BindVertexArray:
+				State::BindVertexArray(cmd->As<BindVertexArrayCommand>().vertexArray);
+				break;
+			case Command::BindBuffer:
+			{
+				const BindBufferCommand& c{ cmd->As<BindBufferCommand>() };
+				const GLenum target{ ToGLBufferTarget(c.binding) };
+				if (c.binding == BufferBinding::Uniform || c.binding == BufferBinding::Storage)
+					State::BindBufferBase(target, c.slot, c.buffer);
+				else
+					State::BindBuffer(target, c.buffer);
+			}
+			break;
+			case Command::BindTexture:
+			{
+				const BindTextureCommand& c{ cmd->As<BindTextureCommand>() };
+				State::BindTexture(c.unit, GL_TEXTURE_2D, c.texture);
+			}
+			break;
+			case Command::Draw:
+			{
+				const DrawCommand& c{ cmd->As<DrawCommand>() };
+				glDrawArraysInstancedBaseInstance(ToGLTopology(c.topology), (GLint)c.firstVertex,
+												  (GLsizei)c.vertexCount, (GLsizei)c.instanceCount, c.baseInstance);
+			}
+			break;
+			case Command::DrawIndexed:
+			{
+				const DrawIndexedCommand& c{ cmd->As<DrawIndexedCommand>() };
+				const void* const offset{ (const void*)(uintptr_t)(c.firstIndex * sizeof(u32)) };
+				glDrawElementsInstancedBaseVertexBaseInstance(ToGLTopology(c.topology), (GLsizei)c.indexCount,
+															  GL_UNSIGNED_INT, offset, (GLsizei)c.instanceCount,
+															  c.baseVertex, c.baseInstance);
+			}
+			break;
+			case Command::DrawIndexedIndirect:
+			{
+				const DrawIndexedIndirectCommand& c{ cmd->As<DrawIndexedIndirectCommand>() };
+				glMultiDrawElementsIndirect(ToGLTopology(c.topology), GL_UNSIGNED_INT, (const void*)(uintptr_t)c.offset,
+											(GLsizei)c.drawCount, (GLsizei)c.stride);
+			}
+			break;
+			case Command::BeginGpuScope:
+				GpuProfiler::BeginScope(cmd->As<BeginGpuScopeCommand>().name);
+				break;
+			case Command::EndGpuScope:
+				GpuProfiler::EndScope();
+				break;
+			default:
+				// Unknown commands are skipped using the size in the header.
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,250 @@
+#include "OpenGLGpuCulling.h"
+#include "OpenGLShaders.h"
+#include "OpenGLStateCache.h"
+#include "../../Utilities/ObjectPool.h"
+#include <cmath>
+
+namespace Havana::Graphics::OpenGL::Culling
+{
+	namespace
+	{
+		constexpr u32 groupSize{ 64 };
+
+		// Storage buffer bindings, the draw data uses StaticBatch::drawDataBinding (0)
+		constexpr u32 sourceCommandsBinding{ 1 };
+		constexpr u32 culledCommandsBinding{ 2 };
+		constexpr u32 visibleDrawsBinding{ 3 };
+		constexpr u32 lodErrorsBinding{ 4 };
+		constexpr u32 lodStatesBinding{ 5 };
+
+		// Uniform locations
+		constexpr GLint countLocation{ 0 };
+		constexpr GLint planesLocation{ 1 };		// 6 locations
+		constexpr GLint lodViewLocation{ 7 };
+		constexpr GLint lodThresholdsLocation{ 8 };
+
+		// Copies the batch's commands with instanceCount cleared
+		constexpr const char* resetSource{ R"(#version 430
+layout(local_size_x = 64) in;
+
+struct DrawCommand { uint indexCount; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };
+layout(std430, binding = 1) readonly buffer SourceCommands { DrawCommand sourceCommands[]; };
+layout(std430, binding = 2) writeonly buffer CulledCommands { DrawCommand culledCommands[]; };
+layout(location = 0) uniform uint commandCount;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= commandCount) return;
+	DrawCommand command = sourceCommands[i];
+	command.instanceCount = 0;
+	culledCommands[i] = command;
+}
+)" };
+
+		// One invocation per instance. Visible instances are appended to the range of the
+		// draw id buffer that starts at the baseInstance of the command for their level.
+		// The level selection mirrors Lod::SelectLod().
+		constexpr const char* cullSource{ R"(#version 430
+layout(local_size_x = 64) in;
+
+struct DrawData { mat4 world; vec3 boundsCenter; float boundsRadius; uint mesh; uint material; uint command; uint lodCount; };
+struct DrawCommand { uint indexCount; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };
+layout(std430, binding = 0) readonly buffer Draws { DrawData draws[]; };
+layout(std430, binding = 2) buffer CulledCommands { DrawCommand culledCommands[]; };
+layout(std430, binding = 3) writeonly buffer VisibleDraws { uint visibleDraws[]; };
+layout(std430, binding = 4) readonly buffer LodErrors { float lodErrors[]; };
+layout(std430, binding = 5) buffer LodStates { uint lodStates[]; };
+layout(location = 0) uniform uint drawCount;
+layout(location = 1) uniform vec4 planes[6];
+layout(location = 7) uniform vec4 lodView;			// camera position, projection scale (0 = no selection)
+layout(location = 8) uniform vec2 lodThresholds;	// pixel error to go coarser, to go finer
+
+uint SelectLod(uint i)
+{
+	uint lodCount = draws[i].lodCount;
+	if (lodView.w == 0.0 || lodCount == 1) return 0u;
+
+	mat4 world = draws[i].world;
+	float worldScale = sqrt(max(max(dot(world[0].xyz, world[0].xyz), dot(world[1].xyz, world[1].xyz)), dot(world[2].xyz, world[2].xyz)));
+	float nearest = max(length(draws[i].boundsCenter - lodView.xyz) - draws[i].boundsRadius, 1e-4);
+	float pixelsPerUnit = lodView.w * worldScale / nearest;
+
+	uint first = draws[i].command;
+	uint lod = min(lodStates[i], lodCount - 1);
+	while (lod + 1 < lodCount && lodErrors[first + lod + 1] * pixelsPerUnit <= lodThresholds.x) lod++;
+	while (lod > 0 && lodErrors[first + lod] * pixelsPerUnit > lodThresholds.y) lod--;
+	lodStates[i] = lod;
+	return lod;
+}
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= drawCount) return;
+
+	vec4 sphere = vec4(draws[i].boundsCenter, 1.0);
+	for (int p = 0; p < 6; p++)
+	{
+		if (dot(planes[p], sphere) < -draws[i].boundsRadius) return;
+	}
+
+	uint command = draws[i].command + SelectLod(i);
+	uint slot = atomicAdd(culledCommands[command].instanceCount, 1u);
+	visibleDraws[culledCommands[command].baseInstance + slot] = i;
+}
+)" };
+
+		struct CullingInfo
+		{
+			StaticBatch::batch_id	batch{ Id::INVALID_ID };
+			GLuint					culledCommands{ 0 };
+			GLuint					visibleDraws{ 0 };
+			GLuint					lodStates{ 0 };		// level of each instance last frame
+			u32						commandCount{ 0 };
+			u32						drawCount{ 0 };
+		};
+
+		constexpr u32 maxCullings{ 256 };
+
+		GLuint										resetProgram{ 0 };
+		GLuint										cullProgram{ 0 };
+		Utils::ObjectPool<CullingInfo, culling_id>	cullings{ maxCullings, Memory::Tag::Graphics };
+
+		GLuint CreateComputeProgram(const char* source)
+		{
+			const Shaders::ShaderSource stage{ GL_COMPUTE_SHADER, source };
+			return Shaders::CreateProgram(&stage, 1);
+		}
+
+		constexpr u32 GroupCount(u32 count)
+		{
+			return (count + groupSize - 1) / groupSize;
+		}
+	} // anonymous namespace
+
+	bool Initialize()
+	{
+		resetProgram = CreateComputeProgram(resetSource);
+		cullProgram = CreateComputeProgram(cullSource);
+		return resetProgram && cullProgram;
+	}
+
+	void Shutdown()
+	{
+		cullings.ForEach([](culling_id id, CullingInfo&) { RemoveCulling(id); });
+
+		if (resetProgram) Shaders::RemoveProgram(resetProgram);
+		if (cullProgram) Shaders::RemoveProgram(cullProgram);
+		resetProgram = 0;
+		cullProgram = 0;
+	}
+
+	culling_id CreateCulling(StaticBatch::batch_id batch)
+	{
+		const StaticBatch::StaticBatchStats stats{ StaticBatch::Stats(batch) };
+		assert(stats.commandCount && stats.drawCount);
+
+		CullingInfo info{};
+		info.batch = batch;
+		info.commandCount = stats.commandCount;
+		info.drawCount = stats.drawCount;
+
+		// Starts out as a copy of the batch's commands, so everything is drawn until the first Cull()
+		const GLsizeiptr commandBytes{ (GLsizeiptr)(stats.commandCount * sizeof(DrawIndexedIndirectArgs)) };
+		glGenBuffers(1, &info.culledCommands);
+		State::BindBuffer(GL_DRAW_INDIRECT_BUFFER, info.culledCommands);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, nullptr, GL_DYNAMIC_COPY);
+		State::BindBuffer(GL_COPY_READ_BUFFER, StaticBatch::IndirectBuffer(batch));
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_DRAW_INDIRECT_BUFFER, 0, 0, commandBytes);
+
+		const GLsizeiptr drawIdBytes{ (GLsizeiptr)(stats.drawIdCapacity * sizeof(u32)) };
+		glGenBuffers(1, &info.visibleDraws);
+		State::BindBuffer(GL_ARRAY_BUFFER, info.visibleDraws);
+		glBufferData(GL_ARRAY_BUFFER, drawIdBytes, nullptr, GL_DYNAMIC_COPY);
+		State::BindBuffer(GL_COPY_READ_BUFFER, StaticBatch::DrawIdBuffer(batch));
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, drawIdBytes);
+
+		// Everything starts at level 0
+		const Utils::vector<u32> lodStates(stats.drawCount, 0);
+		glGenBuffers(1, &info.lodStates);
+		State::BindBuffer(GL_SHADER_STORAGE_BUFFER, info.lodStates);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(lodStates.size() * sizeof(u32)), lodStates.data(), GL_DYNAMIC_COPY);
+
+		StaticBatch::SetDrawSource(batch, info.visibleDraws, info.culledCommands);
+		return cullings.Add(info);
+	}
+
+	void RemoveCulling(culling_id id)
+	{
+		CullingInfo& info{ cullings.Get(id) };
+		StaticBatch::SetDrawSource(info.batch, 0, 0);
+
+		glDeleteBuffers(1, &info.culledCommands);
+		State::OnBufferDeleted(info.culledCommands);
+		glDeleteBuffers(1, &info.visibleDraws);
+		State::OnBufferDeleted(info.visibleDraws);
+		glDeleteBuffers(1, &info.lodStates);
+		State::OnBufferDeleted(info.lodStates);
+		cullings.Remove(id);
+	}
+
+	void ExtractFrustumPlanes(const f32* const m, f32* const planes)
+	{
+		// Rows of the column-major matrix: row r is (m[r], m[4 + r], m[8 + r], m[12 + r])
+		auto row = [m](u32 r, u32 c) { return m[c * 4 + r]; };
+		for (u32 i{ 0 }; i < 3; i++)
+		{
+			for (u32 c{ 0 }; c < 4; c++)
+			{
+				planes[(i * 2 + 0) * 4 + c] = row(3, c) + row(i, c);	// left, bottom, near
+				planes[(i * 2 + 1) * 4 + c] = row(3, c) - row(i, c);	// right, top, far
+			}
+		}
+
+		// Normalize so the sphere test can compare against the radius
+		for (u32 p{ 0 }; p < 6; p++)
+		{
+			f32* const plane{ &planes[p * 4] };
+			const f32 length{ std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]) };
+			if (length > 0.0f) for (u32 c{ 0 }; c < 4; c++) plane[c] /= length;
+		}
+	}
+
+	void Cull(culling_id id, const f32* const planes, const Lod::LodView* const lodView)
+	{
+		assert(planes);
+		const CullingInfo& info{ cullings.Get(id) };
+
+		State::BindBufferBase(GL_SHADER_STORAGE_BUFFER, sourceCommandsBinding, StaticBatch::IndirectBuffer(info.batch));
+		State::BindBufferBase(GL_SHADER_STORAGE_BUFFER, culledCommandsBinding, info.culledCommands);
+		State::UseProgram(resetProgram);
+		glUniform1ui(countLocation, info.commandCount);
+		glDispatchCompute(GroupCount(info.commandCount), 1, 1);
+
+		// The counters have to be cleared before instances are appended
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		State::BindBufferBase(GL_SHADER_STORAGE_BUFFER, StaticBatch::drawDataBinding, StaticBatch::DrawDataBuffer(info.batch));
+		State::BindBufferBase(GL_SHADER_STORAGE_BUFFER, visibleDrawsBinding, info.visibleDraws);
+		State::BindBufferBase(GL_SHADER_STORAGE_BUFFER, lodErrorsBinding, StaticBatch::LodErrorBuffer(info.batch));
+		State::BindBufferBase(GL_SHADER_STORAGE_BUFFER, lodStatesBinding, info.lodStates);
+		State::UseProgram(cullProgram);
+		glUniform1ui(countLocation, info.drawCount);
+		glUniform4fv(planesLocation, 6, planes);
+		if (lodView)
+		{
+			const f32* const camera{ lodView->cameraPosition };
+			glUniform4f(lodViewLocation, camera[0], camera[1], camera[2], lodView->projectionScale);
+			glUniform2f(lodThresholdsLocation, lodView->pixelError * (1.0f - lodView->hysteresis), lodView->pixelError * (1.0f + lodView->hysteresis));
+		}
+		else
+		{
+			glUniform4f(lodViewLocation, 0.0f, 0.0f, 0.0f, 0.0f);
+		}
+		glDispatchCompute(GroupCount(info.drawCount), 1, 1);
+
+		// The results are consumed as indirect commands and as a vertex attribute
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+}
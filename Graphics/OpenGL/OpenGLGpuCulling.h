@@ -0,0 +1,36 @@
+#pragma once
+
+#include "OpenGLCommonHeaders.h"
+#include "OpenGLStaticBatch.h"
+
+// GPU-driven frustum culling of static batches. A compute pass tests the world space
+// bounding sphere of every instance against the frustum and appends the visible ones
+// to a per-command range of a draw id buffer, counting them in the instanceCount of
+// a copy of the batch's indirect commands. The batch then draws from those buffers,
+// so visibility never goes through the CPU.
+//
+// Given a view, the pass also picks the level of detail of every visible instance the
+// same way Lod::SelectLod() does, keeping each instance's last level on the GPU for
+// the hysteresis, and appends it to the command of that level.
+namespace Havana::Graphics::OpenGL::Culling
+{
+	DEFINE_TYPED_ID(culling_id);
+
+	// Compiles the compute programs. Must be called with a context current.
+	bool Initialize();
+	void Shutdown();
+
+	// The batch must be built. While the culling context exists the batch draws only
+	// the instances that passed the last Cull().
+	[[nodiscard]] culling_id CreateCulling(StaticBatch::batch_id batch);
+	void RemoveCulling(culling_id id);
+
+	// Planes are (a, b, c, d) with normals pointing into the frustum, a point is inside
+	// when a*x + b*y + c*z + d >= 0. viewProjection is column-major.
+	void ExtractFrustumPlanes(const f32* const viewProjection, f32* const planes /* [6 * 4] */);
+
+	// Dispatch the culling pass for this frame. Must be called on the context thread,
+	// before the command lists that draw the batch are executed. Without a view every
+	// instance is drawn at level 0.
+	void Cull(culling_id id, const f32* const planes, const Lod::LodView* const lodView = nullptr);
+}
@@ -0,0 +1,288 @@
+#include "OpenGLGpuProfiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace Havana::Graphics::OpenGL::GpuProfiler
+{
+	namespace
+	{
+		// One set more than the frames in flight, so a set is only reused after its frame finished
+		constexpr u32 frameQueryCount{ frameBufferCount + 1 };
+		constexpr u32 maxDepth{ 32 };
+
+		// Two timestamps per scope plus the frame begin and end
+		constexpr u32 queriesPerFrame{ maxScopesPerFrame * 2 + 2 };
+		constexpr u32 frameBeginQuery{ 0 };
+		constexpr u32 frameEndQuery{ 1 };
+
+		struct ScopeRecord
+		{
+			const char*	name{ nullptr };
+			u32			beginQuery{ 0 };
+			u32			endQuery{ 0 };
+			u32			depth{ 0 };
+		};
+
+		struct FrameQueries
+		{
+			GLuint		queries[queriesPerFrame]{};
+			ScopeRecord	scopes[maxScopesPerFrame]{};
+			u64			frame{ 0 };
+			u32			scopeCount{ 0 };
+			u32			queryCount{ 0 };
+			bool		isPending{ false };
+		};
+
+		// Rolling window of the durations of one pass
+		struct Samples
+		{
+			f32	values[averageFrameCount]{};
+			f32	sum{ 0.0f };
+			u32	count{ 0 };
+			u32	next{ 0 };
+
+			void Add(f32 value)
+			{
+				if (count == averageFrameCount) sum -= values[next];
+				else count++;
+				values[next] = value;
+				sum += value;
+				next = (next + 1) % averageFrameCount;
+			}
+
+			f32 Average() const { return count ? sum / (f32)count : 0.0f; }
+
+			f32 Max() const
+			{
+				f32 max{ 0.0f };
+				for (u32 i{ 0 }; i < count; i++) max = values[i] > max ? values[i] : max;
+				return max;
+			}
+		};
+
+		struct PassInfo
+		{
+			const char*	name{ nullptr };
+			u32			depth{ 0 };
+			f32			lastMs{ 0.0f };
+			Samples		samples{};
+		};
+
+		FrameQueries	frames[frameQueryCount]{};
+		PassInfo		passes[maxPasses]{};
+		u32				passCount{ 0 };
+		Samples			frameSamples{};
+		GpuFrameTiming	frameTiming{};
+		u64				frameIndex{ 0 };
+		FrameQueries*	currentFrame{ nullptr };
+
+		// Scopes that are open, U32_INVALID_ID for scopes that didn't fit in the frame
+		u32				scopeStack[maxDepth]{};
+		u32				scopeDepth{ 0 };
+		bool			isInitialized{ false };
+
+		u32 FindPass(const char* name)
+		{
+			for (u32 i{ 0 }; i < passCount; i++)
+			{
+				if (passes[i].name == name || !strcmp(passes[i].name, name)) return i;
+			}
+
+			if (passCount == maxPasses) return U32_INVALID_ID;
+			passes[passCount].name = name;
+			return passCount++;
+		}
+
+		u64 QueryResult(GLuint query)
+		{
+			GLuint64 result{ 0 };
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+			return result;
+		}
+
+		constexpr f32 ToMilliseconds(u64 begin, u64 end)
+		{
+			return end > begin ? (f32)((double)(end - begin) * 1e-6) : 0.0f;
+		}
+
+		void Collect(FrameQueries& frame)
+		{
+			assert(frame.isPending);
+			frame.isPending = false;
+
+			// Timestamps are written in submission order, so when the last one is available
+			// all of them are. If it isn't, throw the frame away instead of waiting.
+			GLint isAvailable{ GL_FALSE };
+			glGetQueryObjectiv(frame.queries[frameEndQuery], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+			if (!isAvailable)
+			{
+				frameTiming.droppedFrames++;
+				return;
+			}
+
+			const f32 frameMs{ ToMilliseconds(QueryResult(frame.queries[frameBeginQuery]), QueryResult(frame.queries[frameEndQuery])) };
+			frameSamples.Add(frameMs);
+			frameTiming.frame = frame.frame;
+			frameTiming.lastMs = frameMs;
+			frameTiming.averageMs = frameSamples.Average();
+
+			f32 passMs[maxPasses]{};
+			bool hasRun[maxPasses]{};
+			for (u32 i{ 0 }; i < frame.scopeCount; i++)
+			{
+				const ScopeRecord& scope{ frame.scopes[i] };
+				const u32 pass{ FindPass(scope.name) };
+				if (pass == U32_INVALID_ID) continue;
+
+				passMs[pass] += ToMilliseconds(QueryResult(frame.queries[scope.beginQuery]), QueryResult(frame.queries[scope.endQuery]));
+				passes[pass].depth = scope.depth;
+				hasRun[pass] = true;
+			}
+
+			for (u32 i{ 0 }; i < passCount; i++)
+			{
+				if (!hasRun[i]) continue;
+				passes[i].lastMs = passMs[i];
+				passes[i].samples.Add(passMs[i]);
+			}
+		}
+
+		void WriteTimestamp(FrameQueries& frame, u32 query)
+		{
+			glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+		}
+	} // anonymous namespace
+
+	bool Initialize()
+	{
+		assert(!isInitialized);
+
+		// Timestamps with 0 bits of precision mean the implementation can't measure time
+		GLint bits{ 0 };
+		glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+		if (!bits) return false;
+
+		for (FrameQueries& frame : frames)
+		{
+			frame = {};
+			glGenQueries(queriesPerFrame, &frame.queries[0]);
+		}
+
+		passCount = 0;
+		frameSamples = {};
+		frameTiming = {};
+		frameIndex = 0;
+		currentFrame = nullptr;
+		scopeDepth = 0;
+		isInitialized = true;
+		return true;
+	}
+
+	void Shutdown()
+	{
+		if (!isInitialized) return;
+		for (FrameQueries& frame : frames)
+		{
+			glDeleteQueries(queriesPerFrame, &frame.queries[0]);
+			frame = {};
+		}
+
+		currentFrame = nullptr;
+		isInitialized = false;
+	}
+
+	void BeginFrame()
+	{
+		if (!isInitialized) return;
+		assert(!currentFrame);
+
+		FrameQueries& frame{ frames[frameIndex % frameQueryCount] };
+		if (frame.isPending) Collect(frame);
+
+		frame.frame = frameIndex;
+		frame.scopeCount = 0;
+		frame.queryCount = 2;
+		WriteTimestamp(frame, frameBeginQuery);
+		currentFrame = &frame;
+		scopeDepth = 0;
+	}
+
+	void EndFrame()
+	{
+		if (!isInitialized) return;
+		assert(currentFrame && !scopeDepth);
+
+		WriteTimestamp(*currentFrame, frameEndQuery);
+		currentFrame->isPending = true;
+		currentFrame = nullptr;
+		frameIndex++;
+	}
+
+	void BeginScope(const char* name)
+	{
+		if (!currentFrame) return;
+		assert(name && scopeDepth < maxDepth);
+
+		FrameQueries& frame{ *currentFrame };
+		u32 index{ U32_INVALID_ID };
+		if (frame.scopeCount < maxScopesPerFrame)
+		{
+			index = frame.scopeCount++;
+			ScopeRecord& scope{ frame.scopes[index] };
+			scope.name = name;
+			scope.depth = scopeDepth;
+			scope.beginQuery = frame.queryCount++;
+			scope.endQuery = frame.queryCount++;
+			WriteTimestamp(frame, scope.beginQuery);
+		}
+		else
+		{
+			frameTiming.droppedScopes++;
+		}
+
+		scopeStack[scopeDepth++] = index;
+	}
+
+	void EndScope()
+	{
+		if (!currentFrame) return;
+		assert(scopeDepth);
+
+		const u32 index{ scopeStack[--scopeDepth] };
+		if (index != U32_INVALID_ID)
+			WriteTimestamp(*currentFrame, currentFrame->scopes[index].endQuery);
+	}
+
+	u32 PassTimings(GpuPassTiming* const timings, u32 maxTimings)
+	{
+		assert(timings || !maxTimings);
+		const u32 count{ std::min(passCount, maxTimings) };
+		for (u32 i{ 0 }; i < count; i++)
+		{
+			const PassInfo& pass{ passes[i] };
+			timings[i] = { pass.name, pass.depth, pass.lastMs, pass.samples.Average(), pass.samples.Max() };
+		}
+
+		return passCount;
+	}
+
+	GpuFrameTiming FrameTiming()
+	{
+		return frameTiming;
+	}
+
+	void LogTimings()
+	{
+		printf("::GPU frame %llu: %.3f ms (avg %.3f ms), %u dropped frames, %u dropped scopes\n",
+			   (unsigned long long)frameTiming.frame, frameTiming.lastMs, frameTiming.averageMs,
+			   frameTiming.droppedFrames, frameTiming.droppedScopes);
+
+		for (u32 i{ 0 }; i < passCount; i++)
+		{
+			const PassInfo& pass{ passes[i] };
+			printf("::GPU %*s%-32s %8.3f ms  avg %8.3f ms  max %8.3f ms\n", (int)(pass.depth * 2), "",
+				   pass.name, pass.lastMs, pass.samples.Average(), pass.samples.Max());
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "OpenGLCommonHeaders.h"
+
+// GPU timings from GL_TIMESTAMP queries. Every scope writes a timestamp when it
+// begins and when it ends. Queries are kept in a ring of per-frame sets that is one
+// frame longer than the frames in flight, so a frame's results are read back when
+// its set is reused and the CPU never waits for them. Scopes with the same name are
+// one pass: their times within a frame are added up and averaged over the last
+// averageFrameCount frames in which the pass ran.
+namespace Havana::Graphics::OpenGL::GpuProfiler
+{
+	constexpr u32 maxScopesPerFrame{ 128 };
+	constexpr u32 maxPasses{ 64 };
+	constexpr u32 averageFrameCount{ 64 };
+
+	struct GpuPassTiming
+	{
+		const char*	name{ nullptr };
+		u32			depth{ 0 };			// nesting level of the scope, 0 for top level scopes
+		f32			lastMs{ 0.0f };		// the last frame in which the pass ran
+		f32			averageMs{ 0.0f };
+		f32			maxMs{ 0.0f };		// over the averaged frames
+	};
+
+	struct GpuFrameTiming
+	{
+		u64		frame{ 0 };				// frame the timings are from
+		f32		lastMs{ 0.0f };			// first to last timestamp of the frame
+		f32		averageMs{ 0.0f };
+		u32		droppedFrames{ 0 };		// results that weren't ready in time and were discarded
+		u32		droppedScopes{ 0 };		// scopes beyond maxScopesPerFrame
+	};
+
+	// Must be called with a context current
+	bool Initialize();
+	void Shutdown();
+
+	// Collects the results of the frame that used this query set last and starts a new frame
+	void BeginFrame();
+	void EndFrame();
+
+	// Must be called on the context thread between BeginFrame() and EndFrame(). The name
+	// is stored as a pointer and must stay valid while the profiler reports the pass.
+	void BeginScope(const char* name);
+	void EndScope();
+
+	// Copies up to maxTimings passes in the order they were first seen, returns the number of passes
+	u32 PassTimings(GpuPassTiming* const timings, u32 maxTimings);
+	GpuFrameTiming FrameTiming();
+
+	// Print the frame and pass timings to stdout
+	void LogTimings();
+
+	// Measures the enclosing block
+	class GpuScope
+	{
+	public:
+		explicit GpuScope(const char* name) { BeginScope(name); }
+		~GpuScope() { EndScope(); }
+		DISABLE_COPY_AND_MOVE(GpuScope);
+	};
+}
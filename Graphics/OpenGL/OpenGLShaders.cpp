@@ -0,0 +1,613 @@
+#include "OpenGLShaders.h"
+#include "OpenGLStateCache.h"
+#include "OpenGLCore.h"
+#include "../../Platforms/PlatformTypes.h"
+#include "../../Utilities/ObjectPool.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Havana::Graphics::OpenGL::Shaders
+{
+	namespace
+	{
+		constexpr u32 maxShaderStages{ 5 };
+		constexpr u32 cacheFileMagic{ 0x42505648 }; // "HVPB"
+		constexpr u32 cacheFileVersion{ 1 };
+
+		struct CacheFileHeader
+		{
+			u32 magic;
+			u32 version;
+			u64 programHash;
+			u64 deviceHash;
+			u32 binaryFormat;
+			u32 binarySize;
+		};
+
+		std::string			cacheDirectory;
+		u64					deviceHash{ 0 };
+		bool				isCacheEnabled{ false };
+		ProgramCacheStats	stats{};
+
+		// FNV-1a
+		constexpr u64 fnvOffset{ 0xcbf29ce484222325ull };
+		u64 Hash(const void* const data, size_t size, u64 hash = fnvOffset)
+		{
+			const u8* bytes{ (const u8*)data };
+			for (size_t i{ 0 }; i < size; i++)
+				hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+			return hash;
+		}
+
+		u64 HashString(const char* str, u64 hash)
+		{
+			return str ? Hash(str, strlen(str) + 1, hash) : hash;
+		}
+
+		u64 HashProgram(const ShaderSource* const stages, u32 stageCount)
+		{
+			u64 hash{ fnvOffset };
+			for (u32 i{ 0 }; i < stageCount; i++)
+			{
+				hash = Hash(&stages[i].stage, sizeof(GLenum), hash);
+				hash = HashString(stages[i].source, hash);
+			}
+			return hash;
+		}
+
+		std::string CacheFilePath(u64 programHash)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "/%016llx.glbin", (unsigned long long)programHash);
+			return cacheDirectory + name;
+		}
+
+		void PrintInfoLog([[maybe_unused]] GLuint object, [[maybe_unused]] bool isProgram)
+		{
+#ifdef _DEBUG
+			char log[2048];
+			GLsizei length{ 0 };
+			if (isProgram) glGetProgramInfoLog(object, sizeof(log), &length, log);
+			else glGetShaderInfoLog(object, sizeof(log), &length, log);
+			if (length) fprintf(stderr, "::OpenGL %s error:\n%s\n", isProgram ? "link" : "compile", log);
+#endif // _DEBUG
+		}
+
+		GLuint LoadCachedProgram(u64 programHash)
+		{
+			FILE* file{ fopen(CacheFilePath(programHash).c_str(), "rb") };
+			if (!file) return 0;
+
+			CacheFileHeader header{};
+			Utils::vector<u8> binary;
+			bool isValid{ fread(&header, sizeof(header), 1, file) == 1 &&
+						  header.magic == cacheFileMagic && header.version == cacheFileVersion &&
+						  header.programHash == programHash && header.deviceHash == deviceHash && header.binarySize };
+			if (isValid)
+			{
+				binary.resize(header.binarySize);
+				isValid = fread(binary.data(), 1, header.binarySize, file) == header.binarySize;
+			}
+			fclose(file);
+
+			if (!isValid)
+			{
+				stats.failedLoads++;
+				return 0;
+			}
+
+			const GLuint program{ glCreateProgram() };
+			glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)header.binarySize);
+
+			GLint status{ GL_FALSE };
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (status != GL_TRUE)
+			{
+				// The driver can reject binaries at any time (e.g. after an update that
+				// didn't change the version string). Drop the file and recompile.
+				glDeleteProgram(program);
+				unlink(CacheFilePath(programHash).c_str());
+				stats.failedLoads++;
+				return 0;
+			}
+
+			stats.hits++;
+			return program;
+		}
+
+		void StoreCachedProgram(GLuint program, u64 programHash)
+		{
+			GLint length{ 0 };
+			glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+			if (length <= 0) return;
+
+			Utils::vector<u8> binary(length);
+			GLenum format{ 0 };
+			GLsizei written{ 0 };
+			glGetProgramBinary(program, length, &written, &format, binary.data());
+			if (written <= 0) return;
+
+			const CacheFileHeader header{ cacheFileMagic, cacheFileVersion, programHash, deviceHash, format, (u32)written };
+
+			// Write to a temporary file and rename it so other processes sharing the
+			// cache never see a partially written binary.
+			const std::string path{ CacheFilePath(programHash) };
+			const std::string tempPath{ path + "." + std::to_string(getpid()) + ".tmp" };
+			FILE* file{ fopen(tempPath.c_str(), "wb") };
+			if (!file) return;
+
+			const bool isWritten{ fwrite(&header, sizeof(header), 1, file) == 1 &&
+								  fwrite(binary.data(), 1, written, file) == (size_t)written };
+			fclose(file);
+
+			if (!isWritten || rename(tempPath.c_str(), path.c_str()) != 0)
+				unlink(tempPath.c_str());
+		}
+
+		// Compilation is split in two so the driver can work on it in the background
+		// (GL_KHR_parallel_shader_compile) between the calls.
+		struct PendingCompile
+		{
+			GLuint	program{ 0 };
+			GLuint	shaders[maxShaderStages]{};
+			u32		shaderCount{ 0 };
+		};
+
+		PendingCompile BeginCompile(const ShaderSource* const stages, u32 stageCount)
+		{
+			PendingCompile compile{};
+			compile.program = glCreateProgram();
+			compile.shaderCount = stageCount;
+
+			for (u32 i{ 0 }; i < stageCount; i++)
+			{
+				compile.shaders[i] = glCreateShader(stages[i].stage);
+				glShaderSource(compile.shaders[i], 1, &stages[i].source, nullptr);
+				glCompileShader(compile.shaders[i]);
+				glAttachShader(compile.program, compile.shaders[i]);
+			}
+
+			if (isCacheEnabled) glProgramParameteri(compile.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glLinkProgram(compile.program);
+			return compile;
+		}
+
+		// Querying the status blocks until the driver is done with the program
+		bool FinishCompile(PendingCompile& compile)
+		{
+			bool result{ true };
+			for (u32 i{ 0 }; i < compile.shaderCount; i++)
+			{
+				GLint status{ GL_FALSE };
+				glGetShaderiv(compile.shaders[i], GL_COMPILE_STATUS, &status);
+				if (status != GL_TRUE)
+				{
+					PrintInfoLog(compile.shaders[i], false);
+					result = false;
+				}
+			}
+
+			if (result)
+			{
+				GLint status{ GL_FALSE };
+				glGetProgramiv(compile.program, GL_LINK_STATUS, &status);
+				if (status != GL_TRUE)
+				{
+					PrintInfoLog(compile.program, true);
+					result = false;
+				}
+			}
+
+			for (u32 i{ 0 }; i < compile.shaderCount; i++)
+			{
+				glDetachShader(compile.program, compile.shaders[i]);
+				glDeleteShader(compile.shaders[i]);
+				compile.shaders[i] = 0;
+			}
+			compile.shaderCount = 0;
+
+			if (!result)
+			{
+				glDeleteProgram(compile.program);
+				compile.program = 0;
+			}
+
+			return result;
+		}
+
+		GLuint CompileProgram(const ShaderSource* const stages, u32 stageCount)
+		{
+			PendingCompile compile{ BeginCompile(stages, stageCount) };
+			FinishCompile(compile);
+			return compile.program;
+		}
+
+		//// ASYNC COMPILATION ////////////////////////////////////////////////////////////////////
+
+		using glMaxShaderCompilerThreadsProc = void(*)(GLuint);
+
+		// Work item for the compile thread. Sources are copied since the caller's
+		// strings may be gone by the time the thread gets to them.
+		struct CompileTask
+		{
+			std::string			sources[maxShaderStages];
+			GLenum				stages[maxShaderStages]{};
+			u32					stageCount{ 0 };
+			u64					programHash{ 0 };
+			GLuint				program{ 0 };
+			std::atomic<bool>	isDone{ false };
+		};
+
+		// Fallback for drivers without parallel compile: a thread with its own context that
+		// shares objects with the main context, so the programs it links are usable there.
+		class CompileThread
+		{
+		public:
+			CompileThread() = default;
+			DISABLE_COPY_AND_MOVE(CompileThread);
+			~CompileThread() { assert(!m_thread.joinable()); }
+
+			bool Initialize()
+			{
+				m_display = glXGetCurrentDisplay();
+				GLXContext mainContext{ glXGetCurrentContext() };
+				if (!m_display || !mainContext) return false;
+
+				// Use the same framebuffer configuration as the main context
+				int configId{ 0 };
+				glXQueryContext(m_display, mainContext, GLX_FBCONFIG_ID, &configId);
+				const int configAttribs[]{ GLX_FBCONFIG_ID, configId, None };
+				int configCount{ 0 };
+				GLXFBConfig* configs{ glXChooseFBConfig(m_display, DefaultScreen(m_display), configAttribs, &configCount) };
+				if (!configs || !configCount) return false;
+
+				const auto glXCreateContextAttribsARB{ (Platform::glXCreateContextAttribsARBProc)
+					glXGetProcAddress((const GLubyte*)"glXCreateContextAttribsARB") };
+				GLint major{ 0 }, minor{ 0 };
+				glGetIntegerv(GL_MAJOR_VERSION, &major);
+				glGetIntegerv(GL_MINOR_VERSION, &minor);
+				const int contextAttribs[]{
+					GLX_CONTEXT_MAJOR_VERSION_ARB, major,
+					GLX_CONTEXT_MINOR_VERSION_ARB, minor,
+					None
+				};
+				m_context = glXCreateContextAttribsARB ? glXCreateContextAttribsARB(m_display, configs[0], mainContext, True, contextAttribs) : nullptr;
+
+				const int pbufferAttribs[]{ GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None };
+				m_pbuffer = m_context ? glXCreatePbuffer(m_display, configs[0], pbufferAttribs) : 0;
+				XFree(configs);
+
+				if (!m_context || !m_pbuffer)
+				{
+					Release();
+					return false;
+				}
+
+				m_isRunning = true;
+				m_thread = std::thread{ &CompileThread::Run, this };
+				return true;
+			}
+
+			void Release()
+			{
+				if (m_thread.joinable())
+				{
+					{
+						std::lock_guard lock{ m_mutex };
+						m_isRunning = false;
+					}
+					m_condition.notify_one();
+					m_thread.join();
+				}
+
+				if (m_pbuffer) glXDestroyPbuffer(m_display, m_pbuffer);
+				if (m_context) glXDestroyContext(m_display, m_context);
+				m_pbuffer = 0;
+				m_context = nullptr;
+				m_display = nullptr;
+				m_tasks.clear();
+			}
+
+			void Submit(CompileTask* task)
+			{
+				{
+					std::lock_guard lock{ m_mutex };
+					m_tasks.push_back(task);
+				}
+				m_condition.notify_one();
+			}
+
+			constexpr bool IsRunning() const { return m_context != nullptr; }
+
+		private:
+			void Run()
+			{
+				glXMakeContextCurrent(m_display, m_pbuffer, m_pbuffer, m_context);
+
+				while (true)
+				{
+					CompileTask* task{ nullptr };
+					{
+						std::unique_lock lock{ m_mutex };
+						m_condition.wait(lock, [this] { return !m_isRunning || !m_tasks.empty(); });
+						if (!m_isRunning) break;
+						task = m_tasks.front();
+						m_tasks.pop_front();
+					}
+
+					ShaderSource stages[maxShaderStages]{};
+					for (u32 i{ 0 }; i < task->stageCount; i++)
+						stages[i] = { task->stages[i], task->sources[i].c_str() };
+
+					task->program = CompileProgram(stages, task->stageCount);
+					if (task->program && isCacheEnabled) StoreCachedProgram(task->program, task->programHash);
+
+					// Make sure the program is complete before the main context uses it
+					glFinish();
+					task->isDone.store(true, std::memory_order_release);
+				}
+
+				glXMakeContextCurrent(m_display, None, None, nullptr);
+			}
+
+			Display*					m_display{ nullptr };
+			GLXContext					m_context{ nullptr };
+			GLXPbuffer					m_pbuffer{ 0 };
+			std::thread					m_thread{};
+			std::mutex					m_mutex{};
+			std::condition_variable		m_condition{};
+			Utils::deque<CompileTask*>	m_tasks{};
+			bool						m_isRunning{ false };
+		};
+
+		struct ProgramInfo
+		{
+			PendingCompile					compile{};	// parallel compile path
+			std::unique_ptr<CompileTask>	task{};		// compile thread path
+			u64								programHash{ 0 };
+			GLuint							program{ 0 };
+			ProgramStatus					status{ ProgramStatus::Failed };
+			bool							isRemoved{ false };
+		};
+
+		constexpr u32 maxPrograms{ 1024 };
+		Utils::ObjectPool<ProgramInfo, program_id>	programs{ maxPrograms, Memory::Tag::Graphics };
+		Utils::vector<program_id>					pendingPrograms;
+		CompileThread								compileThread;
+		bool										hasParallelCompile{ false };
+
+		// Returns true when the program is no longer pending
+		bool PollProgram(program_id id)
+		{
+			ProgramInfo& info{ programs.Get(id) };
+			assert(info.status == ProgramStatus::Pending);
+
+			if (info.task)
+			{
+				if (!info.task->isDone.load(std::memory_order_acquire)) return false;
+				info.program = info.task->program;
+				info.task.reset();
+			}
+			else
+			{
+				GLint isComplete{ GL_FALSE };
+				glGetProgramiv(info.compile.program, GL_COMPLETION_STATUS_KHR, &isComplete);
+				if (isComplete != GL_TRUE) return false;
+
+				FinishCompile(info.compile);
+				info.program = info.compile.program;
+				if (info.program && isCacheEnabled) StoreCachedProgram(info.program, info.programHash);
+			}
+
+			info.status = info.program ? ProgramStatus::Ready : ProgramStatus::Failed;
+
+			if (info.isRemoved)
+			{
+				RemoveProgram(info.program);
+				programs.Remove(id);
+			}
+
+			return true;
+		}
+	} // anonymous namespace
+
+	bool Initialize(const char* directory)
+	{
+		stats = {};
+		isCacheEnabled = false;
+
+		if (Core::HasExtension("GL_KHR_parallel_shader_compile") || Core::HasExtension("GL_ARB_parallel_shader_compile"))
+		{
+			// Let the driver pick the number of compiler threads
+			const auto glMaxShaderCompilerThreads{ (glMaxShaderCompilerThreadsProc)
+				glXGetProcAddress((const GLubyte*)"glMaxShaderCompilerThreadsKHR") };
+			if (glMaxShaderCompilerThreads) glMaxShaderCompilerThreads(0xffffffff);
+			hasParallelCompile = true;
+		}
+		else
+		{
+			// Without a compile thread async programs are compiled synchronously
+			hasParallelCompile = false;
+			compileThread.Initialize();
+		}
+
+		if (!directory) return true;
+
+		// Drivers that can't save programs report zero binary formats
+		GLint formatCount{ 0 };
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		if (formatCount <= 0) return true;
+
+		if (mkdir(directory, 0755) != 0 && errno != EEXIST) return false;
+
+		cacheDirectory = directory;
+		deviceHash = HashString((const char*)glGetString(GL_VENDOR), fnvOffset);
+		deviceHash = HashString((const char*)glGetString(GL_RENDERER), deviceHash);
+		deviceHash = HashString((const char*)glGetString(GL_VERSION), deviceHash);
+		isCacheEnabled = true;
+		return true;
+	}
+
+	void Shutdown()
+	{
+		compileThread.Release();
+		programs.ForEach([](program_id, ProgramInfo& info)
+		{
+			if (info.task)
+			{
+				info.program = info.task->program;
+			}
+			else if (info.compile.shaderCount)
+			{
+				FinishCompile(info.compile);
+				info.program = info.compile.program;
+			}
+			if (info.program) glDeleteProgram(info.program);
+		});
+		programs.Clear();
+		pendingPrograms.clear();
+
+		cacheDirectory.clear();
+		isCacheEnabled = false;
+	}
+
+	/// <summary>
+	/// Create a linked program from the given shader stages, loading it from the binary cache when possible.
+	/// </summary>
+	/// <param name="stages"> - Shader stages with their GLSL source.</param>
+	/// <param name="stageCount"> - Number of stages.</param>
+	/// <returns>The GL program name, or 0 if compilation or linking failed.</returns>
+	GLuint CreateProgram(const ShaderSource* const stages, u32 stageCount)
+	{
+		PROFILE_SCOPE("Shaders::CreateProgram");
+		assert(stages && stageCount && stageCount <= maxShaderStages);
+
+		const u64 programHash{ isCacheEnabled ? HashProgram(stages, stageCount) : 0 };
+		if (isCacheEnabled)
+		{
+			const GLuint program{ LoadCachedProgram(programHash) };
+			if (program) return program;
+		}
+
+		stats.misses++;
+		const GLuint program{ CompileProgram(stages, stageCount) };
+		if (program && isCacheEnabled) StoreCachedProgram(program, programHash);
+		return program;
+	}
+
+	void RemoveProgram(GLuint program)
+	{
+		if (!program) return;
+		glDeleteProgram(program);
+		State::OnProgramDeleted(program);
+	}
+
+	const ProgramCacheStats& CacheStats()
+	{
+		return stats;
+	}
+
+	/// <summary>
+	/// Start compiling a program without waiting for the driver. Cached binaries are loaded right away.
+	/// </summary>
+	/// <param name="stages"> - Shader stages with their GLSL source.</param>
+	/// <param name="stageCount"> - Number of stages.</param>
+	/// <returns>ID of the program. Use GetStatus() to find out when it's ready.</returns>
+	program_id CreateProgramAsync(const ShaderSource* const stages, u32 stageCount)
+	{
+		PROFILE_SCOPE("Shaders::CreateProgramAsync");
+		assert(stages && stageCount && stageCount <= maxShaderStages);
+
+		ProgramInfo info{};
+		info.programHash = isCacheEnabled ? HashProgram(stages, stageCount) : 0;
+		info.program = isCacheEnabled ? LoadCachedProgram(info.programHash) : 0;
+
+		if (info.program)
+		{
+			info.status = ProgramStatus::Ready;
+			return programs.Add(std::move(info));
+		}
+
+		stats.misses++;
+		info.status = ProgramStatus::Pending;
+
+		if (hasParallelCompile)
+		{
+			info.compile = BeginCompile(stages, stageCount);
+		}
+		else if (compileThread.IsRunning())
+		{
+			info.task = std::make_unique<CompileTask>();
+			info.task->stageCount = stageCount;
+			info.task->programHash = info.programHash;
+			for (u32 i{ 0 }; i < stageCount; i++)
+			{
+				info.task->stages[i] = stages[i].stage;
+				info.task->sources[i] = stages[i].source;
+			}
+		}
+		else
+		{
+			info.program = CompileProgram(stages, stageCount);
+			if (info.program && isCacheEnabled) StoreCachedProgram(info.program, info.programHash);
+			info.status = info.program ? ProgramStatus::Ready : ProgramStatus::Failed;
+		}
+
+		CompileTask* const task{ info.task.get() };
+		const bool isPending{ info.status == ProgramStatus::Pending };
+		const program_id id{ programs.Add(std::move(info)) };
+		if (isPending) pendingPrograms.emplace_back(id);
+		if (task) compileThread.Submit(task);
+
+		return id;
+	}
+
+	void RemoveProgramAsync(program_id id)
+	{
+		ProgramInfo& info{ programs.Get(id) };
+		assert(!info.isRemoved);
+
+		if (info.status == ProgramStatus::Pending)
+		{
+			// Deleted by Update() once the compiler is done with it
+			info.isRemoved = true;
+			return;
+		}
+
+		RemoveProgram(info.program);
+		programs.Remove(id);
+	}
+
+	ProgramStatus GetStatus(program_id id)
+	{
+		const ProgramInfo& info{ programs.Get(id) };
+		assert(!info.isRemoved);
+		return info.status;
+	}
+
+	GLuint GetProgram(program_id id, GLuint fallback /*= 0*/)
+	{
+		const ProgramInfo& info{ programs.Get(id) };
+		assert(!info.isRemoved);
+		return info.status == ProgramStatus::Ready ? info.program : fallback;
+	}
+
+	void Update()
+	{
+		PROFILE_SCOPE("Shaders::Update");
+		for (u32 i{ 0 }; i < (u32)pendingPrograms.size();)
+		{
+			if (PollProgram(pendingPrograms[i]))
+				Utils::EraseUnordered(pendingPrograms, i);
+			else
+				i++;
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "OpenGLCommonHeaders.h"
+
+namespace Havana::Graphics::OpenGL::Shaders
+{
+	DEFINE_TYPED_ID(program_id);
+
+	enum class ProgramStatus : u32
+	{
+		Pending = 0,
+		Ready,
+		Failed
+	};
+
+	struct ShaderSource
+	{
+		GLenum		stage{ GL_VERTEX_SHADER };
+		const char*	source{ nullptr };
+	};
+
+	struct ProgramCacheStats
+	{
+		u32 hits{ 0 };			// programs loaded from a cached binary
+		u32 misses{ 0 };		// programs compiled from source
+		u32 failedLoads{ 0 };	// cached binaries the driver rejected
+	};
+
+	// Programs are cached on disk as driver binaries, keyed by a hash of their sources
+	// and of GL_VENDOR/GL_RENDERER/GL_VERSION, so a driver update invalidates the cache.
+	// Pass nullptr to disable the cache. Must be called with a context current.
+	bool Initialize(const char* cacheDirectory);
+	void Shutdown();
+
+	[[nodiscard]] GLuint CreateProgram(const ShaderSource* const stages, u32 stageCount);
+	void RemoveProgram(GLuint program);
+
+	const ProgramCacheStats& CacheStats();
+
+	// Asynchronous compilation. Uses GL_KHR_parallel_shader_compile when the driver has it,
+	// otherwise programs are compiled on a thread with its own shared context. Until a
+	// program is ready, GetProgram() returns the fallback so draws can substitute or skip.
+	[[nodiscard]] program_id CreateProgramAsync(const ShaderSource* const stages, u32 stageCount);
+	void RemoveProgramAsync(program_id id);
+	ProgramStatus GetStatus(program_id id);
+	GLuint GetProgram(program_id id, GLuint fallback = 0);
+
+	// Poll pending compilations. Never blocks. Call once per frame on the context thread.
+	void Update();
+}
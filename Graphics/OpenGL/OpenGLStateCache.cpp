@@ -0,0 +1,411 @@
+#include "OpenGLStateCache.h"
+
+namespace Havana::Graphics::OpenGL::State
+{
+	namespace
+	{
+		constexpr GLuint unknownName{ U32_INVALID_ID };
+		constexpr GLenum unknownEnum{ U32_INVALID_ID };
+		constexpr u8 unknownFlag{ 0xff };
+		constexpr u32 uncached{ U32_INVALID_ID };
+
+		enum BufferTarget : u32
+		{
+			ArrayBuffer = 0,
+			ElementArrayBuffer,
+			UniformBuffer,
+			ShaderStorageBuffer,
+			DrawIndirectBuffer,
+			DispatchIndirectBuffer,
+			PixelPackBuffer,
+			PixelUnpackBuffer,
+			CopyReadBuffer,
+			CopyWriteBuffer,
+			AtomicCounterBuffer,
+
+			bufferTargetCount
+		};
+
+		enum TextureTarget : u32
+		{
+			Texture2D = 0,
+			Texture2DArray,
+			TextureCubeMap,
+			Texture3D,
+
+			textureTargetCount
+		};
+
+		enum Capability : u32
+		{
+			DepthTest = 0,
+			Blend,
+			CullFace,
+			ScissorTest,
+			StencilTest,
+			PolygonOffsetFill,
+			PrimitiveRestart,
+			FramebufferSRGB,
+
+			capabilityCount
+		};
+
+		struct Rect
+		{
+			s32 x, y;
+			u32 width, height;
+
+			constexpr bool operator==(const Rect& o) const
+			{
+				return x == o.x && y == o.y && width == o.width && height == o.height;
+			}
+		};
+
+		struct ContextState
+		{
+			GLuint	program;
+			GLuint	vertexArray;
+			GLuint	framebuffer;
+			GLuint	buffers[bufferTargetCount];
+			GLuint	uniformBuffers[maxIndexedBufferBindings];
+			GLuint	storageBuffers[maxIndexedBufferBindings];
+			u32		activeTextureUnit;
+			GLuint	textures[maxTextureUnits][textureTargetCount];
+			u8		capabilities[capabilityCount];
+			u8		depthMask;
+			GLenum	depthFunc;
+			GLenum	blendSource;
+			GLenum	blendDestination;
+			GLenum	cullFaceMode;
+			Rect	viewport;
+			Rect	scissor;
+			f32		clearColor[4];
+			f32		clearDepth;
+			u32		clearStencil;
+			bool	isClearColorKnown;
+			bool	isClearDepthKnown;
+			bool	isClearStencilKnown;
+		};
+
+		ContextState	state{};
+		StateCacheStats	frameStats{};
+		StateCacheStats	lastFrameStats{};
+
+		constexpr u32 ToBufferTarget(GLenum target)
+		{
+			switch (target)
+			{
+			case GL_ARRAY_BUFFER: return ArrayBuffer;
+			case GL_ELEMENT_ARRAY_BUFFER: return ElementArrayBuffer;
+			case GL_UNIFORM_BUFFER: return UniformBuffer;
+			case GL_SHADER_STORAGE_BUFFER: return ShaderStorageBuffer;
+			case GL_DRAW_INDIRECT_BUFFER: return DrawIndirectBuffer;
+			case GL_DISPATCH_INDIRECT_BUFFER: return DispatchIndirectBuffer;
+			case GL_PIXEL_PACK_BUFFER: return PixelPackBuffer;
+			case GL_PIXEL_UNPACK_BUFFER: return PixelUnpackBuffer;
+			case GL_COPY_READ_BUFFER: return CopyReadBuffer;
+			case GL_COPY_WRITE_BUFFER: return CopyWriteBuffer;
+			case GL_ATOMIC_COUNTER_BUFFER: return AtomicCounterBuffer;
+			default: return uncached;
+			}
+		}
+
+		constexpr u32 ToTextureTarget(GLenum target)
+		{
+			switch (target)
+			{
+			case GL_TEXTURE_2D: return Texture2D;
+			case GL_TEXTURE_2D_ARRAY: return Texture2DArray;
+			case GL_TEXTURE_CUBE_MAP: return TextureCubeMap;
+			case GL_TEXTURE_3D: return Texture3D;
+			default: return uncached;
+			}
+		}
+
+		constexpr u32 ToCapability(GLenum capability)
+		{
+			switch (capability)
+			{
+			case GL_DEPTH_TEST: return DepthTest;
+			case GL_BLEND: return Blend;
+			case GL_CULL_FACE: return CullFace;
+			case GL_SCISSOR_TEST: return ScissorTest;
+			case GL_STENCIL_TEST: return StencilTest;
+			case GL_POLYGON_OFFSET_FILL: return PolygonOffsetFill;
+			case GL_PRIMITIVE_RESTART: return PrimitiveRestart;
+			case GL_FRAMEBUFFER_SRGB: return FramebufferSRGB;
+			default: return uncached;
+			}
+		}
+
+		// Returns true if the call needs to be issued, and updates the stats either way
+		template<typename T>
+		bool Update(T& cached, const T& value)
+		{
+			if (cached == value)
+			{
+				frameStats.skipped++;
+				return false;
+			}
+
+			cached = value;
+			frameStats.issued++;
+			return true;
+		}
+
+		void Issued()
+		{
+			frameStats.issued++;
+		}
+
+		void ActiveTexture(u32 unit)
+		{
+			if (Update(state.activeTextureUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+		}
+	} // anonymous namespace
+
+	void Invalidate()
+	{
+		state.program = unknownName;
+		state.vertexArray = unknownName;
+		state.framebuffer = unknownName;
+		for (GLuint& buffer : state.buffers) buffer = unknownName;
+		for (GLuint& buffer : state.uniformBuffers) buffer = unknownName;
+		for (GLuint& buffer : state.storageBuffers) buffer = unknownName;
+		state.activeTextureUnit = U32_INVALID_ID;
+		for (auto& unit : state.textures)
+			for (GLuint& texture : unit) texture = unknownName;
+		for (u8& capability : state.capabilities) capability = unknownFlag;
+		state.depthMask = unknownFlag;
+		state.depthFunc = unknownEnum;
+		state.blendSource = unknownEnum;
+		state.blendDestination = unknownEnum;
+		state.cullFaceMode = unknownEnum;
+		state.viewport = { 0, 0, U32_INVALID_ID, U32_INVALID_ID };
+		state.scissor = { 0, 0, U32_INVALID_ID, U32_INVALID_ID };
+		state.isClearColorKnown = false;
+		state.isClearDepthKnown = false;
+		state.isClearStencilKnown = false;
+	}
+
+	void BeginFrame()
+	{
+		lastFrameStats = frameStats;
+		frameStats = {};
+	}
+
+	const StateCacheStats& FrameStats()
+	{
+		return frameStats;
+	}
+
+	const StateCacheStats& LastFrameStats()
+	{
+		return lastFrameStats;
+	}
+
+	void UseProgram(GLuint program)
+	{
+		if (Update(state.program, program)) glUseProgram(program);
+	}
+
+	void BindVertexArray(GLuint vertexArray)
+	{
+		if (Update(state.vertexArray, vertexArray))
+		{
+			glBindVertexArray(vertexArray);
+			// The element array binding is part of the vertex array object
+			state.buffers[ElementArrayBuffer] = unknownName;
+		}
+	}
+
+	void BindBuffer(GLenum target, GLuint buffer)
+	{
+		const u32 index{ ToBufferTarget(target) };
+		if (index == uncached)
+		{
+			Issued();
+			glBindBuffer(target, buffer);
+			return;
+		}
+
+		if (Update(state.buffers[index], buffer)) glBindBuffer(target, buffer);
+	}
+
+	void BindBufferBase(GLenum target, u32 index, GLuint buffer)
+	{
+		GLuint* const bindings{ target == GL_UNIFORM_BUFFER ? &state.uniformBuffers[0] :
+								target == GL_SHADER_STORAGE_BUFFER ? &state.storageBuffers[0] : nullptr };
+		if (!bindings || index >= maxIndexedBufferBindings)
+		{
+			Issued();
+			glBindBufferBase(target, index, buffer);
+			// Indexed binds also change the generic binding point
+			const u32 generic{ ToBufferTarget(target) };
+			if (generic != uncached) state.buffers[generic] = buffer;
+			return;
+		}
+
+		if (Update(bindings[index], buffer))
+		{
+			glBindBufferBase(target, index, buffer);
+			state.buffers[ToBufferTarget(target)] = buffer;
+		}
+	}
+
+	void BindTexture(u32 unit, GLenum target, GLuint texture)
+	{
+		assert(unit < maxTextureUnits);
+		const u32 index{ ToTextureTarget(target) };
+		if (index == uncached)
+		{
+			ActiveTexture(unit);
+			Issued();
+			glBindTexture(target, texture);
+			return;
+		}
+
+		GLuint& cached{ state.textures[unit][index] };
+		if (cached == texture)
+		{
+			frameStats.skipped++;
+			return;
+		}
+
+		ActiveTexture(unit);
+		Update(cached, texture);
+		glBindTexture(target, texture);
+	}
+
+	void BindFramebuffer(GLuint framebuffer)
+	{
+		if (Update(state.framebuffer, framebuffer)) glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+
+	void SetCapability(GLenum capability, bool enable)
+	{
+		const u32 index{ ToCapability(capability) };
+		if (index == uncached || Update(state.capabilities[index], (u8)enable))
+		{
+			if (index == uncached) Issued();
+			enable ? glEnable(capability) : glDisable(capability);
+		}
+	}
+
+	void DepthMask(bool enable)
+	{
+		if (Update(state.depthMask, (u8)enable)) glDepthMask(enable ? GL_TRUE : GL_FALSE);
+	}
+
+	void DepthFunc(GLenum func)
+	{
+		if (Update(state.depthFunc, func)) glDepthFunc(func);
+	}
+
+	void BlendFunc(GLenum source, GLenum destination)
+	{
+		if (state.blendSource == source && state.blendDestination == destination)
+		{
+			frameStats.skipped++;
+			return;
+		}
+
+		state.blendSource = source;
+		state.blendDestination = destination;
+		Issued();
+		glBlendFunc(source, destination);
+	}
+
+	void CullFace(GLenum mode)
+	{
+		if (Update(state.cullFaceMode, mode)) glCullFace(mode);
+	}
+
+	void Viewport(s32 x, s32 y, u32 width, u32 height)
+	{
+		if (Update(state.viewport, Rect{ x, y, width, height })) glViewport(x, y, (GLsizei)width, (GLsizei)height);
+	}
+
+	void Scissor(s32 x, s32 y, u32 width, u32 height)
+	{
+		if (Update(state.scissor, Rect{ x, y, width, height })) glScissor(x, y, (GLsizei)width, (GLsizei)height);
+	}
+
+	void ClearColor(f32 r, f32 g, f32 b, f32 a)
+	{
+		f32* const color{ &state.clearColor[0] };
+		if (state.isClearColorKnown && color[0] == r && color[1] == g && color[2] == b && color[3] == a)
+		{
+			frameStats.skipped++;
+			return;
+		}
+
+		color[0] = r; color[1] = g; color[2] = b; color[3] = a;
+		state.isClearColorKnown = true;
+		Issued();
+		glClearColor(r, g, b, a);
+	}
+
+	void ClearDepth(f32 depth)
+	{
+		if (state.isClearDepthKnown && state.clearDepth == depth)
+		{
+			frameStats.skipped++;
+			return;
+		}
+
+		state.clearDepth = depth;
+		state.isClearDepthKnown = true;
+		Issued();
+		glClearDepth(depth);
+	}
+
+	void ClearStencil(u32 stencil)
+	{
+		if (state.isClearStencilKnown && state.clearStencil == stencil)
+		{
+			frameStats.skipped++;
+			return;
+		}
+
+		state.clearStencil = stencil;
+		state.isClearStencilKnown = true;
+		Issued();
+		glClearStencil((GLint)stencil);
+	}
+
+	// A deleted program stays in use until another one is bound, so the binding is
+	// unknown rather than 0. Otherwise UseProgram(0) would be skipped.
+	void OnProgramDeleted(GLuint program)
+	{
+		if (state.program == program) state.program = unknownName;
+	}
+
+	// Deleting a bound object resets the binding to 0 in GL, so mirror that
+
+	void OnVertexArrayDeleted(GLuint vertexArray)
+	{
+		if (state.vertexArray != vertexArray) return;
+		state.vertexArray = 0;
+		// The element array binding is part of the vertex array object
+		state.buffers[ElementArrayBuffer] = unknownName;
+	}
+
+	void OnBufferDeleted(GLuint buffer)
+	{
+		for (GLuint& cached : state.buffers) if (cached == buffer) cached = 0;
+		for (GLuint& cached : state.uniformBuffers) if (cached == buffer) cached = 0;
+		for (GLuint& cached : state.storageBuffers) if (cached == buffer) cached = 0;
+	}
+
+	void OnTextureDeleted(GLuint texture)
+	{
+		for (auto& unit : state.textures)
+			for (GLuint& cached : unit) if (cached == texture) cached = 0;
+	}
+
+	void OnFramebufferDeleted(GLuint framebuffer)
+	{
+		if (state.framebuffer == framebuffer) state.framebuffer = 0;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "OpenGLCommonHeaders.h"
+
+// Shadow copy of the GL state that the backend touches. Every setter compares
+// against the cached value and only calls into the driver when the state actually
+// changes. Must only be used on the thread that has the context current.
+namespace Havana::Graphics::OpenGL::State
+{
+	constexpr u32 maxTextureUnits{ 32 };
+	constexpr u32 maxIndexedBufferBindings{ 16 };
+
+	struct StateCacheStats
+	{
+		u32 issued{ 0 };	// calls forwarded to GL
+		u32 skipped{ 0 };	// redundant calls that were filtered out
+	};
+
+	// Forget everything we know about the context. Call this after code outside the
+	// cache changed GL state (e.g. a third party library) or after a context switch.
+	void Invalidate();
+
+	// Stats are per frame. BeginFrame() stores the last frame's numbers and resets the counters.
+	void BeginFrame();
+	const StateCacheStats& FrameStats();
+	const StateCacheStats& LastFrameStats();
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertexArray);
+	void BindBuffer(GLenum target, GLuint buffer);
+	void BindBufferBase(GLenum target, u32 index, GLuint buffer);
+	void BindTexture(u32 unit, GLenum target, GLuint texture);
+	void BindFramebuffer(GLuint framebuffer);
+
+	void SetCapability(GLenum capability, bool enable);
+	void DepthMask(bool enable);
+	void DepthFunc(GLenum func);
+	void BlendFunc(GLenum source, GLenum destination);
+	void CullFace(GLenum mode);
+
+	void Viewport(s32 x, s32 y, u32 width, u32 height);
+	void Scissor(s32 x, s32 y, u32 width, u32 height);
+	void ClearColor(f32 r, f32 g, f32 b, f32 a);
+	void ClearDepth(f32 depth);
+	void ClearStencil(u32 stencil);
+
+	// Resources that get deleted must be removed from the cache, otherwise a new object
+	// that reuses the same name would be treated as already bound.
+	void OnProgramDeleted(GLuint program);
+	void OnVertexArrayDeleted(GLuint vertexArray);
+	void OnBufferDeleted(GLuint buffer);
+	void OnTextureDeleted(GLuint texture);
+	void OnFramebufferDeleted(GLuint framebuffer);
+}
@@ -0,0 +1,312 @@
+#include "OpenGLStaticBatch.h"
+#include "OpenGLStateCache.h"
+#include "../../Utilities/ObjectPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Havana::Graphics::OpenGL::StaticBatch
+{
+	namespace
+	{
+		struct MeshRange
+		{
+			u32 firstIndex;
+			u32 indexCount;
+			s32 baseVertex;
+			f32 boundsCenter[3];
+			f32 boundsRadius;
+			Lod::LodLevel lods[Lod::maxLods];	// relative to firstIndex
+			u32 lodCount;
+		};
+
+		struct BatchInfo
+		{
+			Utils::vector<VertexAttribute>	attributes;
+			Utils::vector<u8>				vertices;
+			Utils::vector<u32>				indices;
+			Utils::vector<MeshRange>		meshes;
+			Utils::vector<StaticDrawData>	draws;			// in the order instances were added until Build()
+			Utils::vector<u32>				drawIndices;	// instance -> index in the draw data after Build()
+			u32								vertexStride{ 0 };
+			GLuint							vertexArray{ 0 };
+			GLuint							vertexBuffer{ 0 };
+			GLuint							indexBuffer{ 0 };
+			GLuint							drawIdBuffer{ 0 };
+			GLuint							drawDataBuffer{ 0 };
+			GLuint							indirectBuffer{ 0 };
+			GLuint							lodErrorBuffer{ 0 };
+			GLuint							activeIndirectBuffer{ 0 };
+			StaticBatchStats				stats{};
+			bool							isBuilt{ false };
+		};
+
+		constexpr u32 maxBatches{ 256 };
+		Utils::ObjectPool<BatchInfo, batch_id> batches{ maxBatches, Memory::Tag::Graphics };
+
+		BatchInfo& GetBatch(batch_id id)
+		{
+			BatchInfo& batch{ batches.Get(id) };
+			assert(batch.vertexStride);
+			return batch;
+		}
+
+		GLuint CreateBuffer(GLenum target, const void* data, size_t size)
+		{
+			GLuint buffer{ 0 };
+			glGenBuffers(1, &buffer);
+			State::BindBuffer(target, buffer);
+			glBufferData(target, (GLsizeiptr)size, data, GL_STATIC_DRAW);
+			return buffer;
+		}
+
+		void DeleteBuffer(GLuint& buffer)
+		{
+			if (!buffer) return;
+			glDeleteBuffers(1, &buffer);
+			State::OnBufferDeleted(buffer);
+			buffer = 0;
+		}
+	} // anonymous namespace
+
+	batch_id CreateBatch(const StaticBatchInitInfo& info)
+	{
+		assert(info.attributes && info.attributeCount && info.vertexStride);
+		BatchInfo batch{};
+		batch.attributes.assign(info.attributes, info.attributes + info.attributeCount);
+		batch.vertexStride = info.vertexStride;
+		return batches.Add(std::move(batch));
+	}
+
+	void RemoveBatch(batch_id id)
+	{
+		BatchInfo& batch{ GetBatch(id) };
+		if (batch.vertexArray)
+		{
+			glDeleteVertexArrays(1, &batch.vertexArray);
+			State::OnVertexArrayDeleted(batch.vertexArray);
+		}
+		DeleteBuffer(batch.vertexBuffer);
+		DeleteBuffer(batch.indexBuffer);
+		DeleteBuffer(batch.drawIdBuffer);
+		DeleteBuffer(batch.drawDataBuffer);
+		DeleteBuffer(batch.indirectBuffer);
+		DeleteBuffer(batch.lodErrorBuffer);
+		batches.Remove(id);
+	}
+
+	u32 AddMesh(batch_id id, const StaticMeshDesc& desc)
+	{
+		BatchInfo& batch{ GetBatch(id) };
+		assert(!batch.isBuilt);
+		assert(desc.vertices && desc.indices && desc.vertexCount && desc.indexCount);
+		assert(desc.lodCount <= Lod::maxLods && (desc.lods || !desc.lodCount));
+
+		const u8* const vertices{ (const u8*)desc.vertices };
+		MeshRange range{ (u32)batch.indices.size(), desc.indexCount, (s32)(batch.vertices.size() / batch.vertexStride),
+						 { desc.boundsCenter[0], desc.boundsCenter[1], desc.boundsCenter[2] }, desc.boundsRadius, {}, 0 };
+		if (desc.lodCount)
+		{
+			for (u32 i{ 0 }; i < desc.lodCount; i++)
+			{
+				assert(desc.lods[i].indexCount && desc.lods[i].firstIndex + desc.lods[i].indexCount <= desc.indexCount);
+				range.lods[i] = desc.lods[i];
+			}
+			range.lodCount = desc.lodCount;
+		}
+		else
+		{
+			range.lods[0] = { 0, desc.indexCount, 0.0f };
+			range.lodCount = 1;
+		}
+		batch.vertices.insert(batch.vertices.end(), vertices, vertices + (size_t)desc.vertexCount * batch.vertexStride);
+		batch.indices.insert(batch.indices.end(), desc.indices, desc.indices + desc.indexCount);
+		batch.meshes.emplace_back(range);
+		return (u32)batch.meshes.size() - 1;
+	}
+
+	u32 AddInstance(batch_id id, u32 mesh, const f32* const world, u32 material)
+	{
+		BatchInfo& batch{ GetBatch(id) };
+		assert(!batch.isBuilt && mesh < batch.meshes.size() && world);
+
+		StaticDrawData draw{};
+		memcpy(draw.world, world, sizeof(draw.world));
+		draw.mesh = mesh;
+		draw.material = material;
+
+		// Static instances never move, so the world space bounds are computed once here
+		const MeshRange& range{ batch.meshes[mesh] };
+		const f32* const c{ range.boundsCenter };
+		f32 maxScale{ 0.0f };
+		for (u32 i{ 0 }; i < 3; i++)
+		{
+			draw.boundsCenter[i] = world[i] * c[0] + world[4 + i] * c[1] + world[8 + i] * c[2] + world[12 + i];
+			const f32* const axis{ &world[i * 4] };
+			maxScale = std::max(maxScale, axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		}
+		draw.boundsRadius = range.boundsRadius * std::sqrt(maxScale);
+
+		batch.draws.emplace_back(draw);
+		return (u32)batch.draws.size() - 1;
+	}
+
+	void Build(batch_id id)
+	{
+		BatchInfo& batch{ GetBatch(id) };
+		assert(!batch.isBuilt && !batch.draws.empty());
+
+		// Instances of the same mesh have to be adjacent so each level of a mesh is a single instanced command.
+		// Instance ids stay the order of AddInstance(), drawIndices maps them to where they end up.
+		const u32 drawCount{ (u32)batch.draws.size() };
+		Utils::vector<u32> order(drawCount);
+		for (u32 i{ 0 }; i < drawCount; i++) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&batch](u32 a, u32 b)
+		{
+			return batch.draws[a].mesh < batch.draws[b].mesh;
+		});
+
+		Utils::vector<StaticDrawData> draws(drawCount);
+		batch.drawIndices.resize(drawCount);
+		for (u32 i{ 0 }; i < drawCount; i++)
+		{
+			draws[i] = batch.draws[order[i]];
+			batch.drawIndices[order[i]] = i;
+		}
+		batch.draws.swap(draws);
+
+		// Each level gets room for all the instances of its mesh in the draw id stream.
+		// The ranges all start out listing those instances, only level 0 draws them.
+		Utils::vector<DrawIndexedIndirectArgs> commands;
+		Utils::vector<f32> lodErrors;
+		Utils::vector<u32> drawIds;
+		for (u32 first{ 0 }, last{ 0 }; first < drawCount; first = last)
+		{
+			const u32 mesh{ batch.draws[first].mesh };
+			while (last < drawCount && batch.draws[last].mesh == mesh) last++;
+
+			const MeshRange& range{ batch.meshes[mesh] };
+			const u32 command{ (u32)commands.size() };
+			for (u32 lod{ 0 }; lod < range.lodCount; lod++)
+			{
+				const Lod::LodLevel& level{ range.lods[lod] };
+				commands.push_back({ level.indexCount, lod ? 0 : last - first, range.firstIndex + level.firstIndex,
+									 range.baseVertex, (u32)drawIds.size() });
+				lodErrors.emplace_back(level.error);
+				for (u32 i{ first }; i < last; i++) drawIds.emplace_back(i);
+			}
+
+			for (u32 i{ first }; i < last; i++)
+			{
+				batch.draws[i].command = command;
+				batch.draws[i].lodCount = range.lodCount;
+			}
+		}
+
+		glGenVertexArrays(1, &batch.vertexArray);
+		State::BindVertexArray(batch.vertexArray);
+
+		batch.vertexBuffer = CreateBuffer(GL_ARRAY_BUFFER, batch.vertices.data(), batch.vertices.size());
+		for (const VertexAttribute& attribute : batch.attributes)
+		{
+			assert(attribute.location != drawIdAttribute);
+			glEnableVertexAttribArray(attribute.location);
+			const bool isInteger{ attribute.type != GL_FLOAT && attribute.type != GL_HALF_FLOAT && !attribute.isNormalized };
+			if (isInteger)
+				glVertexAttribIFormat(attribute.location, (GLint)attribute.componentCount, attribute.type, attribute.offset);
+			else
+				glVertexAttribFormat(attribute.location, (GLint)attribute.componentCount, attribute.type,
+									 attribute.isNormalized ? GL_TRUE : GL_FALSE, attribute.offset);
+			glVertexAttribBinding(attribute.location, 0);
+		}
+		glBindVertexBuffer(0, batch.vertexBuffer, 0, (GLsizei)batch.vertexStride);
+
+		// The draw id stream advances once per instance, starting at the command's baseInstance
+		batch.drawIdBuffer = CreateBuffer(GL_ARRAY_BUFFER, drawIds.data(), drawIds.size() * sizeof(u32));
+		glEnableVertexAttribArray(drawIdAttribute);
+		glVertexAttribIFormat(drawIdAttribute, 1, GL_UNSIGNED_INT, 0);
+		glVertexAttribBinding(drawIdAttribute, drawIdBufferBinding);
+		glVertexBindingDivisor(drawIdBufferBinding, 1);
+		glBindVertexBuffer(drawIdBufferBinding, batch.drawIdBuffer, 0, sizeof(u32));
+
+		// The element array binding is recorded in the vertex array
+		batch.indexBuffer = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.indices.data(), batch.indices.size() * sizeof(u32));
+		State::BindVertexArray(0);
+
+		batch.drawDataBuffer = CreateBuffer(GL_SHADER_STORAGE_BUFFER, batch.draws.data(), batch.draws.size() * sizeof(StaticDrawData));
+		batch.indirectBuffer = CreateBuffer(GL_DRAW_INDIRECT_BUFFER, commands.data(), commands.size() * sizeof(DrawIndexedIndirectArgs));
+		batch.lodErrorBuffer = CreateBuffer(GL_SHADER_STORAGE_BUFFER, lodErrors.data(), lodErrors.size() * sizeof(f32));
+		batch.activeIndirectBuffer = batch.indirectBuffer;
+
+		batch.stats.meshCount = (u32)batch.meshes.size();
+		batch.stats.drawCount = (u32)batch.draws.size();
+		batch.stats.commandCount = (u32)commands.size();
+		batch.stats.drawIdCapacity = (u32)drawIds.size();
+		batch.stats.vertexBytes = batch.vertices.size();
+		batch.stats.indexBytes = batch.indices.size() * sizeof(u32);
+
+		// Everything lives on the GPU from now on
+		batch.vertices = {};
+		batch.indices = {};
+		batch.draws = {};
+		batch.isBuilt = true;
+	}
+
+	void Record(batch_id id, CommandList& list)
+	{
+		const BatchInfo& batch{ GetBatch(id) };
+		assert(batch.isBuilt);
+
+		list.Record(BindVertexArrayCommand{ batch.vertexArray });
+		list.Record(BindBufferCommand{ batch.drawDataBuffer, drawDataBinding, BufferBinding::Storage });
+		list.Record(BindBufferCommand{ batch.activeIndirectBuffer, 0, BufferBinding::Indirect });
+		list.Record(DrawIndexedIndirectCommand{ 0, batch.stats.commandCount, 0, PrimitiveTopology::Triangles });
+	}
+
+	void SetDrawSource(batch_id id, GLuint drawIdBuffer, GLuint indirectBuffer)
+	{
+		BatchInfo& batch{ GetBatch(id) };
+		assert(batch.isBuilt && (drawIdBuffer != 0) == (indirectBuffer != 0));
+
+		State::BindVertexArray(batch.vertexArray);
+		glBindVertexBuffer(drawIdBufferBinding, drawIdBuffer ? drawIdBuffer : batch.drawIdBuffer, 0, sizeof(u32));
+		State::BindVertexArray(0);
+		batch.activeIndirectBuffer = indirectBuffer ? indirectBuffer : batch.indirectBuffer;
+	}
+
+	u32 DrawIndex(batch_id id, u32 instance)
+	{
+		const BatchInfo& batch{ GetBatch(id) };
+		assert(batch.isBuilt && instance < batch.drawIndices.size());
+		return batch.drawIndices[instance];
+	}
+
+	GLuint VertexArray(batch_id id)
+	{
+		return GetBatch(id).vertexArray;
+	}
+
+	GLuint DrawDataBuffer(batch_id id)
+	{
+		return GetBatch(id).drawDataBuffer;
+	}
+
+	GLuint DrawIdBuffer(batch_id id)
+	{
+		return GetBatch(id).drawIdBuffer;
+	}
+
+	GLuint IndirectBuffer(batch_id id)
+	{
+		return GetBatch(id).indirectBuffer;
+	}
+
+	GLuint LodErrorBuffer(batch_id id)
+	{
+		return GetBatch(id).lodErrorBuffer;
+	}
+
+	StaticBatchStats Stats(batch_id id)
+	{
+		return GetBatch(id).stats;
+	}
+}
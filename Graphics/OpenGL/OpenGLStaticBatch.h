@@ -0,0 +1,109 @@
+#pragma once
+
+#include "OpenGLCommonHeaders.h"
+#include "../CommandList.h"
+#include "../MeshLod.h"
+
+// Static geometry batching. Meshes are packed into one vertex and one index buffer,
+// every instance gets a record in a storage buffer, and the whole batch is drawn with
+// a single glMultiDrawElementsIndirect: one indirect command per level of detail of
+// each mesh, with the instances of that mesh drawn as instances of those commands.
+// Every command has its own range of the draw id stream, as long as the mesh has
+// instances. The batch itself draws everything at level 0, GPU culling moves
+// instances to the other commands (see OpenGLGpuCulling.h).
+//
+// Shaders find their instance record through a per-instance vertex attribute holding
+// the draw id (the attribute divisor honors baseInstance, gl_DrawID needs GL 4.6):
+//
+//     layout(location = 15) in uint drawId;
+//     layout(std430, binding = 0) readonly buffer DrawData { StaticDrawData draws[]; };
+namespace Havana::Graphics::OpenGL::StaticBatch
+{
+	DEFINE_TYPED_ID(batch_id);
+
+	constexpr u32 drawIdAttribute{ 15 };
+	constexpr u32 drawIdBufferBinding{ 15 };	// vertex buffer binding point of the draw id stream
+	constexpr u32 drawDataBinding{ 0 };			// storage buffer binding of the StaticDrawData array
+
+	struct VertexAttribute
+	{
+		u32		location{ 0 };
+		u32		componentCount{ 3 };
+		GLenum	type{ GL_FLOAT };
+		u32		offset{ 0 };
+		bool	isNormalized{ false };
+	};
+
+	struct StaticBatchInitInfo
+	{
+		const VertexAttribute*	attributes{ nullptr };
+		u32						attributeCount{ 0 };
+		u32						vertexStride{ 0 };
+	};
+
+	struct StaticMeshDesc
+	{
+		const void*		vertices{ nullptr };
+		const u32*		indices{ nullptr };
+		u32				vertexCount{ 0 };
+		u32				indexCount{ 0 };
+		f32				boundsCenter[3]{};	// bounding sphere in mesh space
+		f32				boundsRadius{ 0.0f };
+		const Lod::LodLevel*	lods{ nullptr };	// ranges of indices, finest first. None means indices is the only level.
+		u32						lodCount{ 0 };
+	};
+
+	// std430 layout
+	struct StaticDrawData
+	{
+		f32 world[16];			// column-major
+		f32 boundsCenter[3];	// bounding sphere in world space
+		f32 boundsRadius;
+		u32 mesh;
+		u32 material;
+		u32 command;			// index of the indirect command that draws this instance at level 0
+		u32 lodCount;			// level l is drawn by command + l
+	};
+	static_assert(sizeof(StaticDrawData) % 16 == 0);
+
+	struct StaticBatchStats
+	{
+		u32 meshCount{ 0 };
+		u32 drawCount{ 0 };			// instances
+		u32 commandCount{ 0 };		// indirect commands, one per level of each mesh
+		u32 drawIdCapacity{ 0 };	// length of the draw id stream, the sum of the commands' ranges
+		u64 vertexBytes{ 0 };
+		u64 indexBytes{ 0 };
+	};
+
+	[[nodiscard]] batch_id CreateBatch(const StaticBatchInitInfo& info);
+	void RemoveBatch(batch_id id);
+
+	// Geometry is copied, so the source can be released right away.
+	u32 AddMesh(batch_id id, const StaticMeshDesc& desc);
+	// Instances are numbered in the order they're added. Build() groups them by mesh,
+	// use DrawIndex() to find an instance's StaticDrawData and draw id afterwards.
+	u32 AddInstance(batch_id id, u32 mesh, const f32* const world, u32 material = 0);
+
+	// Upload everything and release the CPU copies. Must be called with a context current.
+	// No meshes or instances can be added afterwards.
+	void Build(batch_id id);
+
+	// Record the commands that draw the whole batch. The program must already be bound.
+	void Record(batch_id id, CommandList& list);
+
+	// Draw from another draw id stream and indirect buffer, such as the compacted output
+	// of GPU culling. Passing 0 for both restores the batch's own buffers.
+	void SetDrawSource(batch_id id, GLuint drawIdBuffer, GLuint indirectBuffer);
+
+	// Index of the instance's StaticDrawData, which is also its draw id. The batch must be built.
+	u32 DrawIndex(batch_id id, u32 instance);
+
+	// GL names used by other passes (e.g. GPU culling) that replace the indirect commands
+	GLuint VertexArray(batch_id id);
+	GLuint DrawDataBuffer(batch_id id);
+	GLuint DrawIdBuffer(batch_id id);
+	GLuint IndirectBuffer(batch_id id);
+	GLuint LodErrorBuffer(batch_id id);		// f32 error of each command's level, in mesh units
+	StaticBatchStats Stats(batch_id id);
+}
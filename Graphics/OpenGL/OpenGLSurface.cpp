@@ -0,0 +1,132 @@
+#include "OpenGLSurface.h"
+#include <cstdio>
+#include <cstring>
+
+namespace Havana::Graphics::OpenGL
+{
+	namespace
+	{
+		using glXSwapIntervalEXTProc = void(*)(Display*, GLXDrawable, int);
+		using glXSwapIntervalMESAProc = int(*)(unsigned int);
+		using glXSwapIntervalSGIProc = int(*)(int);
+
+		// EXT sets the interval of any drawable, MESA and SGI only that of the current one.
+		// SGI can't turn vsync off and neither of them knows about late swap tearing.
+		struct SwapControl
+		{
+			glXSwapIntervalEXTProc	swapIntervalEXT{ nullptr };
+			glXSwapIntervalMESAProc	swapIntervalMESA{ nullptr };
+			glXSwapIntervalSGIProc	swapIntervalSGI{ nullptr };
+			bool					hasTearControl{ false };
+			bool					isInitialized{ false };
+		} swapControl;
+
+		bool HasGlxExtension(Display* display, const char* name)
+		{
+			const char* extensions{ glXQueryExtensionsString(display, DefaultScreen(display)) };
+			const size_t length{ strlen(name) };
+			while (extensions && (extensions = strstr(extensions, name)))
+			{
+				// Whole tokens only, GLX_EXT_swap_control is a prefix of GLX_EXT_swap_control_tear
+				if (extensions[length] == ' ' || extensions[length] == '\0') return true;
+				extensions += length;
+			}
+			return false;
+		}
+
+		template<typename T>
+		T GetProc(Display* display, const char* extension, const char* name)
+		{
+			return HasGlxExtension(display, extension) ? (T)glXGetProcAddress((const GLubyte*)name) : nullptr;
+		}
+
+		void InitializeSwapControl(Display* display)
+		{
+			if (swapControl.isInitialized) return;
+			swapControl.swapIntervalEXT = GetProc<glXSwapIntervalEXTProc>(display, "GLX_EXT_swap_control", "glXSwapIntervalEXT");
+			swapControl.swapIntervalMESA = GetProc<glXSwapIntervalMESAProc>(display, "GLX_MESA_swap_control", "glXSwapIntervalMESA");
+			swapControl.swapIntervalSGI = GetProc<glXSwapIntervalSGIProc>(display, "GLX_SGI_swap_control", "glXSwapIntervalSGI");
+			swapControl.hasTearControl = swapControl.swapIntervalEXT && HasGlxExtension(display, "GLX_EXT_swap_control_tear");
+			swapControl.isInitialized = true;
+		}
+
+		// A compositing manager owns the _NET_WM_CM_Sn selection of its screen
+		bool IsCompositing(Display* display)
+		{
+			char name[32]{};
+			snprintf(name, sizeof(name), "_NET_WM_CM_S%d", DefaultScreen(display));
+			return XGetSelectionOwner(display, XInternAtom(display, name, False)) != None;
+		}
+
+		// Returns false when the interval isn't supported
+		bool SetSwapInterval(Display* display, GLXDrawable drawable, s32 interval)
+		{
+			if (swapControl.swapIntervalEXT)
+			{
+				if (interval < 0 && !swapControl.hasTearControl) return false;
+				swapControl.swapIntervalEXT(display, drawable, interval);
+				return true;
+			}
+			if (interval < 0) return false;
+			if (swapControl.swapIntervalMESA) return swapControl.swapIntervalMESA((unsigned int)interval) == 0;
+			if (swapControl.swapIntervalSGI && interval > 0) return swapControl.swapIntervalSGI(interval) == 0;
+			return false;
+		}
+	} // anonymous namespace
+
+	OpenGLSurface::OpenGLSurface(Platform::Window window) : m_window{ window }
+	{
+		assert(m_window.Handle());
+		// X window ids are global to the server, so the drawable can be used
+		// through the backend's own display connection.
+		m_drawable = *(XWindow*)m_window.Handle();
+	}
+
+	void OpenGLSurface::Resize(Display* display)
+	{
+		assert(display && m_drawable);
+		XWindowAttributes attributes{};
+		if (XGetWindowAttributes(display, m_drawable, &attributes))
+		{
+			m_width = (u32)attributes.width;
+			m_height = (u32)attributes.height;
+		}
+	}
+
+	void OpenGLSurface::MakeCurrent(Display* display, GLXContext context) const
+	{
+		assert(display && context && m_drawable);
+		glXMakeCurrent(display, m_drawable, context);
+	}
+
+	void OpenGLSurface::Present(Display* display) const
+	{
+		assert(display && m_drawable);
+		glXSwapBuffers(display, m_drawable);
+	}
+
+	void OpenGLSurface::SetPresentMode(Display* display, GLXContext context, PresentMode mode)
+	{
+		InitializeSwapControl(display);
+		MakeCurrent(display, context);
+
+		// Swapping without vsync under a compositor only replaces the frame it shows at
+		// the next vertical blank, so that is mailbox presentation. Without a compositor
+		// the same interval tears.
+		s32 interval{ 1 };
+		switch (mode)
+		{
+		case PresentMode::Immediate: interval = 0; break;
+		case PresentMode::Adaptive: interval = -1; break;
+		case PresentMode::Mailbox: interval = IsCompositing(display) ? 0 : 1; break;
+		default: break;
+		}
+
+		if (interval == 1) mode = PresentMode::VSync;
+		if (!SetSwapInterval(display, m_drawable, interval))
+		{
+			mode = SetSwapInterval(display, m_drawable, 1) ? PresentMode::VSync : m_presentMode;
+		}
+		m_presentMode = mode;
+	}
+}
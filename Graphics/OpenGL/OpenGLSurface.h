@@ -1,14 +1,37 @@
 #pragma once
 
 #include "OpenGLCommonHeaders.h"
+#include "../../Platforms/PlatformTypes.h"
 
 namespace Havana::Graphics::OpenGL
 {
-    class OpenGLSurface
-    {
-        public:
+	// A window drawable. All surfaces share the backend's single context, which is
+	// made current on a surface to render into its back buffer.
+	class OpenGLSurface
+	{
+	public:
+		constexpr OpenGLSurface() = default;
+		explicit OpenGLSurface(Platform::Window window);
 
-        private:
+		// Pick up the current size of the window
+		void Resize(Display* display);
+		void MakeCurrent(Display* display, GLXContext context) const;
+		void Present(Display* display) const;
+		// Sets the swap interval of the drawable, the context is left current on it.
+		// Modes the driver or window system can't provide fall back to vsync.
+		void SetPresentMode(Display* display, GLXContext context, PresentMode mode);
 
-    };
-}
\ No newline at end of file
+		constexpr u32 Width() const { return m_width; }
+		constexpr u32 Height() const { return m_height; }
+		constexpr XWindow Drawable() const { return m_drawable; }
+		constexpr bool IsValid() const { return m_drawable != 0; }
+		constexpr PresentMode GetPresentMode() const { return m_presentMode; }
+
+	private:
+		Platform::Window	m_window{};
+		XWindow				m_drawable{ 0 };
+		u32					m_width{ 0 };
+		u32					m_height{ 0 };
+		PresentMode			m_presentMode{ PresentMode::VSync };
+	};
+}
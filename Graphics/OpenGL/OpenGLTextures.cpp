@@ -0,0 +1,487 @@
+#include "OpenGLTextures.h"
+#include "OpenGLCore.h"
+#include "OpenGLStateCache.h"
+#include "../../Utilities/IndexPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace Havana::Graphics::OpenGL::Textures
+{
+	namespace
+	{
+		constexpr u32 maxTextures{ 4096 };
+		constexpr u32 maxUploadsPerFrame{ 128 };
+		constexpr u32 uploadAlignment{ 256 };
+		constexpr u32 tailSize{ 64 };				// mips this size and smaller are loaded together, up front
+		constexpr u32 evictionDelayFrames{ 120 };	// frames without requests before a texture gives up mips
+		constexpr u32 noRequest{ U32_INVALID_ID };
+		constexpr u32 ringSegmentCount{ frameBufferCount + 1 };
+
+		using glTexPageCommitmentProc = void(*)(GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLboolean);
+		using glBufferStorageProc = void(*)(GLenum, GLsizeiptr, const void*, GLbitfield);
+
+		struct TextureInfo
+		{
+			StreamingTextureDesc	desc{};
+			GLuint					texture{ 0 };
+			u32						residentMip{ 0 };	// finest mip that is resident (mipCount = none)
+			u32						tailMip{ 0 };		// first mip of the tail that is loaded in one go
+			u32						desiredMip{ 0 };
+			u32						sparseLevels{ 0 };	// mips below this index can be (de)committed
+			u64						lastRequestFrame{ 0 };
+			std::atomic<u32>		requestedMip{ noRequest };
+			bool					isAlive{ false };
+		};
+
+		struct Upload
+		{
+			u32 textureIndex;
+			u32 mip;
+			u32 offset;
+		};
+
+		// Pixel buffer ring split in one segment per frame in flight
+		struct UploadRing
+		{
+			GLuint	buffer{ 0 };
+			u8*		mapped{ nullptr };		// only when persistently mapped
+			u32		segmentSize{ 0 };
+			GLsync	fences[ringSegmentCount]{};
+			bool	isPersistent{ false };
+		};
+
+		std::unique_ptr<TextureInfo[]>	textures{};
+		// Slots of removed textures are reused after frameBufferCount frames, so an id that
+		// culling jobs still hold can't refer to a new texture during the frame it was removed in
+		Utils::IndexPool<frameBufferCount>	freeSlots;
+		UploadRing						ring{};
+		StreamingStats					stats{};
+		u64								frameNumber{ 0 };
+		glTexPageCommitmentProc			glTexPageCommitment{ nullptr };
+
+		constexpr GLenum ToGLFormat(TextureFormat format)
+		{
+			return format == TextureFormat::SRGBA8 ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		}
+
+		constexpr u32 MipDimension(u32 size, u32 mip)
+		{
+			return std::max(size >> mip, 1u);
+		}
+
+		constexpr u32 MipBytes(const StreamingTextureDesc& desc, u32 mip)
+		{
+			return MipDimension(desc.width, mip) * MipDimension(desc.height, mip) * 4;
+		}
+
+		constexpr u32 AlignUp(u32 value, u32 alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		[[maybe_unused]] bool IsValidTexture(texture_id id)
+		{
+			return id < maxTextures && textures[id].isAlive;
+		}
+
+		// Mip levels below the sparse tail are committed as they become resident and
+		// decommitted when they're evicted.
+		void SetCommitment(const TextureInfo& info, u32 mip, bool commit)
+		{
+			if (!glTexPageCommitment || mip >= info.sparseLevels) return;
+			State::BindTexture(0, GL_TEXTURE_2D, info.texture);
+			glTexPageCommitment(GL_TEXTURE_2D, (GLint)mip, 0, 0, 0,
+								(GLsizei)MipDimension(info.desc.width, mip), (GLsizei)MipDimension(info.desc.height, mip), 1,
+								commit ? GL_TRUE : GL_FALSE);
+		}
+
+		void SetResidentMip(TextureInfo& info, u32 mip)
+		{
+			info.residentMip = mip;
+			// Keep sampling away from mips that aren't resident
+			State::BindTexture(0, GL_TEXTURE_2D, info.texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)std::min(mip, info.desc.mipCount - 1));
+		}
+
+		bool EvictOne(u32 excludedIndex)
+		{
+			// Pick the texture that has the most mips it doesn't need, preferring ones
+			// that haven't been requested for a while.
+			u32 victim{ U32_INVALID_ID };
+			u32 victimScore{ 0 };
+			for (u32 i{ 0 }; i < maxTextures; i++)
+			{
+				const TextureInfo& info{ textures[i] };
+				if (!info.isAlive || i == excludedIndex || info.residentMip >= info.tailMip) continue;
+
+				const bool isStale{ frameNumber - info.lastRequestFrame > evictionDelayFrames };
+				const u32 surplus{ info.desiredMip > info.residentMip ? info.desiredMip - info.residentMip : 0 };
+				const u32 score{ isStale ? surplus + 64 : surplus };
+				if (score > victimScore)
+				{
+					victim = i;
+					victimScore = score;
+				}
+			}
+
+			if (victim == U32_INVALID_ID) return false;
+
+			TextureInfo& info{ textures[victim] };
+			const u32 mip{ info.residentMip };
+			SetResidentMip(info, mip + 1);
+			SetCommitment(info, mip, false);
+			stats.residentBytes -= MipBytes(info.desc, mip);
+			stats.evictionCount++;
+			return true;
+		}
+
+		void UpdateDemand()
+		{
+			for (u32 i{ 0 }; i < maxTextures; i++)
+			{
+				TextureInfo& info{ textures[i] };
+				if (!info.isAlive) continue;
+
+				const u32 requested{ info.requestedMip.exchange(noRequest, std::memory_order_relaxed) };
+				if (requested != noRequest)
+				{
+					info.desiredMip = requested;
+					info.lastRequestFrame = frameNumber;
+				}
+				else if (frameNumber - info.lastRequestFrame > evictionDelayFrames)
+				{
+					// Not visible for a while, only keep the tail
+					info.desiredMip = info.tailMip;
+				}
+			}
+		}
+
+		u32 GatherUploads(Upload* uploads)
+		{
+			// Textures without their tail come first, then the ones furthest from their desired mip
+			u32 candidates[maxTextures];
+			u32 candidateCount{ 0 };
+			for (u32 i{ 0 }; i < maxTextures; i++)
+			{
+				const TextureInfo& info{ textures[i] };
+				if (info.isAlive && info.residentMip > info.desiredMip) candidates[candidateCount++] = i;
+			}
+
+			auto priority = [](const TextureInfo& info)
+			{
+				return info.residentMip == info.desc.mipCount ? U32_INVALID_ID : info.residentMip - info.desiredMip;
+			};
+			std::sort(&candidates[0], &candidates[candidateCount], [&priority](u32 a, u32 b)
+			{
+				return priority(textures[a]) > priority(textures[b]);
+			});
+
+			u32 uploadCount{ 0 };
+			u32 offset{ 0 };
+			for (u32 c{ 0 }; c < candidateCount && uploadCount < maxUploadsPerFrame; c++)
+			{
+				TextureInfo& info{ textures[candidates[c]] };
+
+				// The tail is uploaded in one go, after that one mip per texture per frame
+				const bool isTail{ info.residentMip == info.desc.mipCount };
+				const u32 lastMip{ isTail ? info.desc.mipCount - 1 : info.residentMip - 1 };
+				const u32 firstMip{ isTail ? info.tailMip : info.residentMip - 1 };
+
+				u32 bytes{ 0 };
+				u32 ringBytes{ 0 };
+				for (u32 mip{ firstMip }; mip <= lastMip; mip++)
+				{
+					bytes += MipBytes(info.desc, mip);
+					ringBytes += AlignUp(MipBytes(info.desc, mip), uploadAlignment);
+				}
+
+				if (offset + ringBytes > ring.segmentSize || uploadCount + (lastMip - firstMip + 1) > maxUploadsPerFrame) continue;
+
+				bool hasMemory{ true };
+				while (stats.residentBytes + bytes > stats.memoryBudget)
+				{
+					if (!EvictOne(candidates[c]))
+					{
+						hasMemory = false;
+						break;
+					}
+				}
+				if (!hasMemory) continue;
+
+				for (u32 mip{ lastMip }; mip + 1 > firstMip; mip--)
+				{
+					uploads[uploadCount++] = { candidates[c], mip, offset };
+					offset += AlignUp(MipBytes(info.desc, mip), uploadAlignment);
+				}
+				stats.residentBytes += bytes;
+			}
+
+			return uploadCount;
+		}
+	} // anonymous namespace
+
+	/// <summary>
+	/// Create the upload ring and the texture table. Must be called with a context current.
+	/// </summary>
+	/// <param name="memoryBudget"> - Maximum number of bytes of resident mips.</param>
+	/// <param name="uploadBytesPerFrame"> - Size of each per-frame segment of the upload ring.</param>
+	/// <returns>True if initialization succeeded.</returns>
+	bool Initialize(u64 memoryBudget, u32 uploadBytesPerFrame)
+	{
+		assert(memoryBudget && uploadBytesPerFrame);
+		Shutdown();
+
+		textures = std::make_unique<TextureInfo[]>(maxTextures);
+		freeSlots.Initialize(maxTextures, Memory::Tag::Graphics);
+
+		stats = {};
+		stats.memoryBudget = memoryBudget;
+
+		if (Core::HasExtension("GL_ARB_sparse_texture"))
+		{
+			glTexPageCommitment = (glTexPageCommitmentProc)glXGetProcAddress((const GLubyte*)"glTexPageCommitmentARB");
+			stats.isSparse = glTexPageCommitment != nullptr;
+		}
+
+		ring.segmentSize = AlignUp(uploadBytesPerFrame, uploadAlignment);
+		const GLsizeiptr ringSize{ (GLsizeiptr)ring.segmentSize * ringSegmentCount };
+		glGenBuffers(1, &ring.buffer);
+		State::BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer);
+
+		const auto glBufferStorage{ (glBufferStorageProc)glXGetProcAddress((const GLubyte*)"glBufferStorage") };
+		if (glBufferStorage && Core::HasExtension("GL_ARB_buffer_storage"))
+		{
+			constexpr GLbitfield flags{ GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT };
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringSize, nullptr, flags);
+			ring.mapped = (u8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringSize, flags);
+			ring.isPersistent = ring.mapped != nullptr;
+		}
+
+		if (!ring.isPersistent)
+		{
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, ringSize, nullptr, GL_STREAM_DRAW);
+		}
+
+		State::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return ring.buffer != 0;
+	}
+
+	void Shutdown()
+	{
+		if (textures)
+		{
+			for (u32 i{ 0 }; i < maxTextures; i++)
+			{
+				if (textures[i].isAlive) RemoveTexture(texture_id{ i });
+			}
+			textures.reset();
+		}
+		freeSlots.Release();
+
+		for (GLsync& fence : ring.fences)
+		{
+			if (fence) glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		if (ring.buffer)
+		{
+			if (ring.isPersistent)
+			{
+				State::BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				State::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			}
+			glDeleteBuffers(1, &ring.buffer);
+			State::OnBufferDeleted(ring.buffer);
+		}
+		ring = {};
+		frameNumber = 0;
+	}
+
+	texture_id CreateTexture(const StreamingTextureDesc& desc)
+	{
+		PROFILE_SCOPE("Textures::CreateTexture");
+		assert(desc.width && desc.height && desc.mipCount && desc.loader);
+		const u32 index{ freeSlots.Allocate() };
+		assert(index != U32_INVALID_ID);
+		if (index == U32_INVALID_ID) return texture_id{ Id::INVALID_ID };
+
+		TextureInfo& info{ textures[index] };
+		info.desc = desc;
+		info.residentMip = desc.mipCount;
+		info.tailMip = desc.mipCount - 1;
+		while (info.tailMip > 0 &&
+			   MipDimension(desc.width, info.tailMip - 1) <= tailSize && MipDimension(desc.height, info.tailMip - 1) <= tailSize)
+		{
+			info.tailMip--;
+		}
+		info.desiredMip = info.tailMip;
+		info.lastRequestFrame = frameNumber;
+		info.requestedMip.store(noRequest, std::memory_order_relaxed);
+		info.sparseLevels = 0;
+
+		glGenTextures(1, &info.texture);
+		State::BindTexture(0, GL_TEXTURE_2D, info.texture);
+
+		bool isSparse{ false };
+		if (glTexPageCommitment)
+		{
+			// Sparse textures have to be a multiple of the page size
+			GLint pageX{ 0 }, pageY{ 0 };
+			glGetInternalformativ(GL_TEXTURE_2D, ToGLFormat(desc.format), GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &pageX);
+			glGetInternalformativ(GL_TEXTURE_2D, ToGLFormat(desc.format), GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &pageY);
+			isSparse = pageX > 0 && pageY > 0 && desc.width % pageX == 0 && desc.height % pageY == 0;
+			if (isSparse) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+		}
+
+		glTexStorage2D(GL_TEXTURE_2D, (GLsizei)desc.mipCount, ToGLFormat(desc.format), (GLsizei)desc.width, (GLsizei)desc.height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.mipCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)desc.mipCount - 1);
+
+		if (isSparse)
+		{
+			GLint sparseLevels{ 0 };
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_NUM_SPARSE_LEVELS_ARB, &sparseLevels);
+			info.sparseLevels = std::min((u32)sparseLevels, info.tailMip);
+
+			// The sparse mip tail is always committed
+			if ((u32)sparseLevels < desc.mipCount)
+			{
+				glTexPageCommitment(GL_TEXTURE_2D, sparseLevels, 0, 0, 0,
+									(GLsizei)MipDimension(desc.width, sparseLevels), (GLsizei)MipDimension(desc.height, sparseLevels), 1, GL_TRUE);
+			}
+			for (u32 mip{ info.sparseLevels }; mip < (u32)sparseLevels; mip++)
+				SetCommitment(info, mip, true);
+		}
+
+		info.isAlive = true;
+		return texture_id{ index };
+	}
+
+	void RemoveTexture(texture_id id)
+	{
+		PROFILE_SCOPE("Textures::RemoveTexture");
+		assert(IsValidTexture(id));
+		TextureInfo& info{ textures[id] };
+
+		for (u32 mip{ info.residentMip }; mip < info.desc.mipCount; mip++)
+			stats.residentBytes -= MipBytes(info.desc, mip);
+
+		glDeleteTextures(1, &info.texture);
+		State::OnTextureDeleted(info.texture);
+		info.texture = 0;
+		info.isAlive = false;
+		freeSlots.Free((u32)id, (u32)(frameNumber % frameBufferCount));
+	}
+
+	GLuint Handle(texture_id id)
+	{
+		assert(IsValidTexture(id));
+		return textures[id].texture;
+	}
+
+	u32 ResidentMip(texture_id id)
+	{
+		assert(IsValidTexture(id));
+		return textures[id].residentMip;
+	}
+
+	void RequestScreenSize(texture_id id, f32 screenPixels)
+	{
+		assert(IsValidTexture(id));
+		TextureInfo& info{ textures[id] };
+
+		// The mip whose size is closest to (but not smaller than) the on-screen size
+		const f32 largest{ (f32)std::max(info.desc.width, info.desc.height) };
+		const f32 ratio{ screenPixels > 1.0f ? largest / screenPixels : largest };
+		const u32 mip{ std::min(ratio > 1.0f ? (u32)std::floor(std::log2(ratio)) : 0u, info.tailMip) };
+
+		// Keep the finest request of this frame
+		u32 current{ info.requestedMip.load(std::memory_order_relaxed) };
+		while (mip < current && !info.requestedMip.compare_exchange_weak(current, mip, std::memory_order_relaxed)) {}
+	}
+
+	void Update()
+	{
+		PROFILE_SCOPE("Textures::Update");
+		frameNumber++;
+		freeSlots.ProcessDeferredFree((u32)(frameNumber % frameBufferCount));
+		stats.uploadCount = 0;
+		stats.uploadBytes = 0;
+		stats.evictionCount = 0;
+
+		UpdateDemand();
+
+		// Don't wait for the GPU: if it's still reading this segment, try again next frame
+		const u32 segment{ (u32)(frameNumber % ringSegmentCount) };
+		GLsync& fence{ ring.fences[segment] };
+		if (fence)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				stats.stalledFrames++;
+				return;
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		Upload uploads[maxUploadsPerFrame];
+		const u32 uploadCount{ GatherUploads(&uploads[0]) };
+		if (!uploadCount) return;
+
+		const u32 segmentOffset{ segment * ring.segmentSize };
+		State::BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer);
+		u8* const base{ ring.isPersistent
+						? ring.mapped + segmentOffset
+						: (u8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, segmentOffset, ring.segmentSize,
+												GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT) };
+		assert(base);
+
+		bool isLoaded[maxUploadsPerFrame];
+		for (u32 i{ 0 }; i < uploadCount; i++)
+		{
+			const Upload& upload{ uploads[i] };
+			const TextureInfo& info{ textures[upload.textureIndex] };
+			isLoaded[i] = info.desc.loader(info.desc.userData, upload.mip, base + upload.offset, MipBytes(info.desc, upload.mip));
+		}
+
+		if (!ring.isPersistent) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// Uploads are ordered coarse to fine per texture, so the resident range stays contiguous
+		for (u32 i{ 0 }; i < uploadCount; i++)
+		{
+			const Upload& upload{ uploads[i] };
+			TextureInfo& info{ textures[upload.textureIndex] };
+			const u32 bytes{ MipBytes(info.desc, upload.mip) };
+
+			if (!isLoaded[i] || upload.mip + 1 != info.residentMip)
+			{
+				// Give the memory back; the mip will be requested again later
+				stats.residentBytes -= bytes;
+				continue;
+			}
+
+			SetCommitment(info, upload.mip, true);
+			State::BindTexture(0, GL_TEXTURE_2D, info.texture);
+			glTexSubImage2D(GL_TEXTURE_2D, (GLint)upload.mip, 0, 0,
+							(GLsizei)MipDimension(info.desc.width, upload.mip), (GLsizei)MipDimension(info.desc.height, upload.mip),
+							GL_RGBA, GL_UNSIGNED_BYTE, (const void*)(uintptr_t)(segmentOffset + upload.offset));
+			SetResidentMip(info, upload.mip);
+
+			stats.uploadCount++;
+			stats.uploadBytes += bytes;
+		}
+
+		State::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	const StreamingStats& Stats()
+	{
+		return stats;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "OpenGLCommonHeaders.h"
+
+// Streaming texture manager. Textures start with only their smallest mips resident
+// and finer mips are streamed in (coarse to fine) as the renderer reports how large
+// the texture appears on screen. Uploads go through a persistently mapped pixel
+// buffer ring that is split in per-frame segments guarded by fences, so the CPU
+// never waits for the GPU. Sparse textures are used when the driver supports them,
+// so mips that aren't resident don't take up memory.
+namespace Havana::Graphics::OpenGL::Textures
+{
+	DEFINE_TYPED_ID(texture_id);
+
+	// Write the pixels of mip level "mip" into "destination" (which is "size" bytes of
+	// mapped buffer memory). Called on the context thread during Update().
+	using mip_loader = bool(*)(void* userData, u32 mip, void* destination, u32 size);
+
+	enum class TextureFormat : u32
+	{
+		RGBA8 = 0,
+		SRGBA8
+	};
+
+	struct StreamingTextureDesc
+	{
+		u32				width{ 0 };
+		u32				height{ 0 };
+		u32				mipCount{ 1 };
+		TextureFormat	format{ TextureFormat::RGBA8 };
+		mip_loader		loader{ nullptr };
+		void*			userData{ nullptr };
+	};
+
+	struct StreamingStats
+	{
+		u64		residentBytes{ 0 };
+		u64		memoryBudget{ 0 };
+		u32		uploadCount{ 0 };		// mips uploaded last frame
+		u32		uploadBytes{ 0 };		// bytes uploaded last frame
+		u32		evictionCount{ 0 };		// mips evicted last frame
+		u32		stalledFrames{ 0 };		// frames where the ring segment was still in use by the GPU
+		bool	isSparse{ false };
+	};
+
+	bool Initialize(u64 memoryBudget, u32 uploadBytesPerFrame);
+	void Shutdown();
+
+	[[nodiscard]] texture_id CreateTexture(const StreamingTextureDesc& desc);
+	void RemoveTexture(texture_id id);
+	GLuint Handle(texture_id id);
+	u32 ResidentMip(texture_id id);
+
+	// Report the size (in pixels) of the largest on-screen footprint of a texture this
+	// frame. Thread-safe, so culling jobs can call it directly.
+	void RequestScreenSize(texture_id id, f32 screenPixels);
+
+	// Retire finished uploads, evict and stream mips. Call once per frame on the context thread.
+	void Update();
+
+	const StreamingStats& Stats();
+}
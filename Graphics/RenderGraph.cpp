@@ -0,0 +1,354 @@
+#include "RenderGraph.h"
+
+namespace Havana::Graphics
+{
+	namespace
+	{
+		constexpr u64 RenderTargetBytes(const RenderTargetDesc& desc)
+		{
+			return (u64)desc.width * desc.height * BytesPerPixel(desc.format);
+		}
+	} // anonymous namespace
+
+	u32 RenderGraph::CreateTransient(const char* name, const RenderTargetDesc& desc)
+	{
+		assert(!m_isCompiled);
+		assert(desc.width && desc.height);
+		ResourceNode node{};
+		node.name = name;
+		node.desc = desc;
+		m_resources.emplace_back(node);
+		return (u32)m_resources.size() - 1;
+	}
+
+	// Imported resources (e.g. the back buffer) live outside the graph. Writing to
+	// them counts as an output, so passes that produce them are never culled.
+	u32 RenderGraph::Import(const char* name, const RenderTargetDesc& desc, u32 renderTarget)
+	{
+		assert(!m_isCompiled);
+		ResourceNode node{};
+		node.name = name;
+		node.desc = desc;
+		node.physical = renderTarget;
+		node.isImported = true;
+		m_resources.emplace_back(node);
+		return (u32)m_resources.size() - 1;
+	}
+
+	u32 RenderGraph::AddPass(const char* name, render_pass_function function, void* data, bool hasSideEffects /*= false*/)
+	{
+		assert(!m_isCompiled && function);
+		PassNode& pass{ m_passes.emplace_back() };
+		pass.name = name;
+		pass.function = function;
+		pass.data = data;
+		pass.hasSideEffects = hasSideEffects;
+		return (u32)m_passes.size() - 1;
+	}
+
+	void RenderGraph::Read(u32 pass, u32 resource)
+	{
+		assert(!m_isCompiled);
+		assert(pass < m_passes.size() && resource < m_resources.size());
+		// Passes must be added in an order where every resource is written before it is read.
+		assert(m_resources[resource].writerCount || m_resources[resource].isImported);
+		m_passes[pass].reads.emplace_back(resource);
+	}
+
+	void RenderGraph::Write(u32 pass, u32 resource, LoadOp loadOp /*= LoadOp::Load*/, const ClearValue& clearValue /*= {}*/)
+	{
+		assert(!m_isCompiled);
+		assert(pass < m_passes.size() && resource < m_resources.size());
+		// At most maxRenderTargets color targets and one depth target per pass
+		const bool isDepth{ IsDepthFormat(m_resources[resource].desc.format) };
+		[[maybe_unused]] u32 sameKindCount{ 0 };
+		for (const ResourceWrite& write : m_passes[pass].writes)
+			if (IsDepthFormat(m_resources[write.resource].desc.format) == isDepth) sameKindCount++;
+		assert(sameKindCount < (isDepth ? 1u : maxRenderTargets));
+		m_passes[pass].writes.emplace_back(ResourceWrite{ resource, loadOp, clearValue });
+		m_resources[resource].writerCount++;
+	}
+
+	bool RenderGraph::Compile()
+	{
+		assert(!m_isCompiled);
+		CullPasses();
+		ComputeLifetimes();
+		AssignPhysicalResources();
+		m_isCompiled = true;
+		return !m_executionOrder.empty();
+	}
+
+	void RenderGraph::Execute(CommandList& commandList) const
+	{
+		assert(m_isCompiled);
+		RenderPassContext context{};
+		context.commandList = &commandList;
+		context.graph = this;
+		context.frameMemory = &FrameMemory();
+
+		for (const u32 index : m_executionOrder)
+		{
+			const PassNode& pass{ m_passes[index] };
+			commandList.Record(BeginGpuScopeCommand{ pass.name });
+			RecordPassBegin(pass, commandList);
+			pass.function(context, pass.data);
+			commandList.Record(EndGpuScopeCommand{});
+		}
+	}
+
+	// Drop all passes and resources so the graph can be rebuilt. Physical render
+	// targets are kept and reused by the next compilation if their descriptions match.
+	void RenderGraph::Reset()
+	{
+		m_passes.clear();
+		m_resources.clear();
+		m_executionOrder.clear();
+		m_transientBytes = 0;
+		m_unaliasedTransientBytes = 0;
+		m_isCompiled = false;
+	}
+
+	void RenderGraph::Release()
+	{
+		Reset();
+		for (PhysicalRenderTarget& physical : m_physical)
+			RemoveRenderTarget(physical.renderTarget);
+		m_physical.clear();
+	}
+
+	u32 RenderGraph::RenderTarget(u32 resource) const
+	{
+		assert(m_isCompiled && resource < m_resources.size());
+		const ResourceNode& node{ m_resources[resource] };
+		if (node.isImported) return node.physical;
+		assert(node.physical < m_physical.size());
+		return m_physical[node.physical].renderTarget;
+	}
+
+	bool RenderGraph::IsPassCulled(u32 pass) const
+	{
+		assert(m_isCompiled && pass < m_passes.size());
+		return m_passes[pass].isCulled;
+	}
+
+	// PRIVATE
+
+	// Reference counting flood fill: a resource that nobody reads releases its writers,
+	// and a pass whose outputs are all unused releases the resources it reads.
+	void RenderGraph::CullPasses()
+	{
+		for (ResourceNode& resource : m_resources)
+			resource.refCount = resource.isImported ? 1 : 0;
+
+		for (PassNode& pass : m_passes)
+		{
+			pass.refCount = (u32)pass.writes.size();
+			pass.isCulled = false;
+			for (const u32 resource : pass.reads)
+				m_resources[resource].refCount++;
+		}
+
+		Utils::vector<u32> unreferenced;
+		for (u32 i{ 0 }; i < (u32)m_resources.size(); i++)
+		{
+			if (!m_resources[i].refCount) unreferenced.emplace_back(i);
+		}
+
+		auto cullPass = [this, &unreferenced](PassNode& pass)
+		{
+			pass.isCulled = true;
+			for (const u32 resource : pass.reads)
+			{
+				assert(m_resources[resource].refCount);
+				if (--m_resources[resource].refCount == 0)
+					unreferenced.emplace_back(resource);
+			}
+		};
+
+		// Passes that don't write anything are only kept for their side effects
+		for (PassNode& pass : m_passes)
+		{
+			if (!pass.refCount && !pass.hasSideEffects) cullPass(pass);
+		}
+
+		while (!unreferenced.empty())
+		{
+			const u32 resource{ unreferenced.back() };
+			unreferenced.pop_back();
+
+			for (PassNode& pass : m_passes)
+			{
+				if (pass.isCulled || pass.hasSideEffects) continue;
+				for (const ResourceWrite& write : pass.writes)
+				{
+					if (write.resource != resource) continue;
+					assert(pass.refCount);
+					if (--pass.refCount == 0) cullPass(pass);
+				}
+			}
+		}
+	}
+
+	void RenderGraph::ComputeLifetimes()
+	{
+		m_executionOrder.clear();
+		for (u32 i{ 0 }; i < (u32)m_passes.size(); i++)
+		{
+			if (!m_passes[i].isCulled) m_executionOrder.emplace_back(i);
+		}
+
+		auto touch = [](ResourceNode& resource, u32 order)
+		{
+			if (resource.firstPass == invalidHandle) resource.firstPass = order;
+			resource.lastPass = order;
+		};
+
+		for (u32 order{ 0 }; order < (u32)m_executionOrder.size(); order++)
+		{
+			const PassNode& pass{ m_passes[m_executionOrder[order]] };
+			for (const u32 resource : pass.reads) touch(m_resources[resource], order);
+			for (const ResourceWrite& write : pass.writes) touch(m_resources[write.resource], order);
+		}
+	}
+
+	// Walk the passes in execution order, giving each transient resource a physical render
+	// target when it's first used and returning that render target to the free list after
+	// its last use. Resources with matching descriptions then share the same memory.
+	void RenderGraph::AssignPhysicalResources()
+	{
+		for (PhysicalRenderTarget& physical : m_physical)
+			physical.isInUse = false;
+		Utils::vector<bool> isUsed(m_physical.size(), false);
+
+		auto acquire = [this, &isUsed](ResourceNode& resource)
+		{
+			for (u32 i{ 0 }; i < (u32)m_physical.size(); i++)
+			{
+				PhysicalRenderTarget& physical{ m_physical[i] };
+				if (!physical.isInUse && physical.desc == resource.desc)
+				{
+					physical.isInUse = true;
+					isUsed[i] = true;
+					resource.physical = i;
+					return;
+				}
+			}
+
+			PhysicalRenderTarget physical{};
+			physical.desc = resource.desc;
+			physical.renderTarget = CreateRenderTarget(resource.desc);
+			physical.isInUse = true;
+			m_physical.emplace_back(physical);
+			isUsed.emplace_back(true);
+			resource.physical = (u32)m_physical.size() - 1;
+		};
+
+		for (u32 order{ 0 }; order < (u32)m_executionOrder.size(); order++)
+		{
+			const PassNode& pass{ m_passes[m_executionOrder[order]] };
+			auto begin = [&](u32 index)
+			{
+				ResourceNode& resource{ m_resources[index] };
+				if (resource.isImported || resource.firstPass != order || resource.physical != invalidHandle) return;
+				acquire(resource);
+				m_unaliasedTransientBytes += RenderTargetBytes(resource.desc);
+			};
+			for (const u32 resource : pass.reads) begin(resource);
+			for (const ResourceWrite& write : pass.writes) begin(write.resource);
+
+			auto end = [&](u32 index)
+			{
+				const ResourceNode& resource{ m_resources[index] };
+				if (resource.isImported || resource.lastPass != order) return;
+				m_physical[resource.physical].isInUse = false;
+			};
+			for (const u32 resource : pass.reads) end(resource);
+			for (const ResourceWrite& write : pass.writes) end(write.resource);
+		}
+
+		// Remove render targets left over from a previous compilation and compact the rest
+		Utils::vector<u32> remap(m_physical.size(), invalidHandle);
+		u32 count{ 0 };
+		for (u32 i{ 0 }; i < (u32)m_physical.size(); i++)
+		{
+			if (!isUsed[i])
+			{
+				RemoveRenderTarget(m_physical[i].renderTarget);
+				continue;
+			}
+			remap[i] = count;
+			m_physical[count++] = m_physical[i];
+		}
+		m_physical.resize(count);
+
+		m_transientBytes = 0;
+		for (const PhysicalRenderTarget& physical : m_physical)
+			m_transientBytes += RenderTargetBytes(physical.desc);
+
+		for (ResourceNode& resource : m_resources)
+		{
+			if (!resource.isImported && resource.physical != invalidHandle)
+				resource.physical = remap[resource.physical];
+		}
+	}
+
+	// Bind the pass outputs and issue the clears it asked for. Writes with LoadOp::Load
+	// to a transient resource that hasn't been written yet have undefined contents,
+	// so they (and LoadOp::DontCare) never generate a clear.
+	void RenderGraph::RecordPassBegin(const PassNode& pass, CommandList& commandList) const
+	{
+		if (pass.writes.empty()) return;
+
+		SetRenderTargetsCommand targets{};
+		for (u32 i{ 0 }; i < maxRenderTargets; i++) targets.colors[i] = invalidHandle;
+		targets.depthStencil = invalidHandle;
+
+		ClearCommand clear{};
+		u32 colorCount{ 0 };
+		bool hasColorClear{ false };
+
+		for (const ResourceWrite& write : pass.writes)
+		{
+			const ResourceNode& resource{ m_resources[write.resource] };
+			const bool isDepth{ IsDepthFormat(resource.desc.format) };
+			if (isDepth)
+			{
+				assert(targets.depthStencil == invalidHandle);
+				targets.depthStencil = RenderTarget(write.resource);
+			}
+			else
+			{
+				assert(colorCount < maxRenderTargets);
+				targets.colors[colorCount++] = RenderTarget(write.resource);
+			}
+
+			if (write.loadOp != LoadOp::Clear) continue;
+
+			if (isDepth)
+			{
+				clear.flags |= ClearFlags::Depth;
+				clear.depth = write.clearValue.depth;
+				if (resource.desc.format == RenderTargetFormat::Depth24Stencil8)
+				{
+					clear.flags |= ClearFlags::Stencil;
+					clear.stencil = write.clearValue.stencil;
+				}
+			}
+			else if (!hasColorClear)
+			{
+				// NOTE: all color targets of a pass are cleared to the first clear color
+				clear.flags |= ClearFlags::Color;
+				memcpy(clear.color, write.clearValue.color, sizeof(clear.color));
+				hasColorClear = true;
+			}
+		}
+
+		commandList.Record(targets);
+
+		const RenderTargetDesc& desc{ m_resources[pass.writes[0].resource].desc };
+		commandList.Record(SetViewportCommand{ 0, 0, desc.width, desc.height });
+
+		if (clear.flags) commandList.Record(clear);
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "../Common/CommonHeaders.h"
+#include "Renderer.h"
+
+namespace Havana::Graphics
+{
+	enum class LoadOp : u8
+	{
+		Load = 0,	// keep the previous contents
+		Clear,		// clear before the pass runs
+		DontCare	// the pass overwrites everything
+	};
+
+	struct ClearValue
+	{
+		f32 color[4]{ 0.0f, 0.0f, 0.0f, 0.0f };
+		f32 depth{ 1.0f };
+		u32 stencil{ 0 };
+	};
+
+	class RenderGraph;
+
+	struct RenderPassContext
+	{
+		CommandList*		commandList{ nullptr };
+		const RenderGraph*	graph{ nullptr };
+		Utils::FrameArena*	frameMemory{ nullptr };	// for data the pass needs until the end of the frame
+	};
+
+	using render_pass_function = void(*)(const RenderPassContext&, void*);
+
+	// Frame graph built from passes that declare which resources they read and write.
+	// Compile() culls passes whose results are never used, computes resource lifetimes
+	// and lets transient render targets with non-overlapping lifetimes share the same
+	// physical render target. The compiled graph is executed every frame until the
+	// topology changes, at which point the graph is reset and rebuilt.
+	class RenderGraph
+	{
+	public:
+		constexpr static u32 invalidHandle{ U32_INVALID_ID };
+
+		RenderGraph() = default;
+		DISABLE_COPY_AND_MOVE(RenderGraph);
+		~RenderGraph() { Release(); }
+
+		// Implemented in the translation unit for this header
+		u32 CreateTransient(const char* name, const RenderTargetDesc& desc);
+		u32 Import(const char* name, const RenderTargetDesc& desc, u32 renderTarget);
+		u32 AddPass(const char* name, render_pass_function function, void* data, bool hasSideEffects = false);
+		void Read(u32 pass, u32 resource);
+		void Write(u32 pass, u32 resource, LoadOp loadOp = LoadOp::Load, const ClearValue& clearValue = {});
+
+		bool Compile();
+		void Execute(CommandList& commandList) const;
+		void Reset();
+		void Release();
+
+		u32 RenderTarget(u32 resource) const;
+		constexpr bool IsCompiled() const { return m_isCompiled; }
+		bool IsPassCulled(u32 pass) const;
+
+		// Memory statistics for the last compilation
+		constexpr u64 TransientBytes() const { return m_transientBytes; }
+		constexpr u64 UnaliasedTransientBytes() const { return m_unaliasedTransientBytes; }
+		u32 PhysicalRenderTargetCount() const { return (u32)m_physical.size(); }
+
+	private:
+		struct ResourceNode
+		{
+			const char*			name{ nullptr };
+			RenderTargetDesc	desc{};
+			u32					physical{ invalidHandle };	// index into m_physical, or render target handle for imports
+			u32					firstPass{ invalidHandle };
+			u32					lastPass{ invalidHandle };
+			u32					refCount{ 0 };
+			u32					writerCount{ 0 };
+			bool				isImported{ false };
+		};
+
+		struct ResourceWrite
+		{
+			u32			resource{ invalidHandle };
+			LoadOp		loadOp{ LoadOp::Load };
+			ClearValue	clearValue{};
+		};
+
+		struct PassNode
+		{
+			const char*					name{ nullptr };
+			render_pass_function		function{ nullptr };
+			void*						data{ nullptr };
+			Utils::vector<u32>			reads;
+			Utils::vector<ResourceWrite> writes;
+			u32							refCount{ 0 };
+			bool						hasSideEffects{ false };
+			bool						isCulled{ false };
+		};
+
+		struct PhysicalRenderTarget
+		{
+			RenderTargetDesc	desc{};
+			u32					renderTarget{ invalidHandle };
+			bool				isInUse{ false };
+		};
+
+		void CullPasses();
+		void ComputeLifetimes();
+		void AssignPhysicalResources();
+		void RecordPassBegin(const PassNode& pass, CommandList& commandList) const;
+
+		Utils::vector<PassNode>				m_passes;
+		Utils::vector<ResourceNode>			m_resources;
+		Utils::vector<PhysicalRenderTarget>	m_physical;		// kept across Reset() so recompiles reuse render targets
+		Utils::vector<u32>					m_executionOrder;
+		u64									m_transientBytes{ 0 };
+		u64									m_unaliasedTransientBytes{ 0 };
+		bool								m_isCompiled{ false };
+	};
+}
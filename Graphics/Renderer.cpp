@@ -1,23 +1,61 @@
 #include "Renderer.h"
 #include "GraphicsPlatformInterface.h"
+#include "FrameStats.h"
+#include <chrono>
+#ifdef _WIN64
 #include "../Graphics/Direct3D12/D3D12Interface.h"
+#endif // _WIN64
+#ifdef __linux__
+#include "../Graphics/OpenGL/OpenGLInterface.h"
+#endif // __linux__
 
 namespace Havana::Graphics
 {
 	namespace
 	{
+		constexpr u32 maxCommandLists{ 64 };
+		constexpr u32 commandListCapacity{ 256 * 1024 };
+		constexpr u32 maxFrameSurfaces{ 16 };
+		constexpr u32 overlayCapacity{ 32 * 1024 };
+		// One frame more than the backends have in flight: when a frame begins, the frame
+		// that used the same memory has finished on the GPU.
+		constexpr u32 frameMemoryCount{ 4 };
+		constexpr u64 frameMemorySize{ 8 * 1024 * 1024 };
+
+		using clock = std::chrono::steady_clock;
+
 		PlatformInterface gfx{};
+		CommandListPool commandLists{};
+		// Sorted by SubmitCommandLists() and replayed by the next RenderFrame()
+		const CommandList* submittedLists[maxCommandLists]{};
+		CommandList overlay{};
+		bool isOverlayVisible{ false };
+		Utils::FrameArena frameMemory{};
+		u32 frameMemoryIndex{ 0 };
+
+		// Render thread time spent on the frame that is being submitted
+		clock::duration frameCpuTime{};
+		clock::time_point lastPresentTime{};
+
+		f32 ToMilliseconds(clock::duration duration)
+		{
+			return std::chrono::duration<f32, std::milli>(duration).count();
+		}
 
 		bool SetGraphicsPlatform(GraphicsPlatform platform)
 		{
 			switch (platform)
 			{
+#ifdef _WIN64
 			case GraphicsPlatform::Direct3D12:
 				D3D12::GetPlatformInterface(gfx);
 				break;
+#endif // _WIN64
+#ifdef __linux__
 			case GraphicsPlatform::OpenGL:
-				D3D12::GetPlatformInterface(gfx);
+				OpenGL::GetPlatformInterface(gfx);
 				break;
+#endif // __linux__
 			default:
 				return false;
 			}
@@ -28,27 +66,148 @@ namespace Havana::Graphics
 
 	bool Initialize(GraphicsPlatform platform)
 	{
-		return SetGraphicsPlatform(platform) && gfx.Initialize();
+		PROFILE_SCOPE("Graphics::Initialize");
+		if (!SetGraphicsPlatform(platform)) return false;
+		commandLists.Initialize(maxCommandLists, commandListCapacity);
+		if (!frameMemory.Initialize(frameMemoryCount, frameMemorySize, Memory::Tag::Graphics)) return false;
+		frameMemoryIndex = 0;
+		FrameStatistics::Reset();
+		lastPresentTime = {};
+		return gfx.Initialize();
 	}
 
 	void Shutdown()
 	{
+		PROFILE_SCOPE("Graphics::Shutdown");
+		gfx.Commands.SetOverlay(nullptr);
+		gfx.Commands.Submit(nullptr, 0);
 		gfx.Shutdown();
+		commandLists.Release();
+		frameMemory.Release();
+		overlay.Release();
+		isOverlayVisible = false;
 	}
 
 	Surface CreateSurface(Platform::Window window)
 	{
+		PROFILE_SCOPE("Graphics::CreateSurface");
 		return gfx.Surface.Create(window);
 	}
 
 	void RemoveSurface(surface_id id)
 	{
+		PROFILE_SCOPE("Graphics::RemoveSurface");
 		assert(Id::IsValid(id));
 		gfx.Surface.Remove(id);
 	}
 
+	void RenderFrame(const Surface* const surfaces, u32 count)
+	{
+		PROFILE_SCOPE("Graphics::RenderFrame");
+		assert(surfaces && count && count <= maxFrameSurfaces);
+		surface_id ids[maxFrameSurfaces];
+		for (u32 i{ 0 }; i < count; i++)
+		{
+			assert(surfaces[i].IsValid());
+			ids[i] = surfaces[i].GetID();
+		}
+
+		const clock::time_point begin{ clock::now() };
+		if (isOverlayVisible)
+		{
+			overlay.Reset();
+			FrameStatistics::RecordOverlay(overlay);
+		}
+
+		gfx.RenderFrame(&ids[0], count);
+		commandLists.Reset();
+
+		frameMemoryIndex = (frameMemoryIndex + 1) % frameMemoryCount;
+		frameMemory.BeginFrame(frameMemoryIndex);
+
+		const clock::time_point end{ clock::now() };
+		FrameTimes times{};
+		times.cpuMs = ToMilliseconds(frameCpuTime + (end - begin));
+		times.gpuMs = gfx.Stats.GpuFrameTime();
+		times.presentIntervalMs = lastPresentTime == clock::time_point{} ? 0.0f : ToMilliseconds(end - lastPresentTime);
+		times.framesInFlight = gfx.Stats.FramesInFlight();
+		FrameStatistics::Record(times);
+
+		frameCpuTime = {};
+		lastPresentTime = end;
+		Memory::EndFrame();
+	}
+
+	u32 CreateRenderTarget(const RenderTargetDesc& desc)
+	{
+		PROFILE_SCOPE("Graphics::CreateRenderTarget");
+		assert(desc.width && desc.height);
+		return gfx.RenderTarget.Create(desc);
+	}
+
+	void RemoveRenderTarget(u32 handle)
+	{
+		PROFILE_SCOPE("Graphics::RemoveRenderTarget");
+		assert(handle != backBufferRenderTarget);
+		gfx.RenderTarget.Remove(handle);
+	}
+
+	CommandList* AcquireCommandList(u32 sortKey)
+	{
+		return commandLists.Acquire(sortKey);
+	}
+
+	// NOTE: must be called from the thread that owns the graphics context, after all
+	//       recording threads for this frame have finished. The lists are replayed and
+	//       released by the next RenderFrame().
+	void SubmitCommandLists()
+	{
+		PROFILE_SCOPE("Graphics::SubmitCommandLists");
+		const clock::time_point begin{ clock::now() };
+		const u32 sortedCount{ commandLists.Sort(&submittedLists[0], maxCommandLists) };
+
+		u32 count{ 0 };
+		for (u32 i{ 0 }; i < sortedCount; i++)
+		{
+			if (!submittedLists[i]->IsEmpty())
+				submittedLists[count++] = submittedLists[i];
+		}
+
+		gfx.Commands.Submit(&submittedLists[0], count);
+		frameCpuTime += clock::now() - begin;
+	}
+
+	Utils::FrameArena& FrameMemory()
+	{
+		return frameMemory;
+	}
+
+	FrameStats GetFrameStats()
+	{
+		return FrameStatistics::Compute();
+	}
+
+	void ResetFrameStats()
+	{
+		FrameStatistics::Reset();
+	}
+
+	u32 WriteFrameStatsJson(char* const buffer, u32 size)
+	{
+		return FrameStatistics::WriteJson(FrameStatistics::Compute(), buffer, size);
+	}
+
+	void ShowFrameStatsOverlay(bool show)
+	{
+		if (show == isOverlayVisible) return;
+		if (show && !overlay.Capacity()) overlay.Initialize(overlayCapacity);
+		isOverlayVisible = show;
+		gfx.Commands.SetOverlay(show ? &overlay : nullptr);
+	}
+
 	void Surface::Resize(u32 width, u32 height) const
 	{
+		PROFILE_SCOPE("Surface::Resize");
 		assert(IsValid());
 		return gfx.Surface.Resize(m_id, width, height);
 	}
@@ -65,9 +224,25 @@ namespace Havana::Graphics
 		return gfx.Surface.Height(m_id);
 	}
 
+	// Same as a frame with only this surface, so per-frame work (frame memory, statistics,
+	// the allocation guard) runs for it too.
 	void Surface::Render() const
+	{
+		PROFILE_SCOPE("Surface::Render");
+		assert(IsValid());
+		RenderFrame(this, 1);
+	}
+
+	void Surface::SetPresentMode(PresentMode mode) const
+	{
+		PROFILE_SCOPE("Surface::SetPresentMode");
+		assert(IsValid());
+		gfx.Surface.SetPresentMode(m_id, mode);
+	}
+
+	PresentMode Surface::GetPresentMode() const
 	{
 		assert(IsValid());
-		gfx.Surface.Render(m_id);
+		return gfx.Surface.GetPresentMode(m_id);
 	}
-}
\ No newline at end of file
+}
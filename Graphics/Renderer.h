@@ -1,10 +1,20 @@
 #pragma once
 #include "../Common/CommonHeaders.h"
 #include "../Platforms/Platform.h"
+#include "../Utilities/FrameArena.h"
+#include "CommandList.h"
 
 namespace Havana::Graphics
 {
 	DEFINE_TYPED_ID(surface_id);
+
+	enum class PresentMode : u32
+	{
+		Immediate = 0,	// no sync, may tear. For benchmarks.
+		VSync,			// wait for vertical blank
+		Adaptive,		// vsync, but late frames are presented right away and may tear
+		Mailbox			// never waits and never tears, the newest frame is shown at each vertical blank
+	};
 	
 	class Surface
 	{
@@ -19,6 +29,10 @@ namespace Havana::Graphics
 		u32 Height() const;
 		void Render() const;
 
+		// Backends fall back to the closest mode they support, which GetPresentMode() returns.
+		void SetPresentMode(PresentMode mode) const;
+		PresentMode GetPresentMode() const;
+
 	private:
 		surface_id m_id{ Id::INVALID_ID };
 	};
@@ -29,15 +43,103 @@ namespace Havana::Graphics
 		Surface surface{};
 	};
 
-	enum GraphicsPlatform : u32
+	enum class RenderTargetFormat : u32
+	{
+		RGBA8 = 0,
+		RGBA16F,
+		R11G11B10F,
+		Depth24Stencil8,
+		Depth32F
+	};
+
+	struct RenderTargetDesc
+	{
+		u32					width{ 0 };
+		u32					height{ 0 };
+		RenderTargetFormat	format{ RenderTargetFormat::RGBA8 };
+
+		constexpr bool operator==(const RenderTargetDesc& o) const
+		{
+			return width == o.width && height == o.height && format == o.format;
+		}
+	};
+
+	constexpr bool IsDepthFormat(RenderTargetFormat format)
+	{
+		return format == RenderTargetFormat::Depth24Stencil8 || format == RenderTargetFormat::Depth32F;
+	}
+
+	constexpr u32 BytesPerPixel(RenderTargetFormat format)
+	{
+		return format == RenderTargetFormat::RGBA16F ? 8 : 4;
+	}
+
+	enum class GraphicsPlatform : u32
 	{
 		Direct3D12 = 0,
 		OpenGL = 1
 	};
 	
+	// Timings of one frame. GPU time is 0 when the backend can't measure it.
+	struct FrameTimes
+	{
+		f32 cpuMs{ 0.0f };				// render thread time in SubmitCommandLists() and RenderFrame()
+		f32 gpuMs{ 0.0f };				// reported a few frames late, once the GPU results are available
+		f32 presentIntervalMs{ 0.0f };	// time since the previous frame was presented
+		u32 framesInFlight{ 0 };		// frames submitted to the GPU that haven't finished yet
+	};
+
+	struct FrameTimePercentiles
+	{
+		f32 p50{ 0.0f };
+		f32 p95{ 0.0f };
+		f32 p99{ 0.0f };
+		f32 worst{ 0.0f };
+	};
+
+	// Statistics over the most recent frames (up to frameStatsHistorySize)
+	constexpr u32 frameStatsHistorySize{ 512 };
+	struct FrameStats
+	{
+		u64						frameCount{ 0 };	// frames rendered since the last reset
+		u32						sampleCount{ 0 };	// frames the percentiles are computed from
+		FrameTimePercentiles	cpu{};
+		FrameTimePercentiles	gpu{};
+		FrameTimePercentiles	presentInterval{};
+		u32						maxFramesInFlight{ 0 };
+		FrameTimes				last{};
+	};
+
 	bool Initialize(GraphicsPlatform platform);
 	void Shutdown();
 
 	Surface CreateSurface(Platform::Window window);
 	void RemoveSurface(surface_id id);
+
+	// Render several surfaces as a single frame: one submission for all of them,
+	// then each one is presented. Cheaper than calling Surface::Render() on each.
+	void RenderFrame(const Surface* const surfaces, u32 count);
+
+	// Returns a backend render target handle that can be used in SetRenderTargetsCommand.
+	u32 CreateRenderTarget(const RenderTargetDesc& desc);
+	void RemoveRenderTarget(u32 handle);
+
+	// Multi-threaded command recording. Any thread may acquire a command list and
+	// record into it. The render thread submits them, and the next RenderFrame() replays
+	// all lists in sort key order on every surface of the frame, with backBufferRenderTarget
+	// referring to that surface. Lists for the following frame are acquired after RenderFrame().
+	[[nodiscard]] CommandList* AcquireCommandList(u32 sortKey);
+	void SubmitCommandLists();
+
+	// Transient memory for the frame that is being recorded, e.g. per-frame draw lists.
+	// It's freed in bulk once the GPU can no longer be using the frame, a few frames later.
+	Utils::FrameArena& FrameMemory();
+
+	FrameStats GetFrameStats();
+	void ResetFrameStats();
+	// Writes the frame stats as a single line JSON object. Returns the length of the
+	// full string, which was truncated if it's not less than size.
+	u32 WriteFrameStatsJson(char* const buffer, u32 size);
+	// Graph of the recent frame times drawn in a corner of every rendered surface
+	void ShowFrameStatsOverlay(bool show);
 }
\ No newline at end of file
@@ -1,8 +1,14 @@
 #include "Platform.h"
 #include "PlatformTypes.h"
+#include "../Utilities/ObjectPool.h"
 
 namespace Havana::Platform
 {
+	namespace
+	{
+		constexpr u32 maxWindows{ 64 };
+	} // anonymous namespace
+
 #ifdef _WIN64	// open window for DirectX context
 	namespace
 	{
@@ -18,43 +24,15 @@ namespace Havana::Platform
 			bool	isClosed{ false };
 		};
 
-		Utils::vector<WindowInfo> windows;
-
-		/////////////////////////////////////////////////////////////////
-		// TODO: this part will be handled by a free-list container later
-		Utils::vector<u32> availableSlots;
-
-		u32 AddToWindows(WindowInfo info)
-		{
-			u32 id{ U32_INVALID_ID };
-			if (availableSlots.empty())
-			{
-				id = (u32)windows.size();
-				windows.emplace_back(info);
-			}
-			else
-			{
-				id = availableSlots.back();
-				availableSlots.pop_back();
-				assert(id != U32_INVALID_ID);
-				windows[id] = info;
-			}
-
-			return id;
-		}
-
-		void RemoveFromWindows(u32 id)
-		{
-			assert(id < windows.size());
-			availableSlots.emplace_back(id);
-		}
-		/////////////////////////////////////////////////////////////////
+		// Objects in the pool don't move, so the window procedure can hold on to its window
+		// while other windows are created
+		Utils::ObjectPool<WindowInfo, window_id> windows{ maxWindows, Memory::Tag::Platform };
 
 		WindowInfo& GetFromId(window_id id)
 		{
-			assert(id < windows.size());
-			assert(windows[id].hwnd);
-			return windows[id];
+			WindowInfo& info{ windows.Get(id) };
+			assert(info.hwnd);
+			return info;
 		}
 
 		WindowInfo& GetFromHandle(window_handle handle)
@@ -66,6 +44,7 @@ namespace Havana::Platform
 		// Callback method for message handling
 		LRESULT CALLBACK internal_window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 		{
+			PROFILE_SCOPE("Platform::WindowProc");
 			WindowInfo* info{ nullptr };
 
 			switch (msg)
@@ -259,7 +238,7 @@ namespace Havana::Platform
 		if (info.hwnd)
 		{
 			DEBUG_OP(SetLastError(0));
-			const window_id id{ AddToWindows(info) };
+			const window_id id{ windows.Add(info) };
 			// Include the window ID in the window class data structure
 			SetWindowLongPtr(info.hwnd, GWLP_USERDATA, (LONG_PTR)id);
 
@@ -284,7 +263,7 @@ namespace Havana::Platform
 	{
 		WindowInfo& info{ GetFromId(id) };
 		DestroyWindow(info.hwnd);
-		RemoveFromWindows(id);
+		windows.Remove(id);
 	}
 #elif __APPLE__
 	// OSX stuff here... open window for Metal context
@@ -293,7 +272,7 @@ namespace Havana::Platform
 		// Linux OS specific window info
 		struct WindowInfo
 		{
-			XWindow*	window{ nullptr };
+			XWindow		window{ 0 };
 			Display*	display{ nullptr };
 			//RECT	fullScreenArea{};
 			s32			left;
@@ -314,43 +293,14 @@ namespace Havana::Platform
 			return outText;
 		}
 
-		Utils::vector<WindowInfo> windows;
-
-		/////////////////////////////////////////////////////////////////
-		// TODO: this part will be handled by a free-list container later
-		Utils::vector<u32> availableSlots;
-
-		u32 AddToWindows(WindowInfo info)
-		{
-			u32 id{ U32_INVALID_ID };
-			if (availableSlots.empty())
-			{
-				id = (u32)windows.size();
-				windows.emplace_back(info);
-			}
-			else
-			{
-				id = availableSlots.back();
-				availableSlots.pop_back();
-				assert(id != U32_INVALID_ID);
-				windows[id] = info;
-			}
-
-			return id;
-		}
-
-		void RemoveFromWindows(u32 id)
-		{
-			assert(id < windows.size());
-			availableSlots.emplace_back(id);
-		}
-		/////////////////////////////////////////////////////////////////
+		// Window handles point into the pool, objects in it don't move
+		Utils::ObjectPool<WindowInfo, window_id> windows{ maxWindows, Memory::Tag::Platform };
 
 		WindowInfo& GetFromId(window_id id)
 		{
-			assert(id < windows.size());
-			assert(windows[id].window);
-			return windows[id];
+			WindowInfo& info{ windows.Get(id) };
+			assert(info.window);
+			return info;
 		}
 		
 		// Linux specific window class functions
@@ -372,13 +322,13 @@ namespace Havana::Platform
 
 		window_handle GetWindowHandle(window_id id)
 		{
-			return GetFromId(id).window;
+			return &GetFromId(id).window;
 		}
 
 		void SetWindowCaption(window_id id, const wchar_t* caption)
 		{
 			WindowInfo& info{ GetFromId(id) };
-			XStoreName(info.display, *(info.window), ConvertToChar(caption));
+			XStoreName(info.display, info.window, ConvertToChar(caption));
 		}
 
 		Math::Vec4u32 GetWindowSize(window_id id)
@@ -395,6 +345,11 @@ namespace Havana::Platform
 
 	Window MakeWindow(const WindowInitInfo* const initInfo /*= nullptr*/)
 	{
+		// The graphics backend may use GLX from other threads (e.g. for shader compilation).
+		// This has to be the first Xlib call of the process.
+		static const Status threadsInitialized{ XInitThreads() };
+		(void)threadsInitialized;
+
 		// Create display
 		Display* display { XOpenDisplay(0) };
 		if (display == NULL) {
@@ -426,69 +381,25 @@ namespace Havana::Platform
 		// check for initial info, use defaults if none given
 		const wchar_t* caption{ (initInfo && initInfo->caption) ? initInfo->caption : L"Havana Game" };
 
-		XWindow window { XCreateWindow(display, *parent, info.left, info.top, info.width, info.height, 0,
-										DefaultDepth(display, screen), InputOutput, visual,
-										CWColormap | CWEventMask, &attributes) };
-		info.window = &window;
-
-		// Create_the_modern_OpenGL_context
-		static int visualAttribs[] {
-			GLX_RENDER_TYPE, GLX_RGBA_BIT,
-			GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
-			GLX_DOUBLEBUFFER, true,
-			GLX_RED_SIZE, 1,
-			GLX_GREEN_SIZE, 1,
-			GLX_BLUE_SIZE, 1,
-			None
-		};
-
-		int numFBC { 0 };
-		GLXFBConfig *fbc { glXChooseFBConfig(display,
-											DefaultScreen(display),
-											visualAttribs, &numFBC) };
-		if (!fbc) {
-			return {};
-		}
-
-		glXCreateContextAttribsARBProc glXCreateContextAttribsARB { 0 };
-		glXCreateContextAttribsARB =
-			(glXCreateContextAttribsARBProc)
-			glXGetProcAddress((const GLubyte*)"glXCreateContextAttribsARB");
-
-		if (!glXCreateContextAttribsARB) {
-			return {};
-		}
-
-		// Set desired minimum OpenGL version
-		int contextAttribs[] {
-			GLX_CONTEXT_MAJOR_VERSION_ARB, 4,
-			GLX_CONTEXT_MINOR_VERSION_ARB, 2,
-			None
-		};
-
-		// Create modern OpenGL context
-		GLXContext context { glXCreateContextAttribsARB(display, fbc[0], NULL, true,
-													contextAttribs) };
-		if (!context) {
-			return {};
-		}
+		info.window = XCreateWindow(display, *parent, info.left, info.top, info.width, info.height, 0,
+									DefaultDepth(display, screen), InputOutput, visual,
+									CWColormap | CWEventMask, &attributes);
 
-		// Show window
-		XMapWindow(display, window);
-		XStoreName(display, window, "Modern GLX with X11");
-		glXMakeCurrent(display, window, context);
+		// Show window. The graphics backend creates its own context and draws
+		// into the window through its own display connection.
+		XMapWindow(display, info.window);
+		XStoreName(display, info.window, "Modern GLX with X11");
+		XFlush(display);
 
-		int major { 0 }, minor { 0 };
-		glGetIntegerv(GL_MAJOR_VERSION, &major);
-		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		return Window{ windows.Add(info) };
 	}
 
 	void RemoveWindow(window_id id)
 	{
 		WindowInfo& info{ GetFromId(id) };
-		XDestroyWindow(info.display, *(info.window));
+		XDestroyWindow(info.display, info.window);
     	XCloseDisplay(info.display);
-		RemoveFromWindows(id);
+		windows.Remove(id);
 	}
 	
 #elif
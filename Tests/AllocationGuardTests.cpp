@@ -0,0 +1,194 @@
+// Steady-state frames of the per-frame containers must not touch the heap. Each test warms
+// up for a few frames and then runs guarded frames under the allocation guard, which
+// "make tests" compiles in with -D_ALLOCATION_GUARD.
+#include "Test.h"
+#include "../Common/AllocationGuard.h"
+#include "../Graphics/CommandList.h"
+#include "../Utilities/FrameArena.h"
+#include "../Utilities/IndexPool.h"
+#include "../Utilities/ObjectPool.h"
+#include <cstdio>
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		constexpr u32 warmupFrames{ 4 };
+		constexpr u32 guardedFrames{ 60 };
+		constexpr u32 frameBufferCount{ 3 };
+
+		// Calls frame(frameNumber) for the warm-up frames and then for guardedFrames frames
+		// under the guard. Nothing in frame() may allocate once it's guarded, CHECK()
+		// included, so results are checked after the guard is off.
+		template<typename F>
+		Memory::AllocationGuardStats RunFrames(F&& frame)
+		{
+			Memory::ResetAllocationGuardStats();
+			Memory::SetAllocationGuard(Memory::AllocationGuardMode::Report, warmupFrames);
+			Memory::EndFrame();	// the warm-up starts at a frame boundary
+			for (u32 i{ 0 }; i < warmupFrames + guardedFrames; i++)
+			{
+				frame(i);
+				Memory::EndFrame();
+			}
+			Memory::SetAllocationGuard(Memory::AllocationGuardMode::Off);
+			return Memory::GetAllocationGuardStats();
+		}
+
+		bool IsSkipped()
+		{
+			if (Memory::IsAllocationGuardSupported()) return false;
+			printf("    skipped: built without _ALLOCATION_GUARD\n");
+			return true;
+		}
+
+		bool IsAllocationFree(const Memory::AllocationGuardStats& stats)
+		{
+			return stats.guardedFrames == guardedFrames && stats.allocations == 0;
+		}
+
+		// Lists recorded in reverse sort key order, sorted and replayed every frame
+		void CommandListRecordAndReplay()
+		{
+			if (IsSkipped()) return;
+
+			using namespace Graphics;
+			constexpr u32 listCount{ 8 };
+			constexpr u32 drawsPerList{ 100 };
+			CommandListPool pool{};
+			pool.Initialize(listCount, 16 * 1024);
+
+			bool isReplayed{ true };
+			const Memory::AllocationGuardStats stats{ RunFrames([&](u32 frame) {
+				pool.Reset();
+				for (u32 i{ 0 }; i < listCount; i++)
+				{
+					CommandList* const list{ pool.Acquire(listCount - i) };
+					list->Record(SetViewportCommand{ 0, 0, 1280, 720 });
+					for (u32 draw{ 0 }; draw < drawsPerList; draw++)
+						list->Record(DrawCommand{ 3, 1, draw * 3, frame, PrimitiveTopology::Triangles });
+				}
+
+				const CommandList* lists[listCount]{};
+				const u32 sortedCount{ pool.Sort(&lists[0], listCount) };
+				u32 draws{ 0 }, lastSortKey{ 0 };
+				for (u32 i{ 0 }; i < sortedCount; i++)
+				{
+					isReplayed = isReplayed && lists[i]->SortKey() > lastSortKey;
+					lastSortKey = lists[i]->SortKey();
+					for (const CommandHeader* cmd{ lists[i]->Begin() }; cmd != lists[i]->End(); cmd = cmd->Next())
+						if (cmd->type == Command::Draw) draws += cmd->As<DrawCommand>().baseInstance == frame;
+				}
+				isReplayed = isReplayed && sortedCount == listCount && draws == listCount * drawsPerList;
+			}) };
+
+			CHECK(isReplayed);
+			CHECK(IsAllocationFree(stats));
+			pool.Release();
+		}
+
+		// Allocations from the arena and from a container on it, all of which fit
+		void FrameArenaAllocate()
+		{
+			if (IsSkipped()) return;
+
+			struct Item
+			{
+				u32 frame;
+				f32 weight;
+			};
+
+			Utils::FrameArena arena{};
+			CHECK(arena.Initialize(frameBufferCount, 1024 * 1024));
+
+			bool isValid{ true };
+			const Memory::AllocationGuardStats stats{ RunFrames([&](u32 frame) {
+				arena.BeginFrame(frame % frameBufferCount);
+				u32* const values{ arena.AllocateArray<u32>(1000) };
+				for (u32 i{ 0 }; i < 1000; i++) values[i] = frame + i;
+				const Item* const item{ arena.New<Item>(Item{ frame, 1.0f }) };
+				void* const aligned{ arena.Allocate(4096, 256) };
+
+				Utils::frame_vector<u32> visible{ Utils::FrameAllocator<u32>{ arena } };
+				for (u32 i{ 0 }; i < 500; i++) visible.emplace_back(values[i]);
+
+				isValid = isValid && item->frame == frame && !((uintptr_t)aligned & 255) &&
+						  visible.back() == frame + 499 && !arena.OverflowBytes();
+			}) };
+
+			CHECK(isValid);
+			CHECK(IsAllocationFree(stats));
+			arena.Release();
+		}
+
+		// Indices allocated and freed with a delay of frameBufferCount frames, enough of them
+		// that the thread's magazine goes back and forth to the shared stack
+		void IndexPoolAllocateAndFree()
+		{
+			if (IsSkipped()) return;
+
+			constexpr u32 indicesPerFrame{ 100 };
+			Utils::IndexPool<frameBufferCount> pool{ 1024 };
+			u32 indices[frameBufferCount][indicesPerFrame]{};
+
+			bool isValid{ true };
+			const Memory::AllocationGuardStats stats{ RunFrames([&](u32 frame) {
+				const u32 frameIdx{ frame % frameBufferCount };
+				pool.ProcessDeferredFree(frameIdx);
+				for (u32 i{ 0 }; i < indicesPerFrame; i++)
+				{
+					if (frame >= frameBufferCount) pool.Free(indices[frameIdx][i], frameIdx);
+					indices[frameIdx][i] = pool.Allocate();
+					isValid = isValid && indices[frameIdx][i] != U32_INVALID_ID;
+				}
+			}) };
+
+			CHECK(isValid);
+			CHECK(IsAllocationFree(stats));
+			pool.Release();
+		}
+
+		// Objects added and removed at the same rate, so the slabs are all there after warm-up
+		void ObjectPoolAddAndRemove()
+		{
+			if (IsSkipped()) return;
+
+			struct Object
+			{
+				u32 frame;
+				u32 value;
+			};
+
+			constexpr u32 liveCount{ 500 };
+			constexpr u32 changesPerFrame{ 100 };
+			Utils::ObjectPool<Object> pool{ liveCount };
+			Id::id_type ids[liveCount]{};
+			for (u32 i{ 0 }; i < liveCount; i++) ids[i] = pool.Add(Object{ 0, i });
+
+			bool isValid{ true };
+			const Memory::AllocationGuardStats stats{ RunFrames([&](u32 frame) {
+				for (u32 i{ 0 }; i < changesPerFrame; i++)
+				{
+					const u32 slot{ (frame * changesPerFrame + i) % liveCount };
+					isValid = isValid && pool.Get(ids[slot]).value == slot;
+					pool.Remove(ids[slot]);
+					ids[slot] = pool.Add(Object{ frame, slot });
+				}
+				u32 count{ 0 };
+				pool.ForEach([&count](Id::id_type, Object&) { count++; });
+				isValid = isValid && count == liveCount;
+			}) };
+
+			CHECK(isValid);
+			CHECK(IsAllocationFree(stats));
+		}
+	} // anonymous namespace
+
+	void AddAllocationGuardTests()
+	{
+		Add("allocation_guard/command_list_record_and_replay", CommandListRecordAndReplay);
+		Add("allocation_guard/frame_arena_allocate", FrameArenaAllocate);
+		Add("allocation_guard/index_pool_allocate_and_free", IndexPoolAllocateAndFree);
+		Add("allocation_guard/object_pool_add_and_remove", ObjectPoolAddAndRemove);
+	}
+}
@@ -0,0 +1,283 @@
+// Round trip through the cooker: sources are cooked by cooker.a (built by "make tests"),
+// read back by the runtime pack reader and checked against what went in.
+#include "Test.h"
+#include "../Content/AssetPack.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		namespace Pack = Content::Pack;
+
+		constexpr const char* cookerPath{ "./cooker.a" };
+		constexpr u32 gridSize{ 16 };
+		constexpr u32 textureWidth{ 4 };
+		constexpr u32 textureHeight{ 2 };
+		// P3 texels, left to right and top to bottom
+		constexpr u8 texels[textureWidth * textureHeight * 3]{
+			255, 0, 0,		0, 255, 0,		0, 0, 255,		10, 20, 30,
+			0, 0, 0,		255, 255, 255,	100, 100, 100,	40, 50, 60,
+		};
+
+		bool WriteFile(const std::string& path, const void* data, size_t size)
+		{
+			FILE* const file{ fopen(path.c_str(), "wb") };
+			if (!file) return false;
+			const bool result{ fwrite(data, 1, size, file) == size };
+			return fclose(file) == 0 && result;
+		}
+
+		bool ReadFile(const std::string& path, Utils::vector<u8>& data)
+		{
+			FILE* const file{ fopen(path.c_str(), "rb") };
+			if (!file) return false;
+			fseek(file, 0, SEEK_END);
+			data.resize((size_t)ftell(file));
+			fseek(file, 0, SEEK_SET);
+			const bool result{ fread(data.data(), 1, data.size(), file) == data.size() };
+			fclose(file);
+			return result;
+		}
+
+		struct CookedPack
+		{
+			std::string quad;
+			std::string grid;
+			std::string texture;
+			std::string pack;
+		};
+
+		// Cook a quad with a single level, a grid with a chain of levels and a small texture
+		bool Cook(CookedPack& cooked)
+		{
+			cooked.quad = TempPath("quad.obj");
+			cooked.grid = TempPath("grid.obj");
+			cooked.texture = TempPath("texture.ppm");
+			cooked.pack = TempPath("test.pack");
+			TempPath("test.pack.tmp");
+
+			const char quad[]{
+				"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+				"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+				"vn 0 0 1\n"
+				"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+			};
+
+			std::string grid{};
+			char line[128];
+			for (u32 y{ 0 }; y <= gridSize; y++)
+				for (u32 x{ 0 }; x <= gridSize; x++)
+				{
+					snprintf(line, sizeof(line), "v %u %u %f\n", x, y, 0.01f * (f32)((x * 7 + y * 3) % 5));
+					grid += line;
+				}
+			for (u32 y{ 0 }; y < gridSize; y++)
+				for (u32 x{ 0 }; x < gridSize; x++)
+				{
+					const u32 v{ y * (gridSize + 1) + x + 1 };
+					snprintf(line, sizeof(line), "f %u %u %u %u\n", v, v + 1, v + gridSize + 2, v + gridSize + 1);
+					grid += line;
+				}
+
+			std::string texture{ "P3\n4 2\n255\n" };
+			for (const u8 texel : texels)
+			{
+				snprintf(line, sizeof(line), "%u ", texel);
+				texture += line;
+			}
+
+			if (!WriteFile(cooked.quad, quad, sizeof(quad) - 1) || !WriteFile(cooked.grid, grid.data(), grid.size()) ||
+				!WriteFile(cooked.texture, texture.data(), texture.size())) return false;
+
+			const std::string command{ std::string{ cookerPath } + " " + cooked.pack + " --lods 1 " + cooked.quad +
+									   " --lods 4 " + cooked.grid + " --linear " + cooked.texture + " > /dev/null" };
+			return system(command.c_str()) == 0;
+		}
+
+		void CheckQuad(Content::pack_id pack, const std::string& name)
+		{
+			const Pack::AssetEntry* const entry{ Content::FindAsset(pack, Pack::NameHash(name.c_str())) };
+			CHECK(entry && entry->type == Pack::AssetType::Mesh);
+			if (!entry) return;
+
+			const Content::MeshView mesh{ Content::GetMesh(pack, *entry) };
+			CHECK(mesh.header->vertexCount == 4 && mesh.header->indexCount == 6);
+			CHECK(mesh.header->lodCount == 1);
+			CHECK(mesh.header->lods[0].firstIndex == 0 && mesh.header->lods[0].indexCount == 6);
+
+			// The polygon is a fan, vertices in the order they first appear, uvs flipped in y
+			constexpr u32 indices[]{ 0, 1, 2, 0, 2, 3 };
+			CHECK(!memcmp(mesh.indices, indices, sizeof(indices)));
+			constexpr f32 positions[4][2]{ { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+			for (u32 i{ 0 }; i < 4; i++)
+			{
+				const Pack::MeshVertex& v{ mesh.vertices[i] };
+				CHECK(v.position[0] == positions[i][0] && v.position[1] == positions[i][1] && v.position[2] == 0.0f);
+				CHECK(v.uv[0] == positions[i][0] && v.uv[1] == 1.0f - positions[i][1]);
+				CHECK(v.normal[0] == 0.0f && v.normal[1] == 0.0f && v.normal[2] == 1.0f);
+			}
+			CHECK(mesh.header->boundsMin[0] == 0.0f && mesh.header->boundsMax[0] == 1.0f);
+			CHECK(mesh.header->boundsMin[1] == 0.0f && mesh.header->boundsMax[1] == 1.0f);
+		}
+
+		void CheckGrid(Content::pack_id pack, const std::string& name)
+		{
+			const Pack::AssetEntry* const entry{ Content::FindAsset(pack, Pack::NameHash(name.c_str())) };
+			CHECK(entry && entry->type == Pack::AssetType::Mesh);
+			if (!entry) return;
+
+			const Content::MeshView mesh{ Content::GetMesh(pack, *entry) };
+			const Pack::MeshHeader& header{ *mesh.header };
+			CHECK(header.vertexCount == (gridSize + 1) * (gridSize + 1));
+			CHECK(header.lodCount > 1 && header.lodCount <= 4);
+			CHECK(header.lods[0].indexCount == gridSize * gridSize * 6);
+			for (u32 lod{ 0 }; lod < header.lodCount; lod++)
+			{
+				const Pack::MeshLod& range{ header.lods[lod] };
+				CHECK(range.indexCount && range.indexCount % 3 == 0);
+				CHECK(range.firstIndex + range.indexCount <= header.indexCount);
+				if (lod > 0) CHECK(range.indexCount < header.lods[lod - 1].indexCount);
+				for (u32 i{ 0 }; i < range.indexCount; i++)
+					CHECK(mesh.indices[range.firstIndex + i] < header.vertexCount);
+			}
+		}
+
+		void CheckTexture(Content::pack_id pack, const std::string& name)
+		{
+			const Pack::AssetEntry* const entry{ Content::FindAsset(pack, Pack::NameHash(name.c_str())) };
+			CHECK(entry && entry->type == Pack::AssetType::Texture);
+			if (!entry) return;
+
+			const Content::TextureView texture{ Content::GetTexture(pack, *entry) };
+			const Pack::TextureHeader& header{ *texture.header };
+			CHECK(header.width == textureWidth && header.height == textureHeight);
+			CHECK(header.mipCount == 3 && !header.isSRGB);
+			CHECK(header.mipSizes[0] == textureWidth * textureHeight * 4);
+			CHECK(header.mipSizes[1] == 2 * 4 && header.mipSizes[2] == 4);
+
+			const u8* const mip0{ Content::TextureMip(texture, 0) };
+			for (u32 i{ 0 }; i < textureWidth * textureHeight; i++)
+			{
+				CHECK(!memcmp(&mip0[i * 4], &texels[i * 3], 3));
+				CHECK(mip0[i * 4 + 3] == 0xff);
+			}
+
+			// Linear textures are box filtered as is: the average of each 2x2 block, give or
+			// take rounding
+			const u8* const mip1{ Content::TextureMip(texture, 1) };
+			for (u32 x{ 0 }; x < 2; x++)
+				for (u32 c{ 0 }; c < 3; c++)
+				{
+					const u32 sum{ (u32)texels[(x * 2) * 3 + c] + texels[(x * 2 + 1) * 3 + c] +
+								   texels[(textureWidth + x * 2) * 3 + c] + texels[(textureWidth + x * 2 + 1) * 3 + c] };
+					CHECK(abs((s32)mip1[x * 4 + c] - (s32)(sum / 4)) <= 1);
+				}
+
+			u8 copy[2 * 4]{};
+			CHECK(Content::LoadTextureMip((void*)texture.header, 1, copy, sizeof(copy)));
+			CHECK(!memcmp(copy, mip1, sizeof(copy)));
+			CHECK(!Content::LoadTextureMip((void*)texture.header, 1, copy, sizeof(copy) - 1));
+		}
+
+		void CookAndRead()
+		{
+			CookedPack cooked{};
+			CHECK(Cook(cooked));
+
+			const Content::pack_id pack{ Content::OpenPack(cooked.pack.c_str()) };
+			CHECK(Id::IsValid(pack));
+			if (!Id::IsValid(pack)) return;
+
+			CheckQuad(pack, cooked.quad);
+			CheckGrid(pack, cooked.grid);
+			CheckTexture(pack, cooked.texture);
+			CHECK(!Content::FindAsset(pack, Pack::NameHash("missing.obj")));
+			Content::ClosePack(pack);
+		}
+
+		// Packs that are damaged anywhere in the header, the index or an asset header are
+		// rejected when they are opened
+		void RejectCorruptPacks()
+		{
+			CookedPack cooked{};
+			CHECK(Cook(cooked));
+			Utils::vector<u8> original{};
+			CHECK(ReadFile(cooked.pack, original));
+			if (original.size() < Pack::assetAlignment) return;
+
+			const std::string path{ TempPath("corrupt.pack") };
+			auto opens = [&path](const Utils::vector<u8>& data)
+			{
+				if (!WriteFile(path, data.data(), data.size())) return false;
+				const Content::pack_id pack{ Content::OpenPack(path.c_str()) };
+				if (!Id::IsValid(pack)) return false;
+				Content::ClosePack(pack);
+				return true;
+			};
+
+			CHECK(opens(original));
+
+			auto header = [](Utils::vector<u8>& data) { return (Pack::PackHeader*)data.data(); };
+			auto entry = [](Utils::vector<u8>& data, u32 i) { return (Pack::AssetEntry*)(data.data() + sizeof(Pack::PackHeader)) + i; };
+			const u32 assetCount{ header(original)->assetCount };
+			CHECK(assetCount == 3);
+
+			Utils::vector<u8> data{ original };
+			header(data)->magic++;
+			CHECK(!opens(data));
+
+			data = original;
+			header(data)->version++;
+			CHECK(!opens(data));
+
+			data = original;
+			header(data)->assetCount = 1u << 30;
+			CHECK(!opens(data));
+
+			// Truncated with a matching file size, so only the entry checks can catch it
+			data = original;
+			data.resize(data.size() - Pack::assetAlignment);
+			header(data)->fileSize = data.size();
+			CHECK(!opens(data));
+
+			for (u32 i{ 0 }; i < assetCount; i++)
+			{
+				data = original;
+				entry(data, i)->offset = ~0ull - 16;
+				CHECK(!opens(data));
+
+				data = original;
+				entry(data, i)->size = data.size();
+				CHECK(!opens(data));
+
+				data = original;
+				entry(data, i)->type = (Pack::AssetType)7;
+				CHECK(!opens(data));
+
+				// The first u32 of both asset headers is a count (vertices, texture width) that
+				// sizes the data, the second one (indices, height) too for meshes
+				data = original;
+				const u64 offset{ entry(data, i)->offset };
+				if (entry(data, i)->type == Pack::AssetType::Mesh)
+					((Pack::MeshHeader*)(data.data() + offset))->vertexCount = 1u << 28;
+				else
+					((Pack::TextureHeader*)(data.data() + offset))->mipSizes[0] = 1u << 28;
+				CHECK(!opens(data));
+			}
+
+			// Entries have to be sorted for the binary search
+			data = original;
+			std::swap(*entry(data, 0), *entry(data, 1));
+			CHECK(!opens(data));
+		}
+	} // anonymous namespace
+
+	void AddAssetPackTests()
+	{
+		Add("asset_pack/cook_and_read", CookAndRead);
+		Add("asset_pack/reject_corrupt_packs", RejectCorruptPacks);
+	}
+}
@@ -0,0 +1,297 @@
+// Dynamic BVH queries against a brute force search over the same fat boxes, while objects
+// are added, moved and removed and the tree is rebuilt in the background
+#include "Test.h"
+#include "../Common/DynamicBvh.h"
+#include <algorithm>
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		using namespace Spatial;
+
+		// Coordinates are multiples of 1/4 and the planes have small integer coefficients,
+		// so the box and frustum tests are exact and the brute force can't disagree with
+		// the tree because of rounding.
+		constexpr f32 margin{ 0.25f };
+		constexpr s32 worldSize{ 256 };
+		constexpr u32 workerCount{ 4 };
+
+		struct Random
+		{
+			u32 state{ 1 };
+			u32 Next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+			// A multiple of 1/4 in [-range, range)
+			f32 Coordinate(s32 range) { return (f32)((s32)(Next() % (u32)(range * 8)) - range * 4) * 0.25f; }
+		};
+
+		Aabb RandomBox(Random& random, u32 maxSize = 8)
+		{
+			Aabb box;
+			for (u32 i{ 0 }; i < 3; i++)
+			{
+				box.min[i] = random.Coordinate(worldSize);
+				box.max[i] = box.min[i] + (f32)(random.Next() % (maxSize * 4)) * 0.25f;
+			}
+			return box;
+		}
+
+		struct Object
+		{
+			proxy_id	id{ Id::INVALID_ID };
+			bool		isAlive{ false };
+		};
+
+		class Reference
+		{
+		public:
+			explicit Reference(DynamicBvh& bvh) : m_bvh{ bvh } {}
+
+			void Add(const Aabb& box)
+			{
+				const u32 userData{ (u32)m_objects.size() };
+				m_objects.emplace_back(Object{ m_bvh.Add(box, userData), true });
+			}
+
+			void Remove(u32 index)
+			{
+				m_bvh.Remove(m_objects[index].id);
+				m_objects[index].isAlive = false;
+			}
+
+			u32 AliveCount() const
+			{
+				u32 count{ 0 };
+				for (const Object& object : m_objects) count += object.isAlive;
+				return count;
+			}
+
+			// Index of a random live object, or U32_INVALID_ID if there are none
+			u32 RandomAlive(Random& random) const
+			{
+				if (!AliveCount()) return U32_INVALID_ID;
+				for (;;)
+				{
+					const u32 index{ random.Next() % (u32)m_objects.size() };
+					if (m_objects[index].isAlive) return index;
+				}
+			}
+
+			proxy_id Id(u32 index) const { return m_objects[index].id; }
+
+			template<typename F>
+			Utils::vector<u32> Select(F&& isSelected) const
+			{
+				Utils::vector<u32> result{};
+				for (u32 i{ 0 }; i < (u32)m_objects.size(); i++)
+					if (m_objects[i].isAlive && isSelected(m_bvh.GetFatBounds(m_objects[i].id))) result.emplace_back(i);
+				return result;
+			}
+
+		private:
+			DynamicBvh&				m_bvh;
+			Utils::vector<Object>	m_objects;
+		};
+
+		bool Overlaps(const Aabb& a, const Aabb& b)
+		{
+			for (u32 i{ 0 }; i < 3; i++)
+				if (a.min[i] > b.max[i] || a.max[i] < b.min[i]) return false;
+			return true;
+		}
+
+		// Not outside any plane, tested with the box corner farthest along each normal
+		bool IsVisible(const f32* const planes, const Aabb& box)
+		{
+			for (u32 p{ 0 }; p < 6; p++)
+			{
+				const f32* const plane{ &planes[p * 4] };
+				f32 distance{ plane[3] };
+				for (u32 i{ 0 }; i < 3; i++) distance += plane[i] * (plane[i] >= 0.0f ? box.max[i] : box.min[i]);
+				if (distance < 0.0f) return false;
+			}
+			return true;
+		}
+
+		// The same slab test and operations as the tree, so rounding is the same too
+		bool IsHit(const f32* const origin, const f32* const inverse, f32 maxDistance, const Aabb& box)
+		{
+			f32 enter{ 0.0f }, exit{ maxDistance };
+			for (u32 i{ 0 }; i < 3; i++)
+			{
+				const f32 t0{ (box.min[i] - origin[i]) * inverse[i] };
+				const f32 t1{ (box.max[i] - origin[i]) * inverse[i] };
+				enter = std::max(enter, std::min(t0, t1));
+				exit = std::min(exit, std::max(t0, t1));
+			}
+			return enter <= exit;
+		}
+
+		Utils::vector<u32> Sorted(Utils::vector<u32> values)
+		{
+			std::sort(values.begin(), values.end());
+			return values;
+		}
+
+		// Every query the tree has, each compared with the brute force result
+		bool QueriesMatch(const DynamicBvh& bvh, const Reference& reference, Random& random)
+		{
+			bool isMatch{ true };
+			for (u32 i{ 0 }; i < 16; i++)
+			{
+				const Aabb box{ RandomBox(random, 64) };
+				Utils::vector<u32> found{};
+				bvh.QueryBox(box, [&found](u32 userData) { found.emplace_back(userData); });
+				isMatch = isMatch && Sorted(found) == reference.Select([&box](const Aabb& fat) { return Overlaps(box, fat); });
+			}
+
+			Utils::vector<u32> found{};
+			for (u32 i{ 0 }; i < 4; i++)
+			{
+				// Looking down z from a random spot, with a 90 degree field of view in x
+				const f32 eye[3]{ random.Coordinate(worldSize / 2), random.Coordinate(worldSize / 2), random.Coordinate(worldSize) };
+				const f32 planes[6 * 4]{
+					0, 0, 1, -(eye[2] + 1),
+					0, 0, -1, eye[2] + 100,
+					1, 0, 1, -eye[0] - eye[2],
+					-1, 0, 1, eye[0] - eye[2],
+					0, 2, 1, -2 * eye[1] - eye[2],
+					0, -2, 1, 2 * eye[1] - eye[2],
+				};
+				found.clear();
+				bvh.QueryFrustum(&planes[0], [&found](u32 userData) { found.emplace_back(userData); });
+				isMatch = isMatch && Sorted(found) == reference.Select([&planes](const Aabb& fat) { return IsVisible(&planes[0], fat); });
+			}
+
+			// Rays along an axis go through the tree's guard against dividing by zero
+			constexpr f32 directions[][3]{ { 1.0f, 0.5f, 0.25f }, { -0.5f, 1.0f, -2.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, -1.0f, 0.0f } };
+			for (const auto& direction : directions)
+			{
+				const f32 origin[3]{ random.Coordinate(worldSize), random.Coordinate(worldSize), random.Coordinate(worldSize) };
+				constexpr f32 maxDistance{ 300.0f };
+				f32 inverse[3];
+				for (u32 i{ 0 }; i < 3; i++)
+				{
+					const f32 d{ direction[i] };
+					inverse[i] = 1.0f / (d > 1e-20f || d < -1e-20f ? d : 1e-20f);
+				}
+
+				found.clear();
+				bvh.QueryRay(&origin[0], &direction[0], maxDistance, [&found](u32 userData, f32 distance) {
+					found.emplace_back(userData);
+					return distance; });
+				isMatch = isMatch && Sorted(found) == reference.Select([&](const Aabb& fat) { return IsHit(&origin[0], &inverse[0], maxDistance, fat); });
+			}
+			return isMatch;
+		}
+
+		void StartWorkers()
+		{
+			Jobs::JobSystemInitInfo info{};
+			info.workerCount = workerCount;
+			Jobs::Initialize(&info);
+		}
+
+		// Frames of random changes. Rebuilds start often and run while the tree keeps
+		// changing and serving queries.
+		void QueriesMatchBruteForce()
+		{
+			StartWorkers();
+			{
+				DynamicBvh bvh{};
+				bvh.Initialize(margin);
+				bvh.SetRebuildFraction(0.05f);
+				Reference reference{ bvh };
+				Random random{};
+
+				for (u32 i{ 0 }; i < 500; i++) reference.Add(RandomBox(random));
+
+				bool isMatch{ true };
+				bool wasRebuilding{ false };
+				for (u32 frame{ 0 }; frame < 300; frame++)
+				{
+					for (u32 change{ 0 }; change < 40; change++)
+					{
+						const u32 action{ random.Next() % 10 };
+						const u32 index{ reference.RandomAlive(random) };
+						if (action < 2 || index == U32_INVALID_ID)
+						{
+							reference.Add(RandomBox(random));
+						}
+						else if (action < 4)
+						{
+							reference.Remove(index);
+						}
+						else
+						{
+							// Mostly small moves that stay near the old box, sometimes a jump
+							Aabb box{ bvh.GetFatBounds(reference.Id(index)) };
+							const f32 step{ action < 9 ? random.Coordinate(2) : random.Coordinate(worldSize) };
+							const u32 axis{ random.Next() % 3 };
+							box.min[axis] += step;
+							box.max[axis] += step;
+							const f32 displacement[3]{ 0.0f, step, 0.0f };
+							bvh.Move(reference.Id(index), box, action == 8 ? &displacement[0] : nullptr);
+						}
+					}
+					isMatch = isMatch && QueriesMatch(bvh, reference, random);
+
+					bvh.Update();
+					wasRebuilding = wasRebuilding || bvh.GetStats().isRebuilding;
+					isMatch = isMatch && QueriesMatch(bvh, reference, random);
+					CHECK(bvh.GetStats().proxyCount == reference.AliveCount());
+				}
+				CHECK(isMatch);
+				CHECK(wasRebuilding);
+
+				bvh.Rebuild();
+				CHECK(QueriesMatch(bvh, reference, random));
+				CHECK(bvh.GetStats().rebuildCount > 1);
+				CHECK(bvh.GetStats().height <= DynamicBvh::maxHeight);
+			}
+			Jobs::Shutdown();
+		}
+
+		// A rebuild of a tree with one object, in the foreground and in the background
+		void RebuildSingleObject()
+		{
+			StartWorkers();
+			{
+				DynamicBvh bvh{};
+				bvh.Initialize(margin);
+				Reference reference{ bvh };
+				Random random{};
+
+				reference.Add(RandomBox(random));
+				bvh.Rebuild();
+				CHECK(bvh.GetStats().proxyCount == 1 && bvh.GetStats().nodeCount == 1);
+				CHECK(QueriesMatch(bvh, reference, random));
+
+				reference.Remove(0);
+				bvh.Rebuild();
+				CHECK(bvh.GetStats().nodeCount == 0);
+
+				for (u32 i{ 0 }; i < 100; i++) reference.Add(RandomBox(random));
+				for (u32 i{ 1 }; i < 100; i++) reference.Remove(i);
+				bvh.Update();
+				while (bvh.GetStats().isRebuilding) bvh.Update();
+				CHECK(bvh.GetStats().proxyCount == 1 && bvh.GetStats().nodeCount == 1);
+				CHECK(QueriesMatch(bvh, reference, random));
+
+				// The one object can still be moved and removed after the rebuild
+				Aabb box{ RandomBox(random) };
+				bvh.Move(reference.Id(100), box);
+				CHECK(QueriesMatch(bvh, reference, random));
+				reference.Remove(100);
+				CHECK(bvh.GetStats().nodeCount == 0);
+			}
+			Jobs::Shutdown();
+		}
+	} // anonymous namespace
+
+	void AddDynamicBvhTests()
+	{
+		Add("dynamic_bvh/queries_match_brute_force", QueriesMatchBruteForce);
+		Add("dynamic_bvh/rebuild_single_object", RebuildSingleObject);
+	}
+}
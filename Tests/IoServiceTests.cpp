@@ -0,0 +1,379 @@
+// Asynchronous reads through io_uring and through the preadv fallback threads.
+//
+// The I/O thread picks requests up as soon as they arrive, so the tests that depend on
+// what is queued at the same time (coalescing, priorities, cancellation) run with a
+// single batch in flight and first fill it with a read from a FIFO. That read blocks
+// until the test writes to the FIFO, and meanwhile everything else stays queued. Reads
+// of a FIFO return its bytes in order, which also tells the order the reads ran in.
+#include "Test.h"
+#include "../Content/IoService.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		using namespace Content::Io;
+
+		constexpr u32 fileSize{ 1024 * 1024 + 123 };
+		constexpr u32 chunkSize{ 4096 };
+		constexpr u32 fifoReadSize{ 4 };
+
+		constexpr u8 Pattern(u64 offset)
+		{
+			return (u8)(offset * 131 + (offset >> 9) * 7);
+		}
+
+		bool IsPattern(const u8* data, u64 offset, u32 size)
+		{
+			for (u32 i{ 0 }; i < size; i++)
+				if (data[i] != Pattern(offset + i)) return false;
+			return true;
+		}
+
+		struct ReadResult
+		{
+			u32			size{ U32_INVALID_ID };
+			IoStatus	status{ IoStatus::Failed };
+			u32			completions{ 0 };
+		};
+
+		void OnRead(void* userData, u8*, u32 size, IoStatus status)
+		{
+			ReadResult& result{ *(ReadResult*)userData };
+			result.size = size;
+			result.status = status;
+			result.completions++;
+		}
+
+		// Job system and I/O service for the duration of a test
+		class IoScope
+		{
+		public:
+			explicit IoScope(bool disableUring, u32 queueDepth = 64)
+			{
+				Jobs::JobSystemInitInfo jobsInfo{};
+				jobsInfo.workerCount = 2;
+				Jobs::Initialize(&jobsInfo);
+
+				IoServiceInitInfo info{};
+				info.queueDepth = queueDepth;
+				info.fallbackThreadCount = 2;
+				info.disableUring = disableUring;
+				m_isInitialized = Initialize(&info);
+				CHECK(m_isInitialized);
+			}
+
+			~IoScope()
+			{
+				if (m_isInitialized) Shutdown();
+				Jobs::Shutdown();
+			}
+
+			DISABLE_COPY_AND_MOVE(IoScope);
+			constexpr bool IsInitialized() const { return m_isInitialized; }
+
+		private:
+			bool m_isInitialized{ false };
+		};
+
+		// The file every test reads from, written once
+		const std::string& PatternFile()
+		{
+			static const std::string path{ TempPath("io_pattern.bin") };
+			static bool isWritten{ false };
+			if (!isWritten)
+			{
+				Utils::vector<u8> data(fileSize);
+				for (u32 i{ 0 }; i < fileSize; i++) data[i] = Pattern(i);
+				FILE* const file{ fopen(path.c_str(), "wb") };
+				isWritten = file && fwrite(data.data(), 1, data.size(), file) == data.size();
+				if (file) fclose(file);
+				CHECK(isWritten);
+			}
+			return path;
+		}
+
+		// A FIFO that has a writer, so opening it for reading doesn't block
+		class Fifo
+		{
+		public:
+			Fifo()
+			{
+				const std::string path{ TempPath("io_fifo") };
+				unlink(path.c_str());
+				if (mkfifo(path.c_str(), 0600)) return;
+				m_writer = open(path.c_str(), O_RDWR | O_CLOEXEC);
+				if (m_writer >= 0) m_file = OpenFile(path.c_str());
+			}
+
+			~Fifo()
+			{
+				if (Id::IsValid(m_file)) CloseFile(m_file);
+				if (m_writer >= 0) close(m_writer);
+			}
+
+			DISABLE_COPY_AND_MOVE(Fifo);
+
+			bool IsValid() const { return Id::IsValid(m_file); }
+			file_id File() const { return m_file; }
+			bool Write(const char* data) const
+			{
+				const size_t size{ strlen(data) };
+				return write(m_writer, data, size) == (ssize_t)size;
+			}
+
+		private:
+			int		m_writer{ -1 };
+			file_id	m_file{ Id::INVALID_ID };
+		};
+
+		request_id ReadFifo(const Fifo& fifo, u8* destination, ReadResult& result, Jobs::JobCounter& counter,
+							IoPriority priority = IoPriority::Normal)
+		{
+			ReadRequest request{};
+			request.file = fifo.File();
+			request.size = fifoReadSize;
+			request.destination = destination;
+			request.priority = priority;
+			request.completion = OnRead;
+			request.userData = &result;
+			request.counter = &counter;
+			return Read(request);
+		}
+
+		// The I/O thread has taken the blocking read off the queue once it counts as a read
+		void WaitUntilReading(u64 reads)
+		{
+			while (Stats().reads < reads) std::this_thread::yield();
+		}
+
+		// Many reads of random ranges, including ranges that end past the end of the file
+		void CheckBatchedReads(bool disableUring)
+		{
+			IoScope scope{ disableUring };
+			if (!scope.IsInitialized()) return;
+			CHECK(Stats().isUring == !disableUring);
+
+			const file_id file{ OpenFile(PatternFile().c_str()) };
+			CHECK(Id::IsValid(file));
+			if (!Id::IsValid(file)) return;
+			CHECK(FileSize(file) == fileSize);
+
+			constexpr u32 readCount{ 512 };
+			Utils::vector<u8> buffer((size_t)readCount * chunkSize);
+			Utils::vector<ReadResult> results(readCount);
+			u64 offsets[readCount]{};
+			u32 sizes[readCount]{};
+			u32 random{ 12345 };
+			Jobs::JobCounter counter{};
+			for (u32 i{ 0 }; i < readCount; i++)
+			{
+				random = random * 1664525 + 1013904223;
+				offsets[i] = (random >> 8) % (fileSize + chunkSize);
+				sizes[i] = 1 + (random % chunkSize);
+
+				ReadRequest request{};
+				request.file = file;
+				request.offset = offsets[i];
+				request.size = sizes[i];
+				request.destination = &buffer[(size_t)i * chunkSize];
+				request.priority = (IoPriority)(i % (u32)IoPriority::count);
+				request.completion = OnRead;
+				request.userData = &results[i];
+				request.counter = &counter;
+				CHECK(Id::IsValid(Read(request)));
+			}
+			Jobs::Wait(counter);
+
+			for (u32 i{ 0 }; i < readCount; i++)
+			{
+				const u32 expected{ offsets[i] >= fileSize ? 0 : (u32)std::min<u64>(sizes[i], fileSize - offsets[i]) };
+				CHECK(results[i].completions == 1);
+				CHECK(results[i].status == IoStatus::Completed);
+				CHECK(results[i].size == expected);
+				CHECK(IsPattern(&buffer[(size_t)i * chunkSize], offsets[i], results[i].size));
+			}
+
+			const IoStats stats{ Stats() };
+			CHECK(stats.requests == readCount);
+			CHECK(stats.reads + stats.coalescedRequests == readCount);
+			CloseFile(file);
+		}
+
+		void BatchedReadsUring()
+		{
+			CheckBatchedReads(false);
+		}
+
+		void BatchedReadsFallback()
+		{
+			CheckBatchedReads(true);
+		}
+
+		// Adjacent chunks queued in any order are read with a single readv
+		void CoalesceAdjacentRequests()
+		{
+			IoScope scope{ false, 1 };
+			if (!scope.IsInitialized()) return;
+			if (!Stats().isUring)
+			{
+				printf("    skipped: io_uring isn't available\n");
+				return;
+			}
+
+			Fifo fifo{};
+			const file_id file{ OpenFile(PatternFile().c_str()) };
+			CHECK(fifo.IsValid() && Id::IsValid(file));
+			if (!fifo.IsValid() || !Id::IsValid(file)) return;
+
+			Jobs::JobCounter counter{};
+			u8 blockerData[fifoReadSize]{};
+			ReadResult blocker{};
+			CHECK(Id::IsValid(ReadFifo(fifo, blockerData, blocker, counter)));
+			WaitUntilReading(1);
+
+			constexpr u32 chunkCount{ 8 };
+			constexpr u32 order[chunkCount]{ 3, 0, 7, 1, 2, 6, 4, 5 };
+			constexpr u64 baseOffset{ 10 * chunkSize };
+			Utils::vector<u8> buffer(chunkCount * chunkSize);
+			ReadResult results[chunkCount]{};
+			for (const u32 chunk : order)
+			{
+				ReadRequest request{};
+				request.file = file;
+				request.offset = baseOffset + chunk * chunkSize;
+				request.size = chunkSize;
+				request.destination = &buffer[chunk * chunkSize];
+				request.completion = OnRead;
+				request.userData = &results[chunk];
+				request.counter = &counter;
+				CHECK(Id::IsValid(Read(request)));
+			}
+
+			CHECK(fifo.Write("wake"));
+			Jobs::Wait(counter);
+
+			CHECK(blocker.status == IoStatus::Completed && !memcmp(blockerData, "wake", fifoReadSize));
+			for (u32 i{ 0 }; i < chunkCount; i++)
+				CHECK(results[i].status == IoStatus::Completed && results[i].size == chunkSize);
+			CHECK(IsPattern(buffer.data(), baseOffset, chunkCount * chunkSize));
+
+			const IoStats stats{ Stats() };
+			CHECK(stats.reads == 2);
+			CHECK(stats.coalescedRequests == chunkCount - 1);
+			CloseFile(file);
+		}
+
+		// Once the batch is free, queued requests start by priority, then in the order they came in
+		void ReadByPriority()
+		{
+			IoScope scope{ false, 1 };
+			if (!scope.IsInitialized()) return;
+			if (!Stats().isUring)
+			{
+				printf("    skipped: io_uring isn't available\n");
+				return;
+			}
+
+			Fifo fifo{};
+			CHECK(fifo.IsValid());
+			if (!fifo.IsValid()) return;
+
+			Jobs::JobCounter counter{};
+			u8 data[6][fifoReadSize]{};
+			ReadResult results[6]{};
+			constexpr IoPriority priorities[6]{ IoPriority::Normal, IoPriority::Low, IoPriority::Normal,
+												IoPriority::High, IoPriority::Low, IoPriority::High };
+			// The first one takes the batch, the rest are queued behind it
+			for (u32 i{ 0 }; i < 6; i++)
+			{
+				CHECK(Id::IsValid(ReadFifo(fifo, data[i], results[i], counter, priorities[i])));
+				if (i == 0) WaitUntilReading(1);
+			}
+
+			CHECK(fifo.Write("r0__r1__r2__r3__r4__r5__"));
+			Jobs::Wait(counter);
+
+			constexpr const char* expected[6]{ "r0__", "r4__", "r3__", "r1__", "r5__", "r2__" };
+			for (u32 i{ 0 }; i < 6; i++)
+			{
+				CHECK(results[i].status == IoStatus::Completed && results[i].size == fifoReadSize);
+				CHECK(!memcmp(data[i], expected[i], fifoReadSize));
+			}
+		}
+
+		// Queued requests are dropped right away, a read the kernel is blocked on is cancelled
+		// there, and both complete exactly once with IoStatus::Cancelled
+		void CancelRequests()
+		{
+			IoScope scope{ false, 1 };
+			if (!scope.IsInitialized()) return;
+			if (!Stats().isUring)
+			{
+				printf("    skipped: io_uring isn't available\n");
+				return;
+			}
+
+			Fifo fifo{};
+			const file_id file{ OpenFile(PatternFile().c_str()) };
+			CHECK(fifo.IsValid() && Id::IsValid(file));
+			if (!fifo.IsValid() || !Id::IsValid(file)) return;
+
+			Jobs::JobCounter counter{};
+			u8 blockerData[fifoReadSize]{};
+			ReadResult blocker{};
+			const request_id blockerId{ ReadFifo(fifo, blockerData, blocker, counter) };
+			WaitUntilReading(1);
+
+			u8 buffer[2][chunkSize]{};
+			ReadResult results[2]{};
+			request_id ids[2]{};
+			for (u32 i{ 0 }; i < 2; i++)
+			{
+				ReadRequest request{};
+				request.file = file;
+				request.offset = i * 3 * chunkSize;
+				request.size = chunkSize;
+				request.destination = buffer[i];
+				request.completion = OnRead;
+				request.userData = &results[i];
+				request.counter = &counter;
+				ids[i] = Read(request);
+			}
+
+			Cancel(ids[0]);
+			Cancel(ids[0]);
+			// The blocked FIFO read only finishes if the kernel cancels it
+			Cancel(blockerId);
+			Cancel(blockerId);
+			Jobs::Wait(counter);
+
+			CHECK(blocker.completions == 1 && blocker.status == IoStatus::Cancelled);
+			CHECK(results[0].completions == 1 && results[0].status == IoStatus::Cancelled && results[0].size == 0);
+			CHECK(results[1].completions == 1 && results[1].status == IoStatus::Completed && results[1].size == chunkSize);
+			CHECK(IsPattern(buffer[1], 3 * chunkSize, chunkSize));
+			CHECK(Stats().cancelledRequests == 2);
+
+			// Ids of finished requests are stale and ignored
+			Cancel(ids[1]);
+			CHECK(results[1].completions == 1 && results[1].status == IoStatus::Completed);
+			CHECK(Stats().cancelledRequests == 2);
+			CloseFile(file);
+		}
+	} // anonymous namespace
+
+	void AddIoServiceTests()
+	{
+		Add("io/batched_reads_uring", BatchedReadsUring);
+		Add("io/batched_reads_fallback", BatchedReadsFallback);
+		Add("io/coalesce_adjacent_requests", CoalesceAdjacentRequests);
+		Add("io/read_by_priority", ReadByPriority);
+		Add("io/cancel_requests", CancelRequests);
+	}
+}
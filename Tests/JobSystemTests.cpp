@@ -0,0 +1,67 @@
+// Regression checks for the job system
+#include "Test.h"
+#include "../Common/JobSystem.h"
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		constexpr u32 iterations{ 100000 };
+		constexpr u32 workerCount{ 4 };
+
+		void Nothing(void*) {}
+
+		void Increment(void* data)
+		{
+			((std::atomic<u32>*)data)->fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void StartWorkers()
+		{
+			Jobs::JobSystemInitInfo info{};
+			info.workerCount = workerCount;
+			Jobs::Initialize(&info);
+		}
+
+		// The owner may destroy a counter as soon as Wait() returns, the job that finished
+		// it must not touch it after publishing zero.
+		void DestroyCounterAfterWait()
+		{
+			StartWorkers();
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				Jobs::JobCounter* const counter{ new Jobs::JobCounter{} };
+				Jobs::Run(Nothing, nullptr, counter);
+				Jobs::Wait(*counter);
+				delete counter;
+			}
+			Jobs::Shutdown();
+		}
+
+		// Same with continuations pending, which are taken out of the counter before it hits zero
+		void DestroyCounterWithContinuations()
+		{
+			StartWorkers();
+			std::atomic<u32> continuations{ 0 };
+			for (u32 i{ 0 }; i < iterations; i++)
+			{
+				Jobs::JobCounter* const counter{ new Jobs::JobCounter{} };
+				Jobs::JobCounter done{};
+				Jobs::Run(Nothing, nullptr, counter);
+				Jobs::RunAfter(*counter, Increment, &continuations, &done);
+				while (!counter->IsDone()) {}
+				delete counter;
+				Jobs::Wait(done);
+			}
+			Jobs::Shutdown();
+			CHECK(continuations == iterations);
+		}
+	} // anonymous namespace
+
+	void AddJobSystemTests()
+	{
+		Add("jobs/destroy_counter_after_wait", DestroyCounterAfterWait);
+		Add("jobs/destroy_counter_with_continuations", DestroyCounterWithContinuations);
+	}
+}
+
@@ -0,0 +1,109 @@
+// Level of detail selection and its hysteresis around the switching distances
+#include "Test.h"
+#include "../Graphics/MeshLod.h"
+#include <cmath>
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		using namespace Graphics::Lod;
+
+		// With 100 pixels per unit at distance 1, a pixel error of 1 and 25% hysteresis,
+		// level 1 (error 1) is taken from 133.3 on and left below 80, and level 2 (error 4)
+		// is taken from 533.3 on and left below 320.
+		constexpr LodLevel levels[3]{ { 0, 300, 0.0f }, { 300, 90, 1.0f }, { 390, 30, 4.0f } };
+
+		LodView MakeView()
+		{
+			LodView view{};
+			view.projectionScale = 100.0f;
+			view.pixelError = 1.0f;
+			view.hysteresis = 0.25f;
+			return view;
+		}
+
+		u32 Select(f32 distance, u32 currentLod, u32 levelCount = 3)
+		{
+			const f32 center[3]{ 0.0f, 0.0f, distance };
+			return SelectLod(&levels[0], levelCount, MakeView(), &center[0], 0.0f, 1.0f, currentLod);
+		}
+
+		void SelectByDistance()
+		{
+			CHECK(Select(10.0f, 0) == 0);
+			CHECK(Select(200.0f, 0) == 1);
+			CHECK(Select(1000.0f, 0) == 2);
+			CHECK(Select(10.0f, 2) == 0);
+			CHECK(Select(1000.0f, 1, 1) == 0);
+			CHECK(Select(1000.0f, 7) == 2);
+
+			// The error is measured from the nearest point of the bounds
+			const f32 center[3]{ 0.0f, 0.0f, 200.0f };
+			CHECK(SelectLod(&levels[0], 3, MakeView(), &center[0], 100.0f, 1.0f) == 0);
+			// and grows with the instance
+			CHECK(SelectLod(&levels[0], 3, MakeView(), &center[0], 0.0f, 2.0f) == 0);
+
+			CHECK(ProjectionScale(2.0f * std::atan(0.5f), 100.0f) > 99.9f && ProjectionScale(2.0f * std::atan(0.5f), 100.0f) < 100.1f);
+		}
+
+		// Between the two thresholds of a level, whatever was picked last frame stays
+		void KeepLevelBetweenThresholds()
+		{
+			for (const f32 distance : { 81.0f, 100.0f, 120.0f, 133.0f })
+			{
+				CHECK(Select(distance, 0) == 0);
+				CHECK(Select(distance, 1) == 1);
+			}
+			for (const f32 distance : { 321.0f, 400.0f, 533.0f })
+			{
+				CHECK(Select(distance, 1) == 1);
+				CHECK(Select(distance, 2) == 2);
+			}
+
+			CHECK(Select(134.0f, 0) == 1);
+			CHECK(Select(79.0f, 1) == 0);
+			CHECK(Select(534.0f, 1) == 2);
+			CHECK(Select(319.0f, 2) == 1);
+		}
+
+		// Moving out and back in again switches at different distances, once each way
+		void SwitchOncePerThreshold()
+		{
+			u32 lod{ 0 };
+			u32 switches{ 0 };
+			f32 coarserAt[2]{}, finerAt[2]{};
+			for (f32 distance{ 50.0f }; distance <= 700.0f; distance += 1.0f)
+			{
+				const u32 next{ Select(distance, lod) };
+				if (next != lod)
+				{
+					coarserAt[lod] = distance;
+					switches++;
+				}
+				lod = next;
+			}
+			for (f32 distance{ 700.0f }; distance >= 50.0f; distance -= 1.0f)
+			{
+				const u32 next{ Select(distance, lod) };
+				if (next != lod)
+				{
+					finerAt[next] = distance;
+					switches++;
+				}
+				lod = next;
+			}
+
+			CHECK(switches == 4 && lod == 0);
+			CHECK(coarserAt[0] == 134.0f && coarserAt[1] == 534.0f);
+			CHECK(finerAt[1] == 319.0f && finerAt[0] == 79.0f);
+		}
+	} // anonymous namespace
+
+	void AddMeshLodTests()
+	{
+		Add("mesh_lod/select_by_distance", SelectByDistance);
+		Add("mesh_lod/keep_level_between_thresholds", KeepLevelBetweenThresholds);
+		Add("mesh_lod/switch_once_per_threshold", SwitchOncePerThreshold);
+	}
+}
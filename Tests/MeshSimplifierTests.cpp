@@ -0,0 +1,194 @@
+// Mesh simplification: every level has to be a valid, smaller triangle list over the
+// original vertices that keeps seams where they are and has no triangles without area
+#include "Test.h"
+#include "../Content/MeshSimplifier.h"
+#include <cmath>
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		namespace Simplifier = Content::Simplifier;
+
+		struct Vertex
+		{
+			f32 position[3];
+			f32 uv[2];
+		};
+
+		struct Mesh
+		{
+			Utils::vector<Vertex>	vertices;
+			Utils::vector<u32>		indices;
+			Utils::vector<bool>		isSeam;
+			Utils::vector<bool>		isRight;	// uv island on the right of the seam
+
+			Simplifier::MeshInput Input() const
+			{
+				Simplifier::MeshInput input{};
+				input.positions = &vertices[0].position[0];
+				input.positionStride = sizeof(Vertex);
+				input.vertexCount = (u32)vertices.size();
+				input.attributes = &vertices[0].uv[0];
+				input.attributeStride = sizeof(Vertex);
+				input.attributeCount = 2;
+				input.attributeWeights[0] = input.attributeWeights[1] = 1.0f;
+				input.indices = indices.data();
+				input.indexCount = (u32)indices.size();
+				return input;
+			}
+		};
+
+		// A gently curved grid, split down the middle into two uv islands. The vertices
+		// on the middle column are there twice, once for each island.
+		Mesh MakeGrid(u32 size)
+		{
+			Mesh mesh{};
+			const u32 seam{ size / 2 };
+			Utils::vector<u32> left((size + 1) * (size + 1)), right((size + 1) * (size + 1));
+			for (u32 y{ 0 }; y <= size; y++)
+				for (u32 x{ 0 }; x <= size; x++)
+				{
+					const f32 px{ (f32)x / size }, py{ (f32)y / size };
+					const f32 height{ 0.05f * std::sin(px * 3.0f) * std::cos(py * 2.0f) };
+					const u32 grid{ y * (size + 1) + x };
+					if (x <= seam)
+					{
+						left[grid] = (u32)mesh.vertices.size();
+						mesh.vertices.emplace_back(Vertex{ { px, py, height }, { px * 0.5f, py } });
+						mesh.isSeam.emplace_back(x == seam);
+						mesh.isRight.emplace_back(false);
+					}
+					if (x >= seam)
+					{
+						right[grid] = (u32)mesh.vertices.size();
+						mesh.vertices.emplace_back(Vertex{ { px, py, height }, { 0.5f + px * 0.5f, py } });
+						mesh.isSeam.emplace_back(x == seam);
+						mesh.isRight.emplace_back(true);
+					}
+				}
+
+			for (u32 y{ 0 }; y < size; y++)
+				for (u32 x{ 0 }; x < size; x++)
+				{
+					const Utils::vector<u32>& island{ x < seam ? left : right };
+					const u32 v{ y * (size + 1) + x };
+					const u32 quad[4]{ island[v], island[v + 1], island[v + size + 2], island[v + size + 1] };
+					for (const u32 i : { 0, 1, 2, 0, 2, 3 }) mesh.indices.emplace_back(quad[i]);
+				}
+			return mesh;
+		}
+
+		f32 DoubleArea(const Mesh& mesh, const u32* const triangle)
+		{
+			const f32* const a{ mesh.vertices[triangle[0]].position };
+			const f32* const b{ mesh.vertices[triangle[1]].position };
+			const f32* const c{ mesh.vertices[triangle[2]].position };
+			const f32 ab[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			const f32 ac[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			const f32 cross[3]{ ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+			return std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+		}
+
+		// Indices in range, no triangles that are degenerate in the index buffer or in space,
+		// no triangle across the seam, and every seam vertex still in use
+		bool IsValidLevel(const Mesh& mesh, const u32* const indices, u32 indexCount)
+		{
+			if (!indexCount || indexCount % 3) return false;
+			Utils::vector<bool> isUsed(mesh.vertices.size(), false);
+			for (u32 t{ 0 }; t < indexCount; t += 3)
+			{
+				const u32* const triangle{ &indices[t] };
+				for (u32 k{ 0 }; k < 3; k++)
+				{
+					if (triangle[k] >= mesh.vertices.size()) return false;
+					if (mesh.isRight[triangle[k]] != mesh.isRight[triangle[0]]) return false;
+					isUsed[triangle[k]] = true;
+				}
+				if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) return false;
+				if (DoubleArea(mesh, triangle) <= 0.0f) return false;
+			}
+			for (u32 i{ 0 }; i < (u32)mesh.vertices.size(); i++)
+				if (mesh.isSeam[i] && !isUsed[i]) return false;
+			return true;
+		}
+
+		void SimplifyGrid()
+		{
+			const Mesh mesh{ MakeGrid(32) };
+			const Simplifier::MeshInput input{ mesh.Input() };
+			CHECK(IsValidLevel(mesh, mesh.indices.data(), input.indexCount));
+
+			u32 previousCount{ input.indexCount };
+			for (const u32 divisor : { 2, 4, 8 })
+			{
+				Utils::vector<u32> simplified(input.indexCount);
+				f32 error{ -1.0f };
+				const u32 target{ input.indexCount / divisor / 3 * 3 };
+				const u32 count{ Simplifier::Simplify(input, target, 1e30f, simplified.data(), &error) };
+				CHECK(count < previousCount);
+				CHECK(IsValidLevel(mesh, simplified.data(), count));
+				CHECK(error >= 0.0f && error < 0.1f);
+				previousCount = count;
+			}
+
+			// Nothing moves further than the error limit allows
+			Utils::vector<u32> simplified(input.indexCount);
+			f32 error{ -1.0f };
+			Simplifier::Simplify(input, 0, 1e-3f, simplified.data(), &error);
+			CHECK(error >= 0.0f && error <= 1e-3f);
+		}
+
+		void GenerateGridLods()
+		{
+			const Mesh mesh{ MakeGrid(32) };
+			Simplifier::LodSettings settings{};
+			settings.lodCount = 5;
+			std::vector<u32> indices{ 7, 7, 7 };	// levels are appended
+			Simplifier::LodRange lods[Simplifier::maxLods]{};
+			const u32 lodCount{ Simplifier::GenerateLods(mesh.Input(), settings, indices, &lods[0]) };
+
+			CHECK(lodCount > 2 && lodCount <= settings.lodCount);
+			CHECK(lods[0].firstIndex == 3 && lods[0].indexCount == mesh.indices.size() && lods[0].error == 0.0f);
+			for (u32 i{ 0 }; i < lodCount; i++)
+			{
+				CHECK(lods[i].firstIndex + lods[i].indexCount <= indices.size());
+				CHECK(IsValidLevel(mesh, &indices[lods[i].firstIndex], lods[i].indexCount));
+				if (!i) continue;
+				CHECK(lods[i].indexCount < lods[i - 1].indexCount);
+				CHECK(lods[i].indexCount >= settings.minTriangleCount * 3);
+				CHECK(lods[i].error >= lods[i - 1].error);
+			}
+		}
+
+		// A flat fan whose cheapest collapse, the center onto v0, would squash the triangle
+		// (center, v1, v2) onto the line through v0, v1 and v2
+		void RejectCollapsesToALine()
+		{
+			Mesh mesh{};
+			const f32 ring[6][2]{ { 1, 0 }, { 1, 1 }, { 1, 2 }, { -1, 1 }, { -1, -1 }, { 1, -1 } };
+			// Any other collapse changes the attributes a lot
+			const f32 values[6]{ 0, 100, 200, 300, 400, 500 };
+			mesh.vertices.emplace_back(Vertex{ { 0, 0, 0 }, { 0, 0 } });
+			for (u32 i{ 0 }; i < 6; i++)
+				mesh.vertices.emplace_back(Vertex{ { ring[i][0], ring[i][1], 0 }, { values[i], 0 } });
+			for (u32 i{ 0 }; i < 6; i++)
+				for (const u32 v : { 0u, i + 1, (i + 1) % 6 + 1 }) mesh.indices.emplace_back(v);
+			mesh.isSeam.assign(mesh.vertices.size(), false);
+			mesh.isRight.assign(mesh.vertices.size(), false);
+
+			const Simplifier::MeshInput input{ mesh.Input() };
+			Utils::vector<u32> simplified(input.indexCount);
+			const u32 count{ Simplifier::Simplify(input, input.indexCount - 6, 1e30f, simplified.data()) };
+			CHECK(count <= input.indexCount);
+			CHECK(IsValidLevel(mesh, simplified.data(), count));
+		}
+	} // anonymous namespace
+
+	void AddMeshSimplifierTests()
+	{
+		Add("mesh_simplifier/simplify_grid", SimplifyGrid);
+		Add("mesh_simplifier/generate_grid_lods", GenerateGridLods);
+		Add("mesh_simplifier/reject_collapses_to_a_line", RejectCollapsesToALine);
+	}
+}
@@ -0,0 +1,184 @@
+// Render graph compilation: culling, transient aliasing and re-executing a compiled graph
+#include "Test.h"
+#include "../Graphics/RenderGraph.h"
+
+// The graph only needs these from the renderer. Defining them here keeps the tests free
+// of a graphics context and lets them count the render targets the graph holds.
+namespace Havana::Graphics
+{
+	namespace
+	{
+		u32 nextRenderTarget{ 1 };
+		u32 createdRenderTargets{ 0 };
+		u32 liveRenderTargets{ 0 };
+		Utils::FrameArena frameMemory{};
+	} // anonymous namespace
+
+	u32 CreateRenderTarget(const RenderTargetDesc&)
+	{
+		createdRenderTargets++;
+		liveRenderTargets++;
+		return nextRenderTarget++;
+	}
+
+	void RemoveRenderTarget(u32)
+	{
+		assert(liveRenderTargets);
+		liveRenderTargets--;
+	}
+
+	Utils::FrameArena& FrameMemory()
+	{
+		return frameMemory;
+	}
+}
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		using namespace Graphics;
+
+		constexpr RenderTargetDesc colorDesc{ 256, 256, RenderTargetFormat::RGBA8 };
+		constexpr u32 backBuffer{ 100 };
+
+		void CountPass(const RenderPassContext& context, void* data)
+		{
+			(*(u32*)data)++;
+			context.commandList->Record(DrawCommand{ 3, 1, 0, 0, PrimitiveTopology::Triangles });
+		}
+
+		// A pass whose output nobody reads is culled, and so is everything that only feeds it.
+		// Passes that write an imported resource or have side effects are kept.
+		void CullUnusedPasses()
+		{
+			u32 calls{ 0 };
+			{
+				RenderGraph graph{};
+				const u32 output{ graph.Import("back buffer", colorDesc, backBuffer) };
+				const u32 lighting{ graph.CreateTransient("lighting", colorDesc) };
+				const u32 unused{ graph.CreateTransient("unused", colorDesc) };
+				const u32 unusedInput{ graph.CreateTransient("unused input", colorDesc) };
+
+				const u32 light{ graph.AddPass("light", CountPass, &calls) };
+				graph.Write(light, lighting, LoadOp::Clear);
+				const u32 compose{ graph.AddPass("compose", CountPass, &calls) };
+				graph.Read(compose, lighting);
+				graph.Write(compose, output);
+				const u32 feed{ graph.AddPass("feed", CountPass, &calls) };
+				graph.Write(feed, unusedInput);
+				const u32 debug{ graph.AddPass("debug", CountPass, &calls) };
+				graph.Read(debug, unusedInput);
+				graph.Write(debug, unused);
+				const u32 readback{ graph.AddPass("readback", CountPass, &calls, true) };
+				graph.Read(readback, lighting);
+				const u32 nothing{ graph.AddPass("nothing", CountPass, &calls) };
+
+				CHECK(graph.Compile());
+				CHECK(!graph.IsPassCulled(light));
+				CHECK(!graph.IsPassCulled(compose));
+				CHECK(graph.IsPassCulled(feed));
+				CHECK(graph.IsPassCulled(debug));
+				CHECK(!graph.IsPassCulled(readback));
+				CHECK(graph.IsPassCulled(nothing));
+				CHECK(graph.RenderTarget(output) == backBuffer);
+				// Only "lighting" needs memory, culled outputs get none
+				CHECK(graph.PhysicalRenderTargetCount() == 1);
+
+				CommandList list{};
+				list.Initialize(4096);
+				graph.Execute(list);
+				CHECK(calls == 3);
+			}
+			CHECK(liveRenderTargets == 0);
+		}
+
+		// A chain of same-sized transients: each one is dead by the time the one after next
+		// is first written, so the chain only needs two physical render targets.
+		void AliasNonOverlappingTransients()
+		{
+			u32 calls{ 0 };
+			{
+				RenderGraph graph{};
+				const u32 output{ graph.Import("back buffer", colorDesc, backBuffer) };
+				u32 transients[4]{};
+				for (u32& transient : transients)
+					transient = graph.CreateTransient("chain", colorDesc);
+
+				u32 pass{ graph.AddPass("first", CountPass, &calls) };
+				graph.Write(pass, transients[0], LoadOp::Clear);
+				for (u32 i{ 1 }; i < std::size(transients); i++)
+				{
+					pass = graph.AddPass("next", CountPass, &calls);
+					graph.Read(pass, transients[i - 1]);
+					graph.Write(pass, transients[i]);
+				}
+				pass = graph.AddPass("present", CountPass, &calls);
+				graph.Read(pass, transients[3]);
+				graph.Write(pass, output);
+
+				CHECK(graph.Compile());
+				CHECK(graph.PhysicalRenderTargetCount() == 2);
+				CHECK(graph.RenderTarget(transients[0]) == graph.RenderTarget(transients[2]));
+				CHECK(graph.RenderTarget(transients[1]) == graph.RenderTarget(transients[3]));
+				CHECK(graph.RenderTarget(transients[0]) != graph.RenderTarget(transients[1]));
+
+				const u64 targetBytes{ (u64)colorDesc.width * colorDesc.height * BytesPerPixel(colorDesc.format) };
+				CHECK(graph.TransientBytes() == 2 * targetBytes);
+				CHECK(graph.UnaliasedTransientBytes() == 4 * targetBytes);
+				CHECK(liveRenderTargets == 2);
+			}
+			CHECK(liveRenderTargets == 0);
+		}
+
+		// A compiled graph records the same commands every time it's executed, and rebuilding
+		// the same topology after Reset() reuses the render targets it already has.
+		void CompileOnceExecuteEveryFrame()
+		{
+			u32 calls{ 0 };
+			RenderGraph graph{};
+			auto build = [&graph, &calls]()
+			{
+				const u32 output{ graph.Import("back buffer", colorDesc, backBuffer) };
+				const u32 scene{ graph.CreateTransient("scene", colorDesc) };
+				const u32 depth{ graph.CreateTransient("depth", { 256, 256, RenderTargetFormat::Depth32F }) };
+				const u32 draw{ graph.AddPass("scene", CountPass, &calls) };
+				graph.Write(draw, scene, LoadOp::Clear);
+				graph.Write(draw, depth, LoadOp::Clear);
+				const u32 post{ graph.AddPass("post", CountPass, &calls) };
+				graph.Read(post, scene);
+				graph.Write(post, output, LoadOp::DontCare);
+				return graph.Compile();
+			};
+
+			CHECK(build());
+			const u32 created{ createdRenderTargets };
+
+			CommandList first{}, second{};
+			first.Initialize(4096);
+			second.Initialize(4096);
+			graph.Execute(first);
+			graph.Execute(second);
+			CHECK(calls == 4);
+			CHECK(graph.IsCompiled());
+			CHECK(first.CommandCount() && first.CommandCount() == second.CommandCount());
+			CHECK(first.Size() == second.Size() && !memcmp(first.Begin(), second.Begin(), first.Size()));
+
+			graph.Reset();
+			CHECK(!graph.IsCompiled());
+			CHECK(build());
+			CHECK(createdRenderTargets == created);
+			CHECK(graph.PhysicalRenderTargetCount() == 2);
+
+			graph.Release();
+			CHECK(liveRenderTargets == 0);
+		}
+	} // anonymous namespace
+
+	void AddRenderGraphTests()
+	{
+		Add("render_graph/cull_unused_passes", CullUnusedPasses);
+		Add("render_graph/alias_non_overlapping_transients", AliasNonOverlappingTransients);
+		Add("render_graph/compile_once_execute_every_frame", CompileOnceExecuteEveryFrame);
+	}
+}
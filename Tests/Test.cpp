@@ -0,0 +1,101 @@
+#include "Test.h"
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace Havana::Tests
+{
+	namespace
+	{
+		struct TestInfo
+		{
+			const char*		name{ nullptr };
+			test_function	function{ nullptr };
+		};
+
+		Utils::vector<TestInfo> tests;
+		u32 failureCount{ 0 };
+		char tempDirectory[]{ "/tmp/havana_tests_XXXXXX" };
+		bool isTempDirectoryCreated{ false };
+		Utils::vector<std::string> tempPaths;
+
+		void RemoveTempFiles()
+		{
+			if (!isTempDirectoryCreated) return;
+			for (const std::string& path : tempPaths) remove(path.c_str());
+			rmdir(tempDirectory);
+		}
+	} // anonymous namespace
+
+	void Add(const char* name, test_function function)
+	{
+		assert(name && function);
+		tests.push_back({ name, function });
+	}
+
+	void Fail(const char* file, u32 line, const char* expression)
+	{
+		fprintf(stderr, "%s:%u: CHECK(%s) failed\n", file, line, expression);
+		failureCount++;
+	}
+
+	std::string TempPath(const char* name)
+	{
+		if (!isTempDirectoryCreated)
+		{
+			isTempDirectoryCreated = mkdtemp(tempDirectory) != nullptr;
+			assert(isTempDirectoryCreated);
+		}
+
+		std::string path{ tempDirectory };
+		path += '/';
+		path += name;
+		tempPaths.emplace_back(path);
+		return path;
+	}
+}
+
+using namespace Havana;
+
+// Usage: tests.a [--filter <substring>]
+// Returns 1 when any test failed.
+int main(int argc, char** argv)
+{
+	const char* filter{ nullptr };
+	for (int i{ 1 }; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [--filter <substring>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Tests::AddJobSystemTests();
+	Tests::AddRenderGraphTests();
+	Tests::AddAssetPackTests();
+	Tests::AddIoServiceTests();
+	Tests::AddDynamicBvhTests();
+	Tests::AddMeshSimplifierTests();
+	Tests::AddMeshLodTests();
+	Tests::AddAllocationGuardTests();
+
+	u32 failedTests{ 0 }, testCount{ 0 };
+	for (const Tests::TestInfo& info : Tests::tests)
+	{
+		if (filter && !strstr(info.name, filter)) continue;
+
+		const u32 failures{ Tests::failureCount };
+		info.function();
+		const bool isFailed{ Tests::failureCount != failures };
+		printf("%-48s %s\n", info.name, isFailed ? "FAILED" : "ok");
+		failedTests += isFailed;
+		testCount++;
+	}
+
+	Tests::RemoveTempFiles();
+	printf("%u of %u tests passed\n", testCount - failedTests, testCount);
+	return failedTests ? 1 : 0;
+}
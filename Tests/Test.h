@@ -0,0 +1,30 @@
+#pragma once
+#include "../Common/CommonHeaders.h"
+#include <string>
+
+// Minimal test harness. Every test is a function that checks its results with CHECK(),
+// which reports a failure and carries on, so one run lists every broken test. Built by
+// "make tests" with asserts on, so the engine's own asserts are checked as well.
+namespace Havana::Tests
+{
+	using test_function = void(*)(void);
+
+	void Add(const char* name, test_function function);
+	void Fail(const char* file, u32 line, const char* expression);
+
+	// Path of a file in a directory that is created for this run and removed with
+	// everything that was requested through here when the tests are done
+	std::string TempPath(const char* name);
+
+	// Defined by the test translation units
+	void AddJobSystemTests();
+	void AddRenderGraphTests();
+	void AddAssetPackTests();
+	void AddIoServiceTests();
+	void AddDynamicBvhTests();
+	void AddMeshSimplifierTests();
+	void AddMeshLodTests();
+	void AddAllocationGuardTests();
+}
+
+#define CHECK(expression) ((expression) ? (void)0 : Havana::Tests::Fail(__FILE__, __LINE__, #expression))
@@ -0,0 +1,452 @@
+// Offline asset cooker. Converts source meshes (.obj) and textures (.ppm) into a single
+// pack file that the runtime maps and uses in place (see Content/AssetPackFormat.h).
+//
+// Usage: cooker.a <output.pack> [--linear] [--lods <count>] <source>...
+// Assets are named by their source path as given on the command line. Textures are
+// treated as sRGB unless they follow --linear. Meshes get a chain of simplified levels
+// of detail, 4 levels by default or as many as the last --lods before them asked for.
+#include "../../Content/AssetPackFormat.h"
+#include "../../Content/MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace Havana::Content;
+
+static_assert(Simplifier::maxLods == Pack::maxLods);
+
+namespace
+{
+	struct CookedAsset
+	{
+		std::string			name;
+		Pack::AssetType		type;
+		std::vector<u8>		data;
+	};
+
+	bool EndsWith(const std::string& s, const char* suffix)
+	{
+		const size_t length{ strlen(suffix) };
+		return s.size() >= length && !strcasecmp(s.c_str() + s.size() - length, suffix);
+	}
+
+	bool ReadFile(const char* path, std::string& contents)
+	{
+		FILE* file{ fopen(path, "rb") };
+		if (!file) return false;
+
+		fseek(file, 0, SEEK_END);
+		contents.resize((size_t)ftell(file));
+		fseek(file, 0, SEEK_SET);
+		const bool result{ fread(contents.data(), 1, contents.size(), file) == contents.size() };
+		fclose(file);
+		return result;
+	}
+
+	template<typename T>
+	void Append(std::vector<u8>& data, const T* values, size_t count)
+	{
+		const u8* const bytes{ (const u8*)values };
+		data.insert(data.end(), bytes, bytes + sizeof(T) * count);
+	}
+
+	void Pad(std::vector<u8>& data, u64 alignment)
+	{
+		data.resize((size_t)Pack::AlignUp(data.size(), alignment), 0);
+	}
+
+	//// MESHES ////
+
+	// OBJ position/uv/normal index triple, 0 = missing
+	struct VertexKey
+	{
+		s32 position, uv, normal;
+		bool operator==(const VertexKey& o) const { return position == o.position && uv == o.uv && normal == o.normal; }
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& k) const
+		{
+			return ((size_t)k.position * 73856093) ^ ((size_t)k.uv * 19349663) ^ ((size_t)k.normal * 83492791);
+		}
+	};
+
+	// OBJ indices are 1-based, negative indices count back from the end
+	s32 ResolveIndex(s32 index, size_t count)
+	{
+		return index < 0 ? (s32)count + index + 1 : index;
+	}
+
+	bool CookMesh(const std::string& path, u32 lodCount, CookedAsset& asset)
+	{
+		std::string source;
+		if (!ReadFile(path.c_str(), source)) return false;
+
+		std::vector<f32> positions, normals, uvs;
+		std::vector<Pack::MeshVertex> vertices;
+		std::vector<u32> indices;
+		std::unordered_map<VertexKey, u32, VertexKeyHash> vertexMap;
+
+		const char* line{ source.c_str() };
+		while (*line)
+		{
+			const char* const next{ strchr(line, '\n') };
+			const std::string text{ line, next ? (size_t)(next - line) : strlen(line) };
+			line = next ? next + 1 : line + text.size();
+
+			f32 x{ 0 }, y{ 0 }, z{ 0 };
+			if (sscanf(text.c_str(), "v %f %f %f", &x, &y, &z) == 3) positions.insert(positions.end(), { x, y, z });
+			else if (sscanf(text.c_str(), "vn %f %f %f", &x, &y, &z) == 3) normals.insert(normals.end(), { x, y, z });
+			else if (sscanf(text.c_str(), "vt %f %f", &x, &y) == 2) uvs.insert(uvs.end(), { x, 1.0f - y });
+			else if (text.size() > 2 && text[0] == 'f' && text[1] == ' ')
+			{
+				// Triangulate the polygon as a fan
+				std::vector<u32> face;
+				const char* cursor{ text.c_str() + 2 };
+				while (*cursor)
+				{
+					while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') cursor++;
+					if (!*cursor) break;
+
+					VertexKey key{ 0, 0, 0 };
+					char* end{ nullptr };
+					key.position = ResolveIndex((s32)strtol(cursor, &end, 10), positions.size() / 3);
+					if (*end == '/')
+					{
+						if (end[1] != '/') key.uv = ResolveIndex((s32)strtol(end + 1, &end, 10), uvs.size() / 2);
+						else end++;
+						if (*end == '/') key.normal = ResolveIndex((s32)strtol(end + 1, &end, 10), normals.size() / 3);
+					}
+					cursor = end;
+					while (*cursor && *cursor != ' ' && *cursor != '\t') cursor++;
+
+					if (key.position < 1 || (size_t)key.position > positions.size() / 3) return false;
+					if ((size_t)key.uv > uvs.size() / 2 || (size_t)key.normal > normals.size() / 3) return false;
+
+					auto [it, isNew] { vertexMap.try_emplace(key, (u32)vertices.size()) };
+					if (isNew)
+					{
+						Pack::MeshVertex v{};
+						memcpy(v.position, &positions[(key.position - 1) * 3], sizeof(v.position));
+						if (key.normal) memcpy(v.normal, &normals[(key.normal - 1) * 3], sizeof(v.normal));
+						if (key.uv) memcpy(v.uv, &uvs[(key.uv - 1) * 2], sizeof(v.uv));
+						vertices.emplace_back(v);
+					}
+					face.emplace_back(it->second);
+				}
+
+				for (size_t i{ 2 }; i < face.size(); i++)
+					indices.insert(indices.end(), { face[0], face[i - 1], face[i] });
+			}
+		}
+
+		if (vertices.empty() || indices.empty()) return false;
+
+		// Normals and uvs are kept where possible, uv changes cost a little more
+		Simplifier::MeshInput mesh{};
+		mesh.positions = vertices[0].position;
+		mesh.positionStride = sizeof(Pack::MeshVertex);
+		mesh.vertexCount = (u32)vertices.size();
+		mesh.attributes = vertices[0].normal;
+		mesh.attributeStride = sizeof(Pack::MeshVertex);
+		mesh.attributeCount = 5;
+		const f32 weights[]{ 0.5f, 0.5f, 0.5f, 1.0f, 1.0f };
+		memcpy(mesh.attributeWeights, weights, sizeof(weights));
+		mesh.indices = indices.data();
+		mesh.indexCount = (u32)indices.size();
+
+		Simplifier::LodSettings settings{};
+		settings.lodCount = lodCount;
+		std::vector<u32> lodIndices;
+		Simplifier::LodRange lods[Simplifier::maxLods];
+
+		Pack::MeshHeader header{};
+		header.lodCount = Simplifier::GenerateLods(mesh, settings, lodIndices, lods);
+		for (u32 i{ 0 }; i < header.lodCount; i++) header.lods[i] = { lods[i].firstIndex, lods[i].indexCount, lods[i].error, 0 };
+		indices = std::move(lodIndices);
+
+		header.vertexCount = (u32)vertices.size();
+		header.indexCount = (u32)indices.size();
+		for (u32 axis{ 0 }; axis < 3; axis++)
+		{
+			header.boundsMin[axis] = vertices[0].position[axis];
+			header.boundsMax[axis] = vertices[0].position[axis];
+		}
+		for (const Pack::MeshVertex& v : vertices)
+		{
+			for (u32 axis{ 0 }; axis < 3; axis++)
+			{
+				header.boundsMin[axis] = std::min(header.boundsMin[axis], v.position[axis]);
+				header.boundsMax[axis] = std::max(header.boundsMax[axis], v.position[axis]);
+			}
+		}
+
+		header.vertexOffset = (u32)Pack::AlignUp(sizeof(header), Pack::subresourceAlignment);
+		header.indexOffset = (u32)Pack::AlignUp(header.vertexOffset + vertices.size() * sizeof(Pack::MeshVertex), Pack::subresourceAlignment);
+
+		asset.type = Pack::AssetType::Mesh;
+		Append(asset.data, &header, 1);
+		Pad(asset.data, Pack::subresourceAlignment);
+		Append(asset.data, vertices.data(), vertices.size());
+		Pad(asset.data, Pack::subresourceAlignment);
+		Append(asset.data, indices.data(), indices.size());
+		return true;
+	}
+
+	//// TEXTURES ////
+
+	f32 ToLinear(u8 value, bool isSRGB)
+	{
+		const f32 c{ value / 255.0f };
+		if (!isSRGB) return c;
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	u8 FromLinear(f32 c, bool isSRGB)
+	{
+		if (isSRGB) c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+		return (u8)std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f);
+	}
+
+	// Box filter one mip down. Colors are averaged in linear space, alpha as is.
+	std::vector<u8> Downsample(const std::vector<u8>& source, u32 width, u32 height, bool isSRGB)
+	{
+		const u32 w{ std::max(width / 2, 1u) };
+		const u32 h{ std::max(height / 2, 1u) };
+		std::vector<u8> result(w * h * 4);
+
+		for (u32 y{ 0 }; y < h; y++)
+		{
+			for (u32 x{ 0 }; x < w; x++)
+			{
+				const u32 x0{ std::min(x * 2, width - 1) }, x1{ std::min(x * 2 + 1, width - 1) };
+				const u32 y0{ std::min(y * 2, height - 1) }, y1{ std::min(y * 2 + 1, height - 1) };
+				const u8* const texels[4]{ &source[(y0 * width + x0) * 4], &source[(y0 * width + x1) * 4],
+										   &source[(y1 * width + x0) * 4], &source[(y1 * width + x1) * 4] };
+
+				u8* const out{ &result[(y * w + x) * 4] };
+				for (u32 c{ 0 }; c < 4; c++)
+				{
+					const bool isColor{ isSRGB && c < 3 };
+					f32 sum{ 0 };
+					for (const u8* texel : texels) sum += ToLinear(texel[c], isColor);
+					out[c] = FromLinear(sum * 0.25f, isColor);
+				}
+			}
+		}
+
+		return result;
+	}
+
+	// Binary (P6) or ASCII (P3) PPM with 8-bit channels
+	bool ReadPPM(const std::string& source, u32& width, u32& height, std::vector<u8>& rgba)
+	{
+		if (source.size() < 2 || source[0] != 'P' || (source[1] != '6' && source[1] != '3')) return false;
+		const bool isBinary{ source[1] == '6' };
+
+		size_t cursor{ 2 };
+		auto nextNumber = [&source, &cursor]() -> s64
+		{
+			while (cursor < source.size())
+			{
+				if (source[cursor] == '#') while (cursor < source.size() && source[cursor] != '\n') cursor++;
+				else if (isspace((u8)source[cursor])) cursor++;
+				else break;
+			}
+			if (cursor >= source.size() || !isdigit((u8)source[cursor])) return -1;
+			s64 value{ 0 };
+			while (cursor < source.size() && isdigit((u8)source[cursor])) value = value * 10 + (source[cursor++] - '0');
+			return value;
+		};
+
+		const s64 w{ nextNumber() }, h{ nextNumber() }, maxValue{ nextNumber() };
+		if (w <= 0 || h <= 0 || maxValue != 255) return false;
+		width = (u32)w;
+		height = (u32)h;
+
+		const size_t texelCount{ (size_t)width * height };
+		rgba.resize(texelCount * 4);
+		if (isBinary)
+		{
+			cursor++; // single whitespace after the header
+			if (source.size() - cursor < texelCount * 3) return false;
+			for (size_t i{ 0 }; i < texelCount; i++)
+			{
+				memcpy(&rgba[i * 4], &source[cursor + i * 3], 3);
+				rgba[i * 4 + 3] = 0xff;
+			}
+		}
+		else
+		{
+			for (size_t i{ 0 }; i < texelCount * 4; i++)
+			{
+				if ((i & 3) == 3) { rgba[i] = 0xff; continue; }
+				const s64 value{ nextNumber() };
+				if (value < 0 || value > 255) return false;
+				rgba[i] = (u8)value;
+			}
+		}
+
+		return true;
+	}
+
+	bool CookTexture(const std::string& path, bool isSRGB, CookedAsset& asset)
+	{
+		std::string source;
+		u32 width{ 0 }, height{ 0 };
+		std::vector<u8> mip;
+		if (!ReadFile(path.c_str(), source) || !ReadPPM(source, width, height, mip)) return false;
+
+		Pack::TextureHeader header{};
+		header.width = width;
+		header.height = height;
+		header.isSRGB = isSRGB ? 1 : 0;
+
+		std::vector<std::vector<u8>> mips;
+		for (;;)
+		{
+			mips.emplace_back(mip);
+			if ((width == 1 && height == 1) || mips.size() == Pack::maxMips) break;
+			mip = Downsample(mip, width, height, isSRGB);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		header.mipCount = (u32)mips.size();
+
+		u64 offset{ Pack::AlignUp(sizeof(header), Pack::subresourceAlignment) };
+		for (u32 i{ 0 }; i < header.mipCount; i++)
+		{
+			header.mipOffsets[i] = (u32)offset;
+			header.mipSizes[i] = (u32)mips[i].size();
+			offset = Pack::AlignUp(offset + mips[i].size(), Pack::subresourceAlignment);
+		}
+
+		asset.type = Pack::AssetType::Texture;
+		Append(asset.data, &header, 1);
+		for (const std::vector<u8>& m : mips)
+		{
+			Pad(asset.data, Pack::subresourceAlignment);
+			Append(asset.data, m.data(), m.size());
+		}
+		return true;
+	}
+
+	//// PACK ////
+
+	bool WritePack(const char* path, std::vector<CookedAsset>& assets)
+	{
+		std::sort(assets.begin(), assets.end(), [](const CookedAsset& a, const CookedAsset& b)
+		{
+			return Pack::NameHash(a.name.c_str()) < Pack::NameHash(b.name.c_str());
+		});
+
+		std::vector<Pack::AssetEntry> entries(assets.size());
+		u64 offset{ Pack::AlignUp(sizeof(Pack::PackHeader) + entries.size() * sizeof(Pack::AssetEntry), Pack::assetAlignment) };
+		for (size_t i{ 0 }; i < assets.size(); i++)
+		{
+			entries[i].nameHash = Pack::NameHash(assets[i].name.c_str());
+			if (i > 0 && entries[i].nameHash == entries[i - 1].nameHash)
+			{
+				fprintf(stderr, "Asset name hash collision: %s and %s\n", assets[i - 1].name.c_str(), assets[i].name.c_str());
+				return false;
+			}
+			entries[i].type = assets[i].type;
+			entries[i].offset = offset;
+			entries[i].size = assets[i].data.size();
+			offset = Pack::AlignUp(offset + assets[i].data.size(), Pack::assetAlignment);
+		}
+
+		const Pack::PackHeader header{ Pack::magic, Pack::version, (u32)entries.size(), Pack::assetAlignment, offset };
+
+		std::vector<u8> index;
+		Append(index, &header, 1);
+		Append(index, entries.data(), entries.size());
+		Pad(index, Pack::assetAlignment);
+
+		// Write to a temporary file and rename, so a failed cook never leaves a truncated pack
+		const std::string temporary{ std::string{ path } + ".tmp" };
+		FILE* file{ fopen(temporary.c_str(), "wb") };
+		if (!file) return false;
+
+		bool result{ fwrite(index.data(), 1, index.size(), file) == index.size() };
+		for (CookedAsset& asset : assets)
+		{
+			Pad(asset.data, Pack::assetAlignment);
+			result = result && fwrite(asset.data.data(), 1, asset.data.size(), file) == asset.data.size();
+		}
+		result = fclose(file) == 0 && result;
+
+		if (!result || rename(temporary.c_str(), path))
+		{
+			remove(temporary.c_str());
+			return false;
+		}
+		return true;
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: %s <output.pack> [--linear] [--lods <count>] <source.obj|source.ppm>...\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<CookedAsset> assets;
+	bool isSRGB{ true };
+	u32 lodCount{ 4 };
+	for (int i{ 2 }; i < argc; i++)
+	{
+		const std::string path{ argv[i] };
+		if (path == "--linear")
+		{
+			isSRGB = false;
+			continue;
+		}
+		if (path == "--lods")
+		{
+			lodCount = i + 1 < argc ? (u32)atoi(argv[++i]) : 0;
+			if (lodCount < 1 || lodCount > Pack::maxLods)
+			{
+				fprintf(stderr, "--lods takes a count from 1 to %u\n", Pack::maxLods);
+				return 1;
+			}
+			continue;
+		}
+
+		CookedAsset asset{ path, Pack::AssetType::Mesh, {} };
+		bool result{ false };
+		if (EndsWith(path, ".obj")) result = CookMesh(path, lodCount, asset);
+		else if (EndsWith(path, ".ppm")) result = CookTexture(path, isSRGB, asset);
+		else
+		{
+			fprintf(stderr, "Unsupported source: %s\n", path.c_str());
+			return 1;
+		}
+
+		if (!result)
+		{
+			fprintf(stderr, "Failed to cook %s\n", path.c_str());
+			return 1;
+		}
+
+		printf("%s: %zu bytes\n", path.c_str(), asset.data.size());
+		assets.emplace_back(std::move(asset));
+	}
+
+	if (!WritePack(argv[1], assets))
+	{
+		fprintf(stderr, "Failed to write %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("Wrote %zu assets to %s\n", assets.size(), argv[1]);
+	return 0;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "../Common/CommonHeaders.h"
+#include <atomic>
+#include <new>
+
+// Bump allocator for data that only lives for a frame. Memory for every frame in flight
+// is reserved once; allocating is a pointer increment and everything a frame allocated
+// is freed at once by BeginFrame() when that frame comes around again. Destructors are
+// never called.
+//
+// Each thread takes chunks of the frame's memory and allocates from its own chunk
+// without atomics, so job threads can allocate at the same time. Allocations that don't
+// fit in the frame's memory fall back to the heap (under a lock) and are freed with the
+// frame as well; OverflowBytes() tells when the arena should be larger.
+//
+// The reserved memory is tracked under the arena's tag as one allocation. Overflow
+// allocations are tracked one by one, so they show up in the tag's per-frame counts.
+namespace Havana::Utils
+{
+	class FrameArena
+	{
+	public:
+		constexpr static u32 maxFrames{ 4 };
+		constexpr static u32 chunkSize{ 64 * 1024 };
+		constexpr static u32 maxChunkAllocation{ chunkSize / 4 };	// larger ones bypass the thread chunks
+		constexpr static u32 defaultAlignment{ 16 };
+
+		FrameArena() = default;
+		DISABLE_COPY_AND_MOVE(FrameArena);
+		~FrameArena() { Release(); }
+
+		/// <summary>
+		/// Reserves the memory of all frames and makes frame 0 the current frame.
+		/// </summary>
+		/// <param name="frameCount"> - Frames whose memory is in use at the same time, usually frameBufferCount + 1.</param>
+		/// <param name="bytesPerFrame"> - Memory of each frame, rounded up to a multiple of chunkSize.</param>
+		/// <param name="tag"> - Subsystem the memory is tracked under.</param>
+		/// <returns>True if the memory could be reserved.</returns>
+		bool Initialize(u32 frameCount, u64 bytesPerFrame, Memory::Tag tag = Memory::Tag::General, Memory::Callsite callsite = MEMORY_CALLSITE)
+		{
+			assert(frameCount && frameCount <= maxFrames && bytesPerFrame);
+			Release();
+
+			m_bytesPerFrame = (bytesPerFrame + chunkSize - 1) & ~(u64)(chunkSize - 1);
+			m_memory = std::unique_ptr<u8[]>{ new (std::nothrow) u8[m_bytesPerFrame * frameCount + cacheLineSize] };
+			if (!m_memory)
+			{
+				m_bytesPerFrame = 0;
+				return false;
+			}
+
+			m_memoryAllocation = Memory::Track(tag, m_bytesPerFrame * frameCount + cacheLineSize, callsite);
+			m_tag = tag;
+			m_callsite = callsite;
+
+			u8* const base{ AlignUp(m_memory.get(), cacheLineSize) };
+			for (u32 i{ 0 }; i < frameCount; i++) m_frames[i].base = base + m_bytesPerFrame * i;
+			m_frameCount = frameCount;
+			m_currentFrame = 0;
+			m_epoch++;
+			return true;
+		}
+
+		void Release()
+		{
+			for (u32 i{ 0 }; i < m_frameCount; i++) Reset(m_frames[i]);
+			if (m_memory) Memory::Untrack(m_memoryAllocation);
+			m_memory.reset();
+			m_frameCount = 0;
+			m_bytesPerFrame = 0;
+			m_epoch++;
+		}
+
+		// Frees everything that was allocated in frameIdx and allocates from it from now on.
+		// Call when the GPU is done with that frame, while no other thread is allocating.
+		void BeginFrame(u32 frameIdx)
+		{
+			assert(frameIdx < m_frameCount);
+			Reset(m_frames[frameIdx]);
+			m_currentFrame = frameIdx;
+			m_epoch++;	// thread chunks of the previous frame are stale
+		}
+
+		[[nodiscard]] void* Allocate(u64 size, u32 alignment = defaultAlignment)
+		{
+			assert(m_frameCount && size && alignment && !(alignment & (alignment - 1)));
+			const u32 slot{ ThreadSlot() };
+			if (slot < maxThreadSlots && size <= maxChunkAllocation && alignment <= cacheLineSize)
+			{
+				ThreadChunk& chunk{ m_chunks[slot] };
+				u8* address{ AlignUp(chunk.current, alignment) };
+				if (chunk.epoch != m_epoch || address + size > chunk.end)
+				{
+					u8* const memory{ AllocateShared(chunkSize, cacheLineSize) };
+					if (!memory) return AllocateOverflow(size, alignment);
+
+					chunk.end = memory + chunkSize;
+					chunk.epoch = m_epoch;
+					address = AlignUp(memory, alignment);
+				}
+				chunk.current = address + size;
+				return address;
+			}
+
+			u8* const memory{ AllocateShared(size, alignment) };
+			return memory ? memory : AllocateOverflow(size, alignment);
+		}
+
+		// Uninitialized memory for count objects of type T
+		template<typename T>
+		[[nodiscard]] T* AllocateArray(u64 count)
+		{
+			return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T) > defaultAlignment ? alignof(T) : defaultAlignment));
+		}
+
+		// The object's destructor is never called
+		template<typename T, typename... Args>
+		[[nodiscard]] T* New(Args&&... args)
+		{
+			return new (Allocate(sizeof(T), alignof(T) > defaultAlignment ? alignof(T) : defaultAlignment)) T{ std::forward<Args>(args)... };
+		}
+
+		// Bytes taken from the current frame's memory, including unused parts of thread chunks
+		u64 Size() const
+		{
+			const u64 offset{ m_frames[m_currentFrame].offset.load(std::memory_order_relaxed) };
+			return offset < m_bytesPerFrame ? offset : m_bytesPerFrame;
+		}
+
+		// Bytes the current frame had to allocate from the heap because its memory ran out
+		u64 OverflowBytes() const { return m_frames[m_currentFrame].overflowBytes.load(std::memory_order_relaxed); }
+		constexpr u64 Capacity() const { return m_bytesPerFrame; }
+		constexpr u32 FrameCount() const { return m_frameCount; }
+
+	private:
+		constexpr static u32 cacheLineSize{ 64 };
+
+		struct Frame
+		{
+			u8*						base{ nullptr };
+			std::atomic<u64>		offset{ 0 };
+			std::atomic<u64>		overflowBytes{ 0 };
+			Utils::vector<u8*>		overflow;
+		};
+
+		// Only used by the thread that owns the slot
+		struct alignas(64) ThreadChunk
+		{
+			u8*		current{ nullptr };
+			u8*		end{ nullptr };
+			u64		epoch{ 0 };
+		};
+
+		template<typename T>
+		static T* AlignUp(T* pointer, u32 alignment)
+		{
+			return reinterpret_cast<T*>((reinterpret_cast<uintptr_t>(pointer) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+		}
+
+		u8* AllocateShared(u64 size, u32 alignment)
+		{
+			Frame& frame{ m_frames[m_currentFrame] };
+			const u64 reserved{ size + alignment - 1 };
+			const u64 offset{ frame.offset.fetch_add(reserved, std::memory_order_relaxed) };
+			if (offset + reserved > m_bytesPerFrame) return nullptr;
+			return AlignUp(frame.base + offset, alignment);
+		}
+
+		u8* AllocateOverflow(u64 size, u32 alignment)
+		{
+			u8* const memory{ static_cast<u8*>(Memory::Allocate(m_tag, size, alignment, m_callsite)) };
+			if (!memory) return nullptr;
+
+			Frame& frame{ m_frames[m_currentFrame] };
+			frame.overflowBytes.fetch_add(size, std::memory_order_relaxed);
+			std::lock_guard lock{ m_overflowMutex };
+			frame.overflow.push_back(memory);
+			return memory;
+		}
+
+		void Reset(Frame& frame)
+		{
+			for (u8* const memory : frame.overflow) Memory::Free(memory);
+			frame.overflow.clear();
+			frame.offset.store(0, std::memory_order_relaxed);
+			frame.overflowBytes.store(0, std::memory_order_relaxed);
+		}
+
+		std::unique_ptr<u8[]>	m_memory{};
+		Memory::Allocation		m_memoryAllocation{};
+		Memory::Callsite		m_callsite{};
+		Memory::Tag				m_tag{ Memory::Tag::General };
+		Frame					m_frames[maxFrames]{};
+		ThreadChunk				m_chunks[maxThreadSlots]{};
+		std::mutex				m_overflowMutex{};
+		u64						m_bytesPerFrame{ 0 };
+		u64						m_epoch{ 0 };
+		u32						m_frameCount{ 0 };
+		u32						m_currentFrame{ 0 };
+	};
+
+	// STL allocator that takes memory from a frame arena; deallocate() does nothing.
+	// Containers using it must not outlive the frame.
+	template<typename T>
+	class FrameAllocator
+	{
+	public:
+		using value_type = T;
+
+		constexpr explicit FrameAllocator(FrameArena& arena) : m_arena{ &arena } {}
+		template<typename U>
+		constexpr FrameAllocator(const FrameAllocator<U>& other) : m_arena{ other.Arena() } {}
+
+		[[nodiscard]] T* allocate(size_t count) { return m_arena->AllocateArray<T>(count); }
+		void deallocate(T*, size_t) {}
+
+		constexpr FrameArena* Arena() const { return m_arena; }
+
+		template<typename U>
+		constexpr bool operator==(const FrameAllocator<U>& other) const { return m_arena == other.Arena(); }
+		template<typename U>
+		constexpr bool operator!=(const FrameAllocator<U>& other) const { return m_arena != other.Arena(); }
+
+	private:
+		FrameArena* m_arena;
+	};
+
+#if USE_STL_VECTOR
+	// e.g. frame_vector<u32> visible{ FrameAllocator<u32>{ arena } };
+	template<typename T>
+	using frame_vector = std::vector<T, FrameAllocator<T>>;
+#endif
+}
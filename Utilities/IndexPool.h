@@ -0,0 +1,256 @@
+#pragma once
+
+#include "../Common/CommonHeaders.h"
+#include <atomic>
+
+// Thread-safe allocator of indices in [0, capacity), for slot tables and descriptor heaps.
+//
+// Free indices are kept in a lock-free stack that is linked through a per-index "next"
+// array, so the pool doesn't allocate after Initialize(). In front of the stack every
+// thread has a small magazine of indices it owns: most Allocate() and Free() calls only
+// touch the calling thread's magazine, and the shared stack is used in batches when a
+// magazine runs empty or full. Frees can be deferred until the GPU is done with a frame,
+// like DescriptorHeap does.
+//
+// Indices cached in magazines can't be handed out to other threads, so a pool that is
+// shared by many threads should have some slack (up to magazineSize per thread).
+//
+// The pool's memory is tracked under the tag it was initialized with.
+namespace Havana::Utils
+{
+	template<u32 frameCount>
+	class IndexPool
+	{
+	public:
+		constexpr static u32 magazineSize{ 16 };
+		constexpr static u32 transferSize{ magazineSize / 2 };
+
+		IndexPool() = default;
+		explicit IndexPool(u32 capacity, Memory::Tag tag = Memory::Tag::General, Memory::Callsite callsite = MEMORY_CALLSITE)
+		{
+			Initialize(capacity, tag, callsite);
+		}
+		DISABLE_COPY_AND_MOVE(IndexPool);
+		~IndexPool() { Release(); }
+
+		// Not thread-safe. Any indices that are still allocated are lost.
+		void Initialize(u32 capacity, Memory::Tag tag = Memory::Tag::General, Memory::Callsite callsite = MEMORY_CALLSITE)
+		{
+			assert(capacity && capacity < U32_INVALID_ID);
+			Release();
+			m_next = std::make_unique<std::atomic<u32>[]>(capacity);
+			for (u32 i{ 0 }; i < capacity; i++)
+				m_next[i].store(i + 1 < capacity ? i + 1 : U32_INVALID_ID, std::memory_order_relaxed);
+			m_head.store(Pack(0, 0), std::memory_order_relaxed);
+
+			for (std::atomic<u32>& head : m_deferredHeads) head.store(U32_INVALID_ID, std::memory_order_relaxed);
+			m_magazines = std::make_unique<Magazine[]>(maxThreadSlots);
+			m_sharedSize.store(0, std::memory_order_relaxed);
+			m_capacity = capacity;
+			DEBUG_OP(m_isAllocated = std::make_unique<std::atomic<bool>[]>(capacity));
+			m_memory = Memory::Track(tag, (u64)capacity * sizeof(std::atomic<u32>) + maxThreadSlots * sizeof(Magazine), callsite);
+		}
+
+		// Not thread-safe
+		void Release()
+		{
+			if (m_capacity) Memory::Untrack(m_memory);
+			m_next.reset();
+			m_magazines.reset();
+			m_head.store(Pack(U32_INVALID_ID, 0), std::memory_order_relaxed);
+			for (std::atomic<u32>& head : m_deferredHeads) head.store(U32_INVALID_ID, std::memory_order_relaxed);
+			m_sharedSize.store(0, std::memory_order_relaxed);
+			m_capacity = 0;
+			DEBUG_OP(m_isAllocated.reset());
+		}
+
+		/// <summary>
+		/// Allocates a free index.
+		/// </summary>
+		/// <returns>The index, or U32_INVALID_ID if the pool is empty.</returns>
+		[[nodiscard]] u32 Allocate()
+		{
+			assert(m_capacity);
+			const u32 slot{ ThreadSlot() };
+			u32 index{ U32_INVALID_ID };
+			if (slot < maxThreadSlots)
+			{
+				Magazine& magazine{ m_magazines[slot] };
+				if (!magazine.count) Refill(magazine);
+				if (!magazine.count) return U32_INVALID_ID;
+
+				index = magazine.indices[--magazine.count];
+				magazine.size.store(magazine.size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+			else
+			{
+				index = Pop();
+				if (index == U32_INVALID_ID) return U32_INVALID_ID;
+				m_sharedSize.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			DEBUG_OP(assert(!m_isAllocated[index].exchange(true, std::memory_order_relaxed)));
+			return index;
+		}
+
+		// The index can be allocated again right away
+		void Free(u32 index)
+		{
+			assert(index < m_capacity);
+			DEBUG_OP(assert(m_isAllocated[index].exchange(false, std::memory_order_relaxed)));
+
+			const u32 slot{ ThreadSlot() };
+			if (slot < maxThreadSlots)
+			{
+				Magazine& magazine{ m_magazines[slot] };
+				if (magazine.count == magazineSize) Flush(magazine, transferSize);
+
+				magazine.indices[magazine.count++] = index;
+				magazine.size.store(magazine.size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+			}
+			else
+			{
+				Push(index, index);
+				m_sharedSize.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+
+		// The index is returned by ProcessDeferredFree(frameIdx), once the GPU is done with that frame
+		void Free(u32 index, u32 frameIdx)
+		{
+			assert(index < m_capacity && frameIdx < frameCount);
+			DEBUG_OP(assert(m_isAllocated[index].exchange(false, std::memory_order_relaxed)));
+
+			// Nothing is popped from these lists, only taken as a whole, so there's no ABA problem
+			std::atomic<u32>& head{ m_deferredHeads[frameIdx] };
+			u32 first{ head.load(std::memory_order_relaxed) };
+			do
+			{
+				m_next[index].store(first, std::memory_order_relaxed);
+			} while (!head.compare_exchange_weak(first, index, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		void ProcessDeferredFree(u32 frameIdx)
+		{
+			assert(frameIdx < frameCount);
+			const u32 first{ m_deferredHeads[frameIdx].exchange(U32_INVALID_ID, std::memory_order_acquire) };
+			if (first == U32_INVALID_ID) return;
+
+			u32 last{ first };
+			s64 count{ 1 };
+			for (u32 next{ m_next[last].load(std::memory_order_relaxed) }; next != U32_INVALID_ID; next = m_next[last].load(std::memory_order_relaxed))
+			{
+				last = next;
+				count++;
+			}
+
+			Push(first, last);
+			m_sharedSize.fetch_sub(count, std::memory_order_relaxed);
+		}
+
+		// Gives the indices cached by the calling thread back to the shared stack, e.g. before the thread exits
+		void FlushThreadCache()
+		{
+			const u32 slot{ ThreadSlot() };
+			if (slot < maxThreadSlots && m_magazines[slot].count)
+				Flush(m_magazines[slot], m_magazines[slot].count);
+		}
+
+		// Allocated indices, including deferred frees that weren't processed yet. Only exact
+		// when no other thread is allocating or freeing.
+		u32 Size() const
+		{
+			if (!m_magazines) return 0;
+			s64 size{ m_sharedSize.load(std::memory_order_relaxed) };
+			for (u32 i{ 0 }; i < maxThreadSlots; i++)
+				size += m_magazines[i].size.load(std::memory_order_relaxed);
+			assert(size >= 0 && size <= m_capacity);
+			return (u32)size;
+		}
+
+		constexpr u32 Capacity() const { return m_capacity; }
+
+	private:
+		// Only touched by the thread that owns it, apart from size which Size() reads
+		struct alignas(64) Magazine
+		{
+			std::atomic<s64>	size{ 0 };		// allocations minus frees on this thread
+			u32					count{ 0 };
+			u32					indices[magazineSize];
+		};
+
+		// The head of the shared stack is tagged with a counter that changes on every push
+		// and pop, so a pop can't succeed on a head that was popped and pushed back meanwhile.
+		constexpr static u64 Pack(u32 index, u32 tag) { return ((u64)tag << 32) | index; }
+		constexpr static u32 HeadIndex(u64 head) { return (u32)head; }
+		constexpr static u32 HeadTag(u64 head) { return (u32)(head >> 32); }
+
+		// Pushes a chain of indices that is already linked from first to last
+		void Push(u32 first, u32 last)
+		{
+			u64 head{ m_head.load(std::memory_order_relaxed) };
+			do
+			{
+				m_next[last].store(HeadIndex(head), std::memory_order_relaxed);
+			} while (!m_head.compare_exchange_weak(head, Pack(first, HeadTag(head) + 1), std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		u32 Pop()
+		{
+			u32 index{ U32_INVALID_ID };
+			return Pop(&index, 1) ? index : U32_INVALID_ID;
+		}
+
+		// Pops up to maxCount indices with a single exchange of the head. The links are read
+		// before the exchange, but if any of them changed meanwhile so did the head's tag.
+		u32 Pop(u32* const indices, u32 maxCount)
+		{
+			u64 head{ m_head.load(std::memory_order_acquire) };
+			while (true)
+			{
+				u32 count{ 0 };
+				u32 next{ HeadIndex(head) };
+				while (next != U32_INVALID_ID && count < maxCount)
+				{
+					indices[count++] = next;
+					next = m_next[next].load(std::memory_order_relaxed);
+				}
+
+				if (!count) return 0;
+				if (m_head.compare_exchange_weak(head, Pack(next, HeadTag(head) + 1), std::memory_order_acquire, std::memory_order_acquire))
+					return count;
+			}
+		}
+
+		// Stored in reverse, so the first popped index is allocated first
+		void Refill(Magazine& magazine)
+		{
+			u32 popped[transferSize];
+			const u32 count{ Pop(&popped[0], transferSize) };
+			for (u32 i{ 0 }; i < count; i++) magazine.indices[magazine.count++] = popped[count - 1 - i];
+		}
+
+		// Moves the top count indices of the magazine to the shared stack with a single push
+		void Flush(Magazine& magazine, u32 count)
+		{
+			assert(count && count <= magazine.count);
+			const u32 begin{ magazine.count - count };
+			for (u32 i{ begin }; i + 1 < magazine.count; i++)
+				m_next[magazine.indices[i]].store(magazine.indices[i + 1], std::memory_order_relaxed);
+
+			Push(magazine.indices[begin], magazine.indices[magazine.count - 1]);
+			magazine.count = begin;
+		}
+
+		std::unique_ptr<std::atomic<u32>[]>	m_next{};
+		std::unique_ptr<Magazine[]>			m_magazines{};
+		std::atomic<u64>					m_head{ Pack(U32_INVALID_ID, 0) };
+		std::atomic<u32>					m_deferredHeads[frameCount]{};
+		std::atomic<s64>					m_sharedSize{ 0 };	// net allocations outside of magazines
+		Memory::Allocation					m_memory{};
+		u32									m_capacity{ 0 };
+#ifdef _DEBUG
+		std::unique_ptr<std::atomic<bool>[]>	m_isAllocated{};
+#endif // _DEBUG
+	};
+}
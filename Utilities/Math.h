@@ -17,7 +17,7 @@ namespace Havana::Math
 		static_assert(bits <= sizeof(u32) * 8);
 		assert(f >= 0.0f && f <= 1.0f);
 
-		constexpr u32 intervals{ (u32)((1ui32 << bits) - 1) };
+		constexpr u32 intervals{ (u32)((1ull << bits) - 1) };
 
 		return (u32)(intervals * f + 0.5f);
 	}
@@ -26,9 +26,9 @@ namespace Havana::Math
 	constexpr f32 UnpackToUnitFloat(u32 i)
 	{
 		static_assert(bits <= sizeof(u32) * 8);
-		assert(i < (1ui32 << bits));
+		assert(i < (1ull << bits));
 
-		constexpr u32 intervals{ (u32)((1ui32 << bits) - 1) };
+		constexpr u32 intervals{ (u32)((1ull << bits) - 1) };
 
 		return (f32)i / intervals;
 	}
@@ -48,7 +48,7 @@ namespace Havana::Math
 	template<u32 bits>
 	constexpr f32 UnpackToUnitFloat(u32 i, f32 min, f32 max)
 	{
-		assert(max < min);
+		assert(min < max);
 
 		return UnpackToUnitFloat<bits>(i) * (max - min) + min;
 	}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "../Common/CommonHeaders.h"
+#include "IndexPool.h"
+#include <new>
+
+// Fixed-size object pool for engine objects (windows, surfaces, ...) that are referred to
+// by id. Objects live in cache-line aligned slabs that are allocated as the pool fills up
+// and are never moved or freed before Release(), so references stay valid while other
+// objects are added. Slots are handed out by an IndexPool, which makes Add() and Remove()
+// O(1), lock-free and mostly thread-local.
+//
+// Ids are Id::id_type values with a generation: removing an object bumps the generation
+// of its slot, so a stale id is caught by the asserts in Get(). Slots are reused right
+// away, so generations wrap around instead of retiring the slot; a stale id is only
+// missed if it's exactly a multiple of GENERATION_MASK reuses old.
+//
+// Slabs are allocated with Memory::Allocate() under the pool's tag, and in _DEBUG builds
+// under the callsite that initialized the pool.
+namespace Havana::Utils
+{
+	template<typename T, typename Handle = Id::id_type>
+	class ObjectPool
+	{
+	public:
+		constexpr static u32 slabBytes{ 16 * 1024 };
+
+		ObjectPool() = default;
+		explicit ObjectPool(u32 capacity, Memory::Tag tag = Memory::Tag::General, Memory::Callsite callsite = MEMORY_CALLSITE)
+		{
+			Initialize(capacity, tag, callsite);
+		}
+		DISABLE_COPY_AND_MOVE(ObjectPool);
+		~ObjectPool() { Release(); }
+
+		// Not thread-safe. Capacity is rounded up to a whole number of slabs.
+		void Initialize(u32 capacity, Memory::Tag tag = Memory::Tag::General, Memory::Callsite callsite = MEMORY_CALLSITE)
+		{
+			Release();
+			const u32 slabCount{ (capacity + objectsPerSlab - 1) >> slabShift };
+			assert(capacity && (u64)slabCount * objectsPerSlab <= Id::Detail::INDEX_MASK);
+
+			m_slabs = std::make_unique<std::atomic<Slab*>[]>(slabCount);
+			for (u32 i{ 0 }; i < slabCount; i++) m_slabs[i].store(nullptr, std::memory_order_relaxed);
+			m_indices.Initialize(slabCount * objectsPerSlab, tag, callsite);
+			m_slabCount = slabCount;
+			m_tag = tag;
+			m_callsite = callsite;
+		}
+
+		// Not thread-safe. Destroys the objects that are still in the pool.
+		void Release()
+		{
+			if (!m_slabs) return;
+			Clear();
+			for (u32 i{ 0 }; i < m_slabCount; i++)
+				DeleteSlab(m_slabs[i].load(std::memory_order_relaxed));
+			m_slabs.reset();
+			m_indices.Release();
+			m_slabCount = 0;
+		}
+
+		/// <summary>
+		/// Constructs an object in a free slot.
+		/// </summary>
+		/// <returns>The id of the new object, or an invalid id if the pool is full.</returns>
+		template<typename... Args>
+		[[nodiscard]] Handle Add(Args&&... args)
+		{
+			assert(m_slabs);
+			const u32 index{ m_indices.Allocate() };
+			assert(index != U32_INVALID_ID);
+			if (index == U32_INVALID_ID) return Handle{ Id::INVALID_ID };
+
+			Slab& slab{ GetOrCreateSlab(index >> slabShift) };
+			const u32 i{ index & (objectsPerSlab - 1) };
+			new (&slab.objects[i]) T{ std::forward<Args>(args)... };
+			slab.isAlive[i] = true;
+			return Handle{ index | ((Id::id_type)slab.generations[i] << Id::Detail::INDEX_BITS) };
+		}
+
+		// Destroys the object. Objects can be removed by any thread, but not at the same
+		// time as another thread uses them.
+		void Remove(Handle id)
+		{
+			const Id::id_type index{ Id::Index(id) };
+			Slab& slab{ GetSlab(id) };
+			const u32 i{ index & (objectsPerSlab - 1) };
+			reinterpret_cast<T*>(&slab.objects[i])->~T();
+			slab.isAlive[i] = false;
+
+			// The largest generation with the largest index would be INVALID_ID
+			slab.generations[i] = (Id::generation_type)((slab.generations[i] + 1u) % Id::Detail::GENERATION_MASK);
+			m_indices.Free(index);
+		}
+
+		T& Get(Handle id) { return *reinterpret_cast<T*>(&GetSlab(id).objects[Id::Index(id) & (objectsPerSlab - 1)]); }
+		const T& Get(Handle id) const { return const_cast<ObjectPool*>(this)->Get(id); }
+
+		bool IsAlive(Handle id) const
+		{
+			if (!Id::IsValid(id) || (Id::Index(id) >> slabShift) >= m_slabCount) return false;
+			const Slab* const slab{ m_slabs[Id::Index(id) >> slabShift].load(std::memory_order_acquire) };
+			const u32 i{ Id::Index(id) & (objectsPerSlab - 1) };
+			return slab && slab->isAlive[i] && slab->generations[i] == Id::Generation(id);
+		}
+
+		// Calls function(id, object) for every object. Not thread-safe.
+		template<typename F>
+		void ForEach(F&& function)
+		{
+			for (u32 s{ 0 }; s < m_slabCount; s++)
+			{
+				Slab* const slab{ m_slabs[s].load(std::memory_order_relaxed) };
+				if (!slab) continue;
+				for (u32 i{ 0 }; i < objectsPerSlab; i++)
+				{
+					if (!slab->isAlive[i]) continue;
+					const Id::id_type index{ (s << slabShift) | i };
+					function(Handle{ index | ((Id::id_type)slab->generations[i] << Id::Detail::INDEX_BITS) },
+							 *reinterpret_cast<T*>(&slab->objects[i]));
+				}
+			}
+		}
+
+		// Removes all objects. Not thread-safe.
+		void Clear()
+		{
+			ForEach([this](Handle id, T&) { Remove(id); });
+		}
+
+		// Objects in the pool. Only exact when no other thread is adding or removing.
+		u32 Size() const { return m_indices.Size(); }
+		constexpr u32 Capacity() const { return m_slabCount * objectsPerSlab; }
+
+	private:
+		constexpr static u32 cacheLineSize{ 64 };
+		constexpr static u32 objectAlignment{ alignof(T) > cacheLineSize ? (u32)alignof(T) : cacheLineSize };
+
+		// Largest power of 2 of objects that fits in a slab, so slots are found with shifts
+		constexpr static u32 SlabShift()
+		{
+			u32 shift{ 0 };
+			while ((sizeof(T) << (shift + 1)) <= slabBytes) shift++;
+			return shift;
+		}
+		constexpr static u32 slabShift{ SlabShift() };
+		constexpr static u32 objectsPerSlab{ 1u << slabShift };
+
+		struct alignas(objectAlignment) Slab
+		{
+			std::aligned_storage_t<sizeof(T), alignof(T)>	objects[objectsPerSlab];
+			Id::generation_type								generations[objectsPerSlab]{};
+			bool											isAlive[objectsPerSlab]{};
+		};
+
+		Slab& GetSlab(Handle id)
+		{
+			assert(Id::IsValid(id) && (Id::Index(id) >> slabShift) < m_slabCount);
+			Slab* const slab{ m_slabs[Id::Index(id) >> slabShift].load(std::memory_order_acquire) };
+			assert(slab);
+			assert(slab->isAlive[Id::Index(id) & (objectsPerSlab - 1)]);
+			assert(slab->generations[Id::Index(id) & (objectsPerSlab - 1)] == Id::Generation(id));
+			return *slab;
+		}
+
+		// Two threads may get the first index of a new slab at the same time; the one that
+		// loses the race frees its slab.
+		Slab& GetOrCreateSlab(u32 slabIndex)
+		{
+			std::atomic<Slab*>& entry{ m_slabs[slabIndex] };
+			Slab* slab{ entry.load(std::memory_order_acquire) };
+			if (slab) return *slab;
+
+			void* const memory{ Memory::Allocate(m_tag, sizeof(Slab), alignof(Slab), m_callsite) };
+			assert(memory);
+			Slab* const created{ new (memory) Slab{} };
+			if (entry.compare_exchange_strong(slab, created, std::memory_order_acq_rel, std::memory_order_acquire))
+				return *created;
+
+			DeleteSlab(created);
+			return *slab;
+		}
+
+		static void DeleteSlab(Slab* slab)
+		{
+			if (!slab) return;
+			slab->~Slab();
+			Memory::Free(slab);
+		}
+
+		std::unique_ptr<std::atomic<Slab*>[]>	m_slabs{};
+		IndexPool<1>							m_indices{};
+		u32										m_slabCount{ 0 };
+		Memory::Tag								m_tag{ Memory::Tag::General };
+		Memory::Callsite						m_callsite{};
+	};
+}
@@ -37,7 +37,25 @@
 	}
 #endif
 
+#include <atomic>
+
 namespace Havana::Utils
 {
 	// TODO: implement our own containers
+
+	// Per-thread state of the lock-free utilities (index pools, frame arenas) lives in
+	// fixed arrays indexed by this slot. Slots aren't reused; threads past the limit
+	// get maxThreadSlots or more and take the shared, slower paths.
+	constexpr u32 maxThreadSlots{ 64 };
+
+	namespace Detail
+	{
+		inline std::atomic<u32> threadSlotCount{ 0 };
+	}
+
+	inline u32 ThreadSlot()
+	{
+		thread_local const u32 slot{ Detail::threadSlotCount.fetch_add(1, std::memory_order_relaxed) };
+		return slot;
+	}
 }
\ No newline at end of file